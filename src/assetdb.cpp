@@ -7,15 +7,19 @@
 #include <chainparams.h>
 #include <consensus/params.h>
 #include <consensus/validation.h>
+#include <key_io.h>
 #include <tinyformat.h>
 #include <util/system.h>
 #include <validation.h>
 #include <wallet/ismine.h>
 
+#include <algorithm>
+#include <cctype>
+
 static const char ASSET_FLAG = 'A';
 
 std::unique_ptr<CAssetsDB> passetsdb;
-CLRUCache<std::string, CAssetData> *passetsCache = nullptr;
+CAssetsCache *passetsCache = nullptr;
 
 CAssetData::CAssetData(const CAsset& _asset, const CTransactionRef& assetTx, const int& nOut, uint32_t _nTime)
 {
@@ -25,12 +29,12 @@ CAssetData::CAssetData(const CAsset& _asset, const CTransactionRef& assetTx, con
     txhash = assetTx->GetHash();
 
 	for (unsigned int k = 0; k < (assetTx->nVersion >= TX_ELE_VERSION ? assetTx->vpout.size() : assetTx->vout.size()) ; k++){
-		const CTxOutAsset &rout = (assetTx->nVersion >= TX_ELE_VERSION ? assetTx->vpout[k] : assetTx->vout[k]);
+		const CTxOutRef rout = assetTx->GetOutputs()[k];
 		if(rout.scriptPubKey == Params().GetConsensus().mandatory_coinbase_destination)
 			inputAmount = rout.nValue;
 	}
 
-    CTxOutAsset txout = (assetTx->nVersion >= TX_ELE_VERSION ? assetTx->vpout[nOut] : assetTx->vout[nOut]);
+    const CTxOutRef txout = assetTx->GetOutputs()[nOut];
 
     issuingAddress = txout.scriptPubKey;
     if(txout.nValue)
@@ -43,6 +47,111 @@ CAssetData::CAssetData()
     this->SetNull();
 }
 
+CAssetRules::CAssetRules(const CAsset& _asset, const uint256& _txhash) :
+    asset(_asset), txhash(_txhash), nFlags(_asset.nFlags), sName(_asset.getAssetName()), sShortName(_asset.getShortName())
+{
+    ExtractDestination(GetScriptForDestination(DecodeDestination(_asset.sIssuingaddress)), issuer);
+}
+
+//! Case-insensitive FNV-1a hash of an asset name
+static uint64_t NameHash(Span<const char> name)
+{
+    uint64_t hash = 0xcbf29ce484222325;
+    for (char c : name) {
+        hash ^= (unsigned char)std::tolower(c);
+        hash *= 0x100000001b3;
+    }
+    return hash;
+}
+
+static bool NameEquals(Span<const char> name, const std::string& other)
+{
+    return name.size() == other.size() && std::equal(name.begin(), name.end(), other.begin(), [](char a, char b) { return std::tolower(a) == std::tolower(b); });
+}
+
+void CAssetsCache::Put(const std::string& key, const CAssetData& value)
+{
+    if (Exists(key)) {
+        RemoveRules(key);
+    } else if (Size() > 0 && Size() >= MaxSize()) {
+        // about to be evicted
+        RemoveRules(m_cache.GetItemsList().back().first);
+    }
+    m_cache.Put(key, value);
+    if (Exists(key))
+        AddRules(key, value);
+}
+
+void CAssetsCache::Erase(const std::string& key)
+{
+    RemoveRules(key);
+    m_cache.Erase(key);
+}
+
+void CAssetsCache::Clear()
+{
+    m_rules_by_name.clear();
+    m_rules_by_id.clear();
+    m_rules.clear();
+    m_cache.Clear();
+}
+
+void CAssetsCache::AddRules(const std::string& key, const CAssetData& value)
+{
+    const CAssetRules* rules = &m_rules.emplace(key, CAssetRules(value.asset, value.txhash)).first->second;
+    m_rules_by_id.emplace(value.asset.assetID, rules);
+    m_rules_by_name.emplace(NameHash(rules->sName), rules);
+    m_rules_by_name.emplace(NameHash(rules->sShortName), rules);
+}
+
+void CAssetsCache::RemoveRules(const std::string& key)
+{
+    auto it = m_rules.find(key);
+    if (it == m_rules.end())
+        return;
+    const CAssetRules* rules = &it->second;
+    auto erase = [rules](auto& index, auto range) {
+        for (auto i = range.first; i != range.second;) {
+            if (i->second == rules)
+                i = index.erase(i);
+            else
+                ++i;
+        }
+    };
+    erase(m_rules_by_id, m_rules_by_id.equal_range(rules->asset->assetID));
+    erase(m_rules_by_name, m_rules_by_name.equal_range(NameHash(rules->sName)));
+    erase(m_rules_by_name, m_rules_by_name.equal_range(NameHash(rules->sShortName)));
+    m_rules.erase(it);
+}
+
+const CAssetRules* CAssetsCache::FindRules(const CAsset& asset) const
+{
+    auto by_id = m_rules_by_id.find(asset.assetID);
+    if (by_id != m_rules_by_id.end())
+        return by_id->second;
+    return FindName(asset.getAssetNameSpan());
+}
+
+bool CAssetsCache::NameExists(const std::string& name) const
+{
+    return FindName(MakeSpan(name)) != nullptr;
+}
+
+bool CAssetsCache::NameExists(const CAsset& asset) const
+{
+    return FindName(asset.getAssetNameSpan()) || FindName(asset.getShortNameSpan());
+}
+
+const CAssetRules* CAssetsCache::FindName(Span<const char> name) const
+{
+    auto range = m_rules_by_name.equal_range(NameHash(name));
+    for (auto it = range.first; it != range.second; ++it) {
+        if (NameEquals(name, it->second->sName) || NameEquals(name, it->second->sShortName))
+            return it->second;
+    }
+    return nullptr;
+}
+
 CAssetsDB::CAssetsDB(size_t nCacheSize, bool fMemory, bool fWipe) : CDBWrapper(GetDataDir() / "assets", nCacheSize, fMemory, fWipe) {
 }
 
@@ -208,31 +317,15 @@ std::vector<CAsset> GetAllAssets(){
 }
 
 bool assetExists(CAsset assetToCheck, uint256 &txhash){
-    
-    for(auto const& x : passetsCache->GetItemsMap()){
-        CAsset checkasset = x.second->second.asset;
-        txhash = x.second->second.txhash;
-        
-        if(checkasset == assetToCheck)
-            return true;
-        
-        if(iequals(assetToCheck.getAssetName(), checkasset.getAssetName()) || iequals(assetToCheck.getAssetName(), checkasset.getShortName()))
-            return true;
-    }
-    
-    return false;
+    const CAssetRules* rules = passetsCache->FindRules(assetToCheck);
+    if (!rules)
+        return false;
+    txhash = rules->txhash;
+    return true;
 }
 
 bool assetNameExists(std::string assetName){
-    
-    for(auto const& x : passetsCache->GetItemsMap()){
-        CAsset checkasset = x.second->second.asset;
-        
-        if(iequals(assetName, checkasset.getAssetName()) || iequals(assetName, checkasset.getShortName()))
-            return true;
-    }
-    
-    return false;
+    return passetsCache->NameExists(assetName);
 }
 
 bool isSubsidy(CAsset assetToCheck){
@@ -10,6 +10,10 @@
 #include <primitives/block.h>
 #include <lrucache.h>
 #include <dbwrapper.h>
+#include <script/standard.h>
+
+#include <map>
+#include <unordered_map>
 
 class CAssetData
 {
@@ -37,6 +41,64 @@ public:
 };
 
 
+/** Consensus rules of an asset, derived once from its metadata */
+class CAssetRules
+{
+public:
+    CAssetHandle asset;
+    uint256 txhash;
+    uint32_t nFlags;
+    //! Issuer decoded from sIssuingaddress
+    CTxDestination issuer;
+    std::string sName;
+    std::string sShortName;
+
+    explicit CAssetRules(const CAsset& asset, const uint256& txhash);
+
+    bool isLimited() const { return nFlags & AssetMetadata::ASSET_LIMITED; }
+    bool isRestricted() const { return nFlags & AssetMetadata::ASSET_RESTRICTED; }
+    bool isInflatable() const { return nFlags & AssetMetadata::ASSET_INFLATABLE; }
+};
+
+/**
+ * The registered assets, by name, with the rules of each asset indexed by asset ID and by
+ * case-insensitive name and short name, so that they are looked up without scanning the cache.
+ */
+class CAssetsCache
+{
+public:
+    typedef CLRUCache<std::string, CAssetData> Cache;
+
+    explicit CAssetsCache(size_t max_size) : m_cache(max_size) {}
+
+    void Put(const std::string& key, const CAssetData& value);
+    void Erase(const std::string& key);
+    void Clear();
+
+    bool Exists(const std::string& key) const { return m_cache.Exists(key); }
+    size_t Size() const { return m_cache.Size(); }
+    size_t MaxSize() const { return m_cache.MaxSize(); }
+    const std::unordered_map<std::string, Cache::list_iterator_t>& GetItemsMap() { return m_cache.GetItemsMap(); }
+
+    //! Rules of the registered asset with the ID of asset, else of one whose name or short name is the name of asset
+    const CAssetRules* FindRules(const CAsset& asset) const;
+    //! Whether a registered asset has this name or short name, ignoring case
+    bool NameExists(const std::string& name) const;
+    //! Whether a registered asset has the name or the short name of asset as its name or short name
+    bool NameExists(const CAsset& asset) const;
+
+private:
+    void AddRules(const std::string& key, const CAssetData& value);
+    void RemoveRules(const std::string& key);
+    const CAssetRules* FindName(Span<const char> name) const;
+
+    //! The registered assets, the indexes below follow its changes and evictions
+    Cache m_cache;
+    std::map<std::string, CAssetRules> m_rules;
+    std::multimap<CAssetID, const CAssetRules*> m_rules_by_id;
+    std::unordered_multimap<uint64_t, const CAssetRules*> m_rules_by_name;
+};
+
 /** Access to the asset database */
 class CAssetsDB : public CDBWrapper
 {
@@ -66,7 +128,7 @@ public:
 extern std::unique_ptr<CAssetsDB> passetsdb;
 
 /** Global variable that point to the assets metadata LRU Cache (protected by cs_main) */
-extern CLRUCache<std::string, CAssetData> *passetsCache;
+extern CAssetsCache *passetsCache;
 
 void DumpAssets();
 
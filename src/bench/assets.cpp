@@ -0,0 +1,150 @@
+// Copyright (c) 2020 The Crown Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <assetdb.h>
+#include <bench/bench.h>
+#include <chainparams.h>
+#include <coins.h>
+#include <consensus/tx_verify.h>
+#include <consensus/validation.h>
+#include <key_io.h>
+#include <test/util/setup_common.h>
+
+static const size_t NUM_ASSETS = 2500;
+static const size_t NUM_BLOCK_TXS = 1000;
+
+//! The issuer of the bench assets
+static const PKHash ISSUER{uint160(std::vector<unsigned char>(20, 0x42))};
+
+static CAsset BenchAsset(size_t i)
+{
+    std::string shortname;
+    for (size_t n = i, k = 0; k < 4; n /= 26, k++) {
+        shortname += 'A' + n % 26;
+    }
+
+    AssetMetadata metadata;
+    metadata.nVersion = AssetMetadata::CURRENT_VERSION;
+    metadata.nFlags = AssetMetadata::ASSET_TRANSFERABLE | AssetMetadata::ASSET_DIVISIBLE;
+    metadata.nType = AssetMetadata::TOKEN;
+    metadata.setName(strprintf("BENCH%05d", i));
+    metadata.setShortName(shortname);
+    metadata.contract_url = "https://example.com/contracts/benchtoken.pdf";
+    metadata.sIssuingaddress = EncodeDestination(ISSUER);
+    return CAsset(metadata);
+}
+
+//! A cache of registered assets, installed as passetsCache for the lifetime of the object
+class BenchAssetsCache
+{
+public:
+    CAssetsCache cache{NUM_ASSETS};
+    std::vector<CAsset> assets;
+
+    BenchAssetsCache() : prev(passetsCache)
+    {
+        for (size_t i = 0; i < NUM_ASSETS; i++) {
+            assets.push_back(BenchAsset(i));
+            CAssetData data;
+            data.asset = assets.back();
+            data.txhash = InsecureRand256();
+            data.nTime = 1600000000;
+            cache.Put(data.asset.getAssetName(), data);
+        }
+        passetsCache = &cache;
+    }
+    ~BenchAssetsCache()
+    {
+        passetsCache = prev;
+    }
+
+private:
+    CAssetsCache* prev;
+};
+
+static void AssetExists(benchmark::Bench& bench)
+{
+    BasicTestingSetup test_setup{CBaseChainParams::REGTEST};
+    BenchAssetsCache registered;
+
+    bench.batch(NUM_ASSETS).unit("asset").run([&] {
+        uint256 txhash;
+        for (const CAsset& asset : registered.assets) {
+            bool exists = assetExists(asset, txhash);
+            assert(exists);
+        }
+    });
+}
+
+static void AssetNameExists(benchmark::Bench& bench)
+{
+    BasicTestingSetup test_setup{CBaseChainParams::REGTEST};
+    BenchAssetsCache registered;
+
+    bench.batch(NUM_ASSETS).unit("asset").run([&] {
+        for (const CAsset& asset : registered.assets) {
+            bool exists = assetNameExists(asset.getShortName());
+            assert(exists);
+        }
+    });
+}
+
+// Tallying the fees of the transactions of a block, each paying in the subsidy asset and moving one other asset
+static void AmountMapTally(benchmark::Bench& bench)
+{
+    BasicTestingSetup test_setup{CBaseChainParams::REGTEST};
+    const CAsset& subsidy_asset = Params().GetConsensus().subsidy_asset;
+    std::vector<CAmountMap> vFees;
+    for (size_t i = 0; i < NUM_BLOCK_TXS; i++) {
+        CAmountMap fee;
+        fee[subsidy_asset] = 1000 + i;
+        fee[BenchAsset(i % 50)] = i;
+        vFees.push_back(fee);
+    }
+
+    bench.batch(NUM_BLOCK_TXS).unit("tx").run([&] {
+        CAmountMap total;
+        for (const CAmountMap& fee : vFees) {
+            total += fee;
+        }
+        assert(MoneyRange(total));
+        total = total - vFees.front();
+        ankerl::nanobench::doNotOptimizeAway(total);
+    });
+}
+
+// A transfer of a registered asset paying its fee in the subsidy asset
+static void CheckTxInputsAsset(benchmark::Bench& bench)
+{
+    RegTestingSetup test_setup;
+    BenchAssetsCache registered;
+    const CAsset& subsidy_asset = Params().GetConsensus().subsidy_asset;
+    const CAsset& asset = registered.assets[NUM_ASSETS / 2];
+    const CScript script = GetScriptForDestination(ISSUER);
+
+    CCoinsView coinsDummy;
+    CCoinsViewCache coins(&coinsDummy);
+    CMutableTransaction mtx;
+    mtx.nVersion = TX_ELE_VERSION;
+    mtx.vin.emplace_back(COutPoint(InsecureRand256(), 0));
+    mtx.vin.emplace_back(COutPoint(InsecureRand256(), 1));
+    coins.AddCoin(mtx.vin[0].prevout, Coin(CTxOutAsset(asset, 1000 * COIN, script), 1, false, false), false);
+    coins.AddCoin(mtx.vin[1].prevout, Coin(CTxOutAsset(subsidy_asset, 1 * COIN, script), 1, false, false), false);
+    mtx.vpout.emplace_back(asset, 1000 * COIN, script);
+    mtx.vpout.emplace_back(subsidy_asset, 1 * COIN - 1000, script);
+    mtx.vpout.emplace_back(subsidy_asset, 1000, CScript());
+    const CTransaction tx(mtx);
+
+    bench.run([&] {
+        TxValidationState state;
+        CAmountMap txfee;
+        bool success = Consensus::CheckTxInputs(tx, state, coins, 100, txfee);
+        ankerl::nanobench::doNotOptimizeAway(success);
+    });
+}
+
+BENCHMARK(AssetExists);
+BENCHMARK(AssetNameExists);
+BENCHMARK(AmountMapTally);
+BENCHMARK(CheckTxInputsAsset);
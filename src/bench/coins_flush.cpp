@@ -0,0 +1,98 @@
+// Copyright (c) 2020 The Crown Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <bench/bench.h>
+#include <coins.h>
+#include <crypto/common.h>
+#include <dbwrapper.h>
+#include <test/util/setup_common.h>
+#include <txdb.h>
+
+static const size_t NUM_COINS = 10000;
+
+//! An issued asset with metadata of a typical size
+static CAsset BenchAsset()
+{
+    AssetMetadata metadata;
+    metadata.nVersion = AssetMetadata::CURRENT_VERSION;
+    metadata.nFlags = AssetMetadata::ASSET_TRANSFERABLE | AssetMetadata::ASSET_DIVISIBLE;
+    metadata.nType = AssetMetadata::TOKEN;
+    metadata.setName("BENCHTOKEN");
+    metadata.setShortName("BNCH");
+    metadata.contract_url = "https://example.com/contracts/benchtoken.pdf";
+    metadata.sIssuingaddress = "tCRWTY7Lmma9XQpKaGskidUgYMXhcSQ5nGvsB";
+    metadata.scriptcode << OP_DUP << OP_HASH160 << std::vector<unsigned char>(20, 0x42) << OP_EQUALVERIFY << OP_CHECKSIG;
+    CAsset asset(metadata);
+    asset.vchAssetSig.assign(72, 0x30);
+    return asset;
+}
+
+static Coin BenchCoin(const CAsset& asset)
+{
+    CScript script;
+    script << OP_DUP << OP_HASH160 << std::vector<unsigned char>(20, 0x17) << OP_EQUALVERIFY << OP_CHECKSIG;
+    return Coin(CTxOutAsset(asset, 10 * COIN, script), 100, false, false);
+}
+
+static COutPoint BenchOutPoint(size_t i)
+{
+    uint256 hash;
+    WriteLE64(hash.begin(), i);
+    return COutPoint(hash, 0);
+}
+
+//! The dirty entries a cache hands to its parent when flushed
+static void FillCoins(CCoinsMap& mapCoins, const Coin& coin)
+{
+    for (size_t i = 0; i < NUM_COINS; i++) {
+        CCoinsCacheEntry& entry = mapCoins[BenchOutPoint(i)];
+        entry.coin = coin;
+        entry.flags = CCoinsCacheEntry::DIRTY | CCoinsCacheEntry::FRESH;
+    }
+}
+
+//! Key of a coin record with its full asset, as the coin database used to store them
+struct FullAssetEntry {
+    const COutPoint& outpoint;
+    SERIALIZE_METHODS(FullAssetEntry, obj) { READWRITE('C', obj.outpoint.hash, VARINT(obj.outpoint.n)); }
+};
+
+// Flushing asset coins to the coin database, which stores asset ordinals
+static void CoinsFlushAssetOrdinal(benchmark::Bench& bench)
+{
+    BasicTestingSetup test_setup{CBaseChainParams::REGTEST};
+    CCoinsViewDB db("coinsflush", 8 << 20, true, true);
+    const Coin coin = BenchCoin(BenchAsset());
+    uint256 hashBlock = InsecureRand256();
+
+    bench.batch(NUM_COINS).unit("coin").run([&] {
+        CCoinsMap mapCoins;
+        FillCoins(mapCoins, coin);
+        bool success = db.BatchWrite(mapCoins, hashBlock);
+        assert(success);
+    });
+}
+
+// The same coins written with their full asset, as the coin database used to store them
+static void CoinsFlushFullAsset(benchmark::Bench& bench)
+{
+    BasicTestingSetup test_setup{CBaseChainParams::REGTEST};
+    CDBWrapper db("coinsflush", 8 << 20, true, true, true);
+    const Coin coin = BenchCoin(BenchAsset());
+
+    bench.batch(NUM_COINS).unit("coin").run([&] {
+        CCoinsMap mapCoins;
+        FillCoins(mapCoins, coin);
+        CDBBatch batch(db);
+        for (CCoinsMap::iterator it = mapCoins.begin(); it != mapCoins.end();) {
+            batch.Write(FullAssetEntry{it->first}, it->second.coin);
+            it = mapCoins.erase(it);
+        }
+        bool success = db.WriteBatch(batch);
+        assert(success);
+    });
+}
+
+BENCHMARK(CoinsFlushAssetOrdinal);
+BENCHMARK(CoinsFlushFullAsset);
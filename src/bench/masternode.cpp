@@ -0,0 +1,132 @@
+// Copyright (c) 2020 The Crown Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <bench/bench.h>
+#include <chainparams.h>
+#include <crypto/common.h>
+#include <masternode/masternode-budget.h>
+#include <masternode/masternode-payments.h>
+#include <masternode/masternodeman.h>
+#include <script/standard.h>
+#include <test/util/setup_common.h>
+#include <validation.h>
+
+static const size_t NUM_MASTERNODES = 2000;
+static const size_t NUM_PROPOSALS = 10;
+
+static COutPoint CollateralOutPoint(size_t i)
+{
+    uint256 hash;
+    WriteLE64(hash.begin(), i + 1);
+    return COutPoint(hash, 0);
+}
+
+/**
+ * Fill the global masternode list with enabled masternodes whose collateral is
+ * in the chainstate and old enough for them to be paid.
+ */
+static void AddMasternodes(size_t count)
+{
+    LOCK(cs_main);
+    const CAsset& asset = Params().GetConsensus().subsidy_asset;
+    const int nHeight = ::ChainActive().Height();
+    for (size_t i = 0; i < count; i++) {
+        CKey key;
+        key.MakeNewKey(true);
+
+        CMasternode mn;
+        mn.vin = CTxIn(CollateralOutPoint(i));
+        mn.pubkey = key.GetPubKey();
+        mn.pubkey2 = key.GetPubKey();
+        mn.sigTime = GetAdjustedTime() - 30 * 24 * 60 * 60;
+        mn.lastPing = CMasternodePing(mn.vin);
+        mn.unitTest = true;
+        mn.cacheInputAge = count + nHeight;
+        mn.cacheInputAgeBlock = nHeight;
+        mnodeman.Add(mn);
+
+        const CScript script = GetScriptForDestination(PKHash(mn.pubkey));
+        Coin coin(CTxOutAsset(asset, Params().MasternodeCollateral(), script), 1 + i % (nHeight - MASTERNODE_MIN_CONFIRMATIONS), false, false);
+        ::ChainstateActive().CoinsTip().AddCoin(mn.vin.prevout, std::move(coin), false);
+    }
+}
+
+// Scoring every masternode of the list for a block, as the payment election does
+static void MasternodeCalculateScore(benchmark::Bench& bench)
+{
+    TestChain100Setup test_setup;
+    AddMasternodes(NUM_MASTERNODES);
+    const std::vector<CMasternode> vMasternodes = mnodeman.GetFullMasternodeVector();
+    const int64_t nBlockHeight = ::ChainActive().Height();
+
+    bench.batch(vMasternodes.size()).unit("masternode").run([&] {
+        arith_uint256 nHigh = 0;
+        for (const CMasternode& mn : vMasternodes) {
+            nHigh = std::max(nHigh, mn.CalculateScore(nBlockHeight));
+        }
+        ankerl::nanobench::doNotOptimizeAway(nHigh);
+    });
+    mnodeman.Clear();
+}
+
+static void MasternodeRanks(benchmark::Bench& bench)
+{
+    TestChain100Setup test_setup;
+    AddMasternodes(NUM_MASTERNODES);
+    const int64_t nBlockHeight = ::ChainActive().Height();
+
+    bench.run([&] {
+        auto vecMasternodeRanks = mnodeman.GetMasternodeRanks(nBlockHeight);
+        ankerl::nanobench::doNotOptimizeAway(vecMasternodeRanks);
+    });
+    mnodeman.Clear();
+}
+
+static void MasternodeNextInQueueForPayment(benchmark::Bench& bench)
+{
+    TestChain100Setup test_setup;
+    AddMasternodes(NUM_MASTERNODES);
+    const int nBlockHeight = ::ChainActive().Height() + 1;
+
+    bench.run([&] {
+        int nCount = 0;
+        CMasternode* pmn = mnodeman.GetNextMasternodeInQueueForPayment(nBlockHeight, true, nCount);
+        ankerl::nanobench::doNotOptimizeAway(pmn);
+    });
+    mnodeman.Clear();
+}
+
+// Selecting the proposals of the next superblock, each voted for by the whole masternode list
+static void BudgetGetBudget(benchmark::Bench& bench)
+{
+    TestChain100Setup test_setup;
+    AddMasternodes(NUM_MASTERNODES);
+    const std::vector<CMasternode> vMasternodes = mnodeman.GetFullMasternodeVector();
+
+    CBudgetManager budgetman;
+    const int nBlockStart = GetNextSuperblock(::ChainActive().Height());
+    for (size_t i = 0; i < NUM_PROPOSALS; i++) {
+        CBudgetProposal proposal(strprintf("proposal-%d", i), "https://example.com", nBlockStart,
+            nBlockStart + GetBudgetPaymentCycleBlocks() * 12, GetScriptForDestination(PKHash(vMasternodes[i].pubkey)),
+            1 * COIN, InsecureRand256());
+        proposal.nTime = GetTime() - 24 * 60 * 60;
+        for (const CMasternode& mn : vMasternodes) {
+            std::string strError;
+            proposal.AddOrUpdateVote(CBudgetVote(mn.vin, proposal.GetHash(), VOTE_YES), strError);
+        }
+        bool success = budgetman.AddProposal(proposal, false);
+        assert(success);
+    }
+
+    bench.run([&] {
+        auto vBudgetProposals = budgetman.GetBudget();
+        ankerl::nanobench::doNotOptimizeAway(vBudgetProposals);
+    });
+    mnodeman.Clear();
+}
+
+BENCHMARK(MasternodeCalculateScore);
+BENCHMARK(MasternodeRanks);
+BENCHMARK(MasternodeNextInQueueForPayment);
+BENCHMARK(BudgetGetBudget);
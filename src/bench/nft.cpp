@@ -0,0 +1,94 @@
+// Copyright (c) 2020 The Crown Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <bench/bench.h>
+#include <chain.h>
+#include <crypto/common.h>
+#include <platform/nf-token/nf-tokens-manager.h>
+
+static const size_t NUM_BLOCKS = 1000;
+static const size_t NUM_NFTOKENS = 20000;
+static const size_t NUM_OWNERS = 500;
+static const uint64_t NUM_PROTOCOLS = 8;
+
+static uint256 Hash256(uint64_t n, uint64_t salt)
+{
+    uint256 hash;
+    WriteLE64(hash.begin(), n);
+    WriteLE64(hash.begin() + 8, salt);
+    return hash;
+}
+
+static CKeyID OwnerId(size_t i)
+{
+    uint160 id;
+    WriteLE64(id.begin(), i + 1);
+    return CKeyID(id);
+}
+
+/**
+ * An nf-token index as NfTokensManager keeps it, spread over a span of blocks,
+ * a few protocols and a set of owners.
+ */
+class BenchNfTokensIndex
+{
+public:
+    Platform::NfTokensIndexSet index;
+    std::vector<std::shared_ptr<Platform::NfToken>> nfTokens;
+
+    BenchNfTokensIndex() : vBlockHashes(NUM_BLOCKS), vBlocks(NUM_BLOCKS)
+    {
+        for (size_t i = 0; i < NUM_BLOCKS; i++) {
+            vBlockHashes[i] = Hash256(i, 0);
+            vBlocks[i].phashBlock = &vBlockHashes[i];
+            vBlocks[i].nHeight = i;
+        }
+        for (size_t i = 0; i < NUM_NFTOKENS; i++) {
+            auto nfToken = std::make_shared<Platform::NfToken>();
+            nfToken->tokenProtocolId = i % NUM_PROTOCOLS;
+            nfToken->tokenId = Hash256(i, 1);
+            nfToken->tokenOwnerKeyId = OwnerId(i % NUM_OWNERS);
+            nfToken->metadata.assign(64, i & 0xff);
+            index.emplace(&vBlocks[i * NUM_BLOCKS / NUM_NFTOKENS], Hash256(i, 2), nfToken);
+            nfTokens.push_back(nfToken);
+        }
+    }
+
+private:
+    std::vector<uint256> vBlockHashes;
+    std::vector<CBlockIndex> vBlocks;
+};
+
+// Looking up every nf-token by protocol and token id, as OwnerOf and GetNfTokenIndex do
+static void NfTokenLookup(benchmark::Bench& bench)
+{
+    BenchNfTokensIndex nfts;
+    const auto& protocolTokenIndex = nfts.index.get<Platform::Tags::ProtocolIdTokenId>();
+
+    bench.batch(NUM_NFTOKENS).unit("nftoken").run([&] {
+        for (const auto& nfToken : nfts.nfTokens) {
+            auto it = protocolTokenIndex.find(std::make_tuple(nfToken->tokenProtocolId, nfToken->tokenId));
+            assert(it != protocolTokenIndex.end());
+        }
+    });
+}
+
+// Counting the nf-tokens of every owner within a protocol, as BalanceOf does
+static void NfTokenBalanceOf(benchmark::Bench& bench)
+{
+    BenchNfTokensIndex nfts;
+    const auto& protocolOwnerIndex = nfts.index.get<Platform::Tags::ProtocolIdOwnerId>();
+
+    bench.batch(NUM_OWNERS).unit("owner").run([&] {
+        size_t nTotal = 0;
+        for (size_t i = 0; i < NUM_OWNERS; i++) {
+            const auto range = protocolOwnerIndex.equal_range(std::make_tuple(i % NUM_PROTOCOLS, OwnerId(i)));
+            nTotal += std::distance(range.first, range.second);
+        }
+        assert(nTotal == NUM_NFTOKENS / NUM_PROTOCOLS);
+    });
+}
+
+BENCHMARK(NfTokenLookup);
+BENCHMARK(NfTokenBalanceOf);
@@ -0,0 +1,149 @@
+// Copyright (c) 2020 The Crown Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <bench/bench.h>
+#include <smsg/smessage.h>
+#include <test/util/setup_common.h>
+
+#include <secp256k1.h>
+
+static const size_t NUM_BUCKET_MESSAGES = 1000;
+static const size_t NUM_RECEIVE_KEYS = 5;
+
+//! The secp256k1 context CSMSG::Start creates
+class SmsgContext
+{
+public:
+    SmsgContext()
+    {
+        assert(!smsg::secp256k1_context_smsg);
+        smsg::secp256k1_context_smsg = secp256k1_context_create(SECP256K1_CONTEXT_SIGN);
+    }
+    ~SmsgContext()
+    {
+        secp256k1_context_destroy(smsg::secp256k1_context_smsg);
+        smsg::secp256k1_context_smsg = nullptr;
+    }
+};
+
+static CKeyID AddSmsgKey(smsg::CSMSG& smsgModule, uint32_t nFlags)
+{
+    smsg::SecMsgKey key;
+    key.key.MakeNewKey(true);
+    key.nFlags = nFlags;
+    const CKeyID id = key.key.GetPubKey().GetID();
+    smsgModule.keyStore.AddKey(id, key);
+    return id;
+}
+
+//! A message of typical length, long enough to be compressed
+static std::string BenchMessage()
+{
+    std::string message;
+    for (int i = 0; message.size() < 512; i++) {
+        message += strprintf("Secure message line %d, sent to a masternode operator. ", i);
+    }
+    return message;
+}
+
+static void SmsgEncrypt(benchmark::Bench& bench)
+{
+    BasicTestingSetup test_setup{CBaseChainParams::MAIN};
+    SmsgContext context;
+    auto smsgModule = std::make_unique<smsg::CSMSG>();
+    const CKeyID addressFrom = AddSmsgKey(*smsgModule, 0);
+    const CKeyID addressTo = AddSmsgKey(*smsgModule, 0);
+    const std::string message = BenchMessage();
+
+    bench.run([&] {
+        smsg::SecureMessage smsg;
+        int rv = smsgModule->Encrypt(smsg, addressFrom, addressTo, message);
+        assert(rv == smsg::SMSG_NO_ERROR);
+    });
+}
+
+static void SmsgDecrypt(benchmark::Bench& bench)
+{
+    BasicTestingSetup test_setup{CBaseChainParams::MAIN};
+    SmsgContext context;
+    auto smsgModule = std::make_unique<smsg::CSMSG>();
+    const CKeyID addressFrom = AddSmsgKey(*smsgModule, 0);
+    const CKeyID addressTo = AddSmsgKey(*smsgModule, 0);
+    CKey keyTo;
+    smsgModule->keyStore.GetKey(addressTo, keyTo);
+
+    smsg::SecureMessage smsg;
+    int rv = smsgModule->Encrypt(smsg, addressFrom, addressTo, BenchMessage());
+    assert(rv == smsg::SMSG_NO_ERROR);
+
+    bench.run([&] {
+        smsg::MessageData msg;
+        int rv = smsgModule->Decrypt(false, keyTo, addressTo, smsg, msg);
+        assert(rv == smsg::SMSG_NO_ERROR);
+    });
+}
+
+// Proof of work of a free message at the minimum difficulty, from the same nonce every time
+static void SmsgSetHash(benchmark::Bench& bench)
+{
+    TestingSetup test_setup{CBaseChainParams::MAIN};
+    SmsgContext context;
+    auto smsgModule = std::make_unique<smsg::CSMSG>();
+    const CKeyID addressFrom = AddSmsgKey(*smsgModule, 0);
+    const CKeyID addressTo = AddSmsgKey(*smsgModule, 0);
+
+    smsg::SecureMessage smsg;
+    smsg.timestamp = GetTime();
+    int rv = smsgModule->Encrypt(smsg, addressFrom, addressTo, BenchMessage());
+    assert(rv == smsg::SMSG_NO_ERROR);
+
+    const bool fWasEnabled = smsg::fSecMsgEnabled.exchange(true);
+    bench.run([&] {
+        memset(smsg.nonce, 0, sizeof(smsg.nonce));
+        int rv = smsgModule->SetHash(&smsg, smsg.pPayload, smsg.nPayload);
+        assert(rv == smsg::SMSG_NO_ERROR);
+    });
+    smsg::fSecMsgEnabled = fWasEnabled;
+}
+
+// Scanning a bucket of messages addressed to other nodes with the receiving keys of this one
+static void SmsgScanBucket(benchmark::Bench& bench)
+{
+    BasicTestingSetup test_setup{CBaseChainParams::MAIN};
+    SmsgContext context;
+    auto smsgModule = std::make_unique<smsg::CSMSG>();
+    for (size_t i = 0; i < NUM_RECEIVE_KEYS; i++) {
+        AddSmsgKey(*smsgModule, smsg::SMK_RECEIVE_ON | smsg::SMK_RECEIVE_ANON);
+    }
+    const CKeyID addressFrom = AddSmsgKey(*smsgModule, 0);
+    const CKeyID addressTo = AddSmsgKey(*smsgModule, 0);
+    const std::string message = BenchMessage();
+
+    std::vector<std::vector<uint8_t>> vHeaders, vPayloads;
+    for (size_t i = 0; i < NUM_BUCKET_MESSAGES; i++) {
+        smsg::SecureMessage smsg;
+        int rv = smsgModule->Encrypt(smsg, addressFrom, addressTo, message);
+        assert(rv == smsg::SMSG_NO_ERROR);
+        vHeaders.emplace_back(smsg::SMSG_HDR_LEN);
+        smsg.WriteHeader(vHeaders.back().data());
+        vPayloads.emplace_back(smsg.pPayload, smsg.pPayload + smsg.nPayload);
+    }
+
+    bench.batch(NUM_BUCKET_MESSAGES).unit("message").run([&] {
+        std::vector<smsg::SecMsgScanItem> items;
+        items.reserve(NUM_BUCKET_MESSAGES);
+        for (size_t i = 0; i < NUM_BUCKET_MESSAGES; i++) {
+            items.emplace_back(vHeaders[i].data(), vPayloads[i].data(), vPayloads[i].size());
+        }
+        smsgModule->ScanMessages(items, false);
+        for (const auto& item : items) {
+            assert(!item.fOwnMessage);
+        }
+    });
+}
+
+BENCHMARK(SmsgEncrypt);
+BENCHMARK(SmsgDecrypt);
+BENCHMARK(SmsgSetHash);
+BENCHMARK(SmsgScanBucket);
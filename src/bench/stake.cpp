@@ -0,0 +1,32 @@
+// Copyright (c) 2020 The Crown Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <amount.h>
+#include <arith_uint256.h>
+#include <bench/bench.h>
+#include <pos/kernel.h>
+#include <pos/stakeminer.h>
+#include <uint256.h>
+
+//! Seconds searched per stake pointer, as in CreateCoinStake
+static const uint32_t STAKE_SEARCH_SECONDS = 30;
+
+// Searching a stake pointer for a proof against a target it never meets, the
+// common case for each pointer on every CreateCoinStake attempt
+static void StakeSearchTimeSpan(benchmark::Bench& bench)
+{
+    const COutPoint outpoint(uint256S("0x5d6e5cb9b0e2b0a3b8d1b1c1a0d4e6f7a8b9c0d1e2f3a4b5c6d7e8f9a0b1c2d3"), 1);
+    const uint256 nStakeModifier = uint256S("0x9a8b7c6d5e4f3a2b1c0d9e8f7a6b5c4d3e2f1a0b9c8d7e6f5a4b3c2d1e0f9a8b");
+    const uint32_t nTimeBlockFrom = 1600000000;
+    const uint32_t nTime = nTimeBlockFrom + 3600;
+    const uint256 nTarget = ArithToUint256(arith_uint256().SetCompact(0x1800ffff));
+
+    bench.batch(STAKE_SEARCH_SECONDS + 1).unit("second").run([&] {
+        Kernel kernel(outpoint, 10000 * COIN, nStakeModifier, nTimeBlockFrom, nTime);
+        bool found = SearchTimeSpan(kernel, nTime, nTime + STAKE_SEARCH_SECONDS, nTarget);
+        assert(!found);
+    });
+}
+
+BENCHMARK(StakeSearchTimeSpan);
@@ -0,0 +1,60 @@
+// Copyright (c) 2020 The Crown Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <bench/bench.h>
+#include <primitives/transaction.h>
+
+static const size_t NUM_OUTPUTS = 1000;
+
+static CTransaction AssetTransaction()
+{
+    AssetMetadata metadata;
+    metadata.nVersion = AssetMetadata::CURRENT_VERSION;
+    metadata.nType = AssetMetadata::TOKEN;
+    metadata.setName("BENCHTOKEN");
+    metadata.setShortName("BNCH");
+    metadata.contract_url = "https://example.com/contracts/benchtoken.pdf";
+    const CAsset asset(metadata);
+
+    CMutableTransaction mtx;
+    mtx.nVersion = TX_ELE_VERSION;
+    for (size_t i = 0; i < NUM_OUTPUTS; i++) {
+        CScript script;
+        script << OP_DUP << OP_HASH160 << std::vector<unsigned char>(20, i & 0xff) << OP_EQUALVERIFY << OP_CHECKSIG;
+        mtx.vpout.emplace_back(asset, COIN, script);
+    }
+    return CTransaction(mtx);
+}
+
+// Summing the outputs of a transaction through copies of each output. A copy duplicates the
+// script, inline for these standard ones, and takes a reference on the shared asset.
+static void TxOutputsCopy(benchmark::Bench& bench)
+{
+    const CTransaction tx = AssetTransaction();
+    bench.batch(NUM_OUTPUTS).unit("output").run([&] {
+        CAmount nValue = 0;
+        for (size_t k = 0; k < tx.GetNumVOuts(); k++) {
+            CTxOutAsset out = (tx.nVersion >= TX_ELE_VERSION ? tx.vpout[k] : tx.vout[k]);
+            nValue += out.nValue + out.scriptPubKey.size();
+        }
+        ankerl::nanobench::doNotOptimizeAway(nValue);
+    });
+}
+
+// The same through the output view, which refers to the outputs in place. Only the time is
+// compared: neither loop allocates, since the scripts fit in the inline buffer and assets are shared.
+static void TxOutputsView(benchmark::Bench& bench)
+{
+    const CTransaction tx = AssetTransaction();
+    bench.batch(NUM_OUTPUTS).unit("output").run([&] {
+        CAmount nValue = 0;
+        for (const CTxOutRef out : tx.GetOutputs()) {
+            nValue += out.nValue + out.scriptPubKey.size();
+        }
+        ankerl::nanobench::doNotOptimizeAway(nValue);
+    });
+}
+
+BENCHMARK(TxOutputsCopy);
+BENCHMARK(TxOutputsView);
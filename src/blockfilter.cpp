@@ -232,7 +232,7 @@ static GCSFilter::ElementSet BasicFilterElements(const CBlock& block,
 
     for (const CTransactionRef& tx : block.vtx) {
         for (size_t o = 0; o < (tx->nVersion >= TX_ELE_VERSION ? tx->vpout.size() : tx->vout.size()); o++) {
-            const CTxOutAsset &txout = (tx->nVersion >= TX_ELE_VERSION ? tx->vpout[o] : tx->vout[o]);
+            const CTxOutRef txout = tx->GetOutputs()[o];
 			const CScript& script = txout.scriptPubKey;
 			if (script.empty() || script[0] == OP_RETURN) continue;
 			elements.emplace(script.begin(), script.end());
@@ -681,4 +681,6 @@ void SelectParams(const std::string& network)
 {
     SelectBaseParams(network);
     globalChainParams = CreateChainParams(gArgs, network);
+    // most outputs hold the subsidy asset
+    CAssetHandle::PreIntern(globalChainParams->GetConsensus().subsidy_asset);
 }
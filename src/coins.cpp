@@ -15,6 +15,8 @@ uint256 CCoinsView::GetBestBlock() const { return uint256(); }
 std::vector<uint256> CCoinsView::GetHeadBlocks() const { return std::vector<uint256>(); }
 bool CCoinsView::BatchWrite(CCoinsMap &mapCoins, const uint256 &hashBlock) { return false; }
 CCoinsViewCursor *CCoinsView::Cursor() const { return nullptr; }
+bool CCoinsView::GetAssetSupply(CAmountMap &supply) const { return false; }
+void CCoinsView::AddAssetSupply(const CAmountMap &delta) { }
 
 bool CCoinsView::HaveCoin(const COutPoint &outpoint) const
 {
@@ -31,6 +33,8 @@ void CCoinsViewBacked::SetBackend(CCoinsView &viewIn) { base = &viewIn; }
 bool CCoinsViewBacked::BatchWrite(CCoinsMap &mapCoins, const uint256 &hashBlock) { return base->BatchWrite(mapCoins, hashBlock); }
 CCoinsViewCursor *CCoinsViewBacked::Cursor() const { return base->Cursor(); }
 size_t CCoinsViewBacked::EstimateSize() const { return base->EstimateSize(); }
+bool CCoinsViewBacked::GetAssetSupply(CAmountMap &supply) const { return base->GetAssetSupply(supply); }
+void CCoinsViewBacked::AddAssetSupply(const CAmountMap &delta) { base->AddAssetSupply(delta); }
 
 SaltedOutpointHasher::SaltedOutpointHasher() : k0(GetRand(std::numeric_limits<uint64_t>::max())), k1(GetRand(std::numeric_limits<uint64_t>::max())) {}
 
@@ -95,6 +99,16 @@ void CCoinsViewCache::AddCoin(const COutPoint &outpoint, Coin&& coin, bool possi
         // DIRTY, then it can be marked FRESH.
         fresh = !(it->second.flags & CCoinsCacheEntry::DIRTY);
     }
+    if (!it->second.coin.IsSpent()) {
+        cacheAssetSupply[it->second.coin.out.nAsset] -= it->second.coin.out.nValue;
+    } else if (inserted && possible_overwrite) {
+        // The coin being overwritten may only exist in the parent view
+        Coin prev;
+        if (base->GetCoin(outpoint, prev)) {
+            cacheAssetSupply[prev.out.nAsset] -= prev.out.nValue;
+        }
+    }
+    cacheAssetSupply[coin.out.nAsset] += coin.out.nValue;
     it->second.coin = std::move(coin);
     it->second.flags |= CCoinsCacheEntry::DIRTY | (fresh ? CCoinsCacheEntry::FRESH : 0);
     cachedCoinsUsage += it->second.coin.DynamicMemoryUsage();
@@ -127,6 +141,9 @@ bool CCoinsViewCache::SpendCoin(const COutPoint &outpoint, Coin* moveout) {
     CCoinsMap::iterator it = FetchCoin(outpoint);
     if (it == cacheCoins.end()) return false;
     cachedCoinsUsage -= it->second.coin.DynamicMemoryUsage();
+    if (!it->second.coin.IsSpent()) {
+        cacheAssetSupply[it->second.coin.out.nAsset] -= it->second.coin.out.nValue;
+    }
     if (moveout) {
         *moveout = std::move(it->second.coin);
     }
@@ -229,7 +246,20 @@ bool CCoinsViewCache::BatchWrite(CCoinsMap &mapCoins, const uint256 &hashBlockIn
     return true;
 }
 
+bool CCoinsViewCache::GetAssetSupply(CAmountMap &supply) const {
+    if (!base->GetAssetSupply(supply))
+        return false;
+    supply += cacheAssetSupply;
+    return true;
+}
+
+void CCoinsViewCache::AddAssetSupply(const CAmountMap &delta) {
+    cacheAssetSupply += delta;
+}
+
 bool CCoinsViewCache::Flush() {
+    base->AddAssetSupply(cacheAssetSupply);
+    cacheAssetSupply.clear();
     bool fOk = base->BatchWrite(cacheCoins, hashBlock);
     cacheCoins.clear();
     cachedCoinsUsage = 0;
@@ -19,8 +19,6 @@
 
 #include <functional>
 #include <unordered_map>
-#include <insight/addressindex.h>
-#include <insight/spentindex.h>
 
 /**
  * A UTXO entry.
@@ -246,6 +244,12 @@ public:
 
     //! Estimate database size (0 if not implemented)
     virtual size_t EstimateSize() const { return 0; }
+
+    //! Retrieve the total unspent amount per asset, false if this view doesn't track it
+    virtual bool GetAssetSupply(CAmountMap &supply) const;
+
+    //! Apply a change of the per asset supply, to be persisted with the next BatchWrite
+    virtual void AddAssetSupply(const CAmountMap &delta);
 };
 
 
@@ -265,6 +269,8 @@ public:
     bool BatchWrite(CCoinsMap &mapCoins, const uint256 &hashBlock) override;
     CCoinsViewCursor *Cursor() const override;
     size_t EstimateSize() const override;
+    bool GetAssetSupply(CAmountMap &supply) const override;
+    void AddAssetSupply(const CAmountMap &delta) override;
 };
 
 
@@ -284,12 +290,11 @@ public:
     /* Cached dynamic memory usage for the inner Coin objects. */
     mutable size_t cachedCoinsUsage;
 
-    mutable std::vector<std::pair<CAddressIndexKey, CAmount> > addressIndex;
-    mutable std::vector<std::pair<CAddressUnspentKey, CAddressUnspentValue> > addressUnspentIndex;
-    mutable std::vector<std::pair<CSpentIndexKey, CSpentIndexValue> > spentIndex;
-
     mutable std::vector<std::pair<COutPoint, SpentCoin> > spent_cache;
 
+    /* Change of the per asset supply caused by the coins added and spent in this cache. */
+    CAmountMap cacheAssetSupply;
+
 public:
     CCoinsViewCache(CCoinsView *baseIn);
 
@@ -307,6 +312,8 @@ public:
     CCoinsViewCursor* Cursor() const override {
         throw std::logic_error("CCoinsViewCache cursor iteration not supported.");
     }
+    bool GetAssetSupply(CAmountMap &supply) const override;
+    void AddAssetSupply(const CAmountMap &delta) override;
 
     /**
      * Check if we have the given utxo already loaded in this cache.
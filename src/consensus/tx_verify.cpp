@@ -118,7 +118,7 @@ unsigned int GetLegacySigOpCount(const CTransaction& tx)
     }
 
     for(unsigned int k = 0; k < (tx.nVersion >= TX_ELE_VERSION ? tx.vpout.size() : tx.vout.size()) ; k++){
-        CTxOutAsset txout = (tx.nVersion >= TX_ELE_VERSION ? tx.vpout[k] : tx.vout[k]);
+        const CTxOutRef txout = tx.GetOutputs()[k];
         nSigOps += txout.scriptPubKey.GetSigOpCount(false);
     }
     return nSigOps;
@@ -209,8 +209,8 @@ bool Consensus::CheckTxInputs(const CTransaction& tx, TxValidationState& state,
     if(tx.nVersion >= TX_ELE_VERSION && inputAssets.size() < 1)
         return state.Invalid(TxValidationResult::TX_CONSENSUS, "bad-txns-input-size");
 
-    CAsset subsidy_asset = GetSubsidyAsset();
-    CAsset dev_asset = GetDevAsset(); //exposed for asset conversion tests
+    const CAsset& subsidy_asset = ::Params().GetConsensus().subsidy_asset;
+    const CAsset& dev_asset = ::Params().GetConsensus().dev_asset; //exposed for asset conversion tests
 
     // enforce asset rules
     {
@@ -236,24 +236,32 @@ bool Consensus::CheckTxInputs(const CTransaction& tx, TxValidationState& state,
                return state.Invalid(TxValidationResult::TX_CONSENSUS, "bad-txns-input-asset-not-transferable ", strprintf("Asset : (%s)", b.first.ToString(false)));
 
         for(auto & a : outputAssets){
-            CAsset asset = a.first;
-            uint256 thash = uint256();
-            bool exists = assetExists(asset, thash);
+            const CAsset& asset = a.first;
+            const CAssetRules* registered = passetsCache->FindRules(asset);
+            bool exists = registered != nullptr;
 
             //Asset exists , check for output rules
             if (exists && asset != subsidy_asset) {
+                // outputs normally carry the registered asset itself, whose rules are precompiled
+                std::unique_ptr<CAssetRules> output_rules;
+                const CAssetRules* rules = registered;
+                if (!registered->asset->IsIdentical(asset)) {
+                    output_rules = std::make_unique<CAssetRules>(asset, registered->txhash);
+                    rules = output_rules.get();
+                }
+
                 // check asset limited
 
-                if(asset.isLimited() && inputAssets.begin()->first != asset && thash != tx.GetHash())
+                if(rules->isLimited() && inputAssets.begin()->first != asset && registered->txhash != tx.GetHash())
                      return state.Invalid(TxValidationResult::TX_CONSENSUS, "bad-txns-output-asset-is-limited", strprintf("cannot convert other assets to (%s)", asset.getAssetName()));
 
                 // check asset restricted
 
-                CTxDestination address1, issuer;
+                CTxDestination address1;
                 ExtractDestination(input_addresses.front(), address1);
-                ExtractDestination(GetScriptForDestination(DecodeDestination(asset.sIssuingaddress)), issuer);
+                const CTxDestination& issuer = rules->issuer;
 
-                if(asset.isRestricted()){
+                if(rules->isRestricted()){
                     if(input_addresses.size() != 1)
                         return state.Invalid(TxValidationResult::TX_CONSENSUS, "bad-txns-input-issuer-multiple", strprintf("Inputs for this restricted asset must come from (%s) only", asset.sIssuingaddress));
 
@@ -263,8 +271,8 @@ bool Consensus::CheckTxInputs(const CTransaction& tx, TxValidationState& state,
                 }
 
                 // check asset inflation
-                if(asset.isInflatable()){
-                    if(EncodeDestination(issuer) != EncodeDestination(address1))
+                if(rules->isInflatable()){
+                    if(!(issuer == address1))
                         return state.Invalid(TxValidationResult::TX_CONSENSUS, "bad-txns-inflation-issuer-mismatch", strprintf("(%s) vs (%s) only", asset.sIssuingaddress, EncodeDestination(address1)));
                 }
             }
@@ -284,13 +292,13 @@ bool Consensus::CheckTxInputs(const CTransaction& tx, TxValidationState& state,
                 if (asset.nVersion > 1)
                     return state.Invalid(TxValidationResult::TX_CONSENSUS, strprintf("invalid asset version %d \n", asset.nVersion));
 
-                if(asset.getAssetName() == "" || asset.getAssetName().length() < 4)
+                if(asset.getAssetNameSpan().size() < 4)
                     return state.Invalid(TxValidationResult::TX_CONSENSUS, strprintf("invalid asset name %s \n", asset.sAssetName));
 
-                if(asset.getShortName() == "" || asset.getShortName().length() < 3)
+                if(asset.getShortNameSpan().size() < 3)
                     return state.Invalid(TxValidationResult::TX_CONSENSUS, strprintf("invalid asset symbol %s \n", asset.sAssetShortName));
 
-                if(assetNameExists(asset.getAssetName()) || assetNameExists(asset.getShortName()))
+                if(passetsCache->NameExists(asset))
                     return state.Invalid(TxValidationResult::TX_CONSENSUS, "bad-txns-asset-name", strprintf("asset name/shortname %s / %s  already in use", asset.getAssetName(), asset.getShortName()));
 
                 if(asset.nExpiry != 0 && asset.nExpiry < tx.nTime)// TODO (Why on earth do transactions not have time ?
@@ -384,10 +392,10 @@ bool Consensus::CheckTxInputs(const CTransaction& tx, TxValidationState& state,
     if(tx.nVersion >= TX_ELE_VERSION){
 
         for (unsigned int k = 0; k < tx.vpout.size(); k++){
-            if(tx.vpout[k].nAsset.IsEmpty())
+            if(tx.vpout[k].nAsset->IsEmpty())
                 return state.Invalid(TxValidationResult::TX_CONSENSUS, "bad-txns-vout-not-explicit-asset", strprintf("%s: %s", __func__, tx.ToString()));
 
-            if((!tx.vpout[k].nAsset.isDivisible() || tx.vpout[k].nAsset.nType == 2) && tx.vpout[k].nValue % COIN != 0)
+            if((!tx.vpout[k].nAsset->isDivisible() || tx.vpout[k].nAsset->nType == 2) && tx.vpout[k].nValue % COIN != 0)
                 return state.Invalid(TxValidationResult::TX_CONSENSUS, "bad-txns-nft-divisible", strprintf("%s: %s", __func__, tx.ToString()));
 
         }
@@ -22,6 +22,7 @@ static inline size_t RecursiveDynamicUsage(const CTxIn& in) {
 }
 
 static inline size_t RecursiveDynamicUsage(const CTxOutAsset& out) {
+    // the asset is shared by every output holding it, see CAssetHandle::DynamicMemoryUsage
     return RecursiveDynamicUsage(out.scriptPubKey);
 }
 
@@ -5,6 +5,7 @@
 
 #include <base58.h>
 #include <consensus/validation.h>
+#include <hash.h>
 #include <crown/instantx.h>
 #include <crown/legacycalls.h>
 #include <crown/legacysigner.h>
@@ -12,6 +13,7 @@
 #include <key.h>
 #include <masternode/activemasternode.h>
 #include <masternode/masternodeman.h>
+#include <memusage.h>
 #include <net.h>
 #include <net_processing.h>
 #include <netmessagemaker.h>
@@ -25,6 +27,13 @@
 
 CInstantSend instantSend;
 
+// height of the tip, -1 without one
+static int GetChainHeight()
+{
+    LOCK(cs_main);
+    return ::ChainActive().Height();
+}
+
 //step 1.) Broadcast intention to lock transaction inputs, "txlreg", CTransaction
 //step 2.) Top INSTANTX_SIGNATURES_TOTAL masternodes, open connect to top 1 masternode.
 //         Send "txvote", CTransaction, Signature, Approve
@@ -39,24 +48,25 @@ void CInstantSend::ProcessMessage(CNode* pfrom, const std::string& strCommand, C
 
     //! instantsend
     if (strCommand == NetMsgType::IX) {
-        CMutableTransaction tx;
-        vRecv >> tx;
+        CTransactionRef ptx;
+        vRecv >> ptx;
+        const CTransaction& tx = *ptx;
 
         uint256 txHash = tx.GetHash();
         CInv inv(MSG_TXLOCK_REQUEST, txHash);
         pfrom->AddInventoryKnown(inv);
 
-        if (mapTxLockReq.count(txHash) || mapTxLockReqRejected.count(txHash))
+        if (TxLockRequested(txHash))
             return;
 
-        if (!IsIxTxValid(MakeTransactionRef(tx)))
+        if (!IsIxTxValid(ptx))
             return;
 
         // Check if transaction is old for lock
         if (GetTransactionAge(txHash) > m_acceptedBlockCount)
             return;
 
-        int64_t nBlockHeight = CreateNewLock(tx);
+        int64_t nBlockHeight = CreateNewLock(ptx);
         if (nBlockHeight == 0)
             return;
 
@@ -64,16 +74,16 @@ void CInstantSend::ProcessMessage(CNode* pfrom, const std::string& strCommand, C
         bool fAccepted = false;
         {
             LOCK(cs_main);
-            fAccepted = AcceptToMemoryPool(*g_rpc_node->mempool, state, MakeTransactionRef(tx), nullptr, true);
+            fAccepted = AcceptToMemoryPool(*g_rpc_node->mempool, state, ptx, nullptr, true);
         }
 
+        LOCK(cs);
         if (fAccepted) {
+            mapTxLockReq.emplace(txHash, ptx);
             connman->RelayInv(inv);
 
             DoConsensusVote(tx, nBlockHeight, *connman);
 
-            mapTxLockReq.insert(std::make_pair(txHash, tx));
-
             LogPrintf("ProcessMessageInstantX::ix - Transaction Lock Request: %s %s : accepted %s\n",
                 pfrom->addr.ToString().c_str(), pfrom->cleanSubVer.c_str(),
                 txHash.ToString().c_str());
@@ -81,7 +91,7 @@ void CInstantSend::ProcessMessage(CNode* pfrom, const std::string& strCommand, C
             return;
 
         } else {
-            mapTxLockReqRejected.insert(std::make_pair(txHash, tx));
+            mapTxLockReqRejected.emplace(txHash, ptx);
 
             // can we get the conflicting transaction as proof?
 
@@ -90,22 +100,20 @@ void CInstantSend::ProcessMessage(CNode* pfrom, const std::string& strCommand, C
                 txHash.ToString().c_str());
 
             for (const auto& in : tx.vin) {
-                if (!mapLockedInputs.count(in.prevout)) {
-                    mapLockedInputs.insert(std::make_pair(in.prevout, txHash));
-                }
+                mapLockedInputs.emplace(in.prevout, txHash);
             }
 
             // resolve conflicts
-            std::map<uint256, CTransactionLock>::iterator i = mapTxLocks.find(txHash);
+            auto i = mapTxLocks.find(txHash);
             if (i != mapTxLocks.end()) {
                 //we only care if we have a complete tx lock
                 if ((*i).second.CountSignatures() >= INSTANTX_SIGNATURES_REQUIRED) {
                     if (!CheckForConflictingLocks(tx)) {
                         LogPrintf("ProcessMessageInstantX::ix - Found Existing Complete IX Lock\n");
 
-                        //reprocess the last 15 blocks
-                        ReprocessBlocks(15);
-                        mapTxLockReq.insert(std::make_pair(txHash, tx));
+                        //reconsider the blocks rejected for conflicting with this lock
+                        ReprocessLockedBlocks(txHash);
+                        mapTxLockReq.emplace(txHash, ptx);
                     }
                 }
             }
@@ -124,7 +132,8 @@ void CInstantSend::ProcessMessage(CNode* pfrom, const std::string& strCommand, C
         CInv inv(MSG_TXLOCK_VOTE, ctxHash);
         pfrom->AddInventoryKnown(inv);
 
-        if (mapTxLockVote.find(ctx.GetHash()) != mapTxLockVote.end())
+        LOCK(cs);
+        if (mapTxLockVote.count(ctxHash))
             return;
 
         // Check if transaction is old for lock
@@ -134,7 +143,7 @@ void CInstantSend::ProcessMessage(CNode* pfrom, const std::string& strCommand, C
             return;
         }
 
-        mapTxLockVote.insert(std::pair(ctx.GetHash(), ctx));
+        AddLockVote(ctx);
 
         if (ProcessConsensusVote(pfrom, ctx, *connman)) {
             /*
@@ -142,20 +151,23 @@ void CInstantSend::ProcessMessage(CNode* pfrom, const std::string& strCommand, C
                 This tracks those messages and allows it at the same rate of the rest of the network, if
                 a peer violates it, it will simply be ignored
             */
-            if (!mapTxLockReq.count(ctx.txHash) && !mapTxLockReqRejected.count(ctx.txHash)) {
-                if (!mapUnknownVotes.count(ctx.vinMasternode.prevout.hash)) {
-                    mapUnknownVotes[ctx.vinMasternode.prevout.hash] = GetTime() + (60 * 10);
+            if (!TxLockRequested(ctx.txHash)) {
+                const uint256& mnHash = ctx.vinMasternode.prevout.hash;
+                auto itUnknown = mapUnknownVotes.find(mnHash);
+                if (itUnknown == mapUnknownVotes.end()) {
+                    SetUnknownVoteTime(mnHash, GetTime() + (60 * 10));
+                    itUnknown = mapUnknownVotes.find(mnHash);
                 }
 
-                if(mapUnknownVotes[ctx.vinMasternode.prevout.hash] > GetTime() &&
-                    mapUnknownVotes[ctx.vinMasternode.prevout.hash] - GetAverageVoteTime() > 60*10){
+                if(itUnknown->second > GetTime() &&
+                    itUnknown->second - GetAverageVoteTime() > 60*10){
                         LogPrintf("ProcessMessageInstantX::ix - masternode is spamming transaction votes: %s %s\n",
                             ctx.vinMasternode.ToString().c_str(),
                             ctx.txHash.ToString().c_str()
                         );
                         return;
                 } else {
-                    mapUnknownVotes[ctx.vinMasternode.prevout.hash] = GetTime()+(60*10);
+                    SetUnknownVoteTime(mnHash, GetTime()+(60*10));
                 }
             }
             connman->RelayInv(inv);
@@ -165,8 +177,8 @@ void CInstantSend::ProcessMessage(CNode* pfrom, const std::string& strCommand, C
 
     //! instantx lock list
     if (strCommand == NetMsgType::IXLOCKLIST) {
-        std::map<uint256, CConsensusVote>::const_iterator it = mapTxLockVote.begin();
-        for (; it != mapTxLockVote.end(); ++it) {
+        LOCK(cs);
+        for (auto it = mapTxLockVote.begin(); it != mapTxLockVote.end(); ++it) {
             CInv inv(MSG_TXLOCK_VOTE, it->second.GetHash());
             pfrom->AddInventoryKnown(inv);
 
@@ -191,7 +203,7 @@ bool CInstantSend::IsIxTxValid(const CTransactionRef& txCollateral) const
     bool missingTx = false;
 
     for (unsigned int k = 0; k <  (txCollateral->nVersion >= TX_ELE_VERSION ? txCollateral->vpout.size() : txCollateral->vout.size()) ; k++){
-        CTxOutAsset o = (txCollateral->nVersion >= TX_ELE_VERSION ? txCollateral->vpout[k] : txCollateral->vout[k]);
+        const CTxOutRef o = txCollateral->GetOutputs()[k];
         nValueOut += o.nValue;
     }
 
@@ -230,13 +242,13 @@ bool CInstantSend::IsIxTxValid(const CTransactionRef& txCollateral) const
     return true;
 }
 
-int64_t CInstantSend::CreateNewLock(const CMutableTransaction& tx)
+int64_t CInstantSend::CreateNewLock(const CTransactionRef& tx)
 {
     LOCK(cs);
 
     int64_t nTxAge = 0;
-    uint256 txHash = tx.GetHash();
-    for (const auto& i : tx.vin) {
+    uint256 txHash = tx->GetHash();
+    for (const auto& i : tx->vin) {
         nTxAge = GetUTXOConfirmations(i.prevout);
         if (nTxAge < 5) //1 less than the "send IX" gui requires, incase of a block propagating the network at the time
         {
@@ -250,32 +262,42 @@ int64_t CInstantSend::CreateNewLock(const CMutableTransaction& tx)
         This prevents attackers from using transaction mallibility to predict which masternodes
         they'll use.
     */
-    int nBlockHeight = (::ChainActive().Tip()->nHeight - nTxAge) + 4;
+    int nTipHeight = GetChainHeight();
+    int nBlockHeight = (nTipHeight - nTxAge) + 4;
 
-    if (!mapTxLocks.count(txHash)) {
+    auto it = mapTxLocks.find(txHash);
+    if (it == mapTxLocks.end()) {
         LogPrintf("CreateNewLock - New Transaction Lock %s !\n", txHash.ToString().c_str());
 
         CTransactionLock newLock;
         newLock.nBlockHeight = nBlockHeight;
         newLock.txHash = txHash;
-        mapTxLocks.insert(std::pair(txHash, newLock));
+        newLock.m_nExpiryHeight = nTipHeight + m_acceptedBlockCount;
+        mapExpiry[newLock.m_nExpiryHeight].vLocks.push_back(txHash);
+        mapTxLocks.emplace(txHash, newLock);
     } else {
-        mapTxLocks[txHash].nBlockHeight = nBlockHeight;
+        it->second.nBlockHeight = nBlockHeight;
         LogPrintf("CreateNewLock - Transaction Lock Exists %s !\n", txHash.ToString().c_str());
     }
 
-    mapTxLockReq.insert(std::make_pair(txHash, tx));
     return nBlockHeight;
 }
 
+// remember a lock request, once its transaction is in the mempool
+void CInstantSend::AddLockRequest(const CTransactionRef& tx)
+{
+    LOCK(cs);
+    mapTxLockReq.emplace(tx->GetHash(), tx);
+}
+
 // check if we need to vote on this transaction
-void CInstantSend::DoConsensusVote(const CMutableTransaction& tx, int64_t nBlockHeight, CConnman& connman)
+void CInstantSend::DoConsensusVote(const CTransaction& tx, int64_t nBlockHeight, CConnman& connman)
 {
     LOCK(cs);
     if (!fMasterNode)
         return;
 
-    int n = mnodeman.GetMasternodeRank(activeMasternode.vin, nBlockHeight, MIN_INSTANTX_PROTO_VERSION);
+    int n = GetQuorumRank(activeMasternode.vin, nBlockHeight);
 
     if (n == -1) {
         LogPrintf("InstantX::DoConsensusVote - Unknown Masternode\n");
@@ -306,7 +328,7 @@ void CInstantSend::DoConsensusVote(const CMutableTransaction& tx, int64_t nBlock
     }
 
     uint256 ctxHash = ctx.GetHash();
-    mapTxLockVote[ctxHash] = ctx;
+    AddLockVote(ctx);
 
     CInv inv(MSG_TXLOCK_VOTE, ctxHash);
     connman.RelayInv(inv);
@@ -317,7 +339,7 @@ bool CInstantSend::ProcessConsensusVote(CNode* pnode, const CConsensusVote& ctx,
 {
     LOCK(cs);
     uint256 ctxHash = ctx.GetHash();
-    int n = mnodeman.GetMasternodeRank(ctx.vinMasternode, ctx.nBlockHeight, MIN_INSTANTX_PROTO_VERSION);
+    int n = GetQuorumRank(ctx.vinMasternode, ctx.nBlockHeight);
 
     CMasternode* pmn = mnodeman.Find(ctx.vinMasternode);
     if (pmn)
@@ -335,62 +357,64 @@ bool CInstantSend::ProcessConsensusVote(CNode* pnode, const CConsensusVote& ctx,
         return false;
     }
 
-    if (!ctx.SignatureValid()) {
-        LogPrintf("InstantX::ProcessConsensusVote - Signature invalid\n");
-        // don't ban, it could just be a non-synced masternode
-        mnodeman.AskForMN(pnode, ctx.vinMasternode, connman);
-        return false;
+    uint256 hashVote = SerializeHash(ctx);
+    if (!setVerifiedVotes.count(hashVote)) {
+        if (!ctx.SignatureValid()) {
+            LogPrintf("InstantX::ProcessConsensusVote - Signature invalid\n");
+            // don't ban, it could just be a non-synced masternode
+            mnodeman.AskForMN(pnode, ctx.vinMasternode, connman);
+            return false;
+        }
+        AddVerifiedVote(hashVote);
     }
 
-    if (!mapTxLocks.count(ctx.txHash)) {
+    auto i = mapTxLocks.find(ctx.txHash);
+    if (i == mapTxLocks.end()) {
         LogPrintf("InstantX::ProcessConsensusVote - New Transaction Lock %s !\n", ctx.txHash.ToString().c_str());
 
         CTransactionLock newLock;
         newLock.nBlockHeight = 0;
         newLock.txHash = ctx.txHash;
-        mapTxLocks.insert(std::make_pair(ctx.txHash, newLock));
+        newLock.m_nExpiryHeight = GetChainHeight() + m_acceptedBlockCount;
+        mapExpiry[newLock.m_nExpiryHeight].vLocks.push_back(ctx.txHash);
+        i = mapTxLocks.emplace(ctx.txHash, newLock).first;
     } else
         LogPrintf("InstantX::ProcessConsensusVote - Transaction Lock Exists %s !\n", ctx.txHash.ToString().c_str());
 
     //compile consessus vote
-    std::map<uint256, CTransactionLock>::iterator i = mapTxLocks.find(ctx.txHash);
-    if (i != mapTxLocks.end()) {
-        (*i).second.AddSignature(ctx);
+    (*i).second.AddSignature(ctx);
 
+    LogPrintf("InstantX::ProcessConsensusVote - Transaction Lock Votes %d - %s !\n", (*i).second.CountSignatures(), ctxHash.ToString().c_str());
 
-        LogPrintf("InstantX::ProcessConsensusVote - Transaction Lock Votes %d - %s !\n", (*i).second.CountSignatures(), ctxHash.ToString().c_str());
+    int nSignatures = (*i).second.CountSignatures();
+    if (nSignatures >= INSTANTX_SIGNATURES_REQUIRED) {
+        LogPrintf("InstantX::ProcessConsensusVote - Transaction Lock Is Complete \n");
+        LogPrintf("InstantX::ProcessConsensusVote - Transaction Lock Is Complete %s !\n", (*i).second.GetHash().ToString().c_str());
+        if (nSignatures == INSTANTX_SIGNATURES_REQUIRED)
+            nCompleteTXLocks++;
 
-        if ((*i).second.CountSignatures() >= INSTANTX_SIGNATURES_REQUIRED) {
-            LogPrintf("InstantX::ProcessConsensusVote - Transaction Lock Is Complete \n");
-            LogPrintf("InstantX::ProcessConsensusVote - Transaction Lock Is Complete %s !\n", (*i).second.GetHash().ToString().c_str());
+        auto itReq = mapTxLockReq.find(ctx.txHash);
+        if (itReq == mapTxLockReq.end() || !CheckForConflictingLocks(*itReq->second)) {
 
-            CMutableTransaction& tx = mapTxLockReq[ctx.txHash];
-            if (!CheckForConflictingLocks(tx)) {
-
-                if (mapTxLockReq.count(ctx.txHash)) {
-                    for (const auto& in : tx.vin) {
-                        if (!mapLockedInputs.count(in.prevout)) {
-                            mapLockedInputs.insert(std::make_pair(in.prevout, ctx.txHash));
-                        }
-                    }
+            if (itReq != mapTxLockReq.end()) {
+                for (const auto& in : itReq->second->vin) {
+                    mapLockedInputs.emplace(in.prevout, ctx.txHash);
                 }
+            }
 
-                // resolve conflicts
+            // resolve conflicts
 
-                //if this tx lock was rejected, we need to remove the conflicting blocks
-                if (mapTxLockReqRejected.count((*i).second.txHash)) {
-                    //reprocess the last 15 blocks
-                    ReprocessBlocks(15);
-                }
+            //if this tx lock was rejected, we need to remove the conflicting blocks
+            if (mapTxLockReqRejected.count((*i).second.txHash)) {
+                //reconsider the blocks rejected for conflicting with this lock
+                ReprocessLockedBlocks((*i).second.txHash);
             }
         }
-        return true;
     }
-
-    return false;
+    return true;
 }
 
-bool CInstantSend::CheckForConflictingLocks(const CMutableTransaction& tx)
+bool CInstantSend::CheckForConflictingLocks(const CTransaction& tx)
 {
     LOCK(cs);
     /*
@@ -402,83 +426,169 @@ bool CInstantSend::CheckForConflictingLocks(const CMutableTransaction& tx)
     */
     uint256 txHash = tx.GetHash();
     for (const auto& in : tx.vin) {
-        if (mapLockedInputs.count(in.prevout)) {
-            if (mapLockedInputs[in.prevout] != txHash) {
-                LogPrintf("InstantX::CheckForConflictingLocks - found two complete conflicting locks - removing both. %s %s",
-                    txHash.ToString().c_str(), mapLockedInputs[in.prevout].ToString().c_str());
-                if (mapTxLocks.count(txHash))
-                    mapTxLocks[txHash].m_expiration = GetTime();
-                if (mapTxLocks.count(mapLockedInputs[in.prevout]))
-                    mapTxLocks[mapLockedInputs[in.prevout]].m_expiration = GetTime();
-                return true;
-            }
+        auto itLocked = mapLockedInputs.find(in.prevout);
+        if (itLocked != mapLockedInputs.end() && itLocked->second != txHash) {
+            LogPrintf("InstantX::CheckForConflictingLocks - found two complete conflicting locks - removing both. %s %s",
+                txHash.ToString().c_str(), itLocked->second.ToString().c_str());
+            int nHeight = GetChainHeight();
+            auto itLock = mapTxLocks.find(txHash);
+            if (itLock != mapTxLocks.end())
+                ExpireLock(itLock->second, nHeight);
+            itLock = mapTxLocks.find(itLocked->second);
+            if (itLock != mapTxLocks.end())
+                ExpireLock(itLock->second, nHeight);
+            return true;
         }
     }
     return false;
 }
 
+/*
+    Rank of the masternode in the InstantX quorum of nBlockHeight, INSTANTX_SIGNATURES_TOTAL + 1 if it is an
+    enabled masternode outside of the quorum and -1 otherwise, as GetMasternodeRank ranks only enabled masternodes
+    of the minimum protocol. The quorum is ranked once per block instead of for every vote.
+*/
+int CInstantSend::GetQuorumRank(const CTxIn& vin, int64_t nBlockHeight) const
+{
+    std::shared_ptr<const CMasternodeQuorum> pquorum = mnodeman.GetQuorum(nBlockHeight, INSTANTX_SIGNATURES_TOTAL, MIN_INSTANTX_PROTO_VERSION);
+    if (!pquorum)
+        return -1;
+
+    int n = pquorum->GetRank(vin.prevout);
+    if (n != -1)
+        return n;
+    CMasternode* pmn = mnodeman.Find(vin);
+    if (pmn && pmn->protocolVersion >= MIN_INSTANTX_PROTO_VERSION && pmn->IsEnabled())
+        return INSTANTX_SIGNATURES_TOTAL + 1;
+    return -1;
+}
+
+// check the rank and signature of a vote, remembering the votes that passed
+bool CInstantSend::IsVoteValid(const CConsensusVote& vote)
+{
+    LOCK(cs);
+
+    uint256 hashVote = SerializeHash(vote);
+    if (setVerifiedVotes.count(hashVote))
+        return true;
+
+    int n = GetQuorumRank(vote.vinMasternode, vote.nBlockHeight);
+
+    if (n == -1) {
+        LogPrintf("InstantX::IsVoteValid - Unknown Masternode\n");
+        return false;
+    }
+
+    if (n > INSTANTX_SIGNATURES_TOTAL) {
+        LogPrintf("InstantX::IsVoteValid - Masternode not in the top %s\n", INSTANTX_SIGNATURES_TOTAL);
+        return false;
+    }
+
+    if (!vote.SignatureValid()) {
+        LogPrintf("InstantX::IsVoteValid - Signature not valid\n");
+        return false;
+    }
+
+    AddVerifiedVote(hashVote);
+    return true;
+}
+
 int64_t CInstantSend::GetAverageVoteTime() const
 {
-    std::map<uint256, int64_t>::const_iterator it = mapUnknownVotes.begin();
-    int64_t total = 0;
-    int64_t count = 0;
+    if (mapUnknownVotes.empty())
+        return 0;
+
+    return nUnknownVoteTimeTotal / (int64_t)mapUnknownVotes.size();
+}
 
-    while (it != mapUnknownVotes.end()) {
-        total += it->second;
-        count++;
-        it++;
+// set the time of a masternode's unknown votes, keeping the total GetAverageVoteTime divides
+void CInstantSend::SetUnknownVoteTime(const uint256& hash, int64_t nTime)
+{
+    auto it = mapUnknownVotes.find(hash);
+    if (it == mapUnknownVotes.end()) {
+        mapUnknownVotes.emplace(hash, nTime);
+    } else {
+        nUnknownVoteTimeTotal -= it->second;
+        it->second = nTime;
     }
+    nUnknownVoteTimeTotal += nTime;
+}
+
+// store a vote for relay until m_acceptedBlockCount blocks from now
+void CInstantSend::AddLockVote(const CConsensusVote& ctx)
+{
+    uint256 ctxHash = ctx.GetHash();
+    if (!mapTxLockVote.emplace(ctxHash, ctx).second)
+        return;
 
-    return total / count;
+    int nHeight = GetChainHeight();
+    mapExpiry[nHeight + m_acceptedBlockCount].vVotes.push_back(ctxHash);
+}
+
+void CInstantSend::AddVerifiedVote(const uint256& hashVote)
+{
+    if (setVerifiedVotes.insert(hashVote).second)
+        mapExpiry[GetChainHeight() + m_acceptedBlockCount].vVerifiedVotes.push_back(hashVote);
+}
+
+// have the lock removed by the next CheckAndRemove
+void CInstantSend::ExpireLock(CTransactionLock& txLock, int nHeight)
+{
+    if (txLock.m_nExpiryHeight <= nHeight)
+        return;
+
+    txLock.m_nExpiryHeight = nHeight;
+    mapExpiry[nHeight].vLocks.push_back(txLock.txHash);
 }
 
 void CInstantSend::CheckAndRemove()
 {
     LOCK(cs);
-    if (!::ChainActive().Tip())
+    int nHeight = GetChainHeight();
+    if (nHeight < 0)
         return;
 
-    std::map<uint256, CTransactionLock>::iterator it = mapTxLocks.begin();
+    while (!mapExpiry.empty() && mapExpiry.begin()->first <= nHeight) {
+        const ExpiryBucket& bucket = mapExpiry.begin()->second;
+
+        for (const auto& txHash : bucket.vLocks) {
+            auto it = mapTxLocks.find(txHash);
+            // the lock was removed already, or expires later after being recreated
+            if (it == mapTxLocks.end() || it->second.m_nExpiryHeight > nHeight)
+                continue;
 
-    while (it != mapTxLocks.end()) {
-        if (GetTime() > it->second.m_expiration) {
             LogPrintf("Removing old transaction lock %s\n", it->second.txHash.ToString().c_str());
 
             // Remove rejected transaction if expired
             mapTxLockReqRejected.erase(it->second.txHash);
 
-            std::map<uint256, CMutableTransaction>::iterator itLock = mapTxLockReq.find(it->second.txHash);
+            auto itLock = mapTxLockReq.find(it->second.txHash);
             if (itLock != mapTxLockReq.end()) {
-                CMutableTransaction& tx = itLock->second;
-
-                for (const auto& in : tx.vin)
+                for (const auto& in : itLock->second->vin)
                     mapLockedInputs.erase(in.prevout);
 
-                mapTxLockReq.erase(it->second.txHash);
+                mapTxLockReq.erase(itLock);
 
                 for (const auto& v : it->second.vecConsensusVotes)
                     mapTxLockVote.erase(v.GetHash());
             }
-            mapTxLocks.erase(it++);
-        } else {
-            it++;
+            mapTxLocks.erase(it);
         }
-    }
 
-    std::map<uint256, CConsensusVote>::iterator itVote = mapTxLockVote.begin();
-    while (itVote != mapTxLockVote.end()) {
-        if (GetTime() > it->second.m_expiration || GetTransactionAge(it->second.txHash) > CInstantSend::nCompleteTXLocks) {
-            // Remove transaction vote if it is expired or belongs to old transaction
-            mapTxLockVote.erase(itVote++);
-        } else {
-            ++itVote;
-        }
+        // Remove transaction votes that belong to old transactions
+        for (const auto& hash : bucket.vVotes)
+            mapTxLockVote.erase(hash);
+
+        for (const auto& hash : bucket.vVerifiedVotes)
+            setVerifiedVotes.erase(hash);
+
+        mapExpiry.erase(mapExpiry.begin());
     }
 }
 
 int CInstantSend::GetSignaturesCount(uint256 txHash) const
 {
-    std::map<uint256, CTransactionLock>::const_iterator i = mapTxLocks.find(txHash);
+    auto i = mapTxLocks.find(txHash);
     if (i != mapTxLocks.end()) {
         return (*i).second.CountSignatures();
     }
@@ -487,7 +597,7 @@ int CInstantSend::GetSignaturesCount(uint256 txHash) const
 
 bool CInstantSend::IsLockTimedOut(uint256 txHash) const
 {
-    std::map<uint256, CTransactionLock>::const_iterator i = mapTxLocks.find(txHash);
+    auto i = mapTxLocks.find(txHash);
     if (i != mapTxLocks.end()) {
         return GetTime() > (*i).second.m_timeout;
     }
@@ -504,6 +614,23 @@ bool CInstantSend::AlreadyHave(uint256 txHash) const
     return mapTxLockVote.find(txHash) != mapTxLockVote.end();
 }
 
+bool CInstantSend::GetLockVote(const uint256& hash, CConsensusVote& vote) const
+{
+    LOCK(cs);
+    auto it = mapTxLockVote.find(hash);
+    if (it == mapTxLockVote.end())
+        return false;
+    vote = it->second;
+    return true;
+}
+
+CTransactionRef CInstantSend::GetLockRequest(const uint256& txHash) const
+{
+    LOCK(cs);
+    auto it = mapTxLockReq.find(txHash);
+    return it == mapTxLockReq.end() ? nullptr : it->second;
+}
+
 std::string CInstantSend::ToString() const
 {
     std::ostringstream info;
@@ -513,6 +640,15 @@ std::string CInstantSend::ToString() const
     return info.str();
 }
 
+size_t CInstantSend::DynamicMemoryUsage() const
+{
+    LOCK(cs);
+
+    size_t nUsage = memusage::DynamicUsage(mapLockedInputs) + memusage::DynamicUsage(mapTxLocks) + memusage::DynamicUsage(mapUnknownVotes);
+    nUsage += memusage::DynamicUsage(mapTxLockReq) + memusage::DynamicUsage(mapTxLockReqRejected) + memusage::DynamicUsage(mapTxLockVote);
+    return nUsage + memusage::DynamicUsage(setVerifiedVotes) + memusage::DynamicUsage(mapExpiry);
+}
+
 void CInstantSend::Clear()
 {
     LOCK(cs);
@@ -522,6 +658,9 @@ void CInstantSend::Clear()
     mapTxLocks.clear();
     mapUnknownVotes.clear();
     mapTxLockReqRejected.clear();
+    setVerifiedVotes.clear();
+    mapExpiry.clear();
+    nUnknownVoteTimeTotal = 0;
 }
 
 int CInstantSend::GetCompleteLocksCount() const
@@ -529,6 +668,11 @@ int CInstantSend::GetCompleteLocksCount() const
     return nCompleteTXLocks;
 }
 
+CConsensusVote::CConsensusVote()
+    : m_expiration(GetTime() + (CInstantSend::m_numberOfSeconds * CInstantSend::m_acceptedBlockCount))
+{
+}
+
 uint256 CConsensusVote::GetHash() const
 {
     return ArithToUint256(UintToArith256(vinMasternode.prevout.hash) + vinMasternode.prevout.n + UintToArith256(txHash));
@@ -583,26 +727,18 @@ bool CConsensusVote::Sign()
     return true;
 }
 
+CTransactionLock::CTransactionLock()
+    : m_nExpiryHeight(0)
+    , m_timeout(GetTime() + (CInstantSend::m_numberOfSeconds * 5))
+{
+}
+
 bool CTransactionLock::SignaturesValid() const
 {
 
     for (const auto& vote : vecConsensusVotes) {
-        int n = mnodeman.GetMasternodeRank(vote.vinMasternode, vote.nBlockHeight, MIN_INSTANTX_PROTO_VERSION);
-
-        if (n == -1) {
-            LogPrintf("CTransactionLock::SignaturesValid() - Unknown Masternode\n");
-            return false;
-        }
-
-        if (n > INSTANTX_SIGNATURES_TOTAL) {
-            LogPrintf("CTransactionLock::SignaturesValid() - Masternode not in the top %s\n", INSTANTX_SIGNATURES_TOTAL);
+        if (!instantSend.IsVoteValid(vote))
             return false;
-        }
-
-        if (!vote.SignatureValid()) {
-            LogPrintf("CTransactionLock::SignaturesValid() - Signature not valid\n");
-            return false;
-        }
     }
 
     return true;
@@ -611,6 +747,7 @@ bool CTransactionLock::SignaturesValid() const
 void CTransactionLock::AddSignature(const CConsensusVote& cv)
 {
     vecConsensusVotes.push_back(cv);
+    mapVoteCounts[cv.nBlockHeight]++;
 }
 
 int CTransactionLock::CountSignatures() const
@@ -623,13 +760,8 @@ int CTransactionLock::CountSignatures() const
     if (nBlockHeight == 0)
         return -1;
 
-    int n = 0;
-    for (const auto& v : vecConsensusVotes) {
-        if (v.nBlockHeight == nBlockHeight) {
-            n++;
-        }
-    }
-    return n;
+    auto it = mapVoteCounts.find(nBlockHeight);
+    return it == mapVoteCounts.end() ? 0 : it->second;
 }
 
 uint256 CTransactionLock::GetHash() const
@@ -637,7 +769,7 @@ uint256 CTransactionLock::GetHash() const
     return txHash;
 }
 
-void RelayTransactionLockReq(CTransactionRef& tx)
+void RelayTransactionLockReq(const CTransactionRef& tx)
 {
     const CNetMsgMaker msgMaker(PROTOCOL_VERSION);
     CInv inv(MSG_TXLOCK_REQUEST, tx->GetHash());
@@ -7,12 +7,18 @@
 #define INSTANTX_H
 
 #include <base58.h>
+#include <coins.h>
 #include <crown/spork.h>
 #include <key.h>
 #include <net.h>
+#include <primitives/transaction.h>
 #include <sync.h>
+#include <txmempool.h>
 #include <util/system.h>
 
+#include <unordered_map>
+#include <unordered_set>
+
 /*
     At 15 signatures, 1/2 of the masternode network can be owned by
     one party without comprimising the security of InstantX
@@ -33,63 +39,9 @@ static const int MIN_INSTANTX_PROTO_VERSION = 70040;
 
 extern CInstantSend instantSend;
 
-class CInstantSend {
-public:
-    void ProcessMessage(CNode* pfrom, const std::string& strCommand, CDataStream& vRecv, CConnman* connman);
-    void CheckAndRemove();
-    void Clear();
-    int64_t CreateNewLock(const CMutableTransaction& tx);
-    int GetSignaturesCount(uint256 txHash) const;
-    int GetCompleteLocksCount() const;
-    bool IsLockTimedOut(uint256 txHash) const;
-    bool TxLockRequested(uint256 txHash) const;
-    bool AlreadyHave(uint256 txHash) const;
-    std::string ToString() const;
-
-    SERIALIZE_METHODS(CInstantSend, obj)
-    {
-        READWRITE(obj.mapLockedInputs);
-        READWRITE(obj.mapTxLockVote);
-        READWRITE(obj.mapTxLockReq);
-        READWRITE(obj.mapTxLocks);
-        READWRITE(obj.mapUnknownVotes);
-        READWRITE(obj.mapTxLockReqRejected);
-        READWRITE(obj.nCompleteTXLocks);
-    }
-
-public:
-    static const int m_acceptedBlockCount = 24;
-    static const int m_numberOfSeconds = 60;
-
-private:
-    void DoConsensusVote(const CMutableTransaction& tx, int64_t nBlockHeight, CConnman& connman);
-    bool IsIxTxValid(const CTransactionRef& txCollateral) const;
-    bool ProcessConsensusVote(CNode* pnode, const CConsensusVote& ctx, CConnman& connman);
-    bool CheckForConflictingLocks(const CMutableTransaction& tx);
-    int64_t GetAverageVoteTime() const;
-
-private:
-    // critical section to protect the inner data structures
-    mutable RecursiveMutex cs;
-
-    std::map<COutPoint, uint256> mapLockedInputs;
-    std::map<uint256, CTransactionLock> mapTxLocks;
-    std::map<uint256, int64_t> mapUnknownVotes; //track votes with no tx for DOS
-    std::map<uint256, CMutableTransaction> mapTxLockReqRejected;
-    int nCompleteTXLocks;
-
-public:
-    // TODO: test how warm this is, these should be private w/LOCK
-    std::map<uint256, CConsensusVote> mapTxLockVote;
-    std::map<uint256, CMutableTransaction> mapTxLockReq;
-};
-
 class CConsensusVote {
 public:
-    CConsensusVote()
-        : m_expiration(GetTime() + (CInstantSend::m_numberOfSeconds * CInstantSend::m_acceptedBlockCount))
-    {
-    }
+    CConsensusVote();
     uint256 GetHash() const;
     bool SignatureValid() const;
     bool Sign();
@@ -113,33 +65,83 @@ public:
 
 class CTransactionLock {
 public:
-    CTransactionLock()
-        : m_expiration(GetTime() + (CInstantSend::m_numberOfSeconds * CInstantSend::m_acceptedBlockCount))
-        , m_timeout(GetTime() + (CInstantSend::m_numberOfSeconds * 5))
-    {
-    }
+    CTransactionLock();
     bool SignaturesValid() const;
     int CountSignatures() const;
     void AddSignature(const CConsensusVote& cv);
     uint256 GetHash() const;
 
-    SERIALIZE_METHODS(CTransactionLock, obj)
-    {
-        READWRITE(obj.nBlockHeight);
-        READWRITE(obj.txHash);
-        READWRITE(obj.vecConsensusVotes);
-        READWRITE(obj.m_expiration);
-        READWRITE(obj.m_timeout);
-    }
-
 public:
     int nBlockHeight;
     uint256 txHash;
     std::vector<CConsensusVote> vecConsensusVotes;
-    int m_expiration;
+    // number of votes per block height, the votes have no proof of the height so only those for nBlockHeight count
+    std::map<int, int> mapVoteCounts;
+    int m_nExpiryHeight;
     int m_timeout;
 };
 
-void RelayTransactionLockReq(CTransactionRef& tx);
+class CInstantSend {
+public:
+    void ProcessMessage(CNode* pfrom, const std::string& strCommand, CDataStream& vRecv, CConnman* connman);
+    void CheckAndRemove();
+    void Clear();
+    int64_t CreateNewLock(const CTransactionRef& tx);
+    void AddLockRequest(const CTransactionRef& tx);
+    int GetSignaturesCount(uint256 txHash) const;
+    int GetCompleteLocksCount() const;
+    bool IsLockTimedOut(uint256 txHash) const;
+    bool TxLockRequested(uint256 txHash) const;
+    bool AlreadyHave(uint256 txHash) const;
+    bool IsVoteValid(const CConsensusVote& vote);
+    bool GetLockVote(const uint256& hash, CConsensusVote& vote) const;
+    CTransactionRef GetLockRequest(const uint256& txHash) const;
+    std::string ToString() const;
+    /// Memory held by the locks, lock requests and votes
+    size_t DynamicMemoryUsage() const;
+
+public:
+    static const int m_acceptedBlockCount = 24;
+    static const int m_numberOfSeconds = 60;
+
+private:
+    void DoConsensusVote(const CTransaction& tx, int64_t nBlockHeight, CConnman& connman);
+    bool IsIxTxValid(const CTransactionRef& txCollateral) const;
+    bool ProcessConsensusVote(CNode* pnode, const CConsensusVote& ctx, CConnman& connman);
+    bool CheckForConflictingLocks(const CTransaction& tx);
+    int64_t GetAverageVoteTime() const;
+    void SetUnknownVoteTime(const uint256& hash, int64_t nTime);
+    int GetQuorumRank(const CTxIn& vin, int64_t nBlockHeight) const;
+    void AddLockVote(const CConsensusVote& ctx);
+    void AddVerifiedVote(const uint256& hashVote);
+    void ExpireLock(CTransactionLock& txLock, int nHeight);
+
+private:
+    // what to remove once the tip reaches the height of the bucket
+    struct ExpiryBucket {
+        std::vector<uint256> vLocks;
+        std::vector<uint256> vVotes;
+        std::vector<uint256> vVerifiedVotes;
+    };
+
+    // critical section to protect the inner data structures
+    mutable RecursiveMutex cs;
+
+    std::unordered_map<COutPoint, uint256, SaltedOutpointHasher> mapLockedInputs;
+    std::unordered_map<uint256, CTransactionLock, SaltedTxidHasher> mapTxLocks;
+    std::unordered_map<uint256, int64_t, SaltedTxidHasher> mapUnknownVotes; //track votes with no tx for DOS
+    int64_t nUnknownVoteTimeTotal{0};
+    // lock requests share the transaction with the mempool instead of keeping copies
+    std::unordered_map<uint256, CTransactionRef, SaltedTxidHasher> mapTxLockReq;
+    std::unordered_map<uint256, CTransactionRef, SaltedTxidHasher> mapTxLockReqRejected;
+    std::unordered_map<uint256, CConsensusVote, SaltedTxidHasher> mapTxLockVote;
+    // serialized hashes of votes whose rank and signature were checked
+    std::unordered_set<uint256, SaltedTxidHasher> setVerifiedVotes;
+    // expiry wheel by block height, so CheckAndRemove only visits what expires
+    std::map<int, ExpiryBucket> mapExpiry;
+    int nCompleteTXLocks{0};
+};
+
+void RelayTransactionLockReq(const CTransactionRef& tx);
 
 #endif
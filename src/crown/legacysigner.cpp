@@ -46,7 +46,7 @@ bool CLegacySigner::IsVinAssociatedWithPubkey(CTxIn& vin, CPubKey& pubkey, int n
     //! get specific vout
     unsigned int voutn = 0;
     for (unsigned int k = 0; k <  (txVin->nVersion >= TX_ELE_VERSION ? txVin->vpout.size() : txVin->vout.size()) ; k++){
-        CTxOutAsset out = (txVin->nVersion >= TX_ELE_VERSION ? txVin->vpout[k] : txVin->vout[k]);
+        const CTxOutRef out = txVin->GetOutputs()[k];
 
     //for (const auto& out : txVin->vout) {
         if (vin.prevout.n != voutn++)
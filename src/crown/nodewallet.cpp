@@ -229,11 +229,11 @@ bool NodeWallet::CreateCoinStake(const int nHeight, const uint32_t& nBits, const
         return false;
     }
 
-    OUTPUT_PTR<CTxData> out0 = MAKE_OUTPUT<CTxData>();
-    out0->vData.resize(4);
+    CTxData out0;
+    out0.vData.resize(4);
     uint32_t tmp = htole32(nHeight+1);
-    memcpy(&out0->vData[0], &tmp, 4);
-    txCoinStake.vdata.push_back(out0);
+    memcpy(&out0.vData[0], &tmp, 4);
+    txCoinStake.vdata.emplace_back(std::move(out0));
 
     int64_t m_smsg_fee_rate_target = 0;
     uint32_t m_smsg_difficulty_target = 0; // 0 = auto
@@ -259,7 +259,8 @@ bool NodeWallet::CreateCoinStake(const int nHeight, const uint32_t& nBits, const
             }
             smsg_fee_rate += diff;
         }
-        std::vector<uint8_t> vSmsgFeeRate(1), &vData = *txCoinStake.vdata[0]->GetPData();
+        std::vector<uint8_t> vSmsgFeeRate(1);
+        CTxDataBytes &vData = *txCoinStake.vdata[0]->GetPData();
         vSmsgFeeRate[0] = DO_SMSG_FEE;
         if (0 != part::PutVarInt(vSmsgFeeRate, smsg_fee_rate)) {
             return error("%s: PutVarInt failed: %d.", __func__, smsg_fee_rate);
@@ -309,7 +310,8 @@ bool NodeWallet::CreateCoinStake(const int nHeight, const uint32_t& nBits, const
             }
         }
 
-        std::vector<uint8_t> vSmsgDifficulty(5), &vData = *txCoinStake.vdata[0]->GetPData();
+        std::vector<uint8_t> vSmsgDifficulty(5);
+        CTxDataBytes &vData = *txCoinStake.vdata[0]->GetPData();
         vSmsgDifficulty[0] = DO_SMSG_DIFFICULTY;
         uint32_t tmp = htole32(next_compact);
         memcpy(&vSmsgDifficulty[1], &tmp, 4);
@@ -410,7 +412,7 @@ bool GetPointers(stakingnode* pstaker, std::vector<StakePointer>& vStakePointers
                 continue;
 
             if (tx->IsCoinBase()) {
-                CTxOutAsset mout = (tx->nVersion >= TX_ELE_VERSION ? tx->vpout[nPaymentSlot] : tx->vout[nPaymentSlot]);
+                const CTxOutRef mout = tx->GetOutputs()[nPaymentSlot];
                 if(mout.scriptPubKey == scriptMNPubKey){
                     StakePointer stakePointer;
                     stakePointer.hashBlock = pindex->GetBlockHash();
@@ -0,0 +1,257 @@
+// Copyright (c) 2014-2020 The Crown developers
+// Distributed under the MIT/X11 software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef CROWN_SEENOBJECTS_H
+#define CROWN_SEENOBJECTS_H
+
+#include <cuckoocache.h>
+#include <memusage.h>
+#include <primitives/transaction.h>
+#include <serialize.h>
+#include <uint256.h>
+
+#include <algorithm>
+#include <cstring>
+#include <deque>
+#include <map>
+#include <memory>
+#include <set>
+
+/** Extract the eight cuckoo hashes straight from an already uniformly distributed object hash. */
+class SeenObjectHasher
+{
+public:
+    template <uint8_t hash_select>
+    uint32_t operator()(const uint256& key) const
+    {
+        static_assert(hash_select < 8, "SeenObjectHasher only has 8 hashes available.");
+        uint32_t u;
+        std::memcpy(&u, key.begin() + 4 * hash_select, 4);
+        return u;
+    }
+};
+
+/**
+ * Seen-set for relayed masternode/systemnode pings and broadcasts.
+ *
+ * Answering "have I seen this hash" is done by a fixed size cuckoo cache of hashes,
+ * so every object seen during the retention window costs 32 bytes instead of a full copy.
+ * Full objects are only kept for the latest (highest sigTime) ping/broadcast of every
+ * node, which is all we ever announce and therefore all peers can ask us for.
+ *
+ * The cuckoo cache can't delete, erased hashes are therefore remembered in a small
+ * set that masks them until they are seen again or the cache is rebuilt.
+ *
+ * The recent hashes seen for every node are listed too, so that dropping a node also
+ * forgets its older objects and lets them be announced again.
+ *
+ * T must expose vin and sigTime. Serialized as std::map<uint256, T> to keep the cache
+ * files compatible with the previous format.
+ */
+template <typename T>
+class CSeenObjects
+{
+private:
+    std::unique_ptr<CuckooCache::cache<uint256, SeenObjectHasher>> setSeen;
+    uint32_t nSeenElements;
+    // slots of setSeen, as sized by its setup
+    uint32_t nSeenSize{0};
+    // hashes still in setSeen that must be reported as unseen
+    std::set<uint256> setErased;
+
+    // latest object per node, keyed by hash
+    std::map<uint256, T> mapObjects;
+    // node collateral -> hash of its latest object
+    std::map<COutPoint, uint256> mapLatest;
+    // node collateral -> hashes seen for it, oldest first
+    std::map<COutPoint, std::deque<uint256>> mapNodeSeen;
+
+    void EraseObject(typename std::map<uint256, T>::iterator it)
+    {
+        auto itLatest = mapLatest.find(it->second.vin.prevout);
+        if (itLatest != mapLatest.end() && itLatest->second == it->first)
+            mapLatest.erase(itLatest);
+        mapObjects.erase(it);
+    }
+
+    void ResetSeen()
+    {
+        // setup() alone keeps the old entries when the size doesn't change
+        setSeen.reset(new CuckooCache::cache<uint256, SeenObjectHasher>());
+        nSeenSize = setSeen->setup(nSeenElements);
+        setErased.clear();
+    }
+
+    void Forget(const uint256& hash)
+    {
+        setSeen->contains(hash, true);
+        setErased.insert(hash);
+        if (setErased.size() > nSeenElements / 16) {
+            // Too many masked entries, start over from the stored objects. Forgetting
+            // hashes of objects we dropped only costs revalidation if they come again.
+            ResetSeen();
+            for (const auto& item : mapObjects)
+                setSeen->insert(item.first);
+        }
+    }
+
+    void ForgetNode(const COutPoint& outpoint)
+    {
+        auto it = mapNodeSeen.find(outpoint);
+        if (it == mapNodeSeen.end())
+            return;
+        std::deque<uint256> vHashes = std::move(it->second);
+        mapNodeSeen.erase(it);
+        for (const uint256& hash : vHashes)
+            Forget(hash);
+    }
+
+public:
+    typedef typename std::map<uint256, T>::const_iterator const_iterator;
+
+    //! Hashes listed for every node, older ones are only forgotten by the cuckoo cache
+    static constexpr size_t MAX_SEEN_PER_NODE = 32;
+
+    explicit CSeenObjects(uint32_t nElements) : nSeenElements(nElements)
+    {
+        ResetSeen();
+    }
+
+    /** Whether the hash was seen, whether or not the object passed validation */
+    bool Has(const uint256& hash) const
+    {
+        if (mapObjects.count(hash))
+            return true;
+        return !setErased.count(hash) && setSeen->contains(hash, false);
+    }
+
+    /** Remember the hash of an object of a node without keeping the object, used before validation */
+    void MarkSeen(const uint256& hash, const COutPoint& outpoint)
+    {
+        setErased.erase(hash);
+        setSeen->insert(hash);
+
+        std::deque<uint256>& vHashes = mapNodeSeen[outpoint];
+        if (std::find(vHashes.begin(), vHashes.end(), hash) != vHashes.end())
+            return;
+        vHashes.push_back(hash);
+        if (vHashes.size() > MAX_SEEN_PER_NODE)
+            vHashes.pop_front();
+    }
+
+    /** Remember the hash and keep obj if it's the newest one known for its node */
+    void Add(const uint256& hash, const T& obj)
+    {
+        MarkSeen(hash, obj.vin.prevout);
+
+        auto itLatest = mapLatest.find(obj.vin.prevout);
+        if (itLatest != mapLatest.end()) {
+            if (itLatest->second == hash)
+                return;
+            auto itPrev = mapObjects.find(itLatest->second);
+            if (itPrev != mapObjects.end()) {
+                if (itPrev->second.sigTime > obj.sigTime)
+                    return;
+                mapObjects.erase(itPrev);
+            }
+        }
+
+        mapObjects[hash] = obj;
+        mapLatest[obj.vin.prevout] = hash;
+    }
+
+    /** Memory held by the cache, the stored objects and the hashes listed per node */
+    size_t DynamicMemoryUsage() const
+    {
+        size_t nUsage = memusage::MallocUsage(size_t{nSeenSize} * sizeof(uint256)) + memusage::DynamicUsage(setErased);
+        nUsage += memusage::DynamicUsage(mapObjects) + memusage::DynamicUsage(mapLatest) + memusage::DynamicUsage(mapNodeSeen);
+        for (const auto& item : mapNodeSeen)
+            nUsage += memusage::MallocUsage(item.second.size() * sizeof(uint256));
+        return nUsage;
+    }
+
+    /** Return the stored object or nullptr if only its hash (or nothing) is known */
+    T* Get(const uint256& hash)
+    {
+        auto it = mapObjects.find(hash);
+        return it == mapObjects.end() ? nullptr : &it->second;
+    }
+
+    /** Forget the hash entirely, so that the object will be accepted again */
+    void Erase(const uint256& hash)
+    {
+        auto it = mapObjects.find(hash);
+        if (it != mapObjects.end())
+            EraseObject(it);
+        Forget(hash);
+    }
+
+    /** Forget the stored object of a node and every hash seen for it, return the hash of the
+     *  stored object or a null hash if there was none */
+    uint256 EraseNode(const COutPoint& outpoint)
+    {
+        uint256 hash;
+        auto itLatest = mapLatest.find(outpoint);
+        if (itLatest != mapLatest.end()) {
+            hash = itLatest->second;
+            Erase(hash);
+        }
+        ForgetNode(outpoint);
+        return hash;
+    }
+
+    /** Drop stored objects for which fExpired returns true, along with the older hashes of
+     *  their nodes, return the hashes of the dropped objects */
+    template <typename Pred>
+    std::vector<uint256> EraseIf(Pred fExpired)
+    {
+        std::vector<uint256> vErased;
+        std::vector<COutPoint> vNodes;
+        auto it = mapObjects.begin();
+        while (it != mapObjects.end()) {
+            if (fExpired(it->second)) {
+                vErased.push_back(it->first);
+                vNodes.push_back(it->second.vin.prevout);
+                EraseObject(it++);
+            } else {
+                ++it;
+            }
+        }
+        for (const uint256& hash : vErased)
+            Forget(hash);
+        for (const COutPoint& outpoint : vNodes)
+            ForgetNode(outpoint);
+        return vErased;
+    }
+
+    void Clear()
+    {
+        mapObjects.clear();
+        mapLatest.clear();
+        mapNodeSeen.clear();
+        ResetSeen();
+    }
+
+    size_t size() const { return mapObjects.size(); }
+    const_iterator begin() const { return mapObjects.begin(); }
+    const_iterator end() const { return mapObjects.end(); }
+
+    template <typename Stream>
+    void Serialize(Stream& s) const
+    {
+        s << mapObjects;
+    }
+
+    template <typename Stream>
+    void Unserialize(Stream& s)
+    {
+        std::map<uint256, T> mapTmp;
+        s >> mapTmp;
+        Clear();
+        for (const auto& item : mapTmp)
+            Add(item.first, item.second);
+    }
+};
+
+#endif // CROWN_SEENOBJECTS_H
@@ -9,18 +9,21 @@
 #include <node/context.h>
 #include <protocol.h>
 #include <rpc/blockchain.h>
+#include <validation.h>
+#include <validationinterface.h>
+
+#include <functional>
+
 #include <boost/lexical_cast.hpp>
 
 
 class CSporkMessage;
 class CSporkManager;
 
-CSporkManager sporkManager;
+RecursiveMutex cs_mapSporks;
 std::map<uint256, CSporkMessage> mapSporks;
 std::map<int, CSporkMessage> mapSporksActive;
-
-//! forward declaration (only gets used once here)
-void UpdateMempoolForReorg(CTxMemPool& mempool, DisconnectedBlockTransactions& disconnectpool, bool fAddToMempool) EXCLUSIVE_LOCKS_REQUIRED(cs_main, mempool.cs);
+CSporkManager sporkManager;
 
 void ProcessSpork(CNode* pfrom, CConnman* connman, const std::string& strCommand, CDataStream& vRecv)
 {
@@ -33,11 +36,13 @@ void ProcessSpork(CNode* pfrom, CConnman* connman, const std::string& strCommand
             return;
 
         uint256 hash = spork.GetHash();
-        if (mapSporksActive.count(spork.nSporkID)) {
-            if (mapSporksActive[spork.nSporkID].nTimeSigned >= spork.nTimeSigned) {
+        {
+            LOCK(cs_mapSporks);
+            if (CSporkManager::IsStale(spork)) {
                 LogPrintf("spork - seen %s block %d \n", hash.ToString(), ::ChainActive().Tip()->nHeight);
                 return;
-            } else {
+            }
+            if (mapSporksActive.count(spork.nSporkID)) {
                 LogPrintf("spork - got updated spork %s block %d \n", hash.ToString(), ::ChainActive().Tip()->nHeight);
             }
         }
@@ -50,68 +55,58 @@ void ProcessSpork(CNode* pfrom, CConnman* connman, const std::string& strCommand
             return;
         }
 
-        mapSporks[hash] = spork;
-        mapSporksActive[spork.nSporkID] = spork;
+        if (!sporkManager.AddSpork(spork))
+            return;
         sporkManager.Relay(spork, *connman);
 
         //does a task if needed
         ExecuteSpork(spork.nSporkID, spork.nValue, *connman);
     }
     if (strCommand == NetMsgType::GETSPORKS) {
-        std::map<int, CSporkMessage>::iterator it = mapSporksActive.begin();
-
-        while (it != mapSporksActive.end()) {
-            const CNetMsgMaker msgMaker(PROTOCOL_VERSION);
-            connman->PushMessage(pfrom, msgMaker.Make(NetMsgType::SPORK, it->second));
-            it++;
+        LOCK(cs_mapSporks);
+        const CNetMsgMaker msgMaker(PROTOCOL_VERSION);
+        for (const auto& item : mapSporksActive) {
+            connman->PushMessage(pfrom, msgMaker.Make(NetMsgType::SPORK, item.second));
         }
     }
 }
 
+CSporkSnapshot::CSporkSnapshot()
+{
+    vValues.fill(-1);
+    vValues[SPORK_2_INSTANTX - SPORK_START] = SPORK_2_INSTANTX_DEFAULT;
+    vValues[SPORK_3_INSTANTX_BLOCK_FILTERING - SPORK_START] = SPORK_3_INSTANTX_BLOCK_FILTERING_DEFAULT;
+    vValues[SPORK_4_ENABLE_MASTERNODE_PAYMENTS - SPORK_START] = SPORK_4_ENABLE_MASTERNODE_PAYMENTS_DEFAULT;
+    vValues[SPORK_5_MAX_VALUE - SPORK_START] = SPORK_5_MAX_VALUE_DEFAULT;
+    vValues[SPORK_7_MASTERNODE_SCANNING - SPORK_START] = SPORK_7_MASTERNODE_SCANNING_DEFAULT;
+    vValues[SPORK_8_MASTERNODE_PAYMENT_ENFORCEMENT - SPORK_START] = SPORK_8_MASTERNODE_PAYMENT_ENFORCEMENT_DEFAULT;
+    vValues[SPORK_9_MASTERNODE_BUDGET_ENFORCEMENT - SPORK_START] = SPORK_9_MASTERNODE_BUDGET_ENFORCEMENT_DEFAULT;
+    vValues[SPORK_10_MASTERNODE_DONT_PAY_OLD_NODES - SPORK_START] = SPORK_10_MASTERNODE_DONT_PAY_OLD_NODES_DEFAULT;
+    vValues[SPORK_11_RESET_BUDGET - SPORK_START] = SPORK_11_RESET_BUDGET_DEFAULT;
+    vValues[SPORK_12_RECONSIDER_BLOCKS - SPORK_START] = SPORK_12_RECONSIDER_BLOCKS_DEFAULT;
+    vValues[SPORK_13_ENABLE_SUPERBLOCKS - SPORK_START] = SPORK_13_ENABLE_SUPERBLOCKS_DEFAULT;
+    vValues[SPORK_14_SYSTEMNODE_PAYMENT_ENFORCEMENT - SPORK_START] = SPORK_14_SYSTEMNODE_PAYMENT_ENFORCEMENT_DEFAULT;
+    vValues[SPORK_15_SYSTEMNODE_DONT_PAY_OLD_NODES - SPORK_START] = SPORK_15_SYSTEMNODE_DONT_PAY_OLD_NODES_DEFAULT;
+    vValues[SPORK_16_DISCONNECT_OLD_NODES - SPORK_START] = SPORK_16_DISCONNECT_OLD_NODES_DEFAULT;
+    vValues[SPORK_17_NFT_TX - SPORK_START] = SPORK_17_NFT_TX_DEFAULT;
+}
+
+int64_t CSporkSnapshot::Get(int nSporkID) const
+{
+    if (nSporkID < SPORK_START || nSporkID > SPORK_END)
+        return -1;
+    return vValues[nSporkID - SPORK_START];
+}
+
 // grab the spork, otherwise say it's off
 bool IsSporkActive(int nSporkID)
 {
-    int64_t r = -1;
+    int64_t r = sporkManager.GetSnapshot()->Get(nSporkID);
 
-    if (mapSporksActive.count(nSporkID)) {
-        r = mapSporksActive[nSporkID].nValue;
-    } else {
-        if (nSporkID == SPORK_2_INSTANTX)
-            r = SPORK_2_INSTANTX_DEFAULT;
-        if (nSporkID == SPORK_3_INSTANTX_BLOCK_FILTERING)
-            r = SPORK_3_INSTANTX_BLOCK_FILTERING_DEFAULT;
-        if (nSporkID == SPORK_4_ENABLE_MASTERNODE_PAYMENTS)
-            r = SPORK_4_ENABLE_MASTERNODE_PAYMENTS_DEFAULT;
-        if (nSporkID == SPORK_5_MAX_VALUE)
-            r = SPORK_5_MAX_VALUE_DEFAULT;
-        if (nSporkID == SPORK_7_MASTERNODE_SCANNING)
-            r = SPORK_7_MASTERNODE_SCANNING_DEFAULT;
-        if (nSporkID == SPORK_8_MASTERNODE_PAYMENT_ENFORCEMENT)
-            r = SPORK_8_MASTERNODE_PAYMENT_ENFORCEMENT_DEFAULT;
-        if (nSporkID == SPORK_9_MASTERNODE_BUDGET_ENFORCEMENT)
-            r = SPORK_9_MASTERNODE_BUDGET_ENFORCEMENT_DEFAULT;
-        if (nSporkID == SPORK_10_MASTERNODE_DONT_PAY_OLD_NODES)
-            r = SPORK_10_MASTERNODE_DONT_PAY_OLD_NODES_DEFAULT;
-        if (nSporkID == SPORK_11_RESET_BUDGET)
-            r = SPORK_11_RESET_BUDGET_DEFAULT;
-        if (nSporkID == SPORK_12_RECONSIDER_BLOCKS)
-            r = SPORK_12_RECONSIDER_BLOCKS_DEFAULT;
-        if (nSporkID == SPORK_13_ENABLE_SUPERBLOCKS)
-            r = SPORK_13_ENABLE_SUPERBLOCKS_DEFAULT;
-        if (nSporkID == SPORK_14_SYSTEMNODE_PAYMENT_ENFORCEMENT)
-            r = SPORK_14_SYSTEMNODE_PAYMENT_ENFORCEMENT_DEFAULT;
-        if (nSporkID == SPORK_15_SYSTEMNODE_DONT_PAY_OLD_NODES)
-            r = SPORK_15_SYSTEMNODE_DONT_PAY_OLD_NODES_DEFAULT;
-        if (nSporkID == SPORK_16_DISCONNECT_OLD_NODES)
-            r = SPORK_16_DISCONNECT_OLD_NODES_DEFAULT;
-        if (nSporkID == SPORK_17_NFT_TX)
-            r = SPORK_17_NFT_TX_DEFAULT;
-
-        if (r == -1)
-            LogPrintf("GetSpork::Unknown Spork %d\n", nSporkID);
-    }
-    if (r == -1)
+    if (r == -1) {
+        LogPrintf("GetSpork::Unknown Spork %d\n", nSporkID);
         r = 4070908800; //return 2099-1-1 by default
+    }
 
     return r < GetTime();
 }
@@ -119,49 +114,65 @@ bool IsSporkActive(int nSporkID)
 // grab the value of the spork on the network, or the default
 int64_t GetSporkValue(int nSporkID)
 {
-    int64_t r = -1;
+    int64_t r = sporkManager.GetSnapshot()->Get(nSporkID);
 
-    if (mapSporksActive.count(nSporkID)) {
-        r = mapSporksActive[nSporkID].nValue;
-    } else {
-        if (nSporkID == SPORK_2_INSTANTX)
-            r = SPORK_2_INSTANTX_DEFAULT;
-        if (nSporkID == SPORK_3_INSTANTX_BLOCK_FILTERING)
-            r = SPORK_3_INSTANTX_BLOCK_FILTERING_DEFAULT;
-        if (nSporkID == SPORK_4_ENABLE_MASTERNODE_PAYMENTS)
-            r = SPORK_4_ENABLE_MASTERNODE_PAYMENTS_DEFAULT;
-        if (nSporkID == SPORK_5_MAX_VALUE)
-            r = SPORK_5_MAX_VALUE_DEFAULT;
-        if (nSporkID == SPORK_7_MASTERNODE_SCANNING)
-            r = SPORK_7_MASTERNODE_SCANNING_DEFAULT;
-        if (nSporkID == SPORK_8_MASTERNODE_PAYMENT_ENFORCEMENT)
-            r = SPORK_8_MASTERNODE_PAYMENT_ENFORCEMENT_DEFAULT;
-        if (nSporkID == SPORK_9_MASTERNODE_BUDGET_ENFORCEMENT)
-            r = SPORK_9_MASTERNODE_BUDGET_ENFORCEMENT_DEFAULT;
-        if (nSporkID == SPORK_10_MASTERNODE_DONT_PAY_OLD_NODES)
-            r = SPORK_10_MASTERNODE_DONT_PAY_OLD_NODES_DEFAULT;
-        if (nSporkID == SPORK_11_RESET_BUDGET)
-            r = SPORK_11_RESET_BUDGET_DEFAULT;
-        if (nSporkID == SPORK_12_RECONSIDER_BLOCKS)
-            r = SPORK_12_RECONSIDER_BLOCKS_DEFAULT;
-        if (nSporkID == SPORK_13_ENABLE_SUPERBLOCKS)
-            r = SPORK_13_ENABLE_SUPERBLOCKS_DEFAULT;
-        if (nSporkID == SPORK_14_SYSTEMNODE_PAYMENT_ENFORCEMENT)
-            r = SPORK_14_SYSTEMNODE_PAYMENT_ENFORCEMENT_DEFAULT;
-        if (nSporkID == SPORK_15_SYSTEMNODE_DONT_PAY_OLD_NODES)
-            r = SPORK_15_SYSTEMNODE_DONT_PAY_OLD_NODES_DEFAULT;
-        if (nSporkID == SPORK_16_DISCONNECT_OLD_NODES)
-            r = SPORK_16_DISCONNECT_OLD_NODES_DEFAULT;
-        if (nSporkID == SPORK_17_NFT_TX)
-            r = SPORK_17_NFT_TX_DEFAULT;
-
-        if (r == -1)
-            LogPrintf("GetSpork::Unknown Spork %d\n", nSporkID);
-    }
+    if (r == -1)
+        LogPrintf("GetSpork::Unknown Spork %d\n", nSporkID);
 
     return r;
 }
 
+bool IsRejectedBySpork(const CRejectedBlock& rejected, int nSporkID)
+{
+    switch (nSporkID) {
+    case SPORK_8_MASTERNODE_PAYMENT_ENFORCEMENT:
+        return rejected.strReason == "bad-mn-payee";
+    case SPORK_14_SYSTEMNODE_PAYMENT_ENFORCEMENT:
+        return rejected.strReason == "bad-sn-payee";
+    case SPORK_9_MASTERNODE_BUDGET_ENFORCEMENT:
+        return rejected.strReason == "bad-mn-payee" || rejected.strReason == "bad-sn-payee";
+    case SPORK_13_ENABLE_SUPERBLOCKS:
+        return rejected.strReason == "bad-cb-amount" || rejected.strReason == "bad-mn-payee" || rejected.strReason == "bad-sn-payee";
+    default:
+        return false;
+    }
+}
+
+/**
+ * Clear the failure flags of the rejected blocks matching fMatch and let ActivateBestChain decide.
+ * The active tip is only disconnected if one of the reconsidered blocks leads to a chain with more work,
+ * blocks which still fail are recorded again by ConnectBlock.
+ */
+static void ReconsiderRejectedBlocks(const std::function<bool(const CRejectedBlock&)>& fMatch)
+{
+    int nReconsidered = 0;
+    {
+        LOCK(cs_main);
+        auto it = mapRejectedBlocks.begin();
+        while (it != mapRejectedBlocks.end()) {
+            if (!fMatch(it->second)) {
+                ++it;
+                continue;
+            }
+            BlockMap::iterator mi = g_chainman.BlockIndex().find(it->first);
+            if (mi != g_chainman.BlockIndex().end() && mi->second) {
+                LogPrintf("ReconsiderRejectedBlocks -- %s height %d (%s)\n", it->first.ToString(), it->second.nHeight, it->second.strReason);
+                ResetBlockFailureFlags(mi->second);
+                nReconsidered++;
+            }
+            it = mapRejectedBlocks.erase(it);
+        }
+    }
+
+    if (nReconsidered == 0)
+        return;
+
+    BlockValidationState state;
+    if (!ActivateBestChain(state, Params())) {
+        LogPrintf("ReconsiderRejectedBlocks -- ActivateBestChain failed: %s\n", state.ToString());
+    }
+}
+
 void ExecuteSpork(int nSporkID, int nValue, CConnman& connman)
 {
     if (nSporkID == SPORK_11_RESET_BUDGET && nValue == 1) {
@@ -170,49 +181,29 @@ void ExecuteSpork(int nSporkID, int nValue, CConnman& connman)
         //correct fork via spork technology
         LogPrintf("Spork::ExecuteSpork -- Reconsider Last %d Blocks\n", nValue);
         ReprocessBlocks(nValue);
+    } else {
+        // the enforcement of a check changed, blocks it rejected may be valid now
+        ReconsiderRejectedBlocks([nSporkID](const CRejectedBlock& rejected) {
+            return IsRejectedBySpork(rejected, nSporkID);
+        });
     }
 }
 
-bool DisconnectBlocks(int blocks)
+void ReprocessBlocks(int nBlocks)
 {
-    LOCK(cs_main);
-
-    BlockValidationState state;
-    const CChainParams& chainparams = Params();
-    LogPrintf("DisconnectBlocks -- Got command to replay %d blocks\n", blocks);
-    for (int i = 0; i < blocks; i++) {
-        DisconnectedBlockTransactions disconnectpool;
-        if (!::ChainstateActive().DisconnectTip(state, chainparams, &disconnectpool) || !state.IsValid()) {
-            // This is likely a fatal error, but keep the mempool consistent,
-            // just in case. Only remove from the mempool in this case.
-            UpdateMempoolForReorg(*g_rpc_node->mempool, disconnectpool, false);
-            return false;
-        }
-    }
-    return true;
+    const int nHeight = WITH_LOCK(cs_main, return ::ChainActive().Height());
+    ReconsiderRejectedBlocks([nHeight, nBlocks](const CRejectedBlock& rejected) {
+        return rejected.nHeight > nHeight - nBlocks;
+    });
 }
 
-void ReprocessBlocks(int nBlocks)
+void ReprocessLockedBlocks(const uint256& txHash)
 {
-    LOCK(cs_main);
-
-    std::map<uint256, int64_t>::iterator it = mapRejectedBlocks.begin();
-    while (it != mapRejectedBlocks.end()) {
-        //use a window twice as large as is usual for the nBlocks we want to reset
-        if ((*it).second > GetTime() - (nBlocks * 60 * 5)) {
-            BlockMap::iterator mi = g_chainman.BlockIndex().find((*it).first);
-            if (mi != g_chainman.BlockIndex().end() && (*mi).second) {
-                CBlockIndex* pindex = (*mi).second;
-                LogPrintf("ReprocessBlocks -- %s\n", (*it).first.ToString());
-                ResetBlockFailureFlags(pindex);
-            }
-        }
-        ++it;
-    }
-
-    DisconnectBlocks(nBlocks);
-    BlockValidationState state;
-    ActivateBestChain(state, Params(), std::shared_ptr<const CBlock>());
+    if (txHash.IsNull())
+        return;
+    ReconsiderRejectedBlocks([&txHash](const CRejectedBlock& rejected) {
+        return rejected.hashConflictTx == txHash;
+    });
 }
 
 bool CSporkManager::CheckSignature(CSporkMessage& spork)
@@ -266,15 +257,48 @@ bool CSporkManager::UpdateSpork(int nSporkID, int64_t nValue, CConnman& connman)
     msg.nValue = nValue;
     msg.nTimeSigned = GetTime();
 
-    if (Sign(msg)) {
-        CInv spork(MSG_SPORK, msg.GetHash());
-        connman.RelayInv(spork);
-        mapSporks[msg.GetHash()] = msg;
-        mapSporksActive[nSporkID] = msg;
-        return true;
+    if (!Sign(msg) || !AddSpork(msg))
+        return false;
+
+    CInv spork(MSG_SPORK, msg.GetHash());
+    connman.RelayInv(spork);
+    return true;
+}
+
+CSporkManager::CSporkManager()
+    : pSnapshot(std::make_shared<const CSporkSnapshot>())
+{
+}
+
+bool CSporkManager::IsStale(const CSporkMessage& spork)
+{
+    AssertLockHeld(cs_mapSporks);
+    auto it = mapSporksActive.find(spork.nSporkID);
+    return it != mapSporksActive.end() && it->second.nTimeSigned >= spork.nTimeSigned;
+}
+
+bool CSporkManager::AddSpork(const CSporkMessage& spork)
+{
+    {
+        LOCK(cs_mapSporks);
+        // a newer version may have been accepted since the caller checked
+        if (IsStale(spork))
+            return false;
+
+        mapSporks[spork.GetHash()] = spork;
+        mapSporksActive[spork.nSporkID] = spork;
+
+        if (spork.nSporkID >= SPORK_START && spork.nSporkID <= SPORK_END) {
+            // writers are serialized by cs_mapSporks, readers keep the old snapshot alive while they use it
+            auto pNew = std::make_shared<CSporkSnapshot>(*GetSnapshot());
+            pNew->vValues[spork.nSporkID - SPORK_START] = spork.nValue;
+            std::atomic_store(&pSnapshot, std::shared_ptr<const CSporkSnapshot>(std::move(pNew)));
+        }
     }
 
-    return false;
+    // listeners may take their own locks, the new value is readable already
+    GetMainSignals().SporkUpdated(spork.nSporkID, spork.nValue);
+    return true;
 }
 
 void CSporkManager::Relay(CSporkMessage& msg, CConnman& connman)
@@ -14,6 +14,9 @@
 #include <util/strencodings.h>
 #include <util/system.h>
 
+#include <array>
+#include <memory>
+
 #include <boost/lexical_cast.hpp>
 
 /*
@@ -55,18 +58,27 @@
 #define SPORK_16_DISCONNECT_OLD_NODES_DEFAULT 4070908800 //OFF
 #define SPORK_17_NFT_TX_DEFAULT 1585044000 //2020-3-24 10:00 AM UTC
 
+#define SPORK_COUNT (SPORK_END - SPORK_START + 1)
+
 class CSporkMessage;
 class CSporkManager;
+struct CRejectedBlock;
 
-extern std::map<uint256, CSporkMessage> mapSporks;
-extern std::map<int, CSporkMessage> mapSporksActive;
+extern RecursiveMutex cs_mapSporks;
+extern std::map<uint256, CSporkMessage> mapSporks GUARDED_BY(cs_mapSporks);
+extern std::map<int, CSporkMessage> mapSporksActive GUARDED_BY(cs_mapSporks);
 extern CSporkManager sporkManager;
 
 void ProcessSpork(CNode* pfrom, CConnman* connman, const std::string& strCommand, CDataStream& vRecv);
 int64_t GetSporkValue(int nSporkID);
 bool IsSporkActive(int nSporkID);
 void ExecuteSpork(int nSporkID, int nValue, CConnman& connman);
+/** Reconsider the blocks rejected within the last nBlocks, without replaying the active chain */
 void ReprocessBlocks(int nBlocks);
+/** Reconsider the blocks rejected because they conflicted with the tx lock of txHash */
+void ReprocessLockedBlocks(const uint256& txHash);
+/** Whether the check that rejected the block is governed by nSporkID */
+bool IsRejectedBySpork(const CRejectedBlock& rejected, int nSporkID);
 
 //
 // Spork Class
@@ -91,15 +103,37 @@ public:
     }
 };
 
+/**
+ * Immutable spork values indexed by spork ID, unset sporks hold their default.
+ * A new snapshot is published for every update, readers never take a lock.
+ */
+class CSporkSnapshot {
+public:
+    std::array<int64_t, SPORK_COUNT> vValues;
+
+    CSporkSnapshot();
+
+    /// Value of the spork, or -1 if the ID is unknown
+    int64_t Get(int nSporkID) const;
+};
+
 class CSporkManager {
 private:
     std::vector<unsigned char> vchSig;
     std::string strMasterPrivKey;
 
+    // only accessed through std::atomic_load/std::atomic_store, a replaced snapshot is freed by its last reader
+    std::shared_ptr<const CSporkSnapshot> pSnapshot;
+
 public:
-    CSporkManager()
-    {
-    }
+    CSporkManager();
+
+    /// The current spork values, safe to use without any lock
+    std::shared_ptr<const CSporkSnapshot> GetSnapshot() const { return std::atomic_load(&pSnapshot); }
+    /// Whether spork is not newer than the accepted version of its ID
+    static bool IsStale(const CSporkMessage& spork) EXCLUSIVE_LOCKS_REQUIRED(cs_mapSporks);
+    /// Store a verified spork and publish its value. Returns false if it is stale
+    bool AddSpork(const CSporkMessage& spork);
 
     std::string GetSporkNameByID(int id);
     int GetSporkIDByName(std::string strName);
@@ -0,0 +1,324 @@
+// Copyright (c) 2021 The Crown Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <chainparams.h>
+#include <index/addressindex.h>
+#include <insight/insight.h>
+#include <undo.h>
+#include <util/system.h>
+#include <validation.h>
+
+/* Keys of the address index have the type [DB_ADDRESSINDEX, CAddressIndexKey] and map to the
+ * amount received or spent. Height and position in the block are big endian encoded, so the
+ * entries of an (address, asset) pair are in block order and can be streamed for a height range.
+ * Keys of the unspent index have the type [DB_ADDRESSUNSPENTINDEX, CAddressUnspentKey].
+ */
+constexpr char DB_ADDRESSINDEX = 'a';
+constexpr char DB_ADDRESSUNSPENTINDEX = 'u';
+
+std::unique_ptr<AddressIndex> g_addressindex;
+
+bool GetAddressIndexKey(const CScript& script, int& type, uint160& hash)
+{
+    std::vector<uint8_t> hashBytes;
+    if (!ExtractIndexInfo(&script, type, hashBytes) || type == ADDR_INDT_UNKNOWN) {
+        return false;
+    }
+    // Keys hold 160 bit hashes, 32 byte witness programs can't be indexed
+    if (hashBytes.size() != hash.size()) {
+        return false;
+    }
+    hash = uint160(hashBytes);
+    return true;
+}
+
+/** Access to the address index database (indexes/addressindex/) */
+class AddressIndex::DB : public BaseIndex::DB
+{
+public:
+    explicit DB(size_t n_cache_size, bool f_memory = false, bool f_wipe = false);
+
+    bool ScanAddressUnspent(const uint160& addressHash, int type, const CAsset& asset,
+                            const std::function<bool(const CAddressUnspentKey&, const CAddressUnspentValue&)>& fn);
+    bool ScanAddressIndex(const std::vector<std::pair<uint160, int>>& addresses, const CAsset& asset,
+                          int start, int end, bool fReverse,
+                          const std::function<bool(const CAddressIndexKey&, const CAmountMap&)>& fn);
+};
+
+AddressIndex::DB::DB(size_t n_cache_size, bool f_memory, bool f_wipe) :
+    BaseIndex::DB(GetDataDir() / "indexes" / "addressindex", n_cache_size, f_memory, f_wipe)
+{}
+
+/**
+ * Collect the assets an address has entries for in an index keyed by (type, address, asset, ...),
+ * jumping from one asset group straight to the next instead of walking every entry.
+ */
+template <typename K, typename SkipKeyFn>
+static void ReadAddressAssets(CDBIterator& cursor, char chIndex, int type, const uint160& addressHash,
+                              const CAsset& filter, std::vector<CAsset>& assets, SkipKeyFn skipKey)
+{
+    cursor.Seek(std::make_pair(chIndex, CAddressIndexIteratorKey(type, addressHash)));
+
+    while (cursor.Valid()) {
+        std::pair<char, K> key;
+        if (!cursor.GetKey(key) || key.first != chIndex || key.second.type != (unsigned int)type || key.second.hashBytes != addressHash) {
+            break;
+        }
+        if (filter.IsNull() || key.second.asset == filter) {
+            assets.push_back(key.second.asset);
+        }
+        cursor.Seek(std::make_pair(chIndex, skipKey(key.second.asset)));
+    }
+}
+
+bool AddressIndex::DB::ScanAddressUnspent(const uint160& addressHash, int type, const CAsset& asset,
+                                          const std::function<bool(const CAddressUnspentKey&, const CAddressUnspentValue&)>& fn)
+{
+    std::unique_ptr<CDBIterator> pcursor(NewIterator());
+
+    // Sorts after every (txhash, index) of the asset
+    const uint256 hashLast = uint256S(std::string(64, 'f'));
+    std::vector<CAsset> assets;
+    ReadAddressAssets<CAddressUnspentKey>(*pcursor, DB_ADDRESSUNSPENTINDEX, type, addressHash, asset, assets,
+        [&](const CAsset& at) { return std::make_pair(CAddressIndexIteratorAssetKey(type, addressHash, at), hashLast); });
+
+    for (const CAsset& at : assets) {
+        pcursor->Seek(std::make_pair(DB_ADDRESSUNSPENTINDEX, CAddressIndexIteratorAssetKey(type, addressHash, at)));
+
+        while (pcursor->Valid()) {
+            std::pair<char, CAddressUnspentKey> key;
+            if (!pcursor->GetKey(key) || key.first != DB_ADDRESSUNSPENTINDEX || key.second.type != (unsigned int)type ||
+                key.second.hashBytes != addressHash || key.second.asset != at) {
+                break;
+            }
+            CAddressUnspentValue nValue;
+            if (!pcursor->GetValue(nValue)) {
+                return error("failed to get address unspent value");
+            }
+            if (!fn(key.second, nValue)) {
+                return true;
+            }
+            pcursor->Next();
+        }
+    }
+
+    return true;
+}
+
+namespace {
+/** Position in the address index entries of a single (address, asset) pair */
+struct AddressIndexCursor
+{
+    std::unique_ptr<CDBIterator> pcursor;
+    int type;
+    uint160 hashBytes;
+    CAsset asset;
+    CAddressIndexKey key;
+};
+} // namespace
+
+bool AddressIndex::DB::ScanAddressIndex(const std::vector<std::pair<uint160, int>>& addresses, const CAsset& asset,
+                                        int start, int end, bool fReverse,
+                                        const std::function<bool(const CAddressIndexKey&, const CAmountMap&)>& fn)
+{
+    // One cursor per (address, asset) group, each one already in height order thanks to the
+    // big endian key encoding. The groups are merged on the fly, so nothing is materialized.
+    std::vector<AddressIndexCursor> cursors;
+    for (const auto& address : addresses) {
+        std::unique_ptr<CDBIterator> pcursor(NewIterator());
+        std::vector<CAsset> assets;
+        // The highest height sorts after every entry of the asset
+        ReadAddressAssets<CAddressIndexKey>(*pcursor, DB_ADDRESSINDEX, address.second, address.first, asset, assets,
+            [&](const CAsset& at) { return CAddressIndexIteratorHeightKey(address.second, address.first, at, std::numeric_limits<unsigned int>::max()); });
+
+        for (const CAsset& at : assets) {
+            AddressIndexCursor cursor{std::unique_ptr<CDBIterator>(NewIterator()), address.second, address.first, at, CAddressIndexKey()};
+            if (!fReverse) {
+                cursor.pcursor->Seek(std::make_pair(DB_ADDRESSINDEX, CAddressIndexIteratorHeightKey(address.second, address.first, at, start)));
+            } else {
+                cursor.pcursor->Seek(std::make_pair(DB_ADDRESSINDEX, CAddressIndexIteratorHeightKey(address.second, address.first, at, end > 0 ? end + 1 : std::numeric_limits<unsigned int>::max())));
+                if (cursor.pcursor->Valid()) {
+                    cursor.pcursor->Prev();
+                } else {
+                    cursor.pcursor->SeekToLast();
+                }
+            }
+            cursors.push_back(std::move(cursor));
+        }
+    }
+
+    // Read the key under the cursor, dropping the cursor once it leaves its group or the height range
+    auto load = [&](AddressIndexCursor& cursor) {
+        std::pair<char, CAddressIndexKey> key;
+        if (cursor.pcursor->Valid() && cursor.pcursor->GetKey(key) && key.first == DB_ADDRESSINDEX &&
+            key.second.type == (unsigned int)cursor.type && key.second.hashBytes == cursor.hashBytes && key.second.asset == cursor.asset &&
+            (fReverse ? (int)key.second.blockHeight >= start : (end <= 0 || (int)key.second.blockHeight <= end))) {
+            cursor.key = key.second;
+            return true;
+        }
+        cursor.pcursor.reset();
+        return false;
+    };
+    for (AddressIndexCursor& cursor : cursors) {
+        load(cursor);
+    }
+
+    while (true) {
+        AddressIndexCursor* pnext = nullptr;
+        for (AddressIndexCursor& cursor : cursors) {
+            if (!cursor.pcursor) continue;
+            if (!pnext) {
+                pnext = &cursor;
+                continue;
+            }
+            const auto pos = std::make_pair(cursor.key.blockHeight, cursor.key.txindex);
+            const auto posNext = std::make_pair(pnext->key.blockHeight, pnext->key.txindex);
+            if (fReverse ? pos > posNext : pos < posNext) {
+                pnext = &cursor;
+            }
+        }
+        if (!pnext) break;
+
+        CAmountMap nValue;
+        if (!pnext->pcursor->GetValue(nValue)) {
+            return error("failed to get address index value");
+        }
+        if (!fn(pnext->key, nValue)) {
+            break;
+        }
+        if (fReverse) {
+            pnext->pcursor->Prev();
+        } else {
+            pnext->pcursor->Next();
+        }
+        load(*pnext);
+    }
+
+    return true;
+}
+
+AddressIndex::AddressIndex(size_t n_cache_size, bool f_memory, bool f_wipe)
+    : m_db(std::make_unique<AddressIndex::DB>(n_cache_size, f_memory, f_wipe))
+{}
+
+AddressIndex::~AddressIndex() {}
+
+bool AddressIndex::WriteBlock(const CBlock& block, const CBlockIndex* pindex)
+{
+    // The genesis block outputs are not spendable and have no undo data
+    if (pindex->nHeight == 0) return true;
+
+    CBlockUndo block_undo;
+    if (!UndoReadFromDisk(block_undo, pindex)) {
+        return false;
+    }
+    if (block_undo.vtxundo.size() + 1 != block.vtx.size()) {
+        return error("%s: block and undo data inconsistent at height %d", __func__, pindex->nHeight);
+    }
+
+    CDBBatch batch(*m_db);
+    int type;
+    uint160 hash;
+    for (unsigned int i = 0; i < block.vtx.size(); i++) {
+        const CTransaction& tx = *block.vtx[i];
+        const uint256& txhash = tx.GetHash();
+
+        // Coinstakes only point at their stake, the undo data has the coins of all other inputs
+        if (i > 0 && !tx.IsCoinStake()) {
+            const CTxUndo& tx_undo = block_undo.vtxundo[i - 1];
+            if (tx_undo.vprevout.size() != tx.vin.size()) {
+                return error("%s: transaction and undo data inconsistent in %s", __func__, txhash.ToString());
+            }
+            for (unsigned int j = 0; j < tx.vin.size(); j++) {
+                const CTxOutAsset& prevout = tx_undo.vprevout[j].out;
+                if (!GetAddressIndexKey(prevout.scriptPubKey, type, hash)) continue;
+
+                // record spending activity and remove the output from the unspent index
+                batch.Write(std::make_pair(DB_ADDRESSINDEX, CAddressIndexKey(type, hash, prevout.nAsset, pindex->nHeight, i, txhash, j, true)),
+                            CAmountMap{{prevout.nAsset, prevout.nValue}});
+                batch.Erase(std::make_pair(DB_ADDRESSUNSPENTINDEX, CAddressUnspentKey(type, hash, prevout.nAsset, tx.vin[j].prevout.hash, tx.vin[j].prevout.n)));
+            }
+        }
+
+        for (unsigned int k = 0; k < tx.GetNumVOuts(); k++) {
+            const CTxOutRef out = tx.GetOutputs()[k];
+            if (!GetAddressIndexKey(out.scriptPubKey, type, hash)) continue;
+
+            // record receiving activity and the unspent output
+            batch.Write(std::make_pair(DB_ADDRESSINDEX, CAddressIndexKey(type, hash, out.nAsset, pindex->nHeight, i, txhash, k, false)),
+                        CAmountMap{{out.nAsset, out.nValue}});
+            batch.Write(std::make_pair(DB_ADDRESSUNSPENTINDEX, CAddressUnspentKey(type, hash, out.nAsset, txhash, k)),
+                        CAddressUnspentValue(out.nValue, out.nAsset, out.scriptPubKey, pindex->nHeight));
+        }
+    }
+
+    return m_db->WriteBatch(batch);
+}
+
+bool AddressIndex::Rewind(const CBlockIndex* current_tip, const CBlockIndex* new_tip)
+{
+    assert(current_tip->GetAncestor(new_tip->nHeight) == new_tip);
+
+    // Undo the disconnected blocks, newest first, the same way DisconnectBlock undoes the UTXO set
+    for (const CBlockIndex* pindex = current_tip; pindex != new_tip; pindex = pindex->pprev) {
+        CBlock block;
+        CBlockUndo block_undo;
+        if (!ReadBlockFromDisk(block, pindex, Params().GetConsensus())) {
+            return error("%s: failed to read block %s from disk", __func__, pindex->GetBlockHash().ToString());
+        }
+        if (!UndoReadFromDisk(block_undo, pindex) || block_undo.vtxundo.size() + 1 != block.vtx.size()) {
+            return error("%s: failed to read undo data of block %s", __func__, pindex->GetBlockHash().ToString());
+        }
+
+        CDBBatch batch(*m_db);
+        int type;
+        uint160 hash;
+        for (int i = block.vtx.size() - 1; i >= 0; i--) {
+            const CTransaction& tx = *block.vtx[i];
+            const uint256& txhash = tx.GetHash();
+
+            for (unsigned int k = 0; k < tx.GetNumVOuts(); k++) {
+                const CTxOutRef out = tx.GetOutputs()[k];
+                if (!GetAddressIndexKey(out.scriptPubKey, type, hash)) continue;
+
+                batch.Erase(std::make_pair(DB_ADDRESSINDEX, CAddressIndexKey(type, hash, out.nAsset, pindex->nHeight, i, txhash, k, false)));
+                batch.Erase(std::make_pair(DB_ADDRESSUNSPENTINDEX, CAddressUnspentKey(type, hash, out.nAsset, txhash, k)));
+            }
+
+            if (i > 0 && !tx.IsCoinStake()) {
+                const CTxUndo& tx_undo = block_undo.vtxundo[i - 1];
+                if (tx_undo.vprevout.size() != tx.vin.size()) {
+                    return error("%s: transaction and undo data inconsistent in %s", __func__, txhash.ToString());
+                }
+                for (unsigned int j = 0; j < tx.vin.size(); j++) {
+                    const Coin& coin = tx_undo.vprevout[j];
+                    if (!GetAddressIndexKey(coin.out.scriptPubKey, type, hash)) continue;
+
+                    // the spent output becomes unspent again
+                    batch.Erase(std::make_pair(DB_ADDRESSINDEX, CAddressIndexKey(type, hash, coin.out.nAsset, pindex->nHeight, i, txhash, j, true)));
+                    batch.Write(std::make_pair(DB_ADDRESSUNSPENTINDEX, CAddressUnspentKey(type, hash, coin.out.nAsset, tx.vin[j].prevout.hash, tx.vin[j].prevout.n)),
+                                CAddressUnspentValue(coin.out.nValue, coin.out.nAsset, coin.out.scriptPubKey, coin.nHeight));
+                }
+            }
+        }
+        if (!m_db->WriteBatch(batch)) return false;
+    }
+
+    return BaseIndex::Rewind(current_tip, new_tip);
+}
+
+BaseIndex::DB& AddressIndex::GetDB() const { return *m_db; }
+
+bool AddressIndex::ScanAddressUnspent(const uint160& addressHash, int type, const CAsset& asset,
+                                      const std::function<bool(const CAddressUnspentKey&, const CAddressUnspentValue&)>& fn) const
+{
+    return m_db->ScanAddressUnspent(addressHash, type, asset, fn);
+}
+
+bool AddressIndex::ScanAddressIndex(const std::vector<std::pair<uint160, int>>& addresses, const CAsset& asset,
+                                    int start, int end, bool fReverse,
+                                    const std::function<bool(const CAddressIndexKey&, const CAmountMap&)>& fn) const
+{
+    return m_db->ScanAddressIndex(addresses, asset, start, end, fReverse, fn);
+}
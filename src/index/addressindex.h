@@ -0,0 +1,66 @@
+// Copyright (c) 2021 The Crown Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef CROWN_INDEX_ADDRESSINDEX_H
+#define CROWN_INDEX_ADDRESSINDEX_H
+
+#include <index/base.h>
+#include <insight/addressindex.h>
+#include <insight/spentindex.h>
+
+#include <functional>
+#include <vector>
+
+class CScript;
+
+/** Extract the address index key of an output script, returns false if it can't be indexed */
+bool GetAddressIndexKey(const CScript& script, int& type, uint160& hash);
+
+/**
+ * AddressIndex records for every address the outputs it received and spent (by height) and the
+ * outputs it currently has unspent. It is built from the blocks and their undo data in the
+ * background, so block connection does not pay for it.
+ */
+class AddressIndex final : public BaseIndex
+{
+protected:
+    class DB;
+
+private:
+    const std::unique_ptr<DB> m_db;
+
+protected:
+    bool WriteBlock(const CBlock& block, const CBlockIndex* pindex) override;
+
+    bool Rewind(const CBlockIndex* current_tip, const CBlockIndex* new_tip) override;
+
+    BaseIndex::DB& GetDB() const override;
+
+    const char* GetName() const override { return "addressindex"; }
+
+public:
+    /// Constructs the index, which becomes available to be queried.
+    explicit AddressIndex(size_t n_cache_size, bool f_memory = false, bool f_wipe = false);
+
+    // Destructor is declared because this class contains a unique_ptr to an incomplete type.
+    virtual ~AddressIndex() override;
+
+    /** Stream the unspent outputs of an address (restricted to asset unless it is null) to fn until it returns false */
+    bool ScanAddressUnspent(const uint160& addressHash, int type, const CAsset& asset,
+                            const std::function<bool(const CAddressUnspentKey&, const CAddressUnspentValue&)>& fn) const;
+
+    /**
+     * Stream the address index entries of the given addresses to fn in block order (newest first if fReverse)
+     * until it returns false. Entries are restricted to asset unless it is null and to the [start, end]
+     * height range, where a bound of 0 means unbounded.
+     */
+    bool ScanAddressIndex(const std::vector<std::pair<uint160, int>>& addresses, const CAsset& asset,
+                          int start, int end, bool fReverse,
+                          const std::function<bool(const CAddressIndexKey&, const CAmountMap&)>& fn) const;
+};
+
+/// The global address index, used by the insight address RPCs. May be null.
+extern std::unique_ptr<AddressIndex> g_addressindex;
+
+#endif // CROWN_INDEX_ADDRESSINDEX_H
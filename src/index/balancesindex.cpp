@@ -0,0 +1,86 @@
+// Copyright (c) 2021 The Crown Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <assetdb.h>
+#include <index/balancesindex.h>
+#include <undo.h>
+#include <util/system.h>
+#include <validation.h>
+
+constexpr char DB_BALANCESINDEX = 'i';
+
+std::unique_ptr<BalancesIndex> g_balancesindex;
+
+/** Access to the balances index database (indexes/balancesindex/) */
+class BalancesIndex::DB : public BaseIndex::DB
+{
+public:
+    explicit DB(size_t n_cache_size, bool f_memory = false, bool f_wipe = false);
+
+    bool ReadBalances(const uint256& block_hash, BlockBalances& balances) const;
+};
+
+BalancesIndex::DB::DB(size_t n_cache_size, bool f_memory, bool f_wipe) :
+    BaseIndex::DB(GetDataDir() / "indexes" / "balancesindex", n_cache_size, f_memory, f_wipe)
+{}
+
+bool BalancesIndex::DB::ReadBalances(const uint256& block_hash, BlockBalances& balances) const
+{
+    return Read(std::make_pair(DB_BALANCESINDEX, block_hash), balances);
+}
+
+BalancesIndex::BalancesIndex(size_t n_cache_size, bool f_memory, bool f_wipe)
+    : m_db(std::make_unique<BalancesIndex::DB>(n_cache_size, f_memory, f_wipe))
+{}
+
+BalancesIndex::~BalancesIndex() {}
+
+/** Amount of the subsidy asset in out, outputs predating assets count as the subsidy asset */
+static CAmount PlainValue(const CTxOutRef& out, const CAsset& subsidy_asset)
+{
+    if (out.scriptPubKey.IsUnspendable()) return 0;
+    return (out.nAsset.IsNull() || out.nAsset == subsidy_asset) ? out.nValue : 0;
+}
+
+bool BalancesIndex::WriteBlock(const CBlock& block, const CBlockIndex* pindex)
+{
+    BlockBalances balances;
+    if (pindex->nHeight > 0) {
+        if (!m_db->ReadBalances(pindex->pprev->GetBlockHash(), balances)) {
+            return error("%s: no balances for block %s", __func__, pindex->pprev->GetBlockHash().ToString());
+        }
+
+        CBlockUndo block_undo;
+        if (!UndoReadFromDisk(block_undo, pindex)) {
+            return false;
+        }
+        if (block_undo.vtxundo.size() + 1 != block.vtx.size()) {
+            return error("%s: block and undo data inconsistent at height %d", __func__, pindex->nHeight);
+        }
+
+        const CAsset subsidy_asset = GetSubsidyAsset();
+        for (unsigned int i = 0; i < block.vtx.size(); i++) {
+            const CTransaction& tx = *block.vtx[i];
+            if (i > 0) {
+                for (const Coin& coin : block_undo.vtxundo[i - 1].vprevout) {
+                    balances.m_balances[BAL_IND_PLAIN] -= PlainValue(CTxOutRef(coin.out), subsidy_asset);
+                }
+            }
+            for (const CTxOutRef out : tx.GetOutputs()) {
+                balances.m_balances[BAL_IND_PLAIN] += PlainValue(out, subsidy_asset);
+            }
+        }
+    }
+
+    CDBBatch batch(*m_db);
+    batch.Write(std::make_pair(DB_BALANCESINDEX, pindex->GetBlockHash()), balances);
+    return m_db->WriteBatch(batch);
+}
+
+BaseIndex::DB& BalancesIndex::GetDB() const { return *m_db; }
+
+bool BalancesIndex::FindBlockBalances(const uint256& block_hash, BlockBalances& balances) const
+{
+    return m_db->ReadBalances(block_hash, balances);
+}
@@ -0,0 +1,45 @@
+// Copyright (c) 2021 The Crown Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef CROWN_INDEX_BALANCESINDEX_H
+#define CROWN_INDEX_BALANCESINDEX_H
+
+#include <index/base.h>
+#include <insight/balanceindex.h>
+
+/**
+ * BalancesIndex records for every block the total amount of the subsidy asset held in
+ * unspent outputs once the block is connected. Entries are keyed by block hash, so those
+ * of blocks reorganized out of the active chain stay valid.
+ */
+class BalancesIndex final : public BaseIndex
+{
+protected:
+    class DB;
+
+private:
+    const std::unique_ptr<DB> m_db;
+
+protected:
+    bool WriteBlock(const CBlock& block, const CBlockIndex* pindex) override;
+
+    BaseIndex::DB& GetDB() const override;
+
+    const char* GetName() const override { return "balancesindex"; }
+
+public:
+    /// Constructs the index, which becomes available to be queried.
+    explicit BalancesIndex(size_t n_cache_size, bool f_memory = false, bool f_wipe = false);
+
+    // Destructor is declared because this class contains a unique_ptr to an incomplete type.
+    virtual ~BalancesIndex() override;
+
+    /// Look up the balances after the block with the given hash was connected.
+    bool FindBlockBalances(const uint256& block_hash, BlockBalances& balances) const;
+};
+
+/// The global balances index. May be null.
+extern std::unique_ptr<BalancesIndex> g_balancesindex;
+
+#endif // CROWN_INDEX_BALANCESINDEX_H
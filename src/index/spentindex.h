@@ -0,0 +1,46 @@
+// Copyright (c) 2021 The Crown Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef CROWN_INDEX_SPENTINDEX_H
+#define CROWN_INDEX_SPENTINDEX_H
+
+#include <index/base.h>
+#include <insight/spentindex.h>
+
+/**
+ * SpentIndex maps every spent output to the input spending it, together with the amount and
+ * address of the output, so that an input can be resolved without the previous transaction.
+ */
+class SpentIndex final : public BaseIndex
+{
+protected:
+    class DB;
+
+private:
+    const std::unique_ptr<DB> m_db;
+
+protected:
+    bool WriteBlock(const CBlock& block, const CBlockIndex* pindex) override;
+
+    bool Rewind(const CBlockIndex* current_tip, const CBlockIndex* new_tip) override;
+
+    BaseIndex::DB& GetDB() const override;
+
+    const char* GetName() const override { return "spentindex"; }
+
+public:
+    /// Constructs the index, which becomes available to be queried.
+    explicit SpentIndex(size_t n_cache_size, bool f_memory = false, bool f_wipe = false);
+
+    // Destructor is declared because this class contains a unique_ptr to an incomplete type.
+    virtual ~SpentIndex() override;
+
+    /// Look up the input spending the output in key, returns false if it is unspent or unknown.
+    bool FindSpent(const CSpentIndexKey& key, CSpentIndexValue& value) const;
+};
+
+/// The global spent index, used by the insight RPCs. May be null.
+extern std::unique_ptr<SpentIndex> g_spentindex;
+
+#endif // CROWN_INDEX_SPENTINDEX_H
@@ -0,0 +1,49 @@
+// Copyright (c) 2021 The Crown Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef CROWN_INDEX_TIMESTAMPINDEX_H
+#define CROWN_INDEX_TIMESTAMPINDEX_H
+
+#include <index/base.h>
+#include <sync.h>
+
+#include <vector>
+
+extern RecursiveMutex cs_main;
+
+/**
+ * TimestampIndex is used to look up the blocks with a timestamp in a given range. Entries of
+ * blocks that have been reorganized out of the active chain are kept.
+ */
+class TimestampIndex final : public BaseIndex
+{
+protected:
+    class DB;
+
+private:
+    const std::unique_ptr<DB> m_db;
+
+protected:
+    bool WriteBlock(const CBlock& block, const CBlockIndex* pindex) override;
+
+    BaseIndex::DB& GetDB() const override;
+
+    const char* GetName() const override { return "timestampindex"; }
+
+public:
+    /// Constructs the index, which becomes available to be queried.
+    explicit TimestampIndex(size_t n_cache_size, bool f_memory = false, bool f_wipe = false);
+
+    // Destructor is declared because this class contains a unique_ptr to an incomplete type.
+    virtual ~TimestampIndex() override;
+
+    /// Collect the blocks with low <= timestamp < high, restricted to the active chain if fActiveOnly.
+    bool FindBlocks(unsigned int high, unsigned int low, bool fActiveOnly,
+                    std::vector<std::pair<uint256, unsigned int>>& hashes) const EXCLUSIVE_LOCKS_REQUIRED(cs_main);
+};
+
+/// The global timestamp index, used by the getblockhashes RPC. May be null.
+extern std::unique_ptr<TimestampIndex> g_timestampindex;
+
+#endif // CROWN_INDEX_TIMESTAMPINDEX_H
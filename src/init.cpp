@@ -25,16 +25,22 @@
 #include <hash.h>
 #include <httprpc.h>
 #include <httpserver.h>
+#include <index/addressindex.h>
+#include <index/balancesindex.h>
 #include <index/blockfilterindex.h>
+#include <index/spentindex.h>
+#include <index/timestampindex.h>
 #include <index/txindex.h>
 #include <interfaces/chain.h>
 #include <interfaces/node.h>
 #include <key.h>
 #include <miner.h>
+#include <mn_processing.h>
 #include <net.h>
 #include <net_permissions.h>
 #include <net_processing.h>
 #include <netbase.h>
+#include <node/coinstats.h>
 #include <node/context.h>
 #include <node/ui_interface.h>
 #include <policy/feerate.h>
@@ -80,7 +86,9 @@
 #include <platform/platform-db.h>
 #include <crown/init.h>
 #include <crown/nodesync.h>
+#include <masternode/masternode-payments.h>
 #include <masternode/masternode-sync.h>
+#include <masternode/masternodeman.h>
 
 #ifndef WIN32
 #include <attributes.h>
@@ -185,6 +193,18 @@ void Interrupt(NodeContext& node)
     if (g_txindex) {
         g_txindex->Interrupt();
     }
+    if (g_addressindex) {
+        g_addressindex->Interrupt();
+    }
+    if (g_spentindex) {
+        g_spentindex->Interrupt();
+    }
+    if (g_timestampindex) {
+        g_timestampindex->Interrupt();
+    }
+    if (g_balancesindex) {
+        g_balancesindex->Interrupt();
+    }
     ForEachBlockFilterIndex([](BlockFilterIndex& index) { index.Interrupt(); });
 }
 
@@ -230,6 +250,7 @@ void Shutdown(NodeContext& node)
         LOCK2(::cs_main, ::g_cs_orphans);
         node.connman->StopNodes();
     }
+    StopMasternodeMessageCapture();
 
     StopTorControl();
 
@@ -284,6 +305,22 @@ void Shutdown(NodeContext& node)
         g_txindex->Stop();
         g_txindex.reset();
     }
+    if (g_addressindex) {
+        g_addressindex->Stop();
+        g_addressindex.reset();
+    }
+    if (g_spentindex) {
+        g_spentindex->Stop();
+        g_spentindex.reset();
+    }
+    if (g_timestampindex) {
+        g_timestampindex->Stop();
+        g_timestampindex.reset();
+    }
+    if (g_balancesindex) {
+        g_balancesindex->Stop();
+        g_balancesindex.reset();
+    }
     ForEachBlockFilterIndex([](BlockFilterIndex& index) { index.Stop(); });
     DestroyAllBlockFilterIndexes();
 
@@ -496,6 +533,7 @@ void SetupServerArgs(NodeContext& node)
     argsman.AddArg("-listen", "Accept connections from outside (default: 1 if no -proxy or -connect)", ArgsManager::ALLOW_ANY, OptionsCategory::CONNECTION);
     argsman.AddArg("-listenonion", strprintf("Automatically create Tor onion service (default: %d)", DEFAULT_LISTEN_ONION), ArgsManager::ALLOW_ANY, OptionsCategory::CONNECTION);
     argsman.AddArg("-maxconnections=<n>", strprintf("Maintain at most <n> connections to peers (default: %u)", DEFAULT_MAX_PEER_CONNECTIONS), ArgsManager::ALLOW_ANY, OptionsCategory::CONNECTION);
+    argsman.AddArg("-msgclassweight=<class>:<n>", strprintf("Share of the processing of the messages of each peer given to a class of messages when several have messages waiting: block, tx, gossip (masternode, systemnode, budget, instantsend and spork) or smsg (default: block:%d, tx:%d, gossip:%d, smsg:%d). This option can be specified multiple times.", DEFAULT_MSG_CLASS_WEIGHTS[0], DEFAULT_MSG_CLASS_WEIGHTS[1], DEFAULT_MSG_CLASS_WEIGHTS[2], DEFAULT_MSG_CLASS_WEIGHTS[3]), ArgsManager::ALLOW_ANY, OptionsCategory::CONNECTION);
     argsman.AddArg("-maxreceivebuffer=<n>", strprintf("Maximum per-connection receive buffer, <n>*1000 bytes (default: %u)", DEFAULT_MAXRECEIVEBUFFER), ArgsManager::ALLOW_ANY, OptionsCategory::CONNECTION);
     argsman.AddArg("-maxsendbuffer=<n>", strprintf("Maximum per-connection send buffer, <n>*1000 bytes (default: %u)", DEFAULT_MAXSENDBUFFER), ArgsManager::ALLOW_ANY, OptionsCategory::CONNECTION);
     argsman.AddArg("-maxtimeadjustment", strprintf("Maximum allowed median peer time offset adjustment. Local perspective of time may be influenced by peers forward or backward by this amount. (default: %u seconds)", DEFAULT_MAX_TIME_ADJUSTMENT), ArgsManager::ALLOW_ANY, OptionsCategory::CONNECTION);
@@ -568,7 +606,10 @@ void SetupServerArgs(NodeContext& node)
     argsman.AddArg("-checkmempool=<n>", strprintf("Run checks every <n> transactions (default: %u, regtest: %u)", defaultChainParams->DefaultConsistencyChecks(), regtestChainParams->DefaultConsistencyChecks()), ArgsManager::ALLOW_ANY | ArgsManager::DEBUG_ONLY, OptionsCategory::DEBUG_TEST);
     argsman.AddArg("-checkpoints", strprintf("Enable rejection of any forks from the known historical chain until block %s (default: %u)", defaultChainParams->Checkpoints().GetHeight(), DEFAULT_CHECKPOINTS_ENABLED), ArgsManager::ALLOW_ANY | ArgsManager::DEBUG_ONLY, OptionsCategory::DEBUG_TEST);
     argsman.AddArg("-deprecatedrpc=<method>", "Allows deprecated RPC method(s) to be used", ArgsManager::ALLOW_ANY | ArgsManager::DEBUG_ONLY, OptionsCategory::DEBUG_TEST);
+    argsman.AddArg("-capturemnmessages", strprintf("Append the masternode, systemnode, budget, instantsend and spork messages received from peers to mnmessages.dat, to be replayed by replaymnmessages (default: %u)", DEFAULT_CAPTURE_MN_MESSAGES), ArgsManager::ALLOW_ANY | ArgsManager::DEBUG_ONLY, OptionsCategory::DEBUG_TEST);
     argsman.AddArg("-dropmessagestest=<n>", "Randomly drop 1 of every <n> network messages", ArgsManager::ALLOW_ANY | ArgsManager::DEBUG_ONLY, OptionsCategory::DEBUG_TEST);
+    argsman.AddArg("-lockstats", strprintf("Record the wait and hold times of every lock by acquiring source location, see getlockstats (default: %u)", DEFAULT_LOCK_STATS), ArgsManager::ALLOW_ANY, OptionsCategory::DEBUG_TEST);
+    argsman.AddArg("-lockstatsinterval=<n>", strprintf("Log the lock sites with the longest waits every <n> seconds when -lockstats is set, 0 to disable (default: %u)", DEFAULT_LOCK_STATS_INTERVAL), ArgsManager::ALLOW_ANY, OptionsCategory::DEBUG_TEST);
     argsman.AddArg("-stopafterblockimport", strprintf("Stop running after importing blocks from disk (default: %u)", DEFAULT_STOPAFTERBLOCKIMPORT), ArgsManager::ALLOW_ANY | ArgsManager::DEBUG_ONLY, OptionsCategory::DEBUG_TEST);
     argsman.AddArg("-stopatheight", strprintf("Stop running after reaching the given height in the main chain (default: %u)", DEFAULT_STOPATHEIGHT), ArgsManager::ALLOW_ANY | ArgsManager::DEBUG_ONLY, OptionsCategory::DEBUG_TEST);
     argsman.AddArg("-limitancestorcount=<n>", strprintf("Do not accept transactions if number of in-mempool ancestors is <n> or more (default: %u)", DEFAULT_ANCESTOR_LIMIT), ArgsManager::ALLOW_ANY | ArgsManager::DEBUG_ONLY, OptionsCategory::DEBUG_TEST);
@@ -916,18 +957,6 @@ void InitParameterInteraction(ArgsManager& args)
         if (args.SoftSetBoolArg("-whitelistrelay", true))
             LogPrintf("%s: parameter interaction: -whitelistforcerelay=1 -> setting -whitelistrelay=1\n", __func__);
     }
-
-    // Make sure additional indexes are recalculated correctly in VerifyDB
-    // (we must reconnect blocks whenever we disconnect them for these indexes to work)
-    bool fAdditionalIndexes =
-        gArgs.GetBoolArg("-addressindex", DEFAULT_ADDRESSINDEX) ||
-        gArgs.GetBoolArg("-spentindex", DEFAULT_SPENTINDEX) ||
-        gArgs.GetBoolArg("-timestampindex", DEFAULT_TIMESTAMPINDEX);
-
-    if (fAdditionalIndexes && gArgs.GetArg("-checklevel", DEFAULT_CHECKLEVEL) < 4) {
-        gArgs.ForceSetArg("-checklevel", "4");
-        LogPrintf("%s: parameter interaction: additional indexes -> setting -checklevel=4\n", __func__);
-    }
 }
 
 /**
@@ -1143,9 +1172,27 @@ bool AppInitParameterInteraction(const ArgsManager& args)
         }
     }
 
+    g_lock_stats = args.GetBoolArg("-lockstats", DEFAULT_LOCK_STATS);
+
+    for (const std::string& strWeight : args.GetArgs("-msgclassweight")) {
+        const size_t pos = strWeight.find(':');
+        MessageClass msg_class;
+        int32_t nWeight;
+        if (pos == std::string::npos || !MessageClassFromString(strWeight.substr(0, pos), msg_class) ||
+            !ParseInt32(strWeight.substr(pos + 1), &nWeight) || !SetMessageClassWeight(msg_class, nWeight)) {
+            return InitError(strprintf(_("Invalid -msgclassweight '%s'"), strWeight));
+        }
+    }
+
     fCheckBlockIndex = args.GetBoolArg("-checkblockindex", chainparams.DefaultConsistencyChecks());
     fCheckpointsEnabled = args.GetBoolArg("-checkpoints", DEFAULT_CHECKPOINTS_ENABLED);
 
+    // The insight indexes are built in the background, the flags also enable the mempool indexes
+    fAddressIndex = args.GetBoolArg("-addressindex", DEFAULT_ADDRESSINDEX);
+    fSpentIndex = args.GetBoolArg("-spentindex", DEFAULT_SPENTINDEX);
+    fTimestampIndex = args.GetBoolArg("-timestampindex", DEFAULT_TIMESTAMPINDEX);
+    fBalancesIndex = args.GetBoolArg("-balancesindex", DEFAULT_BALANCESINDEX);
+
     hashAssumeValid = uint256S(args.GetArg("-assumevalid", chainparams.GetConsensus().defaultAssumeValid.GetHex()));
     if (!hashAssumeValid.IsNull())
         LogPrintf("Assuming ancestors of block %s have valid signatures.\n", hashAssumeValid.GetHex());
@@ -1418,6 +1465,13 @@ bool AppInitMain(const util::Ref& context, NodeContext& node, interfaces::BlockA
         RandAddPeriodic();
     }, std::chrono::minutes{1});
 
+    const int64_t nLockStatsInterval = args.GetArg("-lockstatsinterval", DEFAULT_LOCK_STATS_INTERVAL);
+    if (g_lock_stats && nLockStatsInterval > 0) {
+        node.scheduler->scheduleEvery([]{
+            LogLockStats(LOCK_STATS_LOG_SITES);
+        }, std::chrono::seconds{nLockStatsInterval});
+    }
+
     GetMainSignals().RegisterBackgroundSignalScheduler(*node.scheduler);
 
     /* Register RPC commands regardless of -server setting so they will be
@@ -1483,6 +1537,7 @@ bool AppInitMain(const util::Ref& context, NodeContext& node, interfaces::BlockA
 
     node.peerman.reset(new PeerManager(chainparams, *node.connman, node.banman.get(), *node.scheduler, chainman, *node.mempool));
     RegisterValidationInterface(node.peerman.get());
+    RegisterValidationInterface(&mnodeman);
 
     // sanitize comments per BIP-0014, format user agent and check total size
     std::vector<std::string> uacomments;
@@ -1625,19 +1680,19 @@ bool AppInitMain(const util::Ref& context, NodeContext& node, interfaces::BlockA
     nTotalCache = std::min(nTotalCache, nMaxDbCache << 20); // total cache cannot be greater than nMaxDbcache
     int64_t nBlockTreeDBCache = nTotalCache / 8;
 
-    if (gArgs.GetBoolArg("-addressindex", DEFAULT_ADDRESSINDEX) || gArgs.GetBoolArg("-spentindex", DEFAULT_SPENTINDEX))
-    {
-        // enable 3/4 of the cache if addressindex and/or spentindex is enabled
-        nBlockTreeDBCache = nTotalCache * 3 / 4;
-    } else
-    {
-        nBlockTreeDBCache = std::min(nBlockTreeDBCache, (gArgs.GetBoolArg("-txindex", DEFAULT_TXINDEX) ? nMaxTxIndexCache : nMaxBlockDBCache) << 20);
-    };
+    nBlockTreeDBCache = std::min(nBlockTreeDBCache, (gArgs.GetBoolArg("-txindex", DEFAULT_TXINDEX) ? nMaxTxIndexCache : nMaxBlockDBCache) << 20);
 
     //int64_t nBlockTreeDBCache = std::min(nTotalCache / 8, nMaxBlockDBCache << 20);
     nTotalCache -= nBlockTreeDBCache;
     int64_t nTxIndexCache = std::min(nTotalCache / 8, args.GetBoolArg("-txindex", DEFAULT_TXINDEX) ? nMaxTxIndexCache << 20 : 0);
     nTotalCache -= nTxIndexCache;
+    // the address and spent indexes get a bigger share, they are written to for every transaction
+    int64_t nAddressIndexCache = std::min(nTotalCache / 4, fAddressIndex ? nMaxTxIndexCache << 20 : 0);
+    nTotalCache -= nAddressIndexCache;
+    int64_t nSpentIndexCache = std::min(nTotalCache / 8, fSpentIndex ? nMaxTxIndexCache << 20 : 0);
+    nTotalCache -= nSpentIndexCache;
+    int64_t nSmallIndexCache = (fTimestampIndex || fBalancesIndex) ? std::min(nTotalCache / 32, nMaxBlockDBCache << 20) : 0;
+    nTotalCache -= nSmallIndexCache;
     int64_t filter_index_cache = 0;
     if (!g_enabled_filter_types.empty()) {
         size_t n_indexes = g_enabled_filter_types.size();
@@ -1656,6 +1711,12 @@ bool AppInitMain(const util::Ref& context, NodeContext& node, interfaces::BlockA
     if (args.GetBoolArg("-txindex", DEFAULT_TXINDEX)) {
         LogPrintf("* Using %.1f MiB for transaction index database\n", nTxIndexCache * (1.0 / 1024 / 1024));
     }
+    if (fAddressIndex) {
+        LogPrintf("* Using %.1f MiB for address index database\n", nAddressIndexCache * (1.0 / 1024 / 1024));
+    }
+    if (fSpentIndex) {
+        LogPrintf("* Using %.1f MiB for spent index database\n", nSpentIndexCache * (1.0 / 1024 / 1024));
+    }
     for (BlockFilterType filter_type : g_enabled_filter_types) {
         LogPrintf("* Using %.1f MiB for %s block filter index database\n",
                   filter_index_cache * (1.0 / 1024 / 1024), BlockFilterTypeName(filter_type));
@@ -1694,7 +1755,7 @@ bool AppInitMain(const util::Ref& context, NodeContext& node, interfaces::BlockA
                 passetsdb.reset();
                 passetsdb.reset(new CAssetsDB(nBlockTreeDBCache, false, fReset));
                 delete passetsCache;
-                passetsCache = new CLRUCache<std::string, CAssetData>(2500);
+                passetsCache = new CAssetsCache(2500);
 
                 // Read for fAssetIndex to make sure that we only load asset address balances if it if true
                 //pblocktree->ReadFlag("assetindex", fAssetIndex);
@@ -1711,6 +1772,9 @@ bool AppInitMain(const util::Ref& context, NodeContext& node, interfaces::BlockA
                     //If we're reindexing in prune mode, wipe away unusable block files and all undo data files
                     if (fPruneMode)
                         CleanupBlockRevFiles();
+                } else {
+                    // The insight indexes have their own databases now, free the space of their old records
+                    pblocktree->EraseLegacyInsightIndexes();
                 }
 
                 if (ShutdownRequested()) break;
@@ -1732,28 +1796,6 @@ bool AppInitMain(const util::Ref& context, NodeContext& node, interfaces::BlockA
                     return InitError(_("Incorrect or no genesis block found. Wrong datadir for network?"));
                 }
 
-                // Check for changed -addressindex state
-                if (fAddressIndex != gArgs.GetBoolArg("-addressindex", DEFAULT_ADDRESSINDEX)) {
-                    strLoadError = _("You need to rebuild the database using -reindex to change -addressindex");
-                    break;
-                }
-
-                // Check for changed -spentindex state
-                if (fSpentIndex != gArgs.GetBoolArg("-spentindex", DEFAULT_SPENTINDEX)) {
-                    strLoadError = _("You need to rebuild the database using -reindex to change -spentindex");
-                    break;
-                }
-
-                // Check for changed -timestampindex state
-                if (fTimestampIndex != gArgs.GetBoolArg("-timestampindex", DEFAULT_TIMESTAMPINDEX)) {
-                    strLoadError = _("You need to rebuild the database using -reindex to change -timestampindex");
-                    break;
-                }
-                if (fBalancesIndex != gArgs.GetBoolArg("-balancesindex", DEFAULT_BALANCESINDEX)) {
-                    strLoadError = _("You need to rebuild the database using -reindex to change -balancesindex");
-                    break;
-                }
-
                 // Check for changed -prune state.  What we are concerned about is a user who has pruned blocks
                 // in the past, but is now trying to run unpruned.
                 if (fHavePruned && !fPruneMode) {
@@ -1806,6 +1848,13 @@ bool AppInitMain(const util::Ref& context, NodeContext& node, interfaces::BlockA
                         break;
                     }
 
+                    // Interrupted writes and databases from before the supply tracking have no asset supply yet
+                    if (!InitAssetSupply(chainstate->CoinsDB())) {
+                        strLoadError = _("Error building the asset supply. You will need to rebuild the database using -reindex-chainstate.");
+                        failed_chainstate_init = true;
+                        break;
+                    }
+
                     // The on-disk coinsdb is now in a good state, create the cache
                     chainstate->InitCoinsCache(nCoinCacheUsage);
                     assert(chainstate->CanFlushToDisk());
@@ -1943,6 +1992,26 @@ bool AppInitMain(const util::Ref& context, NodeContext& node, interfaces::BlockA
         g_txindex->Start();
     }
 
+    if (fAddressIndex) {
+        g_addressindex = std::make_unique<AddressIndex>(nAddressIndexCache, false, fReindex);
+        g_addressindex->Start();
+    }
+
+    if (fSpentIndex) {
+        g_spentindex = std::make_unique<SpentIndex>(nSpentIndexCache, false, fReindex);
+        g_spentindex->Start();
+    }
+
+    if (fTimestampIndex) {
+        g_timestampindex = std::make_unique<TimestampIndex>(nSmallIndexCache / 2, false, fReindex);
+        g_timestampindex->Start();
+    }
+
+    if (fBalancesIndex) {
+        g_balancesindex = std::make_unique<BalancesIndex>(nSmallIndexCache / 2, false, fReindex);
+        g_balancesindex->Start();
+    }
+
     for (const auto& filter_type : g_enabled_filter_types) {
         InitBlockFilterIndex(filter_type, filter_index_cache, false, fReindex);
         GetBlockFilterIndex(filter_type)->Start();
@@ -2062,6 +2131,10 @@ bool AppInitMain(const util::Ref& context, NodeContext& node, interfaces::BlockA
         return false;
     }
 
+    if (args.GetBoolArg("-capturemnmessages", DEFAULT_CAPTURE_MN_MESSAGES) && !StartMasternodeMessageCapture(GetDataDir() / "mnmessages.dat")) {
+        return InitError(_("Unable to open mnmessages.dat for -capturemnmessages"));
+    }
+
     {
         LOCK(cs_main);
         LogPrintf("block tree size = %u\n", chainman.BlockIndex().size());
@@ -2183,6 +2256,7 @@ bool AppInitMain(const util::Ref& context, NodeContext& node, interfaces::BlockA
     }, DUMP_BANS_INTERVAL);
 
     node.scheduler->scheduleEvery(std::bind(&ThreadNodeSync, std::ref(*node.connman)), std::chrono::seconds{10});
+    node.scheduler->scheduleEvery(std::bind(&CMasternodePayments::ProcessPendingWinners, &masternodePayments, std::ref(*node.connman)), std::chrono::seconds{1});
     node.scheduler->scheduleEvery(std::bind(&NodeMinter, std::ref(Params()), std::ref(*node.connman)), std::chrono::seconds{60});
 
 #if HAVE_SYSTEM
@@ -5,6 +5,9 @@
 #ifndef CROWN_INSIGHT_BALANCEINDEX_H
 #define CROWN_INSIGHT_BALANCEINDEX_H
 
+#include <amount.h>
+#include <serialize.h>
+
 enum BalanceIndexType {
     BAL_IND_PLAIN_ADDED                 = 0,
     BAL_IND_PLAIN_REMOVED               = 1,
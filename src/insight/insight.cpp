@@ -5,10 +5,14 @@
 
 #include <insight/insight.h>
 #include <insight/addressindex.h>
+#include <insight/balanceindex.h>
 #include <insight/spentindex.h>
 #include <insight/timestampindex.h>
+#include <index/addressindex.h>
+#include <index/balancesindex.h>
+#include <index/spentindex.h>
+#include <index/timestampindex.h>
 #include <validation.h>
-#include <txdb.h>
 #include <txmempool.h>
 #include <uint256.h>
 #include <script/script.h>
@@ -66,10 +70,10 @@ bool ExtractIndexInfo(const CTxOutAsset *out, int &scriptType, std::vector<uint8
 
 bool GetTimestampIndex(const unsigned int &high, const unsigned int &low, const bool fActiveOnly, std::vector<std::pair<uint256, unsigned int> > &hashes)
 {
-    if (!fTimestampIndex) {
+    if (!g_timestampindex) {
         return error("Timestamp index not enabled");
     }
-    if (!pblocktree->ReadTimestampIndex(high, low, fActiveOnly, hashes)) {
+    if (!g_timestampindex->FindBlocks(high, low, fActiveOnly, hashes)) {
         return error("Unable to get hashes for timestamps");
     }
 
@@ -78,13 +82,13 @@ bool GetTimestampIndex(const unsigned int &high, const unsigned int &low, const
 
 bool GetSpentIndex(CSpentIndexKey &key, CSpentIndexValue &value, const CTxMemPool *pmempool)
 {
-    if (!fSpentIndex) {
+    if (!g_spentindex) {
         return false;
     }
     if (pmempool && pmempool->getSpentIndex(key, value)) {
         return true;
     }
-    if (!pblocktree->ReadSpentIndex(key, value)) {
+    if (!g_spentindex->FindSpent(key, value)) {
         return false;
     }
 
@@ -105,10 +109,13 @@ bool HashOnchainActive(const uint256 &hash)
 bool GetAddressIndex(uint160 addressHash, int type, CAsset asset,
                      std::vector<std::pair<CAddressIndexKey, CAmountMap> > &addressIndex, int start, int end)
 {
-    if (!fAddressIndex) {
+    if (!g_addressindex) {
         return error("Address index not enabled");
     }
-    if (!pblocktree->ReadAddressIndex(addressHash, type, asset, addressIndex, start, end)) {
+    if (!g_addressindex->ScanAddressIndex({{addressHash, type}}, asset, start, end, false, [&](const CAddressIndexKey &key, const CAmountMap &value) {
+            addressIndex.push_back(std::make_pair(key, value));
+            return true;
+        })) {
         return error("Unable to get txids for address");
     }
 
@@ -118,10 +125,39 @@ bool GetAddressIndex(uint160 addressHash, int type, CAsset asset,
 bool GetAddressUnspent(uint160 addressHash, int type, CAsset asset,
                        std::vector<std::pair<CAddressUnspentKey, CAddressUnspentValue> > &unspentOutputs)
 {
-    if (!fAddressIndex) {
+    if (!g_addressindex) {
         return error("Address index not enabled");
     }
-    if (!pblocktree->ReadAddressUnspentIndex(addressHash, type, asset, unspentOutputs)) {
+    if (!g_addressindex->ScanAddressUnspent(addressHash, type, asset, [&](const CAddressUnspentKey &key, const CAddressUnspentValue &value) {
+            unspentOutputs.push_back(std::make_pair(key, value));
+            return true;
+        })) {
+        return error("Unable to get txids for address");
+    }
+
+    return true;
+};
+
+bool ScanAddressIndex(const std::vector<std::pair<uint160, int> > &addresses, const CAsset &asset, int start, int end, bool fReverse,
+                      const std::function<bool(const CAddressIndexKey&, const CAmountMap&)> &fn)
+{
+    if (!g_addressindex) {
+        return error("Address index not enabled");
+    }
+    if (!g_addressindex->ScanAddressIndex(addresses, asset, start, end, fReverse, fn)) {
+        return error("Unable to get txids for address");
+    }
+
+    return true;
+};
+
+bool ScanAddressUnspent(const uint160 &addressHash, int type, const CAsset &asset,
+                        const std::function<bool(const CAddressUnspentKey&, const CAddressUnspentValue&)> &fn)
+{
+    if (!g_addressindex) {
+        return error("Address index not enabled");
+    }
+    if (!g_addressindex->ScanAddressUnspent(addressHash, type, asset, fn)) {
         return error("Unable to get txids for address");
     }
 
@@ -130,10 +166,10 @@ bool GetAddressUnspent(uint160 addressHash, int type, CAsset asset,
 
 bool GetBlockBalances(const uint256 &block_hash, BlockBalances &balances)
 {
-    if (!fBalancesIndex) {
+    if (!g_balancesindex) {
         return error("Balances index not enabled");
     }
-    if (!pblocktree->ReadBlockBalancesIndex(block_hash, balances)) {
+    if (!g_balancesindex->FindBlockBalances(block_hash, balances)) {
         return error("Unable to get balances for block %s", block_hash.ToString());
     }
 
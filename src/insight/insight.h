@@ -14,6 +14,7 @@
 #include <amount.h>
 #include <sync.h>
 #include <stdint.h>
+#include <functional>
 #include <vector>
 #include <string>
 #include <utility>
@@ -51,6 +52,10 @@ bool GetAddressIndex(uint160 addressHash, int type, CAsset asset,
                      int start = 0, int end = 0);
 bool GetAddressUnspent(uint160 addressHash, int type, CAsset asset, 
                        std::vector<std::pair<CAddressUnspentKey, CAddressUnspentValue> > &unspentOutputs);
+bool ScanAddressIndex(const std::vector<std::pair<uint160, int> > &addresses, const CAsset &asset, int start, int end, bool fReverse,
+                      const std::function<bool(const CAddressIndexKey&, const CAmountMap&)> &fn);
+bool ScanAddressUnspent(const uint160 &addressHash, int type, const CAsset &asset,
+                        const std::function<bool(const CAddressUnspentKey&, const CAddressUnspentValue&)> &fn);
 bool GetBlockBalances(const uint256 &block_hash, BlockBalances &balances);
 
 bool getAddressFromIndex(const int &type, const uint160 &hash, std::string &address);
@@ -8,6 +8,12 @@
 
 #include <util/strencodings.h>
 #include <insight/insight.h>
+#include <insight/addressindex.h>
+#include <insight/spentindex.h>
+#include <assetdb.h>
+#include <index/addressindex.h>
+#include <index/spentindex.h>
+#include <index/timestampindex.h>
 #include <index/txindex.h>
 #include <validation.h>
 #include <txmempool.h>
@@ -15,6 +21,7 @@
 #include <miner.h>
 
 #include <core_io.h>
+#include <node/coinstats.h>
 #include <node/context.h>
 #include <script/standard.h>
 #include <shutdown.h>
@@ -67,6 +74,76 @@ bool getAddressesFromParams(const UniValue& params, std::vector<std::pair<uint16
     return true;
 }
 
+/** Optional asset filter and paging shared by the address index calls */
+struct AddressQuery
+{
+    CAsset asset;
+    size_t offset = 0;
+    size_t limit = 0; // 0 means no limit
+    bool reverse = false;
+
+    //! Whether the next result is still within the skipped offset
+    bool Skip()
+    {
+        if (offset == 0) return false;
+        --offset;
+        return true;
+    }
+
+    bool Full(size_t count) const { return limit > 0 && count >= limit; }
+};
+
+AddressQuery getAddressQueryFromParams(const UniValue& params)
+{
+    AddressQuery query;
+    if (!params[0].isObject()) {
+        return query;
+    }
+
+    UniValue assetValue = find_value(params[0].get_obj(), "asset");
+    if (assetValue.isStr()) {
+        LOCK(cs_main);
+        query.asset = GetAsset(assetValue.get_str());
+        if (query.asset.IsNull()) {
+            throw JSONRPCError(RPC_INVALID_PARAMETER, strprintf("Unknown asset %s", assetValue.get_str()));
+        }
+    }
+
+    UniValue offsetValue = find_value(params[0].get_obj(), "offset");
+    UniValue limitValue = find_value(params[0].get_obj(), "limit");
+    if (offsetValue.isNum()) {
+        if (offsetValue.get_int() < 0) {
+            throw JSONRPCError(RPC_INVALID_PARAMETER, "Offset is expected to be zero or greater");
+        }
+        query.offset = offsetValue.get_int();
+    }
+    if (limitValue.isNum()) {
+        if (limitValue.get_int() < 0) {
+            throw JSONRPCError(RPC_INVALID_PARAMETER, "Limit is expected to be zero or greater");
+        }
+        query.limit = limitValue.get_int();
+    }
+
+    UniValue reverseValue = find_value(params[0].get_obj(), "reverse");
+    if (reverseValue.isBool()) {
+        query.reverse = reverseValue.get_bool();
+    }
+
+    return query;
+}
+
+/** Wait until the index has processed the blocks connected so far, so that its results match
+ *  the chain tip and the mempool deltas merged into them. Must be called without cs_main. */
+static void EnsureIndexSynced(const BaseIndex* index, const std::string& name)
+{
+    if (!index) {
+        throw JSONRPCError(RPC_MISC_ERROR, strprintf("%s is not enabled.", name));
+    }
+    if (!index->BlockUntilSyncedToCurrentChain()) {
+        throw JSONRPCError(RPC_MISC_ERROR, strprintf("%s is still being built, see getindexinfo for its progress.", name));
+    }
+}
+
 static RPCHelpMan getaddressmempool()
 {
     return RPCHelpMan{"getaddressmempool",
@@ -148,6 +225,9 @@ return RPCHelpMan{"getaddressutxos",
                 {
                     {"address", RPCArg::Type::STR, RPCArg::Optional::NO, "The base58check encoded address."},
                     {"chainInfo", RPCArg::Type::BOOL, /* default */ "false", "Include chain info in results, only applies if start and end specified."},
+                    {"asset", RPCArg::Type::STR, /* default */ "all assets", "Only return outputs of this asset."},
+                    {"offset", RPCArg::Type::NUM, /* default */ "0", "Number of outputs to skip, pages follow the index order (asset, txid, output index)."},
+                    {"limit", RPCArg::Type::NUM, /* default */ "0", "Maximum number of outputs to return, 0 for no limit."},
                 },
                 RPCResult{
                     RPCResult::Type::ARR, "", "", {
@@ -171,6 +251,7 @@ return RPCHelpMan{"getaddressutxos",
     if (!fAddressIndex) {
         throw JSONRPCError(RPC_MISC_ERROR, "Address index is not enabled.");
     }
+    EnsureIndexSynced(g_addressindex.get(), "Address index");
 
     bool includeChainInfo = false;
     if (request.params[0].isObject()) {
@@ -186,11 +267,17 @@ return RPCHelpMan{"getaddressutxos",
         throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "Invalid address 5");
     }
 
+    AddressQuery query = getAddressQueryFromParams(request.params);
     std::vector<std::pair<CAddressUnspentKey, CAddressUnspentValue> > unspentOutputs;
-    CAsset asset;
 
-    for (std::vector<std::pair<uint160, int> >::iterator it = addresses.begin(); it != addresses.end(); it++) {
-        if (!GetAddressUnspent((*it).first, (*it).second, asset, unspentOutputs)) {
+    for (std::vector<std::pair<uint160, int> >::iterator it = addresses.begin(); it != addresses.end() && !query.Full(unspentOutputs.size()); it++) {
+        bool fOk = ScanAddressUnspent((*it).first, (*it).second, query.asset, [&](const CAddressUnspentKey& key, const CAddressUnspentValue& value) {
+            if (!query.Skip()) {
+                unspentOutputs.push_back(std::make_pair(key, value));
+            }
+            return !query.Full(unspentOutputs.size());
+        });
+        if (!fOk) {
             throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "No information available for address");
         }
     }
@@ -243,6 +330,10 @@ static RPCHelpMan getaddressdeltas()
                     {"start", RPCArg::Type::NUM, /* default */ "0", "The start block height."},
                     {"end", RPCArg::Type::NUM, /* default */ "0", "The end block height."},
                     {"chainInfo", RPCArg::Type::BOOL, /* default */ "false", "Include chain info in results, only applies if start and end specified."},
+                    {"asset", RPCArg::Type::STR, /* default */ "all assets", "Only return changes of this asset."},
+                    {"offset", RPCArg::Type::NUM, /* default */ "0", "Number of changes to skip."},
+                    {"limit", RPCArg::Type::NUM, /* default */ "0", "Maximum number of changes to return, 0 for no limit."},
+                    {"reverse", RPCArg::Type::BOOL, /* default */ "false", "Return the newest changes first."},
                 },
                 RPCResult{
                     RPCResult::Type::ARR, "", "", {
@@ -264,6 +355,7 @@ static RPCHelpMan getaddressdeltas()
     if (!fAddressIndex) {
         throw JSONRPCError(RPC_MISC_ERROR, "Address index is not enabled.");
     }
+    EnsureIndexSynced(g_addressindex.get(), "Address index");
 
     UniValue startValue = find_value(request.params[0].get_obj(), "start");
     UniValue endValue = find_value(request.params[0].get_obj(), "end");
@@ -294,19 +386,17 @@ static RPCHelpMan getaddressdeltas()
         throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "Invalid address 6");
     }
 
+    AddressQuery query = getAddressQueryFromParams(request.params);
     std::vector<std::pair<CAddressIndexKey, CAmountMap> > addressIndex;
-    CAsset asset;
 
-    for (std::vector<std::pair<uint160, int> >::iterator it = addresses.begin(); it != addresses.end(); it++) {
-        if (start > 0 && end > 0) {
-            if (!GetAddressIndex((*it).first, (*it).second, asset, addressIndex, start, end)) {
-                throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "No information available for address");
-            }
-        } else {
-            if (!GetAddressIndex((*it).first, (*it).second, asset, addressIndex)) {
-                throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "No information available for address");
-            }
+    bool fOk = ScanAddressIndex(addresses, query.asset, start, end, query.reverse, [&](const CAddressIndexKey& key, const CAmountMap& value) {
+        if (!query.Skip()) {
+            addressIndex.push_back(std::make_pair(key, value));
         }
+        return !query.Full(addressIndex.size());
+    });
+    if (!fOk) {
+        throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "No information available for address");
     }
 
     UniValue deltas(UniValue::VARR);
@@ -324,7 +414,7 @@ static RPCHelpMan getaddressdeltas()
         delta.pushKV("txid", it->first.txhash.GetHex());
         delta.pushKV("index", (int)it->first.index);
         delta.pushKV("blockindex", (int)it->first.txindex);
-        delta.pushKV("height", it->first.blockHeight);
+        delta.pushKV("height", (int)it->first.blockHeight);
         delta.pushKV("address", address);
         deltas.push_back(delta);
     }
@@ -385,6 +475,7 @@ static RPCHelpMan getaddressbalance()
     if (!fAddressIndex) {
         throw JSONRPCError(RPC_MISC_ERROR, "Address index is not enabled.");
     }
+    EnsureIndexSynced(g_addressindex.get(), "Address index");
 
     std::vector<std::pair<uint160, int> > addresses;
 
@@ -433,6 +524,10 @@ static RPCHelpMan getaddresstxids()
                     {"address", RPCArg::Type::STR, RPCArg::Optional::NO, "The base58check encoded address."},
                     {"start", RPCArg::Type::NUM, /* default */ "0", "The start block height."},
                     {"end", RPCArg::Type::NUM, /* default */ "0", "The end block height."},
+                    {"asset", RPCArg::Type::STR, /* default */ "all assets", "Only return transactions moving this asset."},
+                    {"offset", RPCArg::Type::NUM, /* default */ "0", "Number of txids to skip."},
+                    {"limit", RPCArg::Type::NUM, /* default */ "0", "Maximum number of txids to return, 0 for no limit."},
+                    {"reverse", RPCArg::Type::BOOL, /* default */ "false", "Return the newest transactions first."},
                 },
                 RPCResult{
                     RPCResult::Type::ARR, "", "", {
@@ -449,6 +544,7 @@ static RPCHelpMan getaddresstxids()
     if (!fAddressIndex) {
         throw JSONRPCError(RPC_MISC_ERROR, "Address index is not enabled.");
     }
+    EnsureIndexSynced(g_addressindex.get(), "Address index");
 
     std::vector<std::pair<uint160, int> > addresses;
 
@@ -467,41 +563,23 @@ static RPCHelpMan getaddresstxids()
         }
     }
 
-    std::vector<std::pair<CAddressIndexKey, CAmountMap> > addressIndex;
-    CAsset asset;
-
-    for (std::vector<std::pair<uint160, int> >::iterator it = addresses.begin(); it != addresses.end(); it++) {
-        if (start > 0 && end > 0) {
-            if (!GetAddressIndex((*it).first, (*it).second, asset,  addressIndex, start, end)) {
-                throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "No information available for address");
-            }
-        } else {
-            if (!GetAddressIndex((*it).first, (*it).second, asset, addressIndex)) {
-                throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "No information available for address");
-            }
-        }
-    }
-
-    std::set<std::pair<int, std::string> > txids;
+    AddressQuery query = getAddressQueryFromParams(request.params);
     UniValue result(UniValue::VARR);
 
-    for (std::vector<std::pair<CAddressIndexKey, CAmountMap> >::const_iterator it=addressIndex.begin(); it!=addressIndex.end(); it++) {
-        int height = it->first.blockHeight;
-        std::string txid = it->first.txhash.GetHex();
-
-        if (addresses.size() > 1) {
-            txids.insert(std::make_pair(height, txid));
-        } else {
-            if (txids.insert(std::make_pair(height, txid)).second) {
-                result.push_back(txid);
-            }
+    // Entries are streamed in block order, so all entries of a transaction are adjacent
+    uint256 lastTxid;
+    bool fOk = ScanAddressIndex(addresses, query.asset, start, end, query.reverse, [&](const CAddressIndexKey& key, const CAmountMap& value) {
+        if (key.txhash == lastTxid) {
+            return true;
         }
-    }
-
-    if (addresses.size() > 1) {
-        for (std::set<std::pair<int, std::string> >::const_iterator it=txids.begin(); it!=txids.end(); it++) {
-            result.push_back(it->second);
+        lastTxid = key.txhash;
+        if (!query.Skip()) {
+            result.push_back(key.txhash.GetHex());
         }
+        return !query.Full(result.size());
+    });
+    if (!fOk) {
+        throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "No information available for address");
     }
 
     return result;
@@ -535,6 +613,7 @@ static RPCHelpMan getspentinfo()
                 },
         [&](const RPCHelpMan& self, const JSONRPCRequest& request) -> UniValue
 {
+    EnsureIndexSynced(g_spentindex.get(), "Spent index");
     const CTxMemPool& mempool = EnsureMemPool(request.context);
 
     UniValue txidValue = find_value(request.params[0].get_obj(), "txid");
@@ -564,7 +643,7 @@ static RPCHelpMan getspentinfo()
     };
 }
 
-static void AddAddress(CScript *script, UniValue &uv)
+static void AddAddress(const CScript *script, UniValue &uv)
 {
     if (script->IsPayToScriptHash()) {
         std::vector<unsigned char> hashBytes(script->begin()+2, script->begin()+22);
@@ -637,7 +716,7 @@ static UniValue blockToDeltasJSON(const CBlock& block, const CBlockIndex* blocki
 
         UniValue outputs(UniValue::VARR);
         for(unsigned int k = 0; k < (tx.nVersion >= TX_ELE_VERSION ? tx.vpout.size() : tx.vout.size()) ; k++){
-            CTxOutAsset out = (tx.nVersion >= TX_ELE_VERSION ? tx.vpout[k] : tx.vout[k]);
+            const CTxOutRef out = tx.GetOutputs()[k];
 
             UniValue delta(UniValue::VOBJ);
 
@@ -683,6 +762,7 @@ return RPCHelpMan{"getblockdeltas",
         },
         [&](const RPCHelpMan& self, const JSONRPCRequest& request) -> UniValue
 {
+    EnsureIndexSynced(g_spentindex.get(), "Spent index");
     LOCK(cs_main);
 
     const CTxMemPool& mempool = EnsureMemPool(request.context);
@@ -764,6 +844,7 @@ static RPCHelpMan getblockhashes()
 
     std::vector<std::pair<uint256, unsigned int> > blockHashes;
 
+    EnsureIndexSynced(g_timestampindex.get(), "Timestamp index");
     {
         LOCK(cs_main);
         if (!GetTimestampIndex(high, low, fActiveOnly, blockHashes)) {
@@ -789,17 +870,66 @@ static RPCHelpMan getblockhashes()
     };
 }
 
+static Mutex cs_scriptstats;
+//! Last gettxoutsetinfobyscript result, reused while the tip doesn't move
+static CCoinsScriptStats g_scriptstats GUARDED_BY(cs_scriptstats);
+
+//! Help for the per script type and per asset counters
+static std::vector<RPCResult> ScriptTypeStatsDoc()
+{
+    return {
+        {RPCResult::Type::NUM, "num_plain", "The number of unspent outputs with a plain amount"},
+        {RPCResult::Type::NUM, "num_blinded", "The number of unspent outputs with a blinded amount"},
+        {RPCResult::Type::STR_AMOUNT, "total_amount", "The sum of the plain amounts"},
+    };
+}
+
+static UniValue ScriptTypeStatsToUV(const CScriptTypeStats& stats)
+{
+    UniValue ret(UniValue::VOBJ);
+    ret.pushKV("num_plain", (int64_t)stats.nPlain);
+    ret.pushKV("num_blinded", (int64_t)stats.nBlinded);
+    ret.pushKV("total_amount", ValueFromAmount(stats.nPlainValue));
+    return ret;
+}
+
 static RPCHelpMan gettxoutsetinfobyscript()
 {
     return RPCHelpMan{"gettxoutsetinfobyscript",
-                "\nReturns statistics about the unspent transaction output set per script type.\n"
-                "This call may take some time.\n",
+                "\nReturns statistics about the unspent transaction output set per script type and per asset.\n"
+                "The statistics are those of the set last written to disk, which may lag a few blocks behind the tip.\n"
+                "This call may take some time, the result is reused until the set is written again.\n",
                 {
                 },
                 RPCResult{
                     RPCResult::Type::OBJ, "", "", {
-                        {RPCResult::Type::NUM, "height", "The current block height (index)"},
-                        {RPCResult::Type::STR_HEX, "bestblock", "The best block hash hex"},
+                        {RPCResult::Type::NUM, "height", "The height of the block the statistics are for"},
+                        {RPCResult::Type::STR_HEX, "bestblock", "The hash of the block the statistics are for"},
+                        {RPCResult::Type::OBJ, "paytopubkeyhash", "Outputs paying to a public key hash", ScriptTypeStatsDoc()},
+                        {RPCResult::Type::OBJ, "paytoscripthash", "Outputs paying to a script hash", ScriptTypeStatsDoc()},
+                        {RPCResult::Type::OBJ, "other", "Outputs with any other script", ScriptTypeStatsDoc()},
+                        {RPCResult::Type::ARR, "assets", "", {
+                            {RPCResult::Type::OBJ, "", "Outputs of one asset", {
+                                {RPCResult::Type::NUM, "num_plain", "The number of unspent outputs with a plain amount"},
+                                {RPCResult::Type::NUM, "num_blinded", "The number of unspent outputs with a blinded amount"},
+                                {RPCResult::Type::STR_AMOUNT, "total_amount", "The sum of the plain amounts"},
+                                {RPCResult::Type::OBJ, "asset", "", {
+                                    {RPCResult::Type::NUM, "version", "The asset version"},
+                                    {RPCResult::Type::STR, "type", "The asset type"},
+                                    {RPCResult::Type::STR, "name", "The asset name"},
+                                    {RPCResult::Type::STR, "symbol", "The asset symbol"},
+                                    {RPCResult::Type::STR_HEX, "id", "The asset id"},
+                                    {RPCResult::Type::NUM, "expiry", "The expiry time"},
+                                    {RPCResult::Type::STR, "transferable", "\"yes\" if the asset can be transferred"},
+                                    {RPCResult::Type::STR, "convertable", "\"yes\" if the asset can be converted"},
+                                    {RPCResult::Type::STR, "limited", "\"yes\" if the asset is limited"},
+                                    {RPCResult::Type::STR, "restricted", "\"yes\" if the asset is restricted"},
+                                    {RPCResult::Type::STR, "stakeable", "\"yes\" if the asset can be staked"},
+                                    {RPCResult::Type::STR, "inflation", "\"yes\" if more of the asset can be issued"},
+                                    {RPCResult::Type::STR, "divisible", "\"yes\" if the asset is divisible"},
+                                }},
+                            }},
+                        }},
                     }
                 },
                 RPCExamples{
@@ -809,65 +939,43 @@ static RPCHelpMan gettxoutsetinfobyscript()
                 },
         [&](const RPCHelpMan& self, const JSONRPCRequest& request) -> UniValue
 {
-    UniValue ret(UniValue::VOBJ);
+    // Concurrent callers wait for a running scan instead of starting their own
+    LOCK(cs_scriptstats);
 
-    int nHeight;
-    uint256 hashBlock;
-
-    std::unique_ptr<CCoinsViewCursor> pcursor;
+    CCoinsViewDB* pcoinsdb;
+    bool fCached;
     {
         LOCK(cs_main);
-        ::ChainstateActive().ForceFlushStateToDisk();
-        pcursor = std::unique_ptr<CCoinsViewCursor>(::ChainstateActive().CoinsDB().Cursor());
-        assert(pcursor);
-        hashBlock = pcursor->GetBestBlock();
-        nHeight = g_chainman.BlockIndex().find(hashBlock)->second->nHeight;
+        pcoinsdb = &::ChainstateActive().CoinsDB();
+        fCached = !g_scriptstats.hashBlock.IsNull() && g_scriptstats.hashBlock == pcoinsdb->GetBestBlock();
     }
 
-    class PerScriptTypeStats {
-    public:
-        int64_t nPlain = 0;
-        int64_t nBlinded = 0;
-        int64_t nPlainValue = 0;
-
-        UniValue ToUV()
-        {
-            UniValue ret(UniValue::VOBJ);
-            ret.pushKV("num_plain", nPlain);
-            ret.pushKV("num_blinded", nBlinded);
-            ret.pushKV("total_amount", ValueFromAmount(nPlainValue));
-            return ret;
-        }
-    };
-
-    PerScriptTypeStats statsPKH;
-    PerScriptTypeStats statsSH;
-    PerScriptTypeStats statsOther;
-
-    while (pcursor->Valid()) {
-        if (ShutdownRequested()) return false;
-        COutPoint key;
-        Coin coin;
-        if (pcursor->GetKey(key) && pcursor->GetValue(coin)) {
-            PerScriptTypeStats *ps = &statsOther;
-            if (coin.out.scriptPubKey.IsPayToPubkeyHash()) {
-                ps = &statsPKH;
-            } else if (coin.out.scriptPubKey.IsPayToScriptHash()) {
-                ps = &statsSH;
-            }
-            ps->nPlainValue += coin.out.nValue;
-
-        } else {
+    if (!fCached) {
+        // The scan reads a snapshot of the coins database as last flushed, blocks keep connecting meanwhile
+        int nThreads = std::max(1, std::min(GetNumCores(), MAX_UTXO_SCAN_THREADS));
+        CCoinsScriptStats stats;
+        if (!GetUTXOScriptStats(*pcoinsdb, stats, nThreads, ShutdownRequested)) {
             throw JSONRPCError(RPC_INTERNAL_ERROR, "Unable to read UTXO set");
         }
-        pcursor->Next();
+        g_scriptstats = stats;
     }
 
-    ret.pushKV("height", (int64_t)nHeight);
-    ret.pushKV("bestblock", hashBlock.GetHex());
-    ret.pushKV("paytopubkeyhash", statsPKH.ToUV());
-    ret.pushKV("paytoscripthash", statsSH.ToUV());
-    ret.pushKV("other", statsOther.ToUV());
+    UniValue ret(UniValue::VOBJ);
+    ret.pushKV("height", (int64_t)g_scriptstats.nHeight);
+    ret.pushKV("bestblock", g_scriptstats.hashBlock.GetHex());
+    ret.pushKV("paytopubkeyhash", ScriptTypeStatsToUV(g_scriptstats.statsPKH));
+    ret.pushKV("paytoscripthash", ScriptTypeStatsToUV(g_scriptstats.statsSH));
+    ret.pushKV("other", ScriptTypeStatsToUV(g_scriptstats.statsOther));
+
+    UniValue assets(UniValue::VARR);
+    for (const auto& asset : g_scriptstats.mapAssets) {
+        UniValue entry = ScriptTypeStatsToUV(asset.second);
+        UniValue a(UniValue::VOBJ);
+        AssetToUniv(asset.first, a);
+        entry.pushKV("asset", a);
+        assets.push_back(entry);
+    }
+    ret.pushKV("assets", assets);
 
     return ret;
 },
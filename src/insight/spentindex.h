@@ -154,13 +154,13 @@ struct CAddressIndexKey {
     unsigned int type;
     uint160 hashBytes;
     CAsset asset;
-    int blockHeight;
+    unsigned int blockHeight;
     unsigned int txindex;
     uint256 txhash;
     unsigned int  index;
     bool spending;
 
-    SERIALIZE_METHODS(CAddressIndexKey, obj) {READWRITE(obj.type, obj.hashBytes, obj.asset, obj.blockHeight, obj.txindex, obj.txhash, obj.index, obj.spending);}
+    SERIALIZE_METHODS(CAddressIndexKey, obj) {READWRITE(obj.type, obj.hashBytes, obj.asset, Using<BigEndianFormatter<4>>(obj.blockHeight), Using<BigEndianFormatter<4>>(obj.txindex), obj.txhash, obj.index, obj.spending);}
 
     CAddressIndexKey(unsigned int addressType, uint160 addressHash, CAsset at, int height, int blockindex,
                      uint256 txid, unsigned int indexValue, bool isSpending) {
@@ -240,11 +240,11 @@ struct CAddressIndexIteratorHeightKey {
     unsigned int type;
     uint160 hashBytes;
     CAsset asset;
-    int blockHeight;
+    unsigned int blockHeight;
 
-    SERIALIZE_METHODS(CAddressIndexIteratorHeightKey, obj) {READWRITE(obj.type, obj.hashBytes, obj.asset, obj.blockHeight);}
+    SERIALIZE_METHODS(CAddressIndexIteratorHeightKey, obj) {READWRITE(obj.type, obj.hashBytes, obj.asset, Using<BigEndianFormatter<4>>(obj.blockHeight));}
 
-    CAddressIndexIteratorHeightKey(unsigned int addressType, uint160 addressHash, CAsset at, int height) {
+    CAddressIndexIteratorHeightKey(unsigned int addressType, uint160 addressHash, CAsset at, unsigned int height) {
         type = addressType;
         hashBytes = addressHash;
         asset = at;
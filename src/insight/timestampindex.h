@@ -6,11 +6,12 @@
 #ifndef CROWN_TIMESTAMPINDEX_H
 #define CROWN_TIMESTAMPINDEX_H
 
+#include <serialize.h>
 #include <uint256.h>
 
 struct CTimestampIndexIteratorKey {
     unsigned int timestamp;
-    SERIALIZE_METHODS(CTimestampIndexIteratorKey, obj) { READWRITE(obj.timestamp); }
+    SERIALIZE_METHODS(CTimestampIndexIteratorKey, obj) { READWRITE(Using<BigEndianFormatter<4>>(obj.timestamp)); }
 
     explicit CTimestampIndexIteratorKey(unsigned int time) {
         timestamp = time;
@@ -25,11 +26,12 @@ struct CTimestampIndexIteratorKey {
     }
 };
 
+// The timestamp is big endian encoded so that keys sort by time
 struct CTimestampIndexKey {
     unsigned int timestamp;
     uint256 blockHash;
 
-    SERIALIZE_METHODS(CTimestampIndexKey, obj) { READWRITE(obj.timestamp, obj.blockHash); }
+    SERIALIZE_METHODS(CTimestampIndexKey, obj) { READWRITE(Using<BigEndianFormatter<4>>(obj.timestamp), obj.blockHash); }
 
     explicit CTimestampIndexKey(unsigned int time, uint256 hash) {
         timestamp = time;
@@ -216,13 +216,13 @@ bool CActiveMasternode::SendMasternodePing(std::string& errorMessage, CConnman&
         }
 
         pmn->lastPing = mnp;
-        mnodeman.mapSeenMasternodePing.insert(std::make_pair(mnp.GetHash(), mnp));
+        mnodeman.mapSeenMasternodePing.Add(mnp.GetHash(), mnp);
 
         //mnodeman.mapSeenMasternodeBroadcast.lastPing is probably outdated, so we'll update it
         CMasternodeBroadcast mnb(*pmn);
         uint256 hash = mnb.GetHash();
-        if (mnodeman.mapSeenMasternodeBroadcast.count(hash))
-            mnodeman.mapSeenMasternodeBroadcast[hash].lastPing = mnp;
+        if (CMasternodeBroadcast* pmnb = mnodeman.mapSeenMasternodeBroadcast.Get(hash))
+            pmnb->lastPing = mnp;
 
         mnp.Relay(connman);
 
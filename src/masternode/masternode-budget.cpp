@@ -21,6 +21,7 @@
 #include <masternode/masternode-sync.h>
 #include <masternode/masternode.h>
 #include <masternode/masternodeman.h>
+#include <memusage.h>
 #include <net.h>
 #include <net_processing.h>
 #include <netfulfilledman.h>
@@ -127,7 +128,7 @@ bool IsBudgetCollateralValid(uint256 nTxCollateralHash, uint256 nExpectedHash, s
 
     bool foundOpReturn = false;
     for (unsigned int k = 0; k <  (txCollateral->nVersion >= TX_ELE_VERSION ? txCollateral->vpout.size() : txCollateral->vout.size()) ; k++){
-        CTxOutAsset o = (txCollateral->nVersion >= TX_ELE_VERSION ? txCollateral->vpout[k] : txCollateral->vout[k]);
+        const CTxOutRef o = txCollateral->GetOutputs()[k];
         if(!o.scriptPubKey.IsNormalPaymentScript() && !o.scriptPubKey.IsUnspendable()){
             strError = strprintf("Invalid Script %s", txCollateral->ToString());
             LogPrint(BCLog::MASTERNODE, "CBudgetProposalBroadcast::IsBudgetCollateralValid - %s\n", strError);
@@ -2095,7 +2096,7 @@ bool BudgetDraft::IsTransactionValid(const CTransaction& txNew, int nBlockHeight
     for (const auto& payment : m_payments) {
         bool found = false;
         for (unsigned int k = 0; k <  (txNew.nVersion >= TX_ELE_VERSION ? txNew.vpout.size() : txNew.vout.size()) ; k++){
-            CTxOutAsset out = (txNew.nVersion >= TX_ELE_VERSION ? txNew.vpout[k] : txNew.vout[k]);
+            const CTxOutRef out = txNew.GetOutputs()[k];
             if(payment.payee == out.scriptPubKey && payment.nAmount == out.nValue)
                 found = true;
         }
@@ -2370,3 +2371,13 @@ std::string CBudgetManager::ToString() const
 
     return info.str();
 }
+
+size_t CBudgetManager::DynamicMemoryUsage() const
+{
+    LOCK(m_cs);
+
+    size_t nUsage = memusage::DynamicUsage(mapCollateralTxids) + memusage::DynamicUsage(mapProposals) + memusage::DynamicUsage(mapBudgetDrafts);
+    nUsage += memusage::DynamicUsage(mapSeenMasternodeBudgetProposals) + memusage::DynamicUsage(mapSeenMasternodeBudgetVotes) + memusage::DynamicUsage(mapOrphanMasternodeBudgetVotes);
+    nUsage += memusage::DynamicUsage(mapSeenBudgetDrafts) + memusage::DynamicUsage(mapSeenBudgetDraftVotes) + memusage::DynamicUsage(mapOrphanBudgetDraftVotes);
+    return nUsage;
+}
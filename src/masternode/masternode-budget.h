@@ -186,6 +186,8 @@ public:
 
     std::string GetRequiredPaymentsString(int nBlockHeight) const;
     std::string ToString() const;
+    /// Memory held by the proposals, budgets and seen objects
+    size_t DynamicMemoryUsage() const;
 
     void CheckOrphanVotes(CConnman& connman);
     void CheckAndRemove();
@@ -13,6 +13,7 @@
 #include <masternode/masternode-payments.h>
 #include <masternode/masternode-sync.h>
 #include <masternode/masternodeman.h>
+#include <memusage.h>
 #include <net_processing.h>
 #include <netfulfilledman.h>
 #include <netmessagemaker.h>
@@ -20,6 +21,8 @@
 #include <util/moneystr.h>
 #include <util/system.h>
 
+#include <thread>
+
 /** Object for who's going to get paid on which blocks */
 CMasternodePayments masternodePayments;
 
@@ -268,36 +271,9 @@ void CMasternodePayments::ProcessMessageMasternodePayments(CNode* pfrom, const s
             return;
         }
 
-        std::string strError = "";
-        if (!winner.IsValid(pfrom, strError, *connman)) {
-            if (strError != "")
-                LogPrint(BCLog::MASTERNODE, "mnw - invalid message - %s\n", strError);
-            return;
-        }
-
-        if (!masternodePayments.CanVote(winner.vinMasternode.prevout, winner.nBlockHeight)) {
-            LogPrint(BCLog::MASTERNODE, "mnw - masternode already voted - %s\n", winner.vinMasternode.prevout.ToStringShort());
-            return;
-        }
-
-        if (!winner.SignatureValid()) {
-            LogPrint(BCLog::MASTERNODE, "mnw - invalid signature\n");
-            if (masternodeSync.IsSynced())
-                Misbehaving(pfrom->GetId(), 20);
-            // it could just be a non-synced masternode
-            mnodeman.AskForMN(pfrom, winner.vinMasternode, *connman);
-            return;
-        }
-        
-        CTxDestination address1;
-        ExtractDestination(winner.payee, address1);
-
-        LogPrint(BCLog::MASTERNODE, "mnw - winning vote - Addr %s Height %d bestHeight %d - %s\n", EncodeDestination(address1), winner.nBlockHeight, nHeight, winner.vinMasternode.prevout.ToStringShort());
-
-        if (masternodePayments.AddWinningMasternode(winner)) {
-            winner.Relay(*connman);
-            masternodeSync.AddedMasternodeWinner(winner.GetHash());
-        }
+        // the rank, vote and signature checks are done for a whole batch at once
+        if (QueueWinner(pfrom->GetId(), winner) && GetWinnerStats().nQueued >= MNPAYMENTS_BATCH_SIZE)
+            ProcessPendingWinners(*connman);
     }
 }
 
@@ -393,6 +369,201 @@ bool CMasternodePayments::AddWinningMasternode(CMasternodePaymentWinner& winnerI
     return true;
 }
 
+bool CMasternodePayments::QueueWinner(NodeId nodeId, const CMasternodePaymentWinner& winner)
+{
+    CPendingMasternodeWinner pending{nodeId, winner};
+
+    LOCK(cs_pendingWinners);
+    if (!setPendingWinners.insert(pending.winner.GetHash()).second)
+        return false;
+
+    vecPendingWinners.push_back(std::move(pending));
+    winnerStats.nReceived++;
+    return true;
+}
+
+CMasternodeWinnerStats CMasternodePayments::GetWinnerStats()
+{
+    LOCK(cs_pendingWinners);
+    CMasternodeWinnerStats stats = winnerStats;
+    stats.nQueued = vecPendingWinners.size();
+    return stats;
+}
+
+void CMasternodePayments::VerifyWinnerSignatures(const std::vector<std::pair<CPubKey, CMasternodePaymentWinner*>>& vecToVerify, std::vector<char>& vecValid)
+{
+    vecValid.assign(vecToVerify.size(), 0);
+
+    auto verify = [&](size_t nBegin, size_t nEnd) {
+        for (size_t i = nBegin; i < nEnd; i++) {
+            const CMasternodePaymentWinner& winner = *vecToVerify[i].second;
+            std::string strMessage = winner.vinMasternode.prevout.ToStringShort() + boost::lexical_cast<std::string>(winner.nBlockHeight) + winner.payee.ToString();
+            std::string strError;
+            vecValid[i] = legacySigner.VerifyMessage(vecToVerify[i].first, winner.vchSig, strMessage, strError);
+        }
+    };
+
+    // public key recovery dominates a big batch, so split it over the cores
+    size_t nThreads = std::min<size_t>(std::max(GetNumCores(), 1), vecToVerify.size() / MNPAYMENTS_PARALLEL_MIN);
+    if (nThreads <= 1) {
+        verify(0, vecToVerify.size());
+        return;
+    }
+
+    size_t nChunk = (vecToVerify.size() + nThreads - 1) / nThreads;
+    std::vector<std::thread> vecThreads;
+    for (size_t nBegin = nChunk; nBegin < vecToVerify.size(); nBegin += nChunk)
+        vecThreads.emplace_back(verify, nBegin, std::min(nBegin + nChunk, vecToVerify.size()));
+    verify(0, nChunk);
+    for (auto& thread : vecThreads)
+        thread.join();
+}
+
+void CMasternodePayments::ProcessPendingWinners(CConnman& connman)
+{
+    LOCK(cs_processWinners);
+
+    std::vector<CPendingMasternodeWinner> vecBatch;
+    {
+        LOCK(cs_pendingWinners);
+        vecBatch.swap(vecPendingWinners);
+        setPendingWinners.clear();
+    }
+    if (vecBatch.empty())
+        return;
+
+    int64_t nTimeStart = GetTimeMicros();
+
+    auto askForMN = [&connman](NodeId nodeId, const CTxIn& vin) {
+        connman.ForNode(nodeId, [&](CNode* pnode) {
+            mnodeman.AskForMN(pnode, vin, connman);
+            return true;
+        });
+    };
+
+    // group by height, so that one rank table serves every winner of the group
+    std::map<int, std::vector<CPendingMasternodeWinner*>> mapByHeight;
+    for (auto& pending : vecBatch)
+        mapByHeight[pending.winner.nBlockHeight].push_back(&pending);
+
+    std::vector<CPendingMasternodeWinner*> vecChecked;
+    std::vector<CPendingMasternodeWinner*> vecHeld;
+    std::vector<std::pair<CPubKey, CMasternodePaymentWinner*>> vecToVerify;
+    for (const auto& group : mapByHeight) {
+        // ranks up to twice the payment quorum are told apart, an enabled masternode missing from it is way off
+        std::shared_ptr<const CMasternodeQuorum> pquorum = mnodeman.GetQuorum(group.first - 100, MNPAYMENTS_SIGNATURES_TOTAL * 2, MIN_MNW_PEER_PROTO_VERSION);
+        if (!pquorum) {
+            // the block the ranks are calculated from isn't known yet, try again with the next batch
+            vecHeld.insert(vecHeld.end(), group.second.begin(), group.second.end());
+            continue;
+        }
+
+        for (CPendingMasternodeWinner* pending : group.second) {
+            CMasternodePaymentWinner& winner = pending->winner;
+            CMasternode* pmn = mnodeman.Find(winner.vinMasternode);
+
+            if (!IsReferenceNode(winner.vinMasternode)) {
+                if (!pmn) {
+                    LogPrint(BCLog::MASTERNODE, "mnw - invalid message - Unknown Masternode %s\n", winner.vinMasternode.prevout.ToStringShort());
+                    askForMN(pending->nodeId, winner.vinMasternode);
+                    continue;
+                }
+
+                if (pmn->protocolVersion < MIN_MNW_PEER_PROTO_VERSION) {
+                    LogPrint(BCLog::MASTERNODE, "mnw - invalid message - Masternode protocol too old %d - req %d\n", pmn->protocolVersion, MIN_MNW_PEER_PROTO_VERSION);
+                    continue;
+                }
+
+                // like CMasternodePaymentWinner::IsValid, a masternode without a rank (not enabled) is not rejected
+                int n = pquorum->GetRank(winner.vinMasternode.prevout);
+                if (n == -1 && pmn->IsEnabled()) {
+                    LogPrint(BCLog::MASTERNODE, "mnw - invalid message - Masternode not in the top %d\n", MNPAYMENTS_SIGNATURES_TOTAL);
+                    if (masternodeSync.IsSynced()) {
+                        LOCK(cs_main);
+                        Misbehaving(pending->nodeId, 20);
+                    }
+                    continue;
+                }
+                if (n > MNPAYMENTS_SIGNATURES_TOTAL) {
+                    //It's common to have masternodes mistakenly think they are in the top 10
+                    // We don't want to print all of these messages, or punish them unless they're way off
+                    continue;
+                }
+            }
+
+            if (!CanVote(winner.vinMasternode.prevout, winner.nBlockHeight)) {
+                LogPrint(BCLog::MASTERNODE, "mnw - masternode already voted - %s\n", winner.vinMasternode.prevout.ToStringShort());
+                continue;
+            }
+
+            // an unknown reference node can't have a valid signature, the empty key makes it fail
+            vecToVerify.emplace_back(pmn ? pmn->pubkey2 : CPubKey(), &winner);
+            vecChecked.push_back(pending);
+        }
+    }
+
+    std::vector<char> vecValid;
+    VerifyWinnerSignatures(vecToVerify, vecValid);
+
+    std::vector<CMasternodePaymentWinner*> vecValidWinners;
+    for (size_t i = 0; i < vecChecked.size(); i++) {
+        if (vecValid[i]) {
+            vecValidWinners.push_back(&vecChecked[i]->winner);
+            continue;
+        }
+        LogPrint(BCLog::MASTERNODE, "mnw - invalid signature\n");
+        if (masternodeSync.IsSynced()) {
+            LOCK(cs_main);
+            Misbehaving(vecChecked[i]->nodeId, 20);
+        }
+        // it could just be a non-synced masternode
+        askForMN(vecChecked[i]->nodeId, vecChecked[i]->winner.vinMasternode);
+    }
+
+    std::vector<CMasternodePaymentWinner*> vecAccepted;
+    {
+        LOCK2(cs_mapMasternodePayeeVotes, cs_mapMasternodeBlocks);
+
+        for (CMasternodePaymentWinner* pwinner : vecValidWinners) {
+            CMasternodePaymentWinner& winner = *pwinner;
+            uint256 hash = winner.GetHash();
+            if (mapMasternodePayeeVotes.count(hash))
+                continue;
+            mapMasternodePayeeVotes[hash] = winner;
+
+            auto itBlock = mapMasternodeBlocks.emplace(winner.nBlockHeight, CMasternodeBlockPayees(winner.nBlockHeight)).first;
+            itBlock->second.AddPayee(winner.payee, IsReferenceNode(winner.vinMasternode) ? 100 : 1);
+            vecAccepted.push_back(&winner);
+        }
+    }
+
+    for (CMasternodePaymentWinner* pwinner : vecAccepted) {
+        CTxDestination address1;
+        ExtractDestination(pwinner->payee, address1);
+        LogPrint(BCLog::MASTERNODE, "mnw - winning vote - Addr %s Height %d - %s\n", EncodeDestination(address1), pwinner->nBlockHeight, pwinner->vinMasternode.prevout.ToStringShort());
+
+        pwinner->Relay(connman);
+        masternodeSync.AddedMasternodeWinner(pwinner->GetHash());
+    }
+
+    int64_t nTime = GetTimeMicros() - nTimeStart;
+    LogPrint(BCLog::MASTERNODE, "mnw - processed batch of %u winners at %u heights, %u accepted, %u held, %.2fms\n",
+        vecBatch.size(), mapByHeight.size(), vecAccepted.size(), vecHeld.size(), nTime * 0.001);
+
+    LOCK(cs_pendingWinners);
+    // the lowest heights are the first to get their block, the rest is dropped past the limit
+    if (vecHeld.size() > MNPAYMENTS_MAX_HELD)
+        vecHeld.resize(MNPAYMENTS_MAX_HELD);
+    for (CPendingMasternodeWinner* pending : vecHeld) {
+        if (setPendingWinners.insert(pending->winner.GetHash()).second)
+            vecPendingWinners.push_back(std::move(*pending));
+    }
+    winnerStats.nProcessed += vecBatch.size() - vecHeld.size();
+    winnerStats.nAccepted += vecAccepted.size();
+    winnerStats.nBatches++;
+    winnerStats.nProcessTime += nTime;
+}
+
 bool CMasternodeBlockPayees::IsTransactionValid(const CTransaction& txNew, const CAmount& nValueCreated)
 {
     LOCK(cs_vecPayments);
@@ -416,7 +587,7 @@ bool CMasternodeBlockPayees::IsTransactionValid(const CTransaction& txNew, const
         bool found = false;
         int pos = -1;
         for (unsigned int k = 0; k <  (txNew.nVersion >= TX_ELE_VERSION ? txNew.vpout.size() : txNew.vout.size()) ; k++){
-            CTxOutAsset txout = (txNew.nVersion >= TX_ELE_VERSION ? txNew.vpout[k] : txNew.vout[k]);
+            const CTxOutRef txout = txNew.GetOutputs()[k];
             if(payee.scriptPubKey == txout.scriptPubKey && masternodePayment == txout.nValue){
                 found = true;
                 pos = k;
@@ -706,6 +877,12 @@ std::string CMasternodePayments::ToString() const
     return info.str();
 }
 
+size_t CMasternodePayments::DynamicMemoryUsage() const
+{
+    LOCK2(cs_mapMasternodeBlocks, cs_mapMasternodePayeeVotes);
+    return memusage::DynamicUsage(mapMasternodePayeeVotes) + memusage::DynamicUsage(mapMasternodeBlocks) + memusage::DynamicUsage(mapMasternodesLastVote);
+}
+
 int CMasternodePayments::GetOldestBlock()
 {
     LOCK(cs_mapMasternodeBlocks);
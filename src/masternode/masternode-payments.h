@@ -24,6 +24,9 @@ extern CMasternodePayments masternodePayments;
 #define MNPAYMENTS_SIGNATURES_REQUIRED 6
 #define MNPAYMENTS_SIGNATURES_TOTAL 10
 #define MN_PMT_SLOT 1
+#define MNPAYMENTS_BATCH_SIZE 256 // queued winners which trigger a batch without waiting for the scheduler
+#define MNPAYMENTS_PARALLEL_MIN 32 // winners in a batch from which signatures are verified on worker threads
+#define MNPAYMENTS_MAX_HELD (MNPAYMENTS_BATCH_SIZE / 2) // winners kept for a block not known yet, too few to trigger a batch on their own
 
 void ProcessMessageMasternodePayments(CNode* pfrom, const std::string& strCommand, CDataStream& vRecv, CConnman* connman);
 bool IsReferenceNode(CTxIn& vin);
@@ -187,6 +190,22 @@ public:
     }
 };
 
+// A received winner waiting to be verified with the rest of its batch
+struct CPendingMasternodeWinner {
+    NodeId nodeId;
+    CMasternodePaymentWinner winner;
+};
+
+// Counters of the winner ingestion queue
+struct CMasternodeWinnerStats {
+    size_t nQueued{0};       // winners waiting for the next batch
+    uint64_t nReceived{0};   // winners queued since startup
+    uint64_t nProcessed{0};  // winners which went through a batch
+    uint64_t nAccepted{0};   // winners added to the payment votes
+    uint64_t nBatches{0};
+    int64_t nProcessTime{0}; // microseconds spent processing batches
+};
+
 //
 // Masternode Payments Class
 // Keeps track of who should get paid for which blocks
@@ -197,6 +216,16 @@ private:
     int nSyncedFromPeer;
     int nLastBlockHeight;
 
+    // received winners, verified and committed in batches by ProcessPendingWinners
+    Mutex cs_pendingWinners;
+    std::vector<CPendingMasternodeWinner> vecPendingWinners GUARDED_BY(cs_pendingWinners);
+    std::set<uint256> setPendingWinners GUARDED_BY(cs_pendingWinners);
+    CMasternodeWinnerStats winnerStats GUARDED_BY(cs_pendingWinners);
+    // one batch at a time, so that winners are committed in the order they arrived
+    Mutex cs_processWinners;
+
+    void VerifyWinnerSignatures(const std::vector<std::pair<CPubKey, CMasternodePaymentWinner*>>& vecToVerify, std::vector<char>& vecValid);
+
 public:
     std::map<uint256, CMasternodePaymentWinner> mapMasternodePayeeVotes;
     std::map<int, CMasternodeBlockPayees> mapMasternodeBlocks;
@@ -216,6 +245,11 @@ public:
     }
 
     bool AddWinningMasternode(CMasternodePaymentWinner& winner);
+    /// Queue a received winner for the next batch, returns false if it's already queued
+    bool QueueWinner(NodeId nodeId, const CMasternodePaymentWinner& winner);
+    /// Verify the queued winners grouped by height and commit the valid ones at once
+    void ProcessPendingWinners(CConnman& connman);
+    CMasternodeWinnerStats GetWinnerStats();
     bool ProcessBlock(int nBlockHeight, CConnman& connman);
 
     void Sync(CNode* node, int nCountNeeded, CConnman& connman);
@@ -233,6 +267,8 @@ public:
     std::string GetRequiredPaymentsString(int nBlockHeight);
     void FillBlockPayee(CMutableTransaction& txNew, int64_t nFees, bool &hasMNPayment);
     std::string ToString() const;
+    /// Memory held by the votes, block payees and last votes
+    size_t DynamicMemoryUsage() const;
     int GetOldestBlock();
     int GetNewestBlock();
 
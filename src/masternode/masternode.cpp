@@ -36,9 +36,15 @@ bool GetBlockHash(uint256& hash, int nBlockHeight)
     if (nBlockHeight == 0)
         nBlockHeight = ::ChainActive().Tip()->nHeight;
 
-    if (mapCacheBlockHashes.count(nBlockHeight)) {
-        hash = mapCacheBlockHashes[nBlockHeight];
-        return true;
+    // The cached hash is only good while its block is still on the active chain
+    auto it = mapCacheBlockHashes.find(nBlockHeight);
+    if (it != mapCacheBlockHashes.end()) {
+        const CBlockIndex* pindex = ::ChainActive()[nBlockHeight - 1];
+        if (pindex && pindex->GetBlockHash() == it->second) {
+            hash = it->second;
+            return true;
+        }
+        mapCacheBlockHashes.erase(it);
     }
 
     const CBlockIndex* BlockLastSolved = ::ChainActive().Tip();
@@ -167,7 +173,7 @@ bool CMasternode::UpdateFromNewBroadcast(CMasternodeBroadcast& mnb, CConnman& co
         int nDoS = 0;
         if (mnb.lastPing == CMasternodePing() || (mnb.lastPing != CMasternodePing() && mnb.lastPing.CheckAndUpdate(nDoS, connman, false))) {
             lastPing = mnb.lastPing;
-            mnodeman.mapSeenMasternodePing.insert(std::make_pair(lastPing.GetHash(), lastPing));
+            mnodeman.mapSeenMasternodePing.Add(lastPing.GetHash(), lastPing);
         }
         return true;
     }
@@ -369,7 +375,7 @@ bool CMasternode::GetRecentPaymentBlocks(std::vector<const CBlockIndex*>& vPayme
         int m = (block.vtx[0]->nVersion >= TX_ELE_VERSION ? block.vtx[0]->vpout.size() : block.vtx[0]->vout.size());
 
         if (m > 1) {
-            CTxOutAsset out = (block.vtx[0]->nVersion >= TX_ELE_VERSION ? block.vtx[0]->vpout[1] : block.vtx[0]->vout[1]);
+            const CTxOutRef out = block.vtx[0]->GetOutputs()[1];
             if (out.scriptPubKey == mnpayee){
                 vPaymentBlocks.emplace_back(pindex);
                 fBlockFound = true;
@@ -685,7 +691,7 @@ bool CMasternodeBroadcast::CheckInputsAndAdd(int& nDoS, CConnman& connman)
     if (GetInputAge(vin) < MASTERNODE_MIN_CONFIRMATIONS) {
         LogPrint(BCLog::MASTERNODE, "mnb - Input must have at least %d confirmations\n", MASTERNODE_MIN_CONFIRMATIONS);
         // maybe we miss few blocks, let this mnb to be checked again later
-        mnodeman.mapSeenMasternodeBroadcast.erase(GetHash());
+        mnodeman.mapSeenMasternodeBroadcast.Erase(GetHash());
         masternodeSync.mapSeenSyncMNB.erase(GetHash());
         return false;
     }
@@ -925,8 +931,8 @@ bool CMasternodePing::CheckAndUpdate(int& nDos, CConnman& connman, bool fRequire
             //mnodeman.mapSeenMasternodeBroadcast.lastPing is probably outdated, so we'll update it
             CMasternodeBroadcast mnb(*pmn);
             uint256 hash = mnb.GetHash();
-            if (mnodeman.mapSeenMasternodeBroadcast.count(hash)) {
-                mnodeman.mapSeenMasternodeBroadcast[hash].lastPing = *this;
+            if (CMasternodeBroadcast* pmnb = mnodeman.mapSeenMasternodeBroadcast.Get(hash)) {
+                pmnb->lastPing = *this;
             }
 
             pmn->Check(true);
@@ -9,6 +9,7 @@
 #include <masternode/activemasternode.h>
 #include <masternode/masternode.h>
 #include <masternode/masternodeman.h>
+#include <memusage.h>
 #include <net_processing.h>
 #include <netmessagemaker.h>
 #include <sync.h>
@@ -129,14 +130,17 @@ void CMasternodeMan::ProcessMessage(CNode* pfrom, const std::string& strCommand,
 
         LogPrint(BCLog::MASTERNODE, "mnp - Masternode ping, vin: %s\n", mnp.vin.ToString());
 
-        if (mapSeenMasternodePing.count(mnp.GetHash()))
+        uint256 mnpHash = mnp.GetHash();
+        if (mapSeenMasternodePing.Has(mnpHash))
             return;
-        mapSeenMasternodePing.insert(std::make_pair(mnp.GetHash(), mnp));
+        mapSeenMasternodePing.MarkSeen(mnpHash, mnp.vin.prevout);
 
         int nDoS = 0;
         LOCK(cs_main);
-        if (mnp.CheckAndUpdate(nDoS, *connman))
+        if (mnp.CheckAndUpdate(nDoS, *connman)) {
+            mapSeenMasternodePing.Add(mnpHash, mnp);
             return;
+        }
 
         if (nDoS > 0) {
             // if anything significant failed, mark that node
@@ -176,30 +180,27 @@ void CMasternodeMan::ProcessMessage(CNode* pfrom, const std::string& strCommand,
             }
         }
 
-        int nInvCount = 0;
-        for (const auto& mn : vMasternodes) {
-            if (mn.IsEnabled()) {
-                LogPrint(BCLog::MASTERNODE, "dseg - Sending Masternode entry - %s \n", mn.addr.ToString());
-                if (vin == CTxIn() || vin == mn.vin) {
-                    CMasternodeBroadcast mnb = CMasternodeBroadcast(mn);
-                    uint256 hash = mnb.GetHash();
-                    pfrom->PushInventory(CInv(MSG_MASTERNODE_ANNOUNCE, hash));
-                    nInvCount++;
-                    if (!mapSeenMasternodeBroadcast.count(hash)) {
-                        mapSeenMasternodeBroadcast.insert(std::make_pair(hash, mnb));
-                    }
-                    if (vin == mn.vin) {
-                        LogPrint(BCLog::MASTERNODE, "dseg - Sent 1 Masternode entries to %s\n", pfrom->addr.ToString());
-                        return;
-                    }
-                }
-            }
-        }
-
         if (vin == CTxIn()) {
+            // the list inventory is shared between peers and streamed by the send loop in bounded chunks
+            std::shared_ptr<const std::vector<CInv>> pinv = GetListInventory();
+            int nInvCount = pinv->size();
+            pfrom->PushListInventory(pinv);
+
             const CNetMsgMaker msgMaker(PROTOCOL_VERSION);
             connman->PushMessage(pfrom, msgMaker.Make(NetMsgType::MNSYNCSTATUS, MASTERNODE_SYNC_LIST, nInvCount));
             LogPrint(BCLog::MASTERNODE, "dseg - Sent %d Masternode entries to %s\n", nInvCount, pfrom->addr.ToString());
+            return;
+        }
+
+        LOCK(cs);
+        CMasternode* pmn = Find(vin);
+        if (pmn && pmn->IsEnabled()) {
+            LogPrint(BCLog::MASTERNODE, "dseg - Sending Masternode entry - %s \n", pmn->addr.ToString());
+            CMasternodeBroadcast mnb = CMasternodeBroadcast(*pmn);
+            uint256 hash = mnb.GetHash();
+            pfrom->PushInventory(CInv(MSG_MASTERNODE_ANNOUNCE, hash));
+            mapSeenMasternodeBroadcast.Add(hash, mnb);
+            LogPrint(BCLog::MASTERNODE, "dseg - Sent 1 Masternode entries to %s\n", pfrom->addr.ToString());
         }
     }
 }
@@ -217,18 +218,10 @@ void CMasternodeMan::CheckAndRemove(bool forceExpiredRemoval)
 
             LogPrint(BCLog::MASTERNODE, "CMasternodeMan: Removing inactive Masternode %s - %i now\n", (*it).addr.ToString(), size() - 1);
 
-            //erase all of the broadcasts we've seen from this vin
+            //erase the broadcasts we've seen from this vin
             // -- if we missed a few pings and the node was removed, this will allow is to get it back without them
             //    sending a brand new mnb
-            std::map<uint256, CMasternodeBroadcast>::iterator it3 = mapSeenMasternodeBroadcast.begin();
-            while (it3 != mapSeenMasternodeBroadcast.end()) {
-                if ((*it3).second.vin == (*it).vin) {
-                    masternodeSync.mapSeenSyncMNB.erase((*it3).first);
-                    mapSeenMasternodeBroadcast.erase(it3++);
-                } else {
-                    ++it3;
-                }
-            }
+            masternodeSync.mapSeenSyncMNB.erase(mapSeenMasternodeBroadcast.EraseNode((*it).vin.prevout));
 
             // allow us to ask for this masternode again if we see another ping
             std::map<COutPoint, int64_t>::iterator it2 = mWeAskedForMasternodeListEntry.begin();
@@ -241,6 +234,8 @@ void CMasternodeMan::CheckAndRemove(bool forceExpiredRemoval)
             }
 
             it = vMasternodes.erase(it);
+            pListInventory.reset();
+            mapQuorums.clear();
         } else {
             ++it;
         }
@@ -277,26 +272,14 @@ void CMasternodeMan::CheckAndRemove(bool forceExpiredRemoval)
     }
 
     // remove expired mapSeenMasternodeBroadcast
-    std::map<uint256, CMasternodeBroadcast>::iterator it3 = mapSeenMasternodeBroadcast.begin();
-    while (it3 != mapSeenMasternodeBroadcast.end()) {
-        if ((*it3).second.lastPing.sigTime < GetTime() - MASTERNODE_REMOVAL_SECONDS * 2) {
-            LogPrint(BCLog::MASTERNODE, "CMasternodeMan::CheckAndRemove - Removing expired Masternode broadcast %s\n", (*it3).second.GetHash().ToString());
-            masternodeSync.mapSeenSyncMNB.erase((*it3).second.GetHash());
-            mapSeenMasternodeBroadcast.erase(it3++);
-        } else {
-            ++it3;
-        }
+    const int64_t nExpireTime = GetTime() - MASTERNODE_REMOVAL_SECONDS * 2;
+    for (const uint256& hash : mapSeenMasternodeBroadcast.EraseIf([nExpireTime](const CMasternodeBroadcast& mnb) { return mnb.lastPing.sigTime < nExpireTime; })) {
+        LogPrint(BCLog::MASTERNODE, "CMasternodeMan::CheckAndRemove - Removing expired Masternode broadcast %s\n", hash.ToString());
+        masternodeSync.mapSeenSyncMNB.erase(hash);
     }
 
     // remove expired mapSeenMasternodePing
-    std::map<uint256, CMasternodePing>::iterator it4 = mapSeenMasternodePing.begin();
-    while (it4 != mapSeenMasternodePing.end()) {
-        if ((*it4).second.sigTime < GetTime() - (MASTERNODE_REMOVAL_SECONDS * 2)) {
-            mapSeenMasternodePing.erase(it4++);
-        } else {
-            ++it4;
-        }
-    }
+    mapSeenMasternodePing.EraseIf([nExpireTime](const CMasternodePing& mnp) { return mnp.sigTime < nExpireTime; });
 }
 
 void CMasternodeMan::Clear()
@@ -306,8 +289,10 @@ void CMasternodeMan::Clear()
     mAskedUsForMasternodeList.clear();
     mWeAskedForMasternodeList.clear();
     mWeAskedForMasternodeListEntry.clear();
-    mapSeenMasternodeBroadcast.clear();
-    mapSeenMasternodePing.clear();
+    mapSeenMasternodeBroadcast.Clear();
+    mapSeenMasternodePing.Clear();
+    pListInventory.reset();
+    mapQuorums.clear();
     nDsqCount = 0;
 }
 
@@ -326,6 +311,30 @@ int CMasternodeMan::CountEnabled(int protocolVersion)
     return i;
 }
 
+std::shared_ptr<const std::vector<CInv>> CMasternodeMan::GetListInventory()
+{
+    LOCK(cs);
+
+    if (pListInventory && nListInventoryTime > GetTime() - MASTERNODES_LIST_INV_SECONDS)
+        return pListInventory;
+
+    auto pinv = std::make_shared<std::vector<CInv>>();
+    pinv->reserve(vMasternodes.size());
+    for (const auto& mn : vMasternodes) {
+        if (!mn.IsEnabled())
+            continue;
+        CMasternodeBroadcast mnb = CMasternodeBroadcast(mn);
+        uint256 hash = mnb.GetHash();
+        mapSeenMasternodeBroadcast.Add(hash, mnb);
+        pinv->emplace_back(MSG_MASTERNODE_ANNOUNCE, hash);
+    }
+
+    LogPrint(BCLog::MASTERNODE, "CMasternodeMan::GetListInventory - Rebuilt list inventory with %d entries\n", pinv->size());
+    pListInventory = std::move(pinv);
+    nListInventoryTime = GetTime();
+    return pListInventory;
+}
+
 void CMasternodeMan::DsegUpdate(CNode* pnode, CConnman& connman)
 {
     LOCK(cs);
@@ -472,6 +481,8 @@ bool CMasternodeMan::Add(const CMasternode& mn)
     if (!pmn) {
         LogPrint(BCLog::MASTERNODE, "CMasternodeMan: Adding new Masternode %s - %i now\n", mn.addr.ToString(), size() + 1);
         vMasternodes.push_back(mn);
+        pListInventory.reset();
+        mapQuorums.clear();
         return true;
     }
 
@@ -575,6 +586,65 @@ int CMasternodeMan::GetMasternodeRank(const CTxIn& vin, int64_t nBlockHeight, in
     return -1;
 }
 
+std::shared_ptr<const CMasternodeQuorum> CMasternodeMan::GetQuorum(int64_t nBlockHeight, int nSize, int minProtocol)
+{
+    //make sure we know about this block
+    uint256 hash = uint256();
+    if (!GetBlockHash(hash, nBlockHeight))
+        return nullptr;
+
+    LOCK(cs);
+
+    // Keyed by the block the scores are calculated from, a reorg below the height ranks anew
+    int64_t nNow = GetTime();
+    auto key = std::make_tuple(hash, nSize, minProtocol);
+    auto it = mapQuorums.find(key);
+    if (it != mapQuorums.end() && it->second->nTime > nNow - MASTERNODES_QUORUM_SECONDS)
+        return it->second;
+
+    std::vector<std::pair<int64_t, CTxIn> > vecMasternodeScores;
+    for (auto& mn : vMasternodes) {
+        if (mn.protocolVersion < minProtocol)
+            continue;
+        mn.Check();
+        if (!mn.IsEnabled())
+            continue;
+        arith_uint256 n = mn.CalculateScore(nBlockHeight);
+        int64_t n2 = n.GetCompact(false);
+
+        vecMasternodeScores.push_back(std::make_pair(n2, mn.vin));
+    }
+
+    std::sort(vecMasternodeScores.rbegin(), vecMasternodeScores.rend(), CompareScoreTxIn());
+
+    auto pquorum = std::make_shared<CMasternodeQuorum>();
+    pquorum->nBlockHeight = nBlockHeight;
+    pquorum->hashBlock = hash;
+    pquorum->nTime = nNow;
+    int rank = 0;
+    for (const auto& s : vecMasternodeScores) {
+        if (++rank > nSize)
+            break;
+        pquorum->mapRanks.emplace(s.second.prevout, rank);
+    }
+
+    for (auto itq = mapQuorums.begin(); itq != mapQuorums.end();) {
+        if (itq->second->nTime <= nNow - MASTERNODES_QUORUM_SECONDS)
+            itq = mapQuorums.erase(itq);
+        else
+            ++itq;
+    }
+    mapQuorums[key] = pquorum;
+
+    return pquorum;
+}
+
+void CMasternodeMan::SporkUpdated(int nSporkID, int64_t nValue)
+{
+    LOCK(cs);
+    mapQuorums.clear();
+}
+
 std::vector<std::pair<int, CMasternode> > CMasternodeMan::GetMasternodeRanks(int64_t nBlockHeight, int minProtocol)
 {
     std::vector<std::pair<int64_t, CMasternode> > vecMasternodeScores;
@@ -662,6 +732,8 @@ void CMasternodeMan::Remove(CTxIn vin)
         if ((*it).vin == vin) {
             LogPrint(BCLog::MASTERNODE, "CMasternodeMan: Removing Masternode %s - %i now\n", (*it).addr.ToString(), size() - 1);
             vMasternodes.erase(it);
+            pListInventory.reset();
+            mapQuorums.clear();
             break;
         }
         ++it;
@@ -677,10 +749,21 @@ std::string CMasternodeMan::ToString() const
     return info.str();
 }
 
+size_t CMasternodeMan::DynamicMemoryUsage() const
+{
+    LOCK(cs);
+
+    size_t nUsage = memusage::DynamicUsage(vMasternodes);
+    nUsage += memusage::DynamicUsage(mAskedUsForMasternodeList) + memusage::DynamicUsage(mWeAskedForMasternodeList) + memusage::DynamicUsage(mWeAskedForMasternodeListEntry);
+    nUsage += memusage::DynamicUsage(mMnbRecoveryRequests) + memusage::DynamicUsage(mMnbRecoveryGoodReplies);
+    nUsage += memusage::DynamicUsage(mapQuorums);
+    return nUsage + mapSeenMasternodeBroadcast.DynamicMemoryUsage() + mapSeenMasternodePing.DynamicMemoryUsage();
+}
+
 void CMasternodeMan::UpdateMasternodeList(CMasternodeBroadcast mnb, CConnman& connman)
 {
-    mapSeenMasternodePing.insert(std::make_pair(mnb.lastPing.GetHash(), mnb.lastPing));
-    mapSeenMasternodeBroadcast.insert(std::make_pair(mnb.GetHash(), mnb));
+    mapSeenMasternodePing.Add(mnb.lastPing.GetHash(), mnb.lastPing);
+    mapSeenMasternodeBroadcast.Add(mnb.GetHash(), mnb);
     masternodeSync.AddedMasternodeList(mnb.GetHash());
 
     LogPrint(BCLog::MASTERNODE, "CMasternodeMan::UpdateMasternodeList() - addr: %s\n    vin: %s\n", mnb.addr.ToString(), mnb.vin.ToString());
@@ -689,8 +772,10 @@ void CMasternodeMan::UpdateMasternodeList(CMasternodeBroadcast mnb, CConnman& co
     if (!pmn) {
         CMasternode mn(mnb);
         Add(mn);
-    } else {
-        pmn->UpdateFromNewBroadcast(mnb, connman);
+    } else if (pmn->UpdateFromNewBroadcast(mnb, connman)) {
+        LOCK(cs);
+        pListInventory.reset();
+        mapQuorums.clear();
     }
 }
 
@@ -700,11 +785,11 @@ bool CMasternodeMan::CheckMnbAndUpdateMasternodeList(CMasternodeBroadcast mnb, i
     LogPrint(BCLog::MASTERNODE, "CMasternodeMan::CheckMnbAndUpdateMasternodeList - Masternode broadcast, vin: %s\n", mnb.vin.ToString());
 
     uint256 mnbHash = mnb.GetHash();
-    if (mapSeenMasternodeBroadcast.count(mnbHash)) {
+    if (mapSeenMasternodeBroadcast.Has(mnbHash)) {
         masternodeSync.AddedMasternodeList(mnbHash);
         return true;
     }
-    mapSeenMasternodeBroadcast.insert(std::make_pair(mnbHash, mnb));
+    mapSeenMasternodeBroadcast.MarkSeen(mnbHash, mnb.vin.prevout);
 
     LogPrint(BCLog::MASTERNODE, "CMasternodeMan::CheckMnbAndUpdateMasternodeList - Masternode broadcast, vin: %s new\n", mnb.vin.ToString());
 
@@ -734,6 +819,7 @@ bool CMasternodeMan::CheckMnbAndUpdateMasternodeList(CMasternodeBroadcast mnb, i
     // make sure it's still unspent
     //  - this is checked later by .check() in many places and by ThreadCheckLegacySigner()
     if (mnb.CheckInputsAndAdd(nDos, connman)) {
+        mapSeenMasternodeBroadcast.Add(mnbHash, mnb);
         masternodeSync.AddedMasternodeList(mnbHash);
     } else {
         LogPrint(BCLog::MASTERNODE, "CMasternodeMan::CheckMnbAndUpdateMasternodeList - Rejected Masternode entry %s\n", mnb.addr.ToString());
@@ -12,17 +12,44 @@
 #include <util/system.h>
 #include <base58.h>
 #include <validation.h>
+#include <validationinterface.h>
+#include <crown/seenobjects.h>
 #include <masternode/masternode.h>
+#include <coins.h>
+
+#include <tuple>
+#include <unordered_map>
 
 #define MASTERNODES_DUMP_SECONDS (15 * 60)
 #define MASTERNODES_DSEG_SECONDS (3 * 60 * 60)
+#define MASTERNODES_LIST_INV_SECONDS 60
+#define MASTERNODES_SEEN_BROADCAST_ELEMENTS (1 << 14)
+#define MASTERNODES_SEEN_PING_ELEMENTS (1 << 16)
+#define MASTERNODES_QUORUM_SECONDS 60
 
 class CMasternodeMan;
 
 extern CMasternodeMan mnodeman;
 void DumpMasternodes();
 
-class CMasternodeMan {
+/** The top ranked masternodes for a block, ranked once instead of on every vote */
+class CMasternodeQuorum
+{
+public:
+    int64_t nBlockHeight;
+    uint256 hashBlock;
+    int64_t nTime;
+    std::unordered_map<COutPoint, int, SaltedOutpointHasher> mapRanks;
+
+    /// Rank of the masternode, -1 if it is not in the quorum
+    int GetRank(const COutPoint& outpoint) const
+    {
+        auto it = mapRanks.find(outpoint);
+        return it == mapRanks.end() ? -1 : it->second;
+    }
+};
+
+class CMasternodeMan : public CValidationInterface {
 private:
     // critical section to protect the inner data structures
     mutable RecursiveMutex cs;
@@ -50,11 +77,18 @@ private:
     /// Set when masternodes are removed, cleared when CGovernanceManager is notified
     bool fMasternodesRemoved;
 
+    // dseg reply announcing the whole list, shared by all peers until the list changes or it expires
+    std::shared_ptr<const std::vector<CInv>> pListInventory;
+    int64_t nListInventoryTime{0};
+
+    // quorums by (hash of the block scored against, size, min protocol), dropped when the list changes or after MASTERNODES_QUORUM_SECONDS
+    std::map<std::tuple<uint256, int, int>, std::shared_ptr<const CMasternodeQuorum>> mapQuorums;
+
 public:
-    // Keep track of all broadcasts I've seen
-    std::map<uint256, CMasternodeBroadcast> mapSeenMasternodeBroadcast;
-    // Keep track of all pings I've seen
-    std::map<uint256, CMasternodePing> mapSeenMasternodePing;
+    // Keep track of all broadcasts I've seen, full objects only for the latest one per masternode
+    CSeenObjects<CMasternodeBroadcast> mapSeenMasternodeBroadcast{MASTERNODES_SEEN_BROADCAST_ELEMENTS};
+    // Keep track of all pings I've seen, full objects only for the latest one per masternode
+    CSeenObjects<CMasternodePing> mapSeenMasternodePing{MASTERNODES_SEEN_PING_ELEMENTS};
 
     // keep track of dsq count to prevent masternodes from gaming legacySigner queue
     int64_t nDsqCount;
@@ -97,6 +131,9 @@ public:
 
     void DsegUpdate(CNode* pnode, CConnman& connman);
 
+    /// Inventory of all enabled Masternodes, rebuilt at most once per list change or MASTERNODES_LIST_INV_SECONDS
+    std::shared_ptr<const std::vector<CInv>> GetListInventory();
+
     /// Find an entry
     CMasternode* Find(const CScript& payee);
     CMasternode* Find(const CTxIn& vin);
@@ -120,6 +157,8 @@ public:
 
     std::vector<std::pair<int, CMasternode>> GetMasternodeRanks(int64_t nBlockHeight, int minProtocol = 0);
     int GetMasternodeRank(const CTxIn& vin, int64_t nBlockHeight, int minProtocol = 0, bool fOnlyActive = true);
+    /// The nSize top ranked active masternodes for nBlockHeight, null if the block is unknown
+    std::shared_ptr<const CMasternodeQuorum> GetQuorum(int64_t nBlockHeight, int nSize, int minProtocol = 0);
     CMasternode* GetMasternodeByRank(int nRank, int64_t nBlockHeight, int minProtocol = 0, bool fOnlyActive = true);
 
     void ProcessMasternodeConnections(CConnman& connman);
@@ -130,6 +169,8 @@ public:
     int size() { return vMasternodes.size(); }
 
     std::string ToString() const;
+    /// Memory held by the Masternode list, the requests and the seen objects, not counting what the entries allocate themselves
+    size_t DynamicMemoryUsage() const;
 
     void Remove(CTxIn vin);
 
@@ -137,6 +178,10 @@ public:
     void UpdateMasternodeList(CMasternodeBroadcast mnb, CConnman& connman);
     /// Perform complete check and only then update list and maps
     bool CheckMnbAndUpdateMasternodeList(CMasternodeBroadcast mnb, int& nDos, CConnman& connman);
+
+protected:
+    /// Sporks decide which masternodes get paid and how blocks are checked, rank the quorums anew
+    void SporkUpdated(int nSporkID, int64_t nValue) override;
 };
 
 #endif
@@ -178,11 +178,11 @@ std::unique_ptr<CBlockTemplate> BlockAssembler::CreateNewBlock(const CScript& sc
     if (fProofOfStake && nHeight < Params().PoSStartHeight())
         return nullptr;
 
-    OUTPUT_PTR<CTxData> out0 = MAKE_OUTPUT<CTxData>();
-    out0->vData.resize(4);
+    CTxData out0;
+    out0.vData.resize(4);
     uint32_t tmp = htole32(nHeight);
-    memcpy(&out0->vData[0], &tmp, 4);
-    coinbaseTx.vdata.push_back(out0);
+    memcpy(&out0.vData[0], &tmp, 4);
+    coinbaseTx.vdata.emplace_back(std::move(out0));
     int64_t m_smsg_fee_rate_target = 0;
     
     CTransactionRef txPrev = nullptr;
@@ -210,7 +210,8 @@ std::unique_ptr<CBlockTemplate> BlockAssembler::CreateNewBlock(const CScript& sc
             }
             smsg_fee_rate += diff;
         }
-        std::vector<uint8_t> vSmsgFeeRate(1), vSmsgDifficulty(5), &vData = *coinbaseTx.vdata[0]->GetPData();
+        std::vector<uint8_t> vSmsgFeeRate(1), vSmsgDifficulty(5);
+        CTxDataBytes &vData = *coinbaseTx.vdata[0]->GetPData();
         vSmsgFeeRate[0] = DO_SMSG_FEE;
         if (0 != part::PutVarInt(vSmsgFeeRate, smsg_fee_rate)) {
             LogPrintf("%s: PutVarInt failed: %d.", __func__, smsg_fee_rate);
@@ -5,9 +5,11 @@
 #include <mn_processing.h>
 
 #include <chainparams.h>
+#include <clientversion.h>
 #include <net_processing.h>
 #include <netmessagemaker.h>
 #include <protocol.h>
+#include <streams.h>
 #include <util/system.h>
 #include <util/strencodings.h>
 
@@ -40,7 +42,7 @@ bool AlreadyHaveMasternodeTypes(const CInv& inv, const CTxMemPool& mempool)
         case MSG_TXLOCK_VOTE:
             return instantSend.AlreadyHave(inv.hash);
         case MSG_SPORK:
-            return mapSporks.count(inv.hash);
+            return WITH_LOCK(cs_mapSporks, return mapSporks.count(inv.hash));
         case MSG_MASTERNODE_WINNER:
             if(masternodePayments.mapMasternodePayeeVotes.count(inv.hash)) {
                 masternodeSync.AddedMasternodeWinner(inv.hash);
@@ -72,13 +74,13 @@ bool AlreadyHaveMasternodeTypes(const CInv& inv, const CTxMemPool& mempool)
             }
             return false;
         case MSG_MASTERNODE_ANNOUNCE:
-            if(mnodeman.mapSeenMasternodeBroadcast.count(inv.hash)) {
+            if(mnodeman.mapSeenMasternodeBroadcast.Has(inv.hash)) {
                 masternodeSync.AddedMasternodeList(inv.hash);
                 return true;
             }
             return false;
         case MSG_MASTERNODE_PING:
-            return mnodeman.mapSeenMasternodePing.count(inv.hash);
+            return mnodeman.mapSeenMasternodePing.Has(inv.hash);
         case MSG_SYSTEMNODE_WINNER:
             if(systemnodePayments.mapSystemnodePayeeVotes.count(inv.hash)) {
                 systemnodeSync.AddedSystemnodeWinner(inv.hash);
@@ -86,13 +88,13 @@ bool AlreadyHaveMasternodeTypes(const CInv& inv, const CTxMemPool& mempool)
             }
             return false;
         case MSG_SYSTEMNODE_ANNOUNCE:
-            if(snodeman.mapSeenSystemnodeBroadcast.count(inv.hash)) {
+            if(snodeman.mapSeenSystemnodeBroadcast.Has(inv.hash)) {
                 systemnodeSync.AddedSystemnodeList(inv.hash);
                 return true;
             }
             return false;
         case MSG_SYSTEMNODE_PING:
-            return snodeman.mapSeenSystemnodePing.count(inv.hash);
+            return snodeman.mapSeenSystemnodePing.Has(inv.hash);
     }
     // Don't know what it is, just say we already got one
     return true;
@@ -106,22 +108,26 @@ void ProcessGetDataMasternodeTypes(CNode* pfrom, const CChainParams& chainparams
     {
         //! common spork
         if (!pushed && inv.type == MSG_SPORK) {
-            if(mapSporks.count(inv.hash)) {
-                connman->PushMessage(pfrom, msgMaker.Make(NetMsgType::SPORK, mapSporks[inv.hash]));
+            LOCK(cs_mapSporks);
+            auto it = mapSporks.find(inv.hash);
+            if (it != mapSporks.end()) {
+                connman->PushMessage(pfrom, msgMaker.Make(NetMsgType::SPORK, it->second));
                 pushed = true;
             }
         }
 
         //! instantsend types
         if (!pushed && inv.type == MSG_TXLOCK_VOTE) {
-            if(instantSend.mapTxLockVote.count(inv.hash)) {
-                connman->PushMessage(pfrom, msgMaker.Make(NetMsgType::IXLOCKVOTE, instantSend.mapTxLockVote[inv.hash]));
+            CConsensusVote vote;
+            if(instantSend.GetLockVote(inv.hash, vote)) {
+                connman->PushMessage(pfrom, msgMaker.Make(NetMsgType::IXLOCKVOTE, vote));
                 pushed = true;
             }
         }
         if (!pushed && inv.type == MSG_TXLOCK_REQUEST) {
-            if(instantSend.mapTxLockReq.count(inv.hash)) {
-                connman->PushMessage(pfrom, msgMaker.Make(NetMsgType::IX, instantSend.mapTxLockReq[inv.hash]));
+            CTransactionRef tx = instantSend.GetLockRequest(inv.hash);
+            if(tx) {
+                connman->PushMessage(pfrom, msgMaker.Make(NetMsgType::IX, *tx));
                 pushed = true;
             }
         }
@@ -135,21 +141,23 @@ void ProcessGetDataMasternodeTypes(CNode* pfrom, const CChainParams& chainparams
         }
         if (!pushed && inv.type == MSG_MASTERNODE_ANNOUNCE) {
 			
-            if(mnodeman.mapSeenMasternodeBroadcast.count(inv.hash)) {
+            const CMasternodeBroadcast* item = mnodeman.mapSeenMasternodeBroadcast.Get(inv.hash);
+            if(item) {
                 if (pfrom->nVersion < MIN_MNW_PING_VERSION) {
-                    connman->PushMessage(pfrom, msgMaker.Make(NetMsgType::MNBROADCAST, mnodeman.mapSeenMasternodeBroadcast[inv.hash]));
+                    connman->PushMessage(pfrom, msgMaker.Make(NetMsgType::MNBROADCAST, *item));
                 } else {
-                    connman->PushMessage(pfrom, msgMaker.Make(NetMsgType::MNBROADCAST2, mnodeman.mapSeenMasternodeBroadcast[inv.hash]));
+                    connman->PushMessage(pfrom, msgMaker.Make(NetMsgType::MNBROADCAST2, *item));
                 }
                 pushed = true;
             }
         }
         if (!pushed && inv.type == MSG_MASTERNODE_PING) {
-            if(mnodeman.mapSeenMasternodePing.count(inv.hash)){
+            const CMasternodePing* item = mnodeman.mapSeenMasternodePing.Get(inv.hash);
+            if(item){
                 if (pfrom->nVersion < MIN_MNW_PING_VERSION) {
-                    connman->PushMessage(pfrom, msgMaker.Make(NetMsgType::MNPING, mnodeman.mapSeenMasternodePing[inv.hash]));
+                    connman->PushMessage(pfrom, msgMaker.Make(NetMsgType::MNPING, *item));
                 } else {
-                    connman->PushMessage(pfrom, msgMaker.Make(NetMsgType::MNPING2, mnodeman.mapSeenMasternodePing[inv.hash]));
+                    connman->PushMessage(pfrom, msgMaker.Make(NetMsgType::MNPING2, *item));
                 }
                 pushed = true;
             }
@@ -162,14 +170,16 @@ void ProcessGetDataMasternodeTypes(CNode* pfrom, const CChainParams& chainparams
             }
         }
         if (!pushed && inv.type == MSG_SYSTEMNODE_ANNOUNCE) {
-            if(snodeman.mapSeenSystemnodeBroadcast.count(inv.hash)){
-                connman->PushMessage(pfrom, msgMaker.Make(NetMsgType::SNBROADCAST, snodeman.mapSeenSystemnodeBroadcast[inv.hash]));
+            const CSystemnodeBroadcast* item = snodeman.mapSeenSystemnodeBroadcast.Get(inv.hash);
+            if(item){
+                connman->PushMessage(pfrom, msgMaker.Make(NetMsgType::SNBROADCAST, *item));
                 pushed = true;
             }
         }
         if (!pushed && inv.type == MSG_SYSTEMNODE_PING) {
-            if(snodeman.mapSeenSystemnodePing.count(inv.hash)){
-                connman->PushMessage(pfrom, msgMaker.Make(NetMsgType::SNPING, snodeman.mapSeenSystemnodePing[inv.hash]));
+            const CSystemnodePing* item = snodeman.mapSeenSystemnodePing.Get(inv.hash);
+            if(item){
+                connman->PushMessage(pfrom, msgMaker.Make(NetMsgType::SNPING, *item));
                 pushed = true;
             }
         }
@@ -221,7 +231,7 @@ void ProcessGetDataMasternodeTypes(CNode* pfrom, const CChainParams& chainparams
 #define RETURN_ON_CONDITION(condition)  \
         if (condition) { return true; }
 
-bool ProcessMessageMasternodeTypes(CNode* pfrom, const std::string& msg_type, CDataStream& vRecv, const CChainParams& chainparams, CTxMemPool& mempool, CConnman* connman, BanMan* banman, const std::atomic<bool>& interruptMsgProc)
+static void ProcessMessageMasternodeTypesInternal(CNode* pfrom, const std::string& msg_type, CDataStream& vRecv, CConnman* connman)
 {
     mnodeman.ProcessMessage(pfrom, msg_type, vRecv, connman);
     snodeman.ProcessMessage(pfrom, msg_type, vRecv, connman);
@@ -232,6 +242,189 @@ bool ProcessMessageMasternodeTypes(CNode* pfrom, const std::string& msg_type, CD
     ProcessSpork(pfrom, connman, msg_type, vRecv);
     masternodeSync.ProcessMessage(pfrom, msg_type, vRecv, connman);
     systemnodeSync.ProcessMessage(pfrom, msg_type, vRecv, connman);
+}
+
+static Mutex cs_capture;
+static std::unique_ptr<CAutoFile> captureFile GUARDED_BY(cs_capture);
+
+static void CaptureMasternodeMessage(const CNode* pfrom, const std::string& msg_type, const CDataStream& vRecv)
+{
+    LOCK(cs_capture);
+    if (!captureFile)
+        return;
+
+    CMasternodeMessageRecord record;
+    record.nTimeMicros = GetTimeMicros();
+    record.nPeer = pfrom->GetId();
+    record.addrPeer = pfrom->addr;
+    record.nPeerVersion = pfrom->nVersion;
+    record.nRecvVersion = vRecv.GetVersion();
+    record.msg_type = msg_type;
+    record.vData.assign(vRecv.begin(), vRecv.end());
+    try {
+        *captureFile << record;
+    } catch (const std::exception& e) {
+        LogPrintf("%s: failed to write %s message, stopping capture: %s\n", __func__, msg_type, e.what());
+        captureFile.reset();
+    }
+}
+
+bool ProcessMessageMasternodeTypes(CNode* pfrom, const std::string& msg_type, CDataStream& vRecv, const CChainParams& chainparams, CTxMemPool& mempool, CConnman* connman, BanMan* banman, const std::atomic<bool>& interruptMsgProc)
+{
+    if (IsMasternodeMessageType(msg_type))
+        CaptureMasternodeMessage(pfrom, msg_type, vRecv);
+
+    ProcessMessageMasternodeTypesInternal(pfrom, msg_type, vRecv, connman);
+
+    return true;
+}
+
+bool IsMasternodeMessageType(const std::string& msg_type)
+{
+    return GetMessageClass(msg_type) == MessageClass::GOSSIP;
+}
+
+bool StartMasternodeMessageCapture(const fs::path& path)
+{
+    FILE* file = fsbridge::fopen(path, "ab");
+    if (!file) {
+        LogPrintf("%s: failed to open %s\n", __func__, fs::PathToString(path));
+        return false;
+    }
+
+    LOCK(cs_capture);
+    captureFile = std::make_unique<CAutoFile>(file, SER_DISK, CLIENT_VERSION);
+    LogPrintf("Capturing masternode messages to %s\n", fs::PathToString(path));
+    return true;
+}
+
+void StopMasternodeMessageCapture()
+{
+    LOCK(cs_capture);
+    captureFile.reset();
+}
+
+static std::vector<std::pair<std::string, size_t>> GetMasternodeTypesUsage()
+{
+    return {
+        {"masternodes", mnodeman.DynamicMemoryUsage()},
+        {"systemnodes", snodeman.DynamicMemoryUsage()},
+        {"masternodepayments", masternodePayments.DynamicMemoryUsage()},
+        {"systemnodepayments", systemnodePayments.DynamicMemoryUsage()},
+        {"budget", budget.DynamicMemoryUsage()},
+        {"instantsend", instantSend.DynamicMemoryUsage()},
+    };
+}
+
+//! The lock profiler's totals so far, summed over the sites and mutexes of each lock name
+static std::map<std::string, CMasternodeReplayLockStats> GetLockTotals()
+{
+    std::map<std::string, CMasternodeReplayLockStats> mapTotals;
+    for (const LockStats& site : GetLockStats()) {
+        CMasternodeReplayLockStats& total = mapTotals[site.strName];
+        total.nCount += site.nCount;
+        total.nContended += site.nContended;
+        total.nWaitTime += site.nWaitTime;
+        total.nHoldTime += site.nHoldTime;
+    }
+    return mapTotals;
+}
+
+/** Records lock statistics for the duration of a replay, then restores the mock time and -lockstats however it ends */
+class ReplayEnvironment
+{
+    const int64_t nMockTimePrev;
+    const bool fLockStatsPrev;
+
+public:
+    ReplayEnvironment() : nMockTimePrev(GetMockTime()), fLockStatsPrev(g_lock_stats.exchange(true)) {}
+    ~ReplayEnvironment()
+    {
+        SetMockTime(nMockTimePrev);
+        g_lock_stats = fLockStatsPrev;
+    }
+};
+
+bool ReplayMasternodeMessages(const fs::path& path, const CChainParams& chainparams, CTxMemPool& mempool, CConnman& connman, CMasternodeReplayStats& stats, std::string& strError)
+{
+    if (chainparams.NetworkIDString() != CBaseChainParams::REGTEST) {
+        strError = "Replaying changes the masternode state of the running node, only allowed on regtest";
+        return false;
+    }
+
+    CAutoFile file(fsbridge::fopen(path, "rb"), SER_DISK, CLIENT_VERSION);
+    if (file.IsNull()) {
+        strError = strprintf("Failed to open %s", fs::PathToString(path));
+        return false;
+    }
+
+    std::vector<CMasternodeMessageRecord> vRecords;
+    while (true) {
+        CMasternodeMessageRecord record;
+        try {
+            file >> record;
+        } catch (const std::ios_base::failure& e) {
+            if (feof(file.Get()))
+                break;
+            strError = strprintf("Failed to read %s: %s", fs::PathToString(path), e.what());
+            return false;
+        }
+        vRecords.push_back(std::move(record));
+    }
+
+    ReplayEnvironment environment;
+    std::map<NodeId, std::unique_ptr<CNode>> mapPeers;
+    stats.vUsageBefore = GetMasternodeTypesUsage();
+
+    for (const CMasternodeMessageRecord& record : vRecords) {
+        std::unique_ptr<CNode>& pnode = mapPeers[record.nPeer];
+        if (!pnode)
+            pnode = std::make_unique<CNode>(record.nPeer, ServiceFlags(NODE_NETWORK), 0, INVALID_SOCKET, CAddress(record.addrPeer, NODE_NONE), 0, 0, CAddress(), "", ConnectionType::INBOUND);
+        pnode->nVersion = record.nPeerVersion;
+
+        SetMockTime(record.nTimeMicros / 1000000);
+        CDataStream vRecv(record.vData, SER_NETWORK, record.nRecvVersion);
+        const std::map<std::string, CMasternodeReplayLockStats> mapLocksBefore = GetLockTotals();
+        const int64_t nTimeBegin = GetTimeMicros();
+        try {
+            ProcessMessageMasternodeTypesInternal(pnode.get(), record.msg_type, vRecv, &connman);
+            // Winners are only queued by the message, verify them now so that the time is the message's
+            if (record.msg_type == NetMsgType::MNWINNER)
+                masternodePayments.ProcessPendingWinners(connman);
+        } catch (const std::exception& e) {
+            LogPrint(BCLog::MASTERNODE, "%s: %s message from peer=%d: %s\n", __func__, SanitizeString(record.msg_type), record.nPeer, e.what());
+            stats.nFailed++;
+        }
+        const int64_t nTime = GetTimeMicros() - nTimeBegin;
+
+        CMasternodeReplayTypeStats& typeStats = stats.mapTypes[record.msg_type];
+        typeStats.nCount++;
+        typeStats.nBytes += record.vData.size();
+        typeStats.nTotalMicros += nTime;
+        typeStats.nMaxMicros = std::max(typeStats.nMaxMicros, nTime);
+        stats.nMessages++;
+        stats.nElapsedMicros += nTime;
+
+        for (const auto& lock : GetLockTotals()) {
+            CMasternodeReplayLockStats prev;
+            auto it = mapLocksBefore.find(lock.first);
+            if (it != mapLocksBefore.end())
+                prev = it->second;
+            if (lock.second.nCount == prev.nCount && lock.second.nHoldTime == prev.nHoldTime)
+                continue;
+            CMasternodeReplayLockStats& typeLock = typeStats.mapLocks[lock.first];
+            typeLock.nCount += lock.second.nCount - prev.nCount;
+            typeLock.nContended += lock.second.nContended - prev.nContended;
+            typeLock.nWaitTime += lock.second.nWaitTime - prev.nWaitTime;
+            typeLock.nHoldTime += lock.second.nHoldTime - prev.nHoldTime;
+        }
+
+        // Nobody reads what was pushed to the detached peer
+        LOCK(pnode->cs_vSend);
+        pnode->vSendMsg.clear();
+        pnode->nSendSize = 0;
+    }
 
+    stats.vUsageAfter = GetMasternodeTypesUsage();
     return true;
 }
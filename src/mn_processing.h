@@ -7,6 +7,7 @@
 
 #include <consensus/params.h>
 #include <consensus/validation.h>
+#include <fs.h>
 #include <net.h>
 #include <net_processing.h>
 #include <sync.h>
@@ -15,6 +16,9 @@
 class CChainParams;
 class CTxMemPool;
 
+//! Default for -capturemnmessages
+static const bool DEFAULT_CAPTURE_MN_MESSAGES = false;
+
 #define SET_CONDITION_FLAG(flag) flag = true;
 #define RETURN_ON_CONDITION(condition) if (condition) { return true; }
 
@@ -22,4 +26,72 @@ bool AlreadyHaveMasternodeTypes(const CInv& inv, const CTxMemPool& mempool);
 void ProcessGetDataMasternodeTypes(CNode* pfrom, const CChainParams& chainparams, CConnman* connman, const CTxMemPool& mempool, const CInv& inv, bool& pushed) LOCKS_EXCLUDED(cs_main);
 bool ProcessMessageMasternodeTypes(CNode* pfrom, const std::string& msg_type, CDataStream& vRecv, const CChainParams& chainparams, CTxMemPool& mempool, CConnman* connman, BanMan* banman, const std::atomic<bool>& interruptMsgProc);
 
+/** Whether the message is handled by the masternode, systemnode, budget, instantsend or spork subsystems */
+bool IsMasternodeMessageType(const std::string& msg_type);
+
+/** A masternode type message as received from a peer, recorded to be replayed offline */
+struct CMasternodeMessageRecord
+{
+    int64_t nTimeMicros{0};
+    NodeId nPeer{0};
+    CService addrPeer;
+    int nPeerVersion{0};
+    int nRecvVersion{0};
+    std::string msg_type;
+    std::vector<unsigned char> vData;
+
+    SERIALIZE_METHODS(CMasternodeMessageRecord, obj)
+    {
+        READWRITE(obj.nTimeMicros, obj.nPeer, obj.addrPeer, obj.nPeerVersion, obj.nRecvVersion, obj.msg_type, obj.vData);
+    }
+};
+
+/** Acquisitions of the locks of one name, times in nanoseconds as recorded by the lock profiler */
+struct CMasternodeReplayLockStats
+{
+    uint64_t nCount{0};
+    uint64_t nContended{0};
+    uint64_t nWaitTime{0};
+    uint64_t nHoldTime{0};
+};
+
+/** Totals of one message type over a replay */
+struct CMasternodeReplayTypeStats
+{
+    uint64_t nCount{0};
+    uint64_t nBytes{0};
+    //! Including the verification of the winners a mnw message queued
+    int64_t nTotalMicros{0};
+    int64_t nMaxMicros{0};
+    //! Locks acquired while processing the messages of the type, by name
+    std::map<std::string, CMasternodeReplayLockStats> mapLocks;
+};
+
+struct CMasternodeReplayStats
+{
+    uint64_t nMessages{0};
+    //! Messages whose processing threw, e.g. on a truncated payload
+    uint64_t nFailed{0};
+    //! Time spent processing the messages, leaving out the reading and the lock statistics
+    int64_t nElapsedMicros{0};
+    std::map<std::string, CMasternodeReplayTypeStats> mapTypes;
+    //! Memory usage of each subsystem before and after the replay
+    std::vector<std::pair<std::string, size_t>> vUsageBefore;
+    std::vector<std::pair<std::string, size_t>> vUsageAfter;
+};
+
+/** Append every masternode type message received from now on to a file */
+bool StartMasternodeMessageCapture(const fs::path& path);
+void StopMasternodeMessageCapture();
+
+/**
+ * Feed the messages of a capture file into the masternode type subsystems, in order and
+ * at their recorded times, from detached peers with the recorded addresses and versions.
+ * Replies to those peers are dropped; relays go to the connected peers, so the node is
+ * expected to have none. The messages change the state of the running node, so replaying
+ * is only allowed on regtest. Lock statistics are recorded during the replay, and the mock
+ * time and -lockstats setting are restored afterwards.
+ */
+bool ReplayMasternodeMessages(const fs::path& path, const CChainParams& chainparams, CTxMemPool& mempool, CConnman& connman, CMasternodeReplayStats& stats, std::string& strError);
+
 #endif // CROWN_MN_PROCESSING_H
@@ -47,6 +47,7 @@ static_assert(MINIUPNPC_API_VERSION >= 10, "miniUPnPc API version >= 10 assumed"
 
 #include <algorithm>
 #include <cstdint>
+#include <limits>
 #include <unordered_map>
 
 #include <math.h>
@@ -685,6 +686,8 @@ bool CNode::ReceiveMsgBytes(const char *pch, unsigned int nBytes, bool& complete
             assert(i != mapRecvBytesPerMsgCmd.end());
             i->second += result->m_raw_message_size;
 
+            result->m_class = GetMessageClass(result->m_command);
+
             // push the message to the process queue,
             vRecvMsg.push_back(std::move(*result));
 
@@ -695,6 +698,93 @@ bool CNode::ReceiveMsgBytes(const char *pch, unsigned int nBytes, bool& complete
     return true;
 }
 
+static std::array<int, MESSAGE_CLASS_COUNT> g_msg_class_weights{0, DEFAULT_MSG_CLASS_WEIGHTS[0], DEFAULT_MSG_CLASS_WEIGHTS[1], DEFAULT_MSG_CLASS_WEIGHTS[2], DEFAULT_MSG_CLASS_WEIGHTS[3]};
+
+bool SetMessageClassWeight(MessageClass msg_class, int nWeight)
+{
+    if (msg_class == MessageClass::CONTROL || nWeight < 1)
+        return false;
+    g_msg_class_weights[size_t(msg_class)] = nWeight;
+    return true;
+}
+
+bool CProcessMsgQueue::empty() const
+{
+    for (const auto& queue : m_queues) {
+        if (!queue.empty())
+            return false;
+    }
+    return true;
+}
+
+void CProcessMsgQueue::Push(std::list<CNetMessage>& msgs, std::list<CNetMessage>::iterator end)
+{
+    while (msgs.begin() != end) {
+        msgs.front().m_seq = m_next_seq++;
+        std::list<CNetMessage>& queue = m_queues[size_t(msgs.front().m_class)];
+        queue.splice(queue.end(), msgs, msgs.begin());
+    }
+}
+
+bool CProcessMsgQueue::HasDataBefore(uint64_t nSeq) const
+{
+    for (size_t i = 1; i < MESSAGE_CLASS_COUNT; i++) {
+        if (!m_queues[i].empty() && m_queues[i].front().m_seq < nSeq)
+            return true;
+    }
+    return false;
+}
+
+bool CProcessMsgQueue::Pop(std::list<CNetMessage>& msgs)
+{
+    // Only the data messages received before a notfound waiting at the front of the control messages are taken
+    uint64_t nBefore = std::numeric_limits<uint64_t>::max();
+    std::list<CNetMessage>& control = m_queues[size_t(MessageClass::CONTROL)];
+    if (!control.empty()) {
+        if (control.front().m_command != NetMsgType::NOTFOUND || !HasDataBefore(control.front().m_seq)) {
+            msgs.splice(msgs.begin(), control, control.begin());
+            return true;
+        }
+        nBefore = control.front().m_seq;
+    }
+    if (empty())
+        return false;
+
+    while (true) {
+        // Keep serving the current class while it has budget left, then move on to the next
+        for (size_t n = 0; n < MESSAGE_CLASS_COUNT - 1; n++) {
+            const size_t i = 1 + (m_current + n) % (MESSAGE_CLASS_COUNT - 1);
+            std::list<CNetMessage>& queue = m_queues[i];
+            if (queue.empty() || queue.front().m_seq > nBefore || m_byte_budget[i] <= 0 || m_cpu_budget[i] <= 0)
+                continue;
+
+            m_byte_budget[i] -= queue.front().m_raw_message_size;
+            msgs.splice(msgs.begin(), queue, queue.begin());
+            if (queue.empty()) {
+                // An idle class does not save up budget, but keeps its debt
+                m_byte_budget[i] = std::min<int64_t>(m_byte_budget[i], 0);
+                m_cpu_budget[i] = std::min<int64_t>(m_cpu_budget[i], 0);
+            }
+            m_current = i - 1;
+            return true;
+        }
+
+        // Every class with messages has used its budget, start a new round with the class after the last one served
+        m_current = (m_current + 1) % (MESSAGE_CLASS_COUNT - 1);
+        for (size_t i = 1; i < MESSAGE_CLASS_COUNT; i++) {
+            if (m_queues[i].empty() || m_queues[i].front().m_seq > nBefore)
+                continue;
+            m_byte_budget[i] += g_msg_class_weights[i] * MSG_CLASS_BYTES_QUANTUM;
+            m_cpu_budget[i] += g_msg_class_weights[i] * MSG_CLASS_CPU_QUANTUM;
+        }
+    }
+}
+
+void CProcessMsgQueue::ChargeCPUTime(MessageClass msg_class, int64_t nCPUTime)
+{
+    m_cpu_budget[size_t(msg_class)] -= nCPUTime;
+}
+
 int V1TransportDeserializer::readHeader(const char *pch, unsigned int nBytes)
 {
     // copy data to temporary parsing buffer
@@ -1510,7 +1600,7 @@ void CConnman::SocketHandler()
                     }
                     {
                         LOCK(pnode->cs_vProcessMsg);
-                        pnode->vProcessMsg.splice(pnode->vProcessMsg.end(), pnode->vRecvMsg, pnode->vRecvMsg.begin(), it);
+                        pnode->vProcessMsg.Push(pnode->vRecvMsg, it);
                         pnode->nProcessQueueSize += nSizeAdded;
                         pnode->fPauseRecv = pnode->nProcessQueueSize > nReceiveFloodSize;
                     }
@@ -25,9 +25,11 @@
 #include <threadinterrupt.h>
 #include <uint256.h>
 
+#include <array>
 #include <atomic>
 #include <cstdint>
 #include <deque>
+#include <list>
 #include <map>
 #include <thread>
 #include <memory>
@@ -96,6 +98,11 @@ static const int64_t DEFAULT_PEER_CONNECT_TIMEOUT = 60;
 static const bool DEFAULT_FORCEDNSSEED = false;
 static const size_t DEFAULT_MAXRECEIVEBUFFER = 5 * 1000;
 static const size_t DEFAULT_MAXSENDBUFFER    = 1 * 1000;
+/** Default -msgclassweight of the block, tx, gossip and smsg message classes */
+static const int DEFAULT_MSG_CLASS_WEIGHTS[] = {8, 4, 2, 1};
+/** Bytes and CPU time (microseconds) a class may process per round and unit of weight */
+static const int64_t MSG_CLASS_BYTES_QUANTUM = 64 * 1000;
+static const int64_t MSG_CLASS_CPU_QUANTUM = 5 * 1000;
 
 typedef int64_t NodeId;
 
@@ -768,6 +775,8 @@ public:
     uint32_t m_message_size{0};          //!< size of the payload
     uint32_t m_raw_message_size{0};      //!< used wire size of the message (including header/checksum)
     std::string m_command;
+    MessageClass m_class{MessageClass::CONTROL};
+    uint64_t m_seq{0};                   //!< arrival order among the messages of the peer, set when queued for processing
 
     CNetMessage(CDataStream&& recv_in) : m_recv(std::move(recv_in)) {}
 
@@ -777,6 +786,45 @@ public:
     }
 };
 
+/** Set the weight of a message class other than control, at startup */
+bool SetMessageClassWeight(MessageClass msg_class, int nWeight);
+
+/**
+ * The received messages of a peer waiting to be processed, queued by class, so that a
+ * flood of one class does not hold back the others. Control messages are taken first.
+ * The other classes are served by deficit round robin: every round grants each class a
+ * byte and a CPU time budget in proportion to its weight, and a class is served while
+ * it has both left.
+ *
+ * Each class keeps the order it was received in. Messages of different data classes may
+ * be reordered: a block, a transaction, a gossip message and a secure message don't refer
+ * to one another any more than when they come from different peers. A notfound, though,
+ * completes the requests which the messages before it answered, so it is not taken ahead
+ * of the data messages received before it, nor are the control messages queued behind it.
+ */
+class CProcessMsgQueue
+{
+private:
+    std::array<std::list<CNetMessage>, MESSAGE_CLASS_COUNT> m_queues;
+    std::array<int64_t, MESSAGE_CLASS_COUNT> m_byte_budget{};
+    std::array<int64_t, MESSAGE_CLASS_COUNT> m_cpu_budget{};
+    //! The class served last, less one, so that the first round starts with blocks
+    size_t m_current{MESSAGE_CLASS_COUNT - 2};
+    uint64_t m_next_seq{0};
+
+    //! Whether a data message received before the one with sequence number nSeq is queued
+    bool HasDataBefore(uint64_t nSeq) const;
+
+public:
+    bool empty() const;
+    /** Queue the received messages from the beginning of msgs up to end */
+    void Push(std::list<CNetMessage>& msgs, std::list<CNetMessage>::iterator end);
+    /** Move the next message to process to the beginning of msgs, charging its size to its class */
+    bool Pop(std::list<CNetMessage>& msgs);
+    /** Charge the CPU time spent processing a message to its class */
+    void ChargeCPUTime(MessageClass msg_class, int64_t nCPUTime);
+};
+
 /** The TransportDeserializer takes care of holding and deserializing the
  * network receive buffer. It can deserialize the network buffer into a
  * transport protocol agnostic CNetMessage (command & payload)
@@ -888,7 +936,7 @@ public:
     RecursiveMutex cs_vRecv;
 
     RecursiveMutex cs_vProcessMsg;
-    std::list<CNetMessage> vProcessMsg GUARDED_BY(cs_vProcessMsg);
+    CProcessMsgQueue vProcessMsg GUARDED_BY(cs_vProcessMsg);
     size_t nProcessQueueSize{0};
 
     RecursiveMutex cs_sendProcessing;
@@ -1035,6 +1083,9 @@ public:
     std::list<CInv> listAskForBlocks;
     std::vector<CInv> vInventoryOtherToSend;
     std::vector<uint256> vInventoryBlockToSend GUARDED_BY(cs_inventory);
+    // Node list inventories (dseg replies) still to announce and how far we got in each,
+    // streamed in bounded chunks by the send loop
+    std::deque<std::pair<std::shared_ptr<const std::vector<CInv>>, size_t>> vInventoryListToSend GUARDED_BY(cs_inventory);
     Mutex cs_inventory;
 
     struct TxRelay {
@@ -1215,6 +1266,13 @@ public:
         }
     }
 
+    void PushListInventory(std::shared_ptr<const std::vector<CInv>> pinv)
+    {
+        if (!pinv || pinv->empty()) return;
+        LOCK(cs_inventory);
+        vInventoryListToSend.emplace_back(std::move(pinv), 0);
+    }
+
     void AskFor(const CInv& inv);
     void AskForBlock(const CInv& inv);
 
@@ -128,6 +128,8 @@ static const unsigned int INVENTORY_BROADCAST_INTERVAL = 5;
 static constexpr unsigned int INVENTORY_BROADCAST_PER_SECOND = 7;
 /** Maximum number of inventory items to send per transmission. */
 static constexpr unsigned int INVENTORY_BROADCAST_MAX = INVENTORY_BROADCAST_PER_SECOND * INVENTORY_BROADCAST_INTERVAL;
+/** Maximum number of node list (dseg) inventory items to send to a peer per trickle. */
+static constexpr unsigned int MAX_LIST_INV_PER_TRICKLE = 1000;
 /** The number of most recently announced transactions a peer can request. */
 static constexpr unsigned int INVENTORY_MAX_RECENT_RELAY = 3500;
 /** Verify that INVENTORY_MAX_RECENT_RELAY is enough to cache everything typically
@@ -472,6 +474,11 @@ struct Peer {
     /** Total number of addresses that were processed (excludes rate limited ones). */
     std::atomic<uint64_t> m_addr_processed{0};
 
+    /** Protects m_msg_processing_stats */
+    Mutex m_msg_processing_stats_mutex;
+    /** Processing cost of the messages received from this peer, by command */
+    mapMsgCmdProcessingStats m_msg_processing_stats GUARDED_BY(m_msg_processing_stats_mutex);
+
     Peer(NodeId id) : m_id(id) {}
 };
 
@@ -926,10 +933,42 @@ bool GetNodeStateStats(NodeId nodeid, CNodeStateStats &stats) {
     stats.m_misbehavior_score = WITH_LOCK(peer->m_misbehavior_mutex, return peer->m_misbehavior_score);
     stats.m_addr_processed = peer->m_addr_processed.load();
     stats.m_addr_rate_limited = peer->m_addr_rate_limited.load();
+    stats.m_msg_processing_stats = WITH_LOCK(peer->m_msg_processing_stats_mutex, return peer->m_msg_processing_stats);
 
     return true;
 }
 
+void CMessageProcessingStats::Add(int64_t nCPUTimeIn, int64_t nWallTimeIn)
+{
+    nCount++;
+    nCPUTime += nCPUTimeIn;
+    nWallTime += nWallTimeIn;
+    int nBucket = 0;
+    while (nCPUTimeIn > 1 && nBucket < BUCKETS - 1) {
+        nCPUTimeIn = (nCPUTimeIn + 1) >> 1;
+        nBucket++;
+    }
+    vCPUTimeHistogram[nBucket]++;
+}
+
+static Mutex g_msg_processing_stats_mutex;
+static mapMsgCmdProcessingStats g_msg_processing_stats GUARDED_BY(g_msg_processing_stats_mutex);
+
+mapMsgCmdProcessingStats GetMessageProcessingStats()
+{
+    LOCK(g_msg_processing_stats_mutex);
+    return g_msg_processing_stats;
+}
+
+static void AddMessageProcessingStats(Peer& peer, const std::string& msg_type, int64_t nCPUTime, int64_t nWallTime)
+{
+    static const std::set<std::string> setKnownTypes(getAllNetMessageTypes().begin(), getAllNetMessageTypes().end());
+    const std::string& command = setKnownTypes.count(msg_type) ? msg_type : NET_MESSAGE_COMMAND_OTHER;
+
+    WITH_LOCK(g_msg_processing_stats_mutex, g_msg_processing_stats[command].Add(nCPUTime, nWallTime));
+    WITH_LOCK(peer.m_msg_processing_stats_mutex, peer.m_msg_processing_stats[command].Add(nCPUTime, nWallTime));
+}
+
 //////////////////////////////////////////////////////////////////////////////
 //
 // mapOrphanTransactions
@@ -3938,10 +3977,9 @@ bool PeerManager::ProcessMessages(CNode* pfrom, std::atomic<bool>& interruptMsgP
     std::list<CNetMessage> msgs;
     {
         LOCK(pfrom->cs_vProcessMsg);
-        if (pfrom->vProcessMsg.empty())
+        // Just take one message, the next one of its class
+        if (!pfrom->vProcessMsg.Pop(msgs))
             return false;
-        // Just take one message
-        msgs.splice(msgs.begin(), pfrom->vProcessMsg, pfrom->vProcessMsg.begin());
         pfrom->nProcessQueueSize -= msgs.front().m_raw_message_size;
         pfrom->fPauseRecv = pfrom->nProcessQueueSize > m_connman.GetReceiveFloodSize();
         fMoreWork = !pfrom->vProcessMsg.empty();
@@ -3954,6 +3992,8 @@ bool PeerManager::ProcessMessages(CNode* pfrom, std::atomic<bool>& interruptMsgP
     // Message size
     unsigned int nMessageSize = msg.m_message_size;
 
+    const int64_t nCPUTimeStart = GetThreadCPUTimeMicros();
+    const int64_t nTimeStart = GetTimeMicros();
     try {
         ProcessMessage(*pfrom, msg_type, msg.m_recv, msg.m_time, interruptMsgProc);
         if (interruptMsgProc) return false;
@@ -3966,6 +4006,9 @@ bool PeerManager::ProcessMessages(CNode* pfrom, std::atomic<bool>& interruptMsgP
     } catch (...) {
         LogPrint(BCLog::NET, "%s(%s, %u bytes): Unknown exception caught\n", __func__, SanitizeString(msg_type), nMessageSize);
     }
+    const int64_t nCPUTime = GetThreadCPUTimeMicros() - nCPUTimeStart;
+    AddMessageProcessingStats(*peer, msg_type, nCPUTime, GetTimeMicros() - nTimeStart);
+    WITH_LOCK(pfrom->cs_vProcessMsg, pfrom->vProcessMsg.ChargeCPUTime(msg.m_class, nCPUTime));
 
     return fMoreWork;
 }
@@ -4549,6 +4592,23 @@ bool PeerManager::SendMessages(CNode* pto)
                         }
                     }
                     pto->vInventoryOtherToSend.clear();
+
+                    // Stream node list inventory, bounded per trickle so that big lists don't flood the peer
+                    unsigned int nListBudget = MAX_LIST_INV_PER_TRICKLE;
+                    while (nListBudget > 0 && !pto->vInventoryListToSend.empty()) {
+                        auto& stream = pto->vInventoryListToSend.front();
+                        const std::vector<CInv>& vListInv = *stream.first;
+                        while (nListBudget > 0 && stream.second < vListInv.size()) {
+                            vInv.push_back(vListInv[stream.second++]);
+                            nListBudget--;
+                            if (vInv.size() == MAX_INV_SZ) {
+                                m_connman.PushMessage(pto, msgMaker.Make(NetMsgType::INV, vInv));
+                                vInv.clear();
+                            }
+                        }
+                        if (stream.second == vListInv.size())
+                            pto->vInventoryListToSend.pop_front();
+                    }
                 }
             }
         }
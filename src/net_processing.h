@@ -12,6 +12,9 @@
 #include <txrequest.h>
 #include <validationinterface.h>
 
+#include <array>
+#include <map>
+
 class BlockTransactionsRequest;
 class BlockValidationState;
 class CBlockHeader;
@@ -146,6 +149,20 @@ private:
     int64_t m_stale_tip_check_time; //!< Next time to check for stale tip
 };
 
+/** Processing cost of the received messages of one type */
+struct CMessageProcessingStats {
+    //! Histogram bucket i counts the messages that took up to 2^i microseconds of CPU time, the last one all longer ones
+    static constexpr int BUCKETS = 20;
+
+    uint64_t nCount{0};
+    int64_t nCPUTime{0};
+    int64_t nWallTime{0};
+    std::array<uint64_t, BUCKETS> vCPUTimeHistogram{};
+
+    void Add(int64_t nCPUTimeIn, int64_t nWallTimeIn);
+};
+typedef std::map<std::string, CMessageProcessingStats> mapMsgCmdProcessingStats; // command, processing cost
+
 struct CNodeStateStats {
     int m_misbehavior_score = 0;
     int nSyncHeight = -1;
@@ -153,11 +170,15 @@ struct CNodeStateStats {
     std::vector<int> vHeightInFlight;
     uint64_t m_addr_processed = 0;
     uint64_t m_addr_rate_limited = 0;
+    mapMsgCmdProcessingStats m_msg_processing_stats;
 };
 
 /** Get statistics from node state */
 bool GetNodeStateStats(NodeId nodeid, CNodeStateStats &stats);
 
+/** Processing cost of the messages received from all peers since startup, by command */
+mapMsgCmdProcessingStats GetMessageProcessingStats();
+
 /** Relay transaction to every node */
 void RelayTransaction(const CInv& inv, const CConnman& connman);
 void RelayTransaction(const uint256& txid, const uint256& wtxid, const CConnman& connman) EXCLUSIVE_LOCKS_REQUIRED(cs_main);
@@ -8,11 +8,15 @@
 #include <coins.h>
 #include <hash.h>
 #include <serialize.h>
+#include <shutdown.h>
+#include <txdb.h>
 #include <uint256.h>
 #include <util/system.h>
 #include <validation.h>
 
+#include <atomic>
 #include <map>
+#include <thread>
 
 static uint64_t GetBogoSize(const CScript& scriptPubKey)
 {
@@ -36,6 +40,7 @@ static void ApplyStats(CCoinsStats& stats, CHashWriter& ss, const uint256& hash,
         ss << VARINT_MODE(output.second.out.nValue, VarIntMode::NONNEGATIVE_SIGNED);
         stats.nTransactionOutputs++;
         stats.nTotalAmount += output.second.out.nValue;
+        stats.mapTotalAmount[output.second.out.nAsset] += output.second.out.nValue;
         stats.nBogoSize += GetBogoSize(output.second.out.scriptPubKey);
     }
     ss << VARINT(0u);
@@ -48,6 +53,7 @@ static void ApplyStats(CCoinsStats& stats, std::nullptr_t, const uint256& hash,
     for (const auto& output : outputs) {
         stats.nTransactionOutputs++;
         stats.nTotalAmount += output.second.out.nValue;
+        stats.mapTotalAmount[output.second.out.nAsset] += output.second.out.nValue;
         stats.nBogoSize += GetBogoSize(output.second.out.scriptPubKey);
     }
 }
@@ -123,3 +129,113 @@ static void FinalizeHash(CHashWriter& ss, CCoinsStats& stats)
     stats.hashSerialized = ss.GetHash();
 }
 static void FinalizeHash(std::nullptr_t, CCoinsStats& stats) {}
+
+void CCoinsScriptStats::Add(const CCoinsScriptStats& other)
+{
+    statsPKH.Add(other.statsPKH);
+    statsSH.Add(other.statsSH);
+    statsOther.Add(other.statsOther);
+    for (const auto& asset : other.mapAssets) {
+        mapAssets[asset.first].Add(asset.second);
+    }
+}
+
+static void ApplyScriptStats(CCoinsScriptStats& stats, const Coin& coin)
+{
+    CScriptTypeStats* ps = &stats.statsOther;
+    if (coin.out.scriptPubKey.IsPayToPubkeyHash()) {
+        ps = &stats.statsPKH;
+    } else if (coin.out.scriptPubKey.IsPayToScriptHash()) {
+        ps = &stats.statsSH;
+    }
+    ps->nPlain++;
+    ps->nPlainValue += coin.out.nValue;
+
+    CScriptTypeStats& asset = stats.mapAssets[coin.out.nAsset];
+    asset.nPlain++;
+    asset.nPlainValue += coin.out.nValue;
+}
+
+bool GetUTXOScriptStats(const CCoinsViewDB& view, CCoinsScriptStats& stats, int nThreads, const std::function<bool()>& should_abort)
+{
+    // More ranges than threads, so that a thread done with a sparse range picks up the next one.
+    // Flushes run under cs_main, so the snapshot taken with it held never sees one half written.
+    std::vector<std::unique_ptr<CCoinsViewCursor>> cursors;
+    {
+        LOCK(cs_main);
+        cursors = view.RangeCursors(std::min(256, nThreads * 8));
+    }
+    if (cursors.front()->GetBestBlock().IsNull()) {
+        LogPrintf("%s: coins database has no best block\n", __func__);
+        return false;
+    }
+    std::vector<CCoinsScriptStats> vRangeStats(cursors.size());
+    std::atomic<size_t> nNextRange{0};
+    std::atomic<bool> fFailed{false};
+
+    auto worker = [&]() {
+        size_t i;
+        while (!fFailed && (i = nNextRange++) < cursors.size()) {
+            CCoinsViewCursor* pcursor = cursors[i].get();
+            while (pcursor->Valid()) {
+                if (should_abort && should_abort()) {
+                    fFailed = true;
+                    return;
+                }
+                Coin coin;
+                if (!pcursor->GetValue(coin)) {
+                    LogPrintf("%s: unable to read value\n", __func__);
+                    fFailed = true;
+                    return;
+                }
+                ApplyScriptStats(vRangeStats[i], coin);
+                pcursor->Next();
+            }
+        }
+    };
+
+    std::vector<std::thread> threads;
+    for (int n = 1; n < nThreads; n++) {
+        threads.emplace_back(worker);
+    }
+    worker();
+    for (std::thread& thread : threads) {
+        thread.join();
+    }
+    if (fFailed) return false;
+
+    stats = CCoinsScriptStats();
+    stats.hashBlock = cursors.front()->GetBestBlock();
+    {
+        LOCK(cs_main);
+        const CBlockIndex* pindex = LookupBlockIndex(stats.hashBlock);
+        if (!pindex) return false;
+        stats.nHeight = pindex->nHeight;
+    }
+    for (const CCoinsScriptStats& range : vRangeStats) {
+        stats.Add(range);
+    }
+    return true;
+}
+
+bool InitAssetSupply(CCoinsViewDB& view)
+{
+    CAmountMap supply;
+    if (view.GetAssetSupply(supply)) {
+        return true;
+    }
+    if (view.GetBestBlock().IsNull()) {
+        // Empty coins database, the supply is tracked from the first block on
+        return view.WriteAssetSupply(supply);
+    }
+
+    LogPrintf("Building the asset supply from the UTXO set...\n");
+    CCoinsScriptStats stats;
+    if (!GetUTXOScriptStats(view, stats, std::max(1, std::min(GetNumCores(), MAX_UTXO_SCAN_THREADS)), ShutdownRequested)) {
+        return false;
+    }
+    for (const auto& asset : stats.mapAssets) {
+        supply[asset.first] = asset.second.nPlainValue;
+    }
+    return view.WriteAssetSupply(supply);
+}
@@ -7,12 +7,15 @@
 #define CROWN_NODE_COINSTATS_H
 
 #include <amount.h>
+#include <primitives/asset.h>
 #include <uint256.h>
 
 #include <cstdint>
 #include <functional>
+#include <map>
 
 class CCoinsView;
+class CCoinsViewDB;
 
 enum class CoinStatsHashType {
     HASH_SERIALIZED,
@@ -29,6 +32,8 @@ struct CCoinsStats
     uint256 hashSerialized{};
     uint64_t nDiskSize{0};
     CAmount nTotalAmount{0};
+    //! nTotalAmount split per asset
+    CAmountMap mapTotalAmount{};
 
     //! The number of coins contained.
     uint64_t coins_count{0};
@@ -37,4 +42,40 @@ struct CCoinsStats
 //! Calculate statistics about the unspent transaction output set
 bool GetUTXOStats(CCoinsView* view, CCoinsStats& stats, const CoinStatsHashType hash_type, const std::function<void()>& interruption_point = {});
 
+struct CScriptTypeStats
+{
+    uint64_t nPlain{0};
+    //! Outputs with a hidden value. Always 0, Crown has no confidential outputs.
+    uint64_t nBlinded{0};
+    CAmount nPlainValue{0};
+
+    void Add(const CScriptTypeStats& other)
+    {
+        nPlain += other.nPlain;
+        nBlinded += other.nBlinded;
+        nPlainValue += other.nPlainValue;
+    }
+};
+
+struct CCoinsScriptStats
+{
+    int nHeight{0};
+    uint256 hashBlock{};
+    CScriptTypeStats statsPKH;
+    CScriptTypeStats statsSH;
+    CScriptTypeStats statsOther;
+    std::map<CAsset, CScriptTypeStats> mapAssets;
+
+    void Add(const CCoinsScriptStats& other);
+};
+
+//! Upper bound on the threads used to scan the UTXO set
+static constexpr int MAX_UTXO_SCAN_THREADS = 8;
+
+//! Calculate per script type and per asset statistics of the UTXO set, scanning key ranges of one snapshot on nThreads threads
+bool GetUTXOScriptStats(const CCoinsViewDB& view, CCoinsScriptStats& stats, int nThreads, const std::function<bool()>& should_abort = {});
+
+//! Build the per asset supply tracked by the coins database from a full scan, unless it is already there
+bool InitAssetSupply(CCoinsViewDB& view);
+
 #endif // CROWN_NODE_COINSTATS_H
@@ -11,7 +11,7 @@
 #include <coins.h>
 #include <span.h>
 
-CAmount GetDustThreshold(const CTxOutAsset& txout, const CFeeRate& dustRelayFeeIn)
+CAmount GetDustThreshold(const CTxOutRef& txout, const CFeeRate& dustRelayFeeIn)
 {
     // "Dust" is defined in terms of dustRelayFee,
     // which has units satoshis-per-kilobyte.
@@ -45,11 +45,21 @@ CAmount GetDustThreshold(const CTxOutAsset& txout, const CFeeRate& dustRelayFeeI
     return dustRelayFeeIn.GetFee(nSize);
 }
 
-bool IsDust(const CTxOutAsset& txout, const CFeeRate& dustRelayFeeIn)
+CAmount GetDustThreshold(const CTxOutAsset& txout, const CFeeRate& dustRelayFeeIn)
+{
+    return GetDustThreshold(CTxOutRef(txout), dustRelayFeeIn);
+}
+
+bool IsDust(const CTxOutRef& txout, const CFeeRate& dustRelayFeeIn)
 {
     return (txout.nValue < GetDustThreshold(txout, dustRelayFeeIn));
 }
 
+bool IsDust(const CTxOutAsset& txout, const CFeeRate& dustRelayFeeIn)
+{
+    return IsDust(CTxOutRef(txout), dustRelayFeeIn);
+}
+
 bool IsStandard(const CScript& scriptPubKey, TxoutType& whichType)
 {
     std::vector<std::vector<unsigned char> > vSolutions;
@@ -112,7 +122,7 @@ bool IsStandardTx(const CTransaction& tx, bool permit_bare_multisig, const CFeeR
     unsigned int nDataOut = 0;
     TxoutType whichType;
 	for (unsigned int k = 0; k <  (tx.nVersion >= TX_ELE_VERSION ? tx.vpout.size() : tx.vout.size()) ; k++) {
-		CTxOutAsset txout = (tx.nVersion >= TX_ELE_VERSION ? tx.vpout[k] : tx.vout[k]);
+		const CTxOutRef txout = tx.GetOutputs()[k];
                 
     //for (const CTxOutAsset& txout : tx.vout) {
         if (!::IsStandard(txout.scriptPubKey, whichType)) {
@@ -15,6 +15,7 @@
 
 class CCoinsViewCache;
 class CTxOutAsset;
+class CTxOutRef;
 
 /** Default for -blockmaxweight, which controls the range of block weights the mining code will create **/
 static const unsigned int DEFAULT_BLOCK_MAX_WEIGHT = MAX_BLOCK_WEIGHT - 4000;
@@ -83,8 +84,10 @@ static constexpr unsigned int STANDARD_NOT_MANDATORY_VERIFY_FLAGS = STANDARD_SCR
 static constexpr unsigned int STANDARD_LOCKTIME_VERIFY_FLAGS = LOCKTIME_VERIFY_SEQUENCE |
                                                                LOCKTIME_MEDIAN_TIME_PAST;
 
+CAmount GetDustThreshold(const CTxOutRef& txout, const CFeeRate& dustRelayFee);
 CAmount GetDustThreshold(const CTxOutAsset& txout, const CFeeRate& dustRelayFee);
 
+bool IsDust(const CTxOutRef& txout, const CFeeRate& dustRelayFee);
 bool IsDust(const CTxOutAsset& txout, const CFeeRate& dustRelayFee);
 
 bool IsStandard(const CScript& scriptPubKey, TxoutType& whichType);
@@ -7,8 +7,15 @@
 #include <base58.h>
 #include <hash.h>
 #include <key_io.h>
+#include <memusage.h>
+#include <sync.h>
 #include <util/moneystr.h>
 #include <util/system.h>
+
+#include <algorithm>
+#include <cstring>
+#include <atomic>
+#include <map>
 CAmountMap& operator+=(CAmountMap& a, const CAmountMap& b)
 {
     for(std::map<CAsset, CAmount>::const_iterator it = b.begin(); it != b.end(); ++it)
@@ -260,22 +267,36 @@ void AssetMetadata::setShortName(const std::string& _sAssetShortName)
     strcat( reinterpret_cast <char*>(sAssetShortName), padded.c_str());
 }
 
+//! A name field up to its first null, without its leading zeros
+static Span<const char> NameSpan(const unsigned char* name, size_t size)
+{
+    const char* begin = reinterpret_cast<const char*>(name);
+    const char* end = std::find(begin, begin + size, '\0');
+    while (begin != end && *begin == '0')
+        ++begin;
+    return Span<const char>(begin, end);
+}
+
 const std::string AssetMetadata::getAssetName() const
 {
-    std::string data (reinterpret_cast<const char *> (sAssetName),
-                     sizeof (sAssetName) / sizeof (sAssetName[0]));
-    data.erase(0, data.find_first_not_of('0'));
-    data.erase(std::find(data.begin(), data.end(), '\0'), data.end());
-    return data;
+    Span<const char> name = getAssetNameSpan();
+    return std::string(name.begin(), name.end());
 }
 
 const std::string AssetMetadata::getShortName() const
 {
-    std::string data (reinterpret_cast<const char *> (sAssetShortName),
-                     sizeof (sAssetShortName) / sizeof (sAssetShortName[0]));
-    data.erase(0, data.find_first_not_of('0'));
-    data.erase(std::find(data.begin(), data.end(), '\0'), data.end());
-    return data;
+    Span<const char> name = getShortNameSpan();
+    return std::string(name.begin(), name.end());
+}
+
+Span<const char> AssetMetadata::getAssetNameSpan() const
+{
+    return NameSpan(sAssetName, sizeof(sAssetName));
+}
+
+Span<const char> AssetMetadata::getShortNameSpan() const
+{
+    return NameSpan(sAssetShortName, sizeof(sAssetShortName));
 }
 
 bool AssetMetadata::isTransferable() const{
@@ -311,6 +332,157 @@ uint256 AssetMetadata::GetMetaHash() const
     return SerializeHash(*this);
 }
 
+bool CAsset::IsIdentical(const CAsset& other) const
+{
+    // interned assets are shared, so identical ones are usually the same object
+    if (this == &other)
+        return true;
+    return assetID == other.assetID &&
+           nVersion == other.nVersion &&
+           nFlags == other.nFlags &&
+           nType == other.nType &&
+           nExpiry == other.nExpiry &&
+           memcmp(sAssetName, other.sAssetName, sizeof(sAssetName)) == 0 &&
+           memcmp(sAssetShortName, other.sAssetShortName, sizeof(sAssetShortName)) == 0 &&
+           contract_url == other.contract_url &&
+           sIssuingaddress == other.sIssuingaddress &&
+           scriptcode == other.scriptcode &&
+           vchAssetSig == other.vchAssetSig;
+}
+
+namespace {
+/**
+ * The interned assets, by asset ID. Assets sharing an ID but differing in any other field are
+ * kept apart so that outputs still serialize byte for byte. Only weak references are held: an
+ * asset is freed with its last output, and expired entries are swept as the table grows, so
+ * the table can't be inflated by transactions which end up rejected.
+ */
+struct AssetInternTable {
+    Mutex mutex;
+    std::map<CAssetID, std::vector<std::weak_ptr<const CAsset>>> mapAssets GUARDED_BY(mutex);
+    size_t nSweepSize GUARDED_BY(mutex){1024};
+    //! Pre-interned assets, never freed so that a pointer to one stays valid without a lock
+    std::vector<std::unique_ptr<const std::shared_ptr<const CAsset>>> vPreInterned GUARDED_BY(mutex);
+    //! The last pre-interned asset, matched before the table is locked
+    std::atomic<const std::shared_ptr<const CAsset>*> pFastPath{nullptr};
+
+    void Sweep() EXCLUSIVE_LOCKS_REQUIRED(mutex)
+    {
+        for (auto it = mapAssets.begin(); it != mapAssets.end();) {
+            auto& vec = it->second;
+            vec.erase(std::remove_if(vec.begin(), vec.end(), [](const std::weak_ptr<const CAsset>& p) { return p.expired(); }), vec.end());
+            if (vec.empty())
+                it = mapAssets.erase(it);
+            else
+                ++it;
+        }
+        nSweepSize = std::max<size_t>(1024, mapAssets.size() * 2);
+    }
+};
+
+size_t AssetDynamicUsage(const CAsset& asset)
+{
+    // strings past the small string buffer of libstdc++ are allocated
+    auto string_usage = [](const std::string& str) { return str.capacity() > 15 ? memusage::MallocUsage(str.capacity() + 1) : 0; };
+    return memusage::MallocUsage(sizeof(CAsset)) + memusage::MallocUsage(sizeof(memusage::stl_shared_counter)) +
+           string_usage(asset.contract_url) + string_usage(asset.sIssuingaddress) +
+           memusage::DynamicUsage(asset.scriptcode) + memusage::DynamicUsage(asset.vchAssetSig);
+}
+
+AssetInternTable& GetAssetInternTable()
+{
+    static AssetInternTable table;
+    return table;
+}
+} // namespace
+
+const CAsset& CAssetHandle::NullAsset()
+{
+    static const CAsset null_asset;
+    return null_asset;
+}
+
+std::shared_ptr<const CAsset> CAssetHandle::Intern(const CAsset& asset)
+{
+    AssetInternTable& table = GetAssetInternTable();
+    const std::shared_ptr<const CAsset>* pFastPath = table.pFastPath.load(std::memory_order_acquire);
+    if (pFastPath && (*pFastPath)->IsIdentical(asset))
+        return *pFastPath;
+
+    if (asset.IsIdentical(NullAsset()))
+        return nullptr;
+
+    LOCK(table.mutex);
+
+    auto& vec = table.mapAssets[asset.assetID];
+    std::weak_ptr<const CAsset>* pExpired = nullptr;
+    for (auto& weak : vec) {
+        std::shared_ptr<const CAsset> interned = weak.lock();
+        if (!interned)
+            pExpired = &weak;
+        else if (interned->IsIdentical(asset))
+            return interned;
+    }
+
+    // not make_shared: the asset must be freed with its last reference, not with the last weak one
+    std::shared_ptr<const CAsset> interned(new CAsset(asset));
+    if (pExpired)
+        *pExpired = interned;
+    else
+        vec.push_back(interned);
+
+    if (table.mapAssets.size() >= table.nSweepSize)
+        table.Sweep();
+
+    return interned;
+}
+
+void CAssetHandle::PreIntern(const CAsset& asset)
+{
+    std::shared_ptr<const CAsset> interned = Intern(asset);
+    if (!interned)
+        return;
+
+    AssetInternTable& table = GetAssetInternTable();
+    LOCK(table.mutex);
+    for (const auto& pPreInterned : table.vPreInterned) {
+        if (*pPreInterned == interned) {
+            table.pFastPath.store(pPreInterned.get(), std::memory_order_release);
+            return;
+        }
+    }
+    table.vPreInterned.emplace_back(new std::shared_ptr<const CAsset>(std::move(interned)));
+    table.pFastPath.store(table.vPreInterned.back().get(), std::memory_order_release);
+}
+
+size_t CAssetHandle::InternedCount()
+{
+    AssetInternTable& table = GetAssetInternTable();
+    LOCK(table.mutex);
+    size_t nCount = 0;
+    for (const auto& item : table.mapAssets) {
+        for (const auto& weak : item.second)
+            nCount += !weak.expired();
+    }
+    return nCount;
+}
+
+size_t CAssetHandle::DynamicMemoryUsage()
+{
+    AssetInternTable& table = GetAssetInternTable();
+    LOCK(table.mutex);
+    size_t nUsage = memusage::DynamicUsage(table.mapAssets) + memusage::DynamicUsage(table.vPreInterned) +
+                    memusage::MallocUsage(sizeof(std::shared_ptr<const CAsset>)) * table.vPreInterned.size();
+    for (const auto& item : table.mapAssets) {
+        nUsage += memusage::DynamicUsage(item.second);
+        for (const auto& weak : item.second) {
+            if (std::shared_ptr<const CAsset> interned = weak.lock())
+                nUsage += AssetDynamicUsage(*interned);
+        }
+    }
+    return nUsage;
+}
+
 uint256 CAsset::GetHashWithoutSign() const
 {
     CHashWriter ss(SER_GETHASH, PROTOCOL_VERSION);
@@ -393,7 +565,7 @@ CAmountMap operator/(const CAmountMap& a, const CAmountMap& b)
     return c;
 }
 
-std::string AssetTypeToString(uint32_t &type){
+std::string AssetTypeToString(uint32_t type){
     std::string ret;
     switch(type){
         case AssetMetadata::TOKEN   :
@@ -6,7 +6,12 @@
 
 #include <amount.h>
 #include <script/script.h>
+#include <span.h>
 #include <tinyformat.h>
+
+#include <memory>
+#include <vector>
+
 /**
  *  Native Asset Issuance
  *
@@ -87,6 +92,9 @@ public:
 
     const std::string getAssetName() const;
     const std::string getShortName() const;
+    //! The same names, without building a string
+    Span<const char> getAssetNameSpan() const;
+    Span<const char> getShortNameSpan() const;
 
     bool isTransferable() const;
 
@@ -189,6 +197,76 @@ struct CAsset : public AssetMetadata
     }
 
     std::string ToString(bool mini = true) const;
+
+    /** Whether every field matches, unlike operator== which only compares the asset ID */
+    bool IsIdentical(const CAsset& other) const;
+};
+
+/**
+ * Reference to an interned, immutable CAsset.
+ *
+ * Every output of an asset serializes the same metadata, so outputs (and therefore coins and the
+ * coins cache) point to one shared copy per distinct asset instead of owning its strings, script
+ * and signature. A null handle stands for the null asset. Reading converts to const CAsset&,
+ * assigning a CAsset interns it. Serializes exactly like the CAsset it refers to.
+ */
+class CAssetHandle
+{
+private:
+    std::shared_ptr<const CAsset> ptr;
+
+    static std::shared_ptr<const CAsset> Intern(const CAsset& asset);
+
+public:
+    static const CAsset& NullAsset();
+
+    CAssetHandle() = default;
+    explicit CAssetHandle(const CAsset& asset) : ptr(Intern(asset)) {}
+
+    CAssetHandle& operator=(const CAsset& asset)
+    {
+        ptr = Intern(asset);
+        return *this;
+    }
+
+    const CAsset& get() const { return ptr ? *ptr : NullAsset(); }
+    operator const CAsset&() const { return get(); }
+    const CAsset* operator->() const { return &get(); }
+
+    void SetNull() { ptr.reset(); }
+
+    template <typename Stream>
+    void Serialize(Stream& s) const
+    {
+        s << get();
+    }
+
+    template <typename Stream>
+    void Unserialize(Stream& s)
+    {
+        CAsset asset;
+        s >> asset;
+        ptr = Intern(asset);
+    }
+
+    friend bool operator==(const CAssetHandle& a, const CAssetHandle& b)
+    {
+        return a.ptr == b.ptr || a.get() == b.get();
+    }
+
+    friend bool operator!=(const CAssetHandle& a, const CAssetHandle& b)
+    {
+        return !(a == b);
+    }
+
+    /** Intern asset for good, and match it before the intern table is locked. For the subsidy asset */
+    static void PreIntern(const CAsset& asset);
+
+    /** Number of distinct assets currently interned */
+    static size_t InternedCount();
+
+    /** Memory held by the interned assets and their table, which the outputs only point to */
+    static size_t DynamicMemoryUsage();
 };
 
 /** Used for consensus fee and general wallet accounting*/
@@ -277,6 +355,6 @@ inline std::string mapToString(CAmountMap& map)
 
 CAmount valueFor(const CAmountMap& mapValue, const CAsset& asset);
 CAmount convertfloor(CAsset &a, CAsset &b);
-std::string AssetTypeToString(uint32_t &type);
+std::string AssetTypeToString(uint32_t type);
 
 #endif //  CROWN_AMOUNT_H
@@ -55,7 +55,7 @@ bool IsValidTypeAndVersion(int nVersion, int nType)
     return false;
 }
 
-bool ExtractCoinStakeInt64(const std::vector<uint8_t> &vData, DataOutputTypes get_type, CAmount &out)
+bool ExtractCoinStakeInt64(Span<const uint8_t> vData, DataOutputTypes get_type, CAmount &out)
 {
     if (vData.size() < 5) { // First 4 bytes will be height
         return false;
@@ -85,7 +85,7 @@ bool ExtractCoinStakeInt64(const std::vector<uint8_t> &vData, DataOutputTypes ge
     return false;
 }
 
-bool ExtractCoinStakeUint32(const std::vector<uint8_t> &vData, DataOutputTypes get_type, uint32_t &out)
+bool ExtractCoinStakeUint32(Span<const uint8_t> vData, DataOutputTypes get_type, uint32_t &out)
 {
     if (vData.size() < 5) { // First 4 bytes will be height
         return false;
@@ -189,7 +189,7 @@ std::string CTxOut::ToString() const
 
 std::string CTxOutAsset::ToString() const
 {
-    return strprintf("CTxOutAsset \n%s \n(nValue=%s, scriptPubKey=%s)\n", nAsset.ToString(false), strprintf("%d.%08d", nValue / COIN, nValue % COIN), scriptPubKey.ToString());
+    return strprintf("CTxOutAsset \n%s \n(nValue=%s, scriptPubKey=%s)\n", nAsset->ToString(false), strprintf("%d.%08d", nValue / COIN, nValue % COIN), scriptPubKey.ToString());
 }
 
 std::string CTxDataBase::ToString() const
@@ -229,32 +229,8 @@ std::string CTxData::ToString() const
     return strprintf("CTxData(%s)\n", HexStr(vData));
 }
 
-void DeepCopy(CTxDataBaseRef &to, const CTxDataBaseRef &from)
-{
-    switch (from->GetVersion()) {
-        case OUTPUT_DATA:
-            to = MAKE_OUTPUT<CTxData>();
-            *((CTxData*)to.get()) = *((CTxData*)from.get());
-            break;
-        default:
-            break;
-    }
-    return;
-}
-
-std::vector<CTxDataBaseRef> DeepCopy(const std::vector<CTxDataBaseRef> &from)
-{
-    std::vector<CTxDataBaseRef> vdata;
-    vdata.resize(from.size());
-    for (size_t i = 0; i < from.size(); ++i) {
-        DeepCopy(vdata[i], from[i]);
-    }
-
-    return vdata;
-}
-
 CMutableTransaction::CMutableTransaction() : nTime(GetTime()), nVersion(CTransaction::CURRENT_VERSION), nType(TRANSACTION_NORMAL), nLockTime(0) {}
-CMutableTransaction::CMutableTransaction(const CTransaction& tx) : nTime(tx.nTime), vin(tx.vin), vout(tx.vout), vpout(tx.vpout), vdata{DeepCopy(tx.vdata)}, nVersion(tx.nVersion), nType(tx.nType), nLockTime(tx.nLockTime), extraPayload(tx.extraPayload), witness(tx.witness) {}
+CMutableTransaction::CMutableTransaction(const CTransaction& tx) : nTime(tx.nTime), vin(tx.vin), vout(tx.vout), vpout(tx.vpout), vdata(tx.vdata), nVersion(tx.nVersion), nType(tx.nType), nLockTime(tx.nLockTime), extraPayload(tx.extraPayload), witness(tx.witness) {}
 
 uint256 CMutableTransaction::GetHash() const
 {
@@ -292,7 +268,7 @@ uint256 CTransaction::GetWitnessOnlyHash() const
 
 /* For backward compatibility, the hash is initialized to 0. TODO: remove the need for this default constructor entirely. */
 CTransaction::CTransaction() :  nTime(0), vin(), vout(), nVersion(CTransaction::CURRENT_VERSION), nType(TRANSACTION_NORMAL), nLockTime(0), hash{}, m_witness_hash{} {}
-CTransaction::CTransaction(const CMutableTransaction& tx) : nTime(tx.nTime), vin(tx.vin), vout(tx.vout), vpout(tx.vpout), vdata{DeepCopy(tx.vdata)}, nVersion(tx.nVersion), nType(tx.nType), nLockTime(tx.nLockTime), extraPayload(tx.extraPayload), witness(tx.witness), hash{ComputeHash()}, m_witness_hash{ComputeWitnessHash()} {ComputeHash();}
+CTransaction::CTransaction(const CMutableTransaction& tx) : nTime(tx.nTime), vin(tx.vin), vout(tx.vout), vpout(tx.vpout), vdata(tx.vdata), nVersion(tx.nVersion), nType(tx.nType), nLockTime(tx.nLockTime), extraPayload(tx.extraPayload), witness(tx.witness), hash{ComputeHash()}, m_witness_hash{ComputeWitnessHash()} {ComputeHash();}
 CTransaction::CTransaction(CMutableTransaction&& tx) : nTime(tx.nTime), vin(std::move(tx.vin)), vout(std::move(tx.vout)), vpout(std::move(tx.vpout)), vdata(std::move(tx.vdata)), nVersion(tx.nVersion), nType(tx.nType), nLockTime(tx.nLockTime), extraPayload(tx.extraPayload), witness(std::move(tx.witness)), hash{ComputeHash()}, m_witness_hash{ComputeWitnessHash()} {ComputeHash();}
 
 CAmount CTransaction::GetValueOut() const
@@ -322,9 +298,9 @@ CAmount CTransaction::GetTotalSMSGFees() const
 {
     CAmount smsg_fees = 0;
     for (const auto &v : vdata) {
-        if (!v->IsVersion(OUTPUT_DATA))
+        const CTxData *txd = v.GetIf<CTxData>();
+        if (!txd)
             continue;
-        CTxData *txd = (CTxData*) v.get();
         if (txd->vData.size() < 25 || txd->vData[0] != DO_FUND_MSG)
             continue;
         size_t n = (txd->vData.size()-1) / 24;
@@ -448,7 +424,7 @@ bool HasValidFee(const CTransaction& tx) {
     CAmountMap totalFee;
 
     for (unsigned int k = 0; k < (tx.nVersion >= TX_ELE_VERSION ? tx.vpout.size() : tx.vout.size()) ; k++){
-        const CTxOutAsset &txout = (tx.nVersion >= TX_ELE_VERSION ? tx.vpout[k] : tx.vout[k]);
+        const CTxOutRef txout = tx.GetOutputs()[k];
         CAmount fee = 0;
         if (txout.IsFee()) {
             fee = txout.nValue;
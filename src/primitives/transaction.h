@@ -10,6 +10,7 @@
 #include <primitives/txdata.h>
 #include <primitives/asset.h>
 #include <primitives/txwitness.h>
+#include <iterator>
 #include <tuple>
 
 #define TX_NFT_VERSION 3
@@ -177,7 +178,7 @@ public:
         this->scriptPubKey=out.scriptPubKey;
     }
     int16_t nVersion;
-    CAsset nAsset;
+    CAssetHandle nAsset;
 
     SERIALIZE_METHODS(CTxOutAsset, obj) { READWRITE(obj.nValue, obj.scriptPubKey, obj.nVersion, obj.nAsset);}
 
@@ -232,6 +233,79 @@ public:
 };
 
 
+/**
+ * Non-owning reference to an output of a transaction, in vout or in vpout.
+ *
+ * Outputs in vout have no asset; for them nAsset is the null asset, as in a CTxOutAsset
+ * converted from the CTxOut.
+ */
+class CTxOutRef
+{
+public:
+    const CAmount& nValue;
+    const CScript& scriptPubKey;
+    const CAsset& nAsset;
+    int16_t nVersion;
+
+    explicit CTxOutRef(const CTxOut& out) : nValue(out.nValue), scriptPubKey(out.scriptPubKey), nAsset(CAssetHandle::NullAsset()), nVersion(0) {}
+    explicit CTxOutRef(const CTxOutAsset& out) : nValue(out.nValue), scriptPubKey(out.scriptPubKey), nAsset(out.nAsset), nVersion(out.nVersion) {}
+
+    //! Serializes as the CTxOutAsset it stands for
+    template <typename Stream>
+    void Serialize(Stream& s) const
+    {
+        s << nValue << scriptPubKey << nVersion << nAsset;
+    }
+
+    bool IsNull() const { return nValue == -1; }
+    bool IsFee() const { return scriptPubKey == CScript() && nValue > 0; }
+};
+
+/**
+ * The outputs of a transaction, vpout from TX_ELE_VERSION and vout before it, without copying them.
+ */
+class CTxOutsView
+{
+private:
+    const std::vector<CTxOut>* m_vout;
+    const std::vector<CTxOutAsset>* m_vpout;
+
+public:
+    class const_iterator
+    {
+    private:
+        const std::vector<CTxOut>* m_vout;
+        const std::vector<CTxOutAsset>* m_vpout;
+        size_t m_pos;
+
+    public:
+        typedef std::input_iterator_tag iterator_category;
+        typedef CTxOutRef value_type;
+        typedef std::ptrdiff_t difference_type;
+        typedef const value_type* pointer;
+        typedef CTxOutRef reference;
+
+        const_iterator(const CTxOutsView& view, size_t pos) : m_vout(view.m_vout), m_vpout(view.m_vpout), m_pos(pos) {}
+        CTxOutRef operator*() const { return m_vpout ? CTxOutRef((*m_vpout)[m_pos]) : CTxOutRef((*m_vout)[m_pos]); }
+        const_iterator& operator++() { ++m_pos; return *this; }
+        bool operator==(const const_iterator& other) const { return m_pos == other.m_pos; }
+        bool operator!=(const const_iterator& other) const { return m_pos != other.m_pos; }
+    };
+
+    CTxOutsView(const std::vector<CTxOut>& vout, const std::vector<CTxOutAsset>& vpout, bool fAssets) :
+        m_vout(fAssets ? nullptr : &vout), m_vpout(fAssets ? &vpout : nullptr) {}
+
+    size_t size() const { return m_vpout ? m_vpout->size() : m_vout->size(); }
+    bool empty() const { return size() == 0; }
+
+    CTxOutRef operator[](size_t i) const { return m_vpout ? CTxOutRef((*m_vpout)[i]) : CTxOutRef((*m_vout)[i]); }
+    CTxOutRef at(size_t i) const { return m_vpout ? CTxOutRef(m_vpout->at(i)) : CTxOutRef(m_vout->at(i)); }
+
+    const_iterator begin() const { return const_iterator(*this, 0); }
+    const_iterator end() const { return const_iterator(*this, size()); }
+};
+
+
 struct CMutableTransaction;
 
 /**
@@ -280,14 +354,14 @@ inline void UnserializeTransaction(TxType& tx, Stream& s) {
         s >> tx.vin;
         s >> tx.vpout;
         s >> tx.nLockTime;
+        // not reserved for: the count comes from the peer, each output is checked as it is read
         size_t nOutputs = ReadCompactSize(s);
-        tx.vdata.reserve(nOutputs);
         for (size_t k = 0; k < nOutputs; ++k) {
             uint8_t bv;
             s >> bv;
             switch (bv) {
                 case OUTPUT_DATA:
-                    tx.vdata.push_back(MAKE_OUTPUT<CTxData>());
+                    tx.vdata.emplace_back(CTxData());
                     break;
                 default:
                     throw std::ios_base::failure("Unknown transaction output type");
@@ -380,7 +454,7 @@ public:
     const std::vector<CTxIn> vin;
     const std::vector<CTxOut> vout;
     const std::vector<CTxOutAsset> vpout;
-    const std::vector<CTxDataBaseRef> vdata;
+    const std::vector<CTxDataOutput> vdata;
     const int16_t nVersion;
     const int16_t nType;
     const uint32_t nLockTime;
@@ -423,6 +497,12 @@ public:
         return nVersion >= TX_ELE_VERSION ? vpout.size() : vout.size();
     }
 
+    //! The outputs, in vpout or vout according to nVersion
+    CTxOutsView GetOutputs() const
+    {
+        return CTxOutsView(vout, vpout, nVersion >= TX_ELE_VERSION);
+    }
+
     const uint256& GetHash() const { return hash; }
     const uint256& GetWitnessHash() const { return m_witness_hash; };
     // ELEMENTS: the witness only hash used in elements witness roots
@@ -473,7 +553,7 @@ struct CMutableTransaction
     std::vector<CTxIn> vin;
     std::vector<CTxOut> vout;
     std::vector<CTxOutAsset> vpout;
-    std::vector<CTxDataBaseRef> vdata;
+    std::vector<CTxDataOutput> vdata;
     int16_t nVersion;
     int16_t nType;
     uint32_t nLockTime;
@@ -504,6 +584,12 @@ struct CMutableTransaction
         return nVersion >= TX_ELE_VERSION ? vpout.size() : vout.size();
     }
 
+    //! The outputs, in vpout or vout according to nVersion
+    CTxOutsView GetOutputs() const
+    {
+        return CTxOutsView(vout, vpout, nVersion >= TX_ELE_VERSION);
+    }
+
     /** Compute the hash of this CMutableTransaction. This is computed on the
      * fly, as opposed to GetHash() in CTransaction, which uses a cached result.
      */
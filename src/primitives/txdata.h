@@ -3,11 +3,15 @@
 
 #include <script/script.h>
 
+#include <prevector.h>
 #include <serialize.h>
+#include <span.h>
 #include <uint256.h>
 #include <pubkey.h>
 #include <amount.h>
 
+#include <variant>
+
 class CTxData;
 
 enum DataTypes
@@ -27,8 +31,14 @@ enum DataOutputTypes
     DO_SMSG_DIFFICULTY      = 3,
 };
 
-bool ExtractCoinStakeInt64(const std::vector<uint8_t> &vData, DataOutputTypes get_type, CAmount &out);
-bool ExtractCoinStakeUint32(const std::vector<uint8_t> &vData, DataOutputTypes get_type, uint32_t &out);
+/**
+ * Payload of a data output. Coinstake data (height, smsg fee rate and
+ * difficulty) never exceeds 20 bytes, so it is kept inline.
+ */
+typedef prevector<24, uint8_t> CTxDataBytes;
+
+bool ExtractCoinStakeInt64(Span<const uint8_t> vData, DataOutputTypes get_type, CAmount &out);
+bool ExtractCoinStakeUint32(Span<const uint8_t> vData, DataOutputTypes get_type, uint32_t &out);
 
 std::string dataTypeToString(DataTypes &dt);
 
@@ -62,8 +72,8 @@ public:
         return nVersion == _nVersion;
     }
 
-    virtual std::vector<uint8_t> *GetPData() { return nullptr; };
-    virtual const std::vector<uint8_t> *GetPData() const { return nullptr; };
+    virtual CTxDataBytes *GetPData() { return nullptr; };
+    virtual const CTxDataBytes *GetPData() const { return nullptr; };
 
     virtual bool GetSmsgFeeRate(CAmount &nCfwd) const { return false; };
     virtual bool GetSmsgDifficulty(uint32_t &compact) const { return false; };
@@ -79,18 +89,14 @@ public:
     std::string ToString() const;
 };
 
-#define OUTPUT_PTR std::shared_ptr
-typedef OUTPUT_PTR<CTxDataBase> CTxDataBaseRef;
-#define MAKE_OUTPUT std::make_shared
-
 class CTxData : public CTxDataBase
 {
 public:
     CTxData() : CTxDataBase(OUTPUT_DATA) {};
-    explicit CTxData(const std::vector<uint8_t> &vData_) : CTxDataBase(OUTPUT_DATA), vData(vData_) {};
+    explicit CTxData(const std::vector<uint8_t> &vData_) : CTxDataBase(OUTPUT_DATA), vData(vData_.begin(), vData_.end()) {};
 
     uint8_t nType;
-    std::vector<uint8_t> vData;
+    CTxDataBytes vData;
 
     SERIALIZE_METHODS(CTxData, obj) { READWRITE(obj.nType, obj.vData); }
 
@@ -104,11 +110,11 @@ public:
         return ExtractCoinStakeUint32(vData, DO_SMSG_DIFFICULTY, compact);
     }
 
-    std::vector<uint8_t> *GetPData() override
+    CTxDataBytes *GetPData() override
     {
         return &vData;
     }
-    const std::vector<uint8_t> *GetPData() const override
+    const CTxDataBytes *GetPData() const override
     {
         return &vData;
     }
@@ -138,4 +144,40 @@ public:
     std::string ToString() const;
 };
 
+/**
+ * A data output stored inline in its transaction. The set of data output
+ * types is small and fixed, so they are held in a variant instead of behind
+ * a shared_ptr each, which saves an allocation and an atomic refcount per
+ * output whenever a block or transaction is deserialized.
+ */
+class CTxDataOutput
+{
+private:
+    std::variant<CTxData> m_data;
+
+public:
+    CTxDataOutput() = default;
+    CTxDataOutput(CTxData data) : m_data(std::move(data)) {};
+
+    CTxDataBase *get()
+    {
+        return std::visit([](CTxDataBase &data) { return &data; }, m_data);
+    }
+    const CTxDataBase *get() const
+    {
+        return std::visit([](const CTxDataBase &data) { return &data; }, m_data);
+    }
+
+    CTxDataBase *operator->() { return get(); }
+    const CTxDataBase *operator->() const { return get(); }
+    CTxDataBase &operator*() { return *get(); }
+    const CTxDataBase &operator*() const { return *get(); }
+
+    //! The output as type T, or nullptr if it holds another type
+    template <typename T>
+    T *GetIf() { return std::get_if<T>(&m_data); }
+    template <typename T>
+    const T *GetIf() const { return std::get_if<T>(&m_data); }
+};
+
 #endif
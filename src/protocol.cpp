@@ -8,6 +8,8 @@
 #include <util/strencodings.h>
 #include <util/system.h>
 
+#include <map>
+
 static std::atomic<bool> g_initial_block_download_completed(false);
 
 namespace NetMsgType {
@@ -51,6 +53,7 @@ const char *SMSGPING = "smsgPing";
 const char *SMSGPONG = "smsgPong";
 const char *SMSGDISABLED = "smsgDisabled";
 const char *SMSGSHOW = "smsgShow";
+const char *SMSGSHOWRANGES = "smsgShowRng";
 const char *SMSGMATCH = "smsgMatch";
 const char *SMSGHAVE = "smsgHave";
 const char *SMSGWANT = "smsgWant";
@@ -154,6 +157,7 @@ const static std::string allNetMessageTypes[] = {
     NetMsgType::SMSGPONG,
     NetMsgType::SMSGDISABLED,
     NetMsgType::SMSGSHOW,
+    NetMsgType::SMSGSHOWRANGES,
     NetMsgType::SMSGMATCH,
     NetMsgType::SMSGHAVE,
     NetMsgType::SMSGWANT,
@@ -317,6 +321,82 @@ const std::vector<std::string> &getAllNetMessageTypes()
     return allNetMessageTypesVec;
 }
 
+static const std::map<std::string, MessageClass> mapMessageClasses = {
+    {NetMsgType::BLOCK, MessageClass::BLOCK},
+    {NetMsgType::HEADERS, MessageClass::BLOCK},
+    {NetMsgType::CMPCTBLOCK, MessageClass::BLOCK},
+    {NetMsgType::BLOCKTXN, MessageClass::BLOCK},
+    {NetMsgType::MERKLEBLOCK, MessageClass::BLOCK},
+    {NetMsgType::BLOCKPROOF, MessageClass::BLOCK},
+    {NetMsgType::TX, MessageClass::TX},
+    {NetMsgType::BUDGETPROPOSAL, MessageClass::GOSSIP},
+    {NetMsgType::BUDGETVOTE, MessageClass::GOSSIP},
+    {NetMsgType::BUDGETVOTESYNC, MessageClass::GOSSIP},
+    {NetMsgType::DSEEP, MessageClass::GOSSIP},
+    {NetMsgType::DSEG, MessageClass::GOSSIP},
+    {NetMsgType::DSTX, MessageClass::GOSSIP},
+    {NetMsgType::FINALBUDGET, MessageClass::GOSSIP},
+    {NetMsgType::FINALBUDGETVOTE, MessageClass::GOSSIP},
+    {NetMsgType::GETMNWINNERS, MessageClass::GOSSIP},
+    {NetMsgType::GETSNWINNERS, MessageClass::GOSSIP},
+    {NetMsgType::GETSPORKS, MessageClass::GOSSIP},
+    {NetMsgType::IX, MessageClass::GOSSIP},
+    {NetMsgType::IXLOCKLIST, MessageClass::GOSSIP},
+    {NetMsgType::IXLOCKVOTE, MessageClass::GOSSIP},
+    {NetMsgType::MNBROADCAST, MessageClass::GOSSIP},
+    {NetMsgType::MNBROADCAST2, MessageClass::GOSSIP},
+    {NetMsgType::MNPING, MessageClass::GOSSIP},
+    {NetMsgType::MNPING2, MessageClass::GOSSIP},
+    {NetMsgType::MNSYNCSTATUS, MessageClass::GOSSIP},
+    {NetMsgType::MNWINNER, MessageClass::GOSSIP},
+    {NetMsgType::SNBROADCAST, MessageClass::GOSSIP},
+    {NetMsgType::SNPING, MessageClass::GOSSIP},
+    {NetMsgType::SNWINNER, MessageClass::GOSSIP},
+    {NetMsgType::SNDSEG, MessageClass::GOSSIP},
+    {NetMsgType::SNSYNCSTATUS, MessageClass::GOSSIP},
+    {NetMsgType::SPORK, MessageClass::GOSSIP},
+    {NetMsgType::SMSGIGNORE, MessageClass::SMSG},
+    {NetMsgType::SMSGPING, MessageClass::SMSG},
+    {NetMsgType::SMSGPONG, MessageClass::SMSG},
+    {NetMsgType::SMSGDISABLED, MessageClass::SMSG},
+    {NetMsgType::SMSGSHOW, MessageClass::SMSG},
+    {NetMsgType::SMSGSHOWRANGES, MessageClass::SMSG},
+    {NetMsgType::SMSGMATCH, MessageClass::SMSG},
+    {NetMsgType::SMSGHAVE, MessageClass::SMSG},
+    {NetMsgType::SMSGWANT, MessageClass::SMSG},
+    {NetMsgType::SMSGMSG, MessageClass::SMSG},
+    {NetMsgType::SMSGINV, MessageClass::SMSG},
+};
+
+MessageClass GetMessageClass(const std::string& msg_type)
+{
+    auto it = mapMessageClasses.find(msg_type);
+    return it != mapMessageClasses.end() ? it->second : MessageClass::CONTROL;
+}
+
+std::string MessageClassToString(MessageClass msg_class)
+{
+    switch (msg_class) {
+    case MessageClass::CONTROL: return "control";
+    case MessageClass::BLOCK: return "block";
+    case MessageClass::TX: return "tx";
+    case MessageClass::GOSSIP: return "gossip";
+    case MessageClass::SMSG: return "smsg";
+    } // no default case, so the compiler can warn about missing cases
+    assert(false);
+}
+
+bool MessageClassFromString(const std::string& str, MessageClass& msg_class)
+{
+    for (size_t i = 0; i < MESSAGE_CLASS_COUNT; i++) {
+        if (str == MessageClassToString(MessageClass(i))) {
+            msg_class = MessageClass(i);
+            return true;
+        }
+    }
+    return false;
+}
+
 /**
  * Convert a service flag (NODE_*) to a human readable string.
  * It supports unknown service flags which will be returned as "UNKNOWN[...]".
@@ -273,6 +273,7 @@ extern const char *SMSGPING;
 extern const char *SMSGPONG;
 extern const char *SMSGDISABLED;
 extern const char *SMSGSHOW;
+extern const char *SMSGSHOWRANGES;
 extern const char *SMSGMATCH;
 extern const char *SMSGHAVE;
 extern const char *SMSGWANT;
@@ -312,6 +313,20 @@ extern const char* BLOCKPROOF;
 /* Get a vector of all valid message types (see above) */
 const std::vector<std::string>& getAllNetMessageTypes();
 
+/** Classes of received messages, each processed from its own queue */
+enum class MessageClass : uint8_t {
+    CONTROL, //!< Handshake, addresses, inventory, requests and unknown types, always processed first
+    BLOCK,   //!< Blocks, headers and compact blocks
+    TX,      //!< Transactions
+    GOSSIP,  //!< Masternode, systemnode, budget, instantsend and spork messages
+    SMSG,    //!< Secure messages
+};
+static const size_t MESSAGE_CLASS_COUNT = 5;
+
+MessageClass GetMessageClass(const std::string& msg_type);
+std::string MessageClassToString(MessageClass msg_class);
+bool MessageClassFromString(const std::string& str, MessageClass& msg_class);
+
 /** nServices flags */
 enum ServiceFlags : uint64_t {
     // NOTE: When adding here, be sure to update serviceFlagToStr too
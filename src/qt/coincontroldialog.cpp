@@ -626,7 +626,7 @@ void CoinControlDialog::updateView()
             const COutPoint& output = std::get<0>(outpair);
             const interfaces::WalletTxOut& out = std::get<1>(outpair);
             nSum += out.txout.nValue;
-            sAsset = QString::fromStdString(out.txout.nAsset.getAssetName());
+            sAsset = QString::fromStdString(out.txout.nAsset->getAssetName());
             nChildren++;
             CCoinControlWidgetItem *itemOutput;
             if (treeMode)    itemOutput = new CCoinControlWidgetItem(itemWalletAddress);
@@ -88,7 +88,7 @@ public:
                 
                 rec.address = sAddress;
                 rec.label = sLabel;
-                std::string assetname =out.txout.nAsset.getShortName();
+                std::string assetname =out.txout.nAsset->getShortName();
                 CAmount assetamount = out.txout.nValue;
                                                    
                 rec.asset = QString::fromStdString(assetname);
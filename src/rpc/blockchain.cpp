@@ -1099,6 +1099,10 @@ static RPCHelpMan gettxoutsetinfo()
                         {RPCResult::Type::STR_HEX, "hash_serialized_2", "The serialized hash (only present if 'hash_serialized_2' hash_type is chosen)"},
                         {RPCResult::Type::NUM, "disk_size", "The estimated size of the chainstate on disk"},
                         {RPCResult::Type::STR_AMOUNT, "total_amount", "The total amount"},
+                        {RPCResult::Type::OBJ_DYN, "total_amount_by_asset", "The total amount per asset",
+                        {
+                            {RPCResult::Type::STR_AMOUNT, "asset", "The total amount of the asset"},
+                        }},
                     }},
                 RPCExamples{
                     HelpExampleCli("gettxoutsetinfo", "")
@@ -1126,6 +1130,9 @@ static RPCHelpMan gettxoutsetinfo()
         }
         ret.pushKV("disk_size", stats.nDiskSize);
         ret.pushKV("total_amount", ValueFromAmount(stats.nTotalAmount));
+        UniValue assets(UniValue::VOBJ);
+        AmountMapToUniv(stats.mapTotalAmount, assets);
+        ret.pushKV("total_amount_by_asset", assets);
     } else {
         throw JSONRPCError(RPC_INTERNAL_ERROR, "Unable to read UTXO set");
     }
@@ -1968,7 +1975,7 @@ static RPCHelpMan getblockstats()
         CAmountMap tx_total_out;
         if (loop_outputs) {
             for (size_t o = 0; o < (tx->nVersion >= TX_ELE_VERSION ? tx->vpout.size() : tx->vout.size()); o++) {
-                const CTxOutAsset &out = (tx->nVersion >= TX_ELE_VERSION ? tx->vpout[o] : tx->vout[o]);
+                const CTxOutRef out = tx->GetOutputs()[o];
                 tx_total_out[out.nAsset] += out.nValue;
                 utxo_size_inc += GetSerializeSize(out, PROTOCOL_VERSION) + PER_UTXO_OVERHEAD;
             }
@@ -4,6 +4,9 @@
 #include <key_io.h>
 #include <logging.h>
 #include <assetdb.h>
+#include <node/coinstats.h>
+#include <shutdown.h>
+#include <txdb.h>
 
 #include <rpc/rawtransaction_util.h>
 #include <rpc/util.h>
@@ -187,6 +190,29 @@ static RPCHelpMan convertasset()
     };
 }
 
+//! Unspent amount of asset, counting the untagged outputs of pre-asset transactions as the subsidy asset
+static CAmount GetAssetSupply(const CAmountMap& supply, const CAsset& asset)
+{
+    CAmount nSupply = 0;
+    auto it = supply.find(asset);
+    if (it != supply.end()) nSupply += it->second;
+    if (asset == GetSubsidyAsset()) {
+        it = supply.find(CAsset());
+        if (it != supply.end()) nSupply += it->second;
+    }
+    return nSupply;
+}
+
+static CAmountMap GetTipAssetSupply()
+{
+    LOCK(cs_main);
+    CAmountMap supply;
+    if (!::ChainstateActive().CoinsTip().GetAssetSupply(supply)) {
+        throw JSONRPCError(RPC_INTERNAL_ERROR, "Asset supply is not available");
+    }
+    return supply;
+}
+
 static RPCHelpMan getasset()
 {
     return RPCHelpMan{"getasset",
@@ -210,6 +236,7 @@ static RPCHelpMan getasset()
     UniValue result(UniValue::VOBJ);
 
     AssetToUniv(asset,result);
+    result.pushKV("supply", ValueFromAmount(GetAssetSupply(GetTipAssetSupply(), asset.asset)));
 
     return result;
 },
@@ -234,11 +261,13 @@ static RPCHelpMan getassets()
         [&](const RPCHelpMan& self, const JSONRPCRequest& request) -> UniValue
 {
     std::vector<CAsset> allassets = ::GetAllAssets();
+    CAmountMap supply = GetTipAssetSupply();
 
     UniValue result(UniValue::VARR);
     for(auto asset : allassets){
         UniValue entry(UniValue::VOBJ);
         AssetToUniv(asset,entry);
+        entry.pushKV("supply", ValueFromAmount(GetAssetSupply(supply, asset)));
         result.push_back(entry);
     }
 
@@ -247,6 +276,84 @@ static RPCHelpMan getassets()
     };
 }
 
+static RPCHelpMan verifyassetsupply()
+{
+    return RPCHelpMan{"verifyassetsupply",
+                "\n  Compare the tracked asset supply with a full scan of the UTXO set. This call may take some time.\n",
+                {
+                },
+                RPCResult{
+                    RPCResult::Type::OBJ, "", "", {
+                        {RPCResult::Type::NUM, "height", "The block height the supply was verified at"},
+                        {RPCResult::Type::STR_HEX, "bestblock", "The block hash the supply was verified at"},
+                        {RPCResult::Type::BOOL, "valid", "Whether the tracked supply matches the scan"},
+                        {RPCResult::Type::ARR, "mismatches", "Assets with a different supply", {
+                            {RPCResult::Type::OBJ, "", "", {
+                                {RPCResult::Type::STR, "asset", "The asset name"},
+                                {RPCResult::Type::STR_AMOUNT, "tracked", "The tracked supply"},
+                                {RPCResult::Type::STR_AMOUNT, "scanned", "The supply found by the scan"},
+                            }},
+                        }},
+                    }
+                },
+                RPCExamples{
+            HelpExampleCli("verifyassetsupply", "") +
+            "\nAs a JSON-RPC call\n"
+            + HelpExampleRpc("verifyassetsupply", "")
+                },
+        [&](const RPCHelpMan& self, const JSONRPCRequest& request) -> UniValue
+{
+    CCoinsViewDB* pcoinsdb;
+    CAmountMap tracked;
+    uint256 hashBlock;
+    {
+        LOCK(cs_main);
+        ::ChainstateActive().ForceFlushStateToDisk();
+        pcoinsdb = &::ChainstateActive().CoinsDB();
+        if (!pcoinsdb->GetAssetSupply(tracked)) {
+            throw JSONRPCError(RPC_INTERNAL_ERROR, "Asset supply is not available");
+        }
+        hashBlock = pcoinsdb->GetBestBlock();
+    }
+
+    CCoinsScriptStats stats;
+    if (!GetUTXOScriptStats(*pcoinsdb, stats, std::max(1, std::min(GetNumCores(), MAX_UTXO_SCAN_THREADS)), ShutdownRequested)) {
+        throw JSONRPCError(RPC_INTERNAL_ERROR, "Unable to read UTXO set");
+    }
+    if (stats.hashBlock != hashBlock) {
+        throw JSONRPCError(RPC_MISC_ERROR, "The chain tip moved during the scan, try again");
+    }
+
+    CAmountMap scanned;
+    for (const auto& asset : stats.mapAssets) {
+        scanned[asset.first] = asset.second.nPlainValue;
+    }
+    CAmountMap all = tracked;
+    all += scanned;
+
+    UniValue mismatches(UniValue::VARR);
+    for (const auto& asset : all) {
+        CAmount nTracked = tracked.count(asset.first) ? tracked[asset.first] : 0;
+        CAmount nScanned = scanned.count(asset.first) ? scanned[asset.first] : 0;
+        if (nTracked != nScanned) {
+            UniValue entry(UniValue::VOBJ);
+            entry.pushKV("asset", asset.first.getAssetName());
+            entry.pushKV("tracked", ValueFromAmount(nTracked));
+            entry.pushKV("scanned", ValueFromAmount(nScanned));
+            mismatches.push_back(entry);
+        }
+    }
+
+    UniValue result(UniValue::VOBJ);
+    result.pushKV("height", stats.nHeight);
+    result.pushKV("bestblock", stats.hashBlock.GetHex());
+    result.pushKV("valid", mismatches.empty());
+    result.pushKV("mismatches", mismatches);
+    return result;
+},
+    };
+}
+
 static RPCHelpMan getnumassets()
 {
     return RPCHelpMan{"getnumassets",
@@ -285,6 +392,7 @@ static const CRPCCommand commands[] =
     { "contracts",  "getasset",            &getasset,               {}    },
     { "contracts",  "getassets",           &getassets,              {}    },
     { "contracts",  "getnumassets",        &getnumassets,           {}    },
+    { "contracts",  "verifyassetsupply",   &verifyassetsupply,      {}    },
 
 };
 
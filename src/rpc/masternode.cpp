@@ -4,6 +4,7 @@
 
 #include <init.h>
 #include <key_io.h>
+#include <mn_processing.h>
 #include <net.h>
 #include <net_processing.h>
 #include <node/context.h>
@@ -635,6 +636,41 @@ UniValue getmasternodewinners(const JSONRPCRequest& request)
     return ret;
 }
 
+UniValue getmasternodewinnerstats(const JSONRPCRequest& request)
+{
+    if (request.fHelp || (request.params.size() > 0))
+        throw std::runtime_error(
+            "getmasternodewinnerstats\n"
+            "\nGet the counters of the masternode winner ingestion queue\n"
+
+            "\nResult:\n"
+            "{\n"
+            "  \"queued\": n,        (numeric) Winners waiting for the next batch\n"
+            "  \"received\": n,      (numeric) Winners queued since startup\n"
+            "  \"processed\": n,     (numeric) Winners verified in a batch\n"
+            "  \"accepted\": n,      (numeric) Winners added to the payment votes\n"
+            "  \"batches\": n,       (numeric) Batches processed\n"
+            "  \"processtime\": n,   (numeric) Milliseconds spent processing batches\n"
+            "  \"throughput\": n     (numeric) Winners processed per second of processing time\n"
+            "}\n"
+
+            "\nExamples:\n"
+            + HelpExampleCli("getmasternodewinnerstats", "") + HelpExampleRpc("getmasternodewinnerstats", ""));
+
+    CMasternodeWinnerStats stats = masternodePayments.GetWinnerStats();
+
+    UniValue obj(UniValue::VOBJ);
+    obj.pushKV("queued", (uint64_t)stats.nQueued);
+    obj.pushKV("received", stats.nReceived);
+    obj.pushKV("processed", stats.nProcessed);
+    obj.pushKV("accepted", stats.nAccepted);
+    obj.pushKV("batches", stats.nBatches);
+    obj.pushKV("processtime", stats.nProcessTime / 1000);
+    obj.pushKV("throughput", stats.nProcessTime > 0 ? stats.nProcessed * 1000000 / stats.nProcessTime : 0);
+
+    return obj;
+}
+
 UniValue getmasternodescores(const JSONRPCRequest& request)
 {
     if (request.fHelp || request.params.size() > 1)
@@ -867,6 +903,97 @@ UniValue decodemasternodebroadcast(const JSONRPCRequest& request)
     return resultObj;
 }
 
+UniValue replaymnmessages(const JSONRPCRequest& request)
+{
+    if (request.fHelp || request.params.size() != 1)
+        throw std::runtime_error(
+            "replaymnmessages \"path\"\n"
+            "\nFeed the masternode, systemnode, budget, instantsend and spork messages captured\n"
+            "with -capturemnmessages into this node, as if they were received again at their\n"
+            "recorded times. Requires a regtest node without peers, e.g. started with -connect=0.\n"
+            "Lock statistics are recorded during the replay, whether or not -lockstats is set.\n"
+
+            "\nArguments:\n"
+            "1. \"path\"    (string, required) The capture file, relative paths are taken from the data directory\n"
+
+            "\nResult:\n"
+            "{\n"
+            "  \"messages\": n,              (numeric) Messages replayed\n"
+            "  \"failed\": n,                (numeric) Messages whose processing failed\n"
+            "  \"elapsed_ms\": n,            (numeric) Time spent processing the messages\n"
+            "  \"messages_per_second\": n,   (numeric) Replay throughput\n"
+            "  \"types\": {                  (json object) Per message type\n"
+            "    \"type\": {\n"
+            "      \"count\": n,             (numeric) Messages of the type\n"
+            "      \"bytes\": n,             (numeric) Payload bytes of the type\n"
+            "      \"total_us\": n,          (numeric) Time spent processing the type, with verifying the winners of mnw messages\n"
+            "      \"max_us\": n,            (numeric) Longest processing of a single message of the type\n"
+            "      \"locks\": {              (json object) Locks acquired while processing the type, by name\n"
+            "        \"name\": {\n"
+            "          \"count\": n,         (numeric) Acquisitions\n"
+            "          \"contended\": n,     (numeric) Acquisitions which had to wait\n"
+            "          \"wait_us\": n,       (numeric) Total wait\n"
+            "          \"hold_us\": n        (numeric) Total hold time\n"
+            "        }, ...\n"
+            "      }\n"
+            "    }, ...\n"
+            "  },\n"
+            "  \"before\": { ... },          (json object) Memory usage of each subsystem before the replay, in bytes\n"
+            "  \"after\": { ... }            (json object) Memory usage of each subsystem after the replay, in bytes\n"
+            "}\n"
+
+            "\nExamples:\n"
+            + HelpExampleCli("replaymnmessages", "\"mnmessages.dat\"") + HelpExampleRpc("replaymnmessages", "\"mnmessages.dat\""));
+
+    CConnman& connman = *g_rpc_node->connman;
+    if (connman.GetNodeCount(CConnman::CONNECTIONS_ALL) > 0) {
+        throw JSONRPCError(RPC_MISC_ERROR, "Replaying would relay to the connected peers, disconnect them first");
+    }
+
+    const fs::path path = fsbridge::AbsPathJoin(GetDataDir(), fs::u8path(request.params[0].get_str()));
+    CMasternodeReplayStats stats;
+    std::string strError;
+    if (!ReplayMasternodeMessages(path, Params(), *g_rpc_node->mempool, connman, stats, strError)) {
+        throw JSONRPCError(RPC_MISC_ERROR, strError);
+    }
+
+    UniValue types(UniValue::VOBJ);
+    for (const auto& type : stats.mapTypes) {
+        UniValue obj(UniValue::VOBJ);
+        obj.pushKV("count", type.second.nCount);
+        obj.pushKV("bytes", type.second.nBytes);
+        obj.pushKV("total_us", type.second.nTotalMicros);
+        obj.pushKV("max_us", type.second.nMaxMicros);
+        UniValue locks(UniValue::VOBJ);
+        for (const auto& lock : type.second.mapLocks) {
+            UniValue lockObj(UniValue::VOBJ);
+            lockObj.pushKV("count", lock.second.nCount);
+            lockObj.pushKV("contended", lock.second.nContended);
+            lockObj.pushKV("wait_us", lock.second.nWaitTime / 1000);
+            lockObj.pushKV("hold_us", lock.second.nHoldTime / 1000);
+            locks.pushKV(lock.first, lockObj);
+        }
+        obj.pushKV("locks", locks);
+        types.pushKV(type.first, obj);
+    }
+    UniValue before(UniValue::VOBJ);
+    for (const auto& usage : stats.vUsageBefore)
+        before.pushKV(usage.first, (uint64_t)usage.second);
+    UniValue after(UniValue::VOBJ);
+    for (const auto& usage : stats.vUsageAfter)
+        after.pushKV(usage.first, (uint64_t)usage.second);
+
+    UniValue result(UniValue::VOBJ);
+    result.pushKV("messages", stats.nMessages);
+    result.pushKV("failed", stats.nFailed);
+    result.pushKV("elapsed_ms", stats.nElapsedMicros / 1000);
+    result.pushKV("messages_per_second", stats.nElapsedMicros ? stats.nMessages * 1000000.0 / stats.nElapsedMicros : 0.0);
+    result.pushKV("types", types);
+    result.pushKV("before", before);
+    result.pushKV("after", after);
+    return result;
+}
+
 void RegisterMasternodeCommands(CRPCTable& t)
 {
     static const CRPCCommand commands[] = {
@@ -883,7 +1010,9 @@ void RegisterMasternodeCommands(CRPCTable& t)
         { "masternode", "listmasternodeconf", &listmasternodeconf, {} },
         { "masternode", "getmasternodestatus", &getmasternodestatus, {} },
         { "masternode", "getmasternodewinners", &getmasternodewinners, {} },
+        { "masternode", "getmasternodewinnerstats", &getmasternodewinnerstats, {} },
         { "masternode", "getmasternodescores", &getmasternodescores, {} },
+        { "hidden", "replaymnmessages", &replaymnmessages, {"path"} },
     };
 
     for (unsigned int vcidx = 0; vcidx < ARRAYLEN(commands); vcidx++)
@@ -5,7 +5,11 @@
 
 #include <crown/nodewallet.h>
 #include <httpserver.h>
+#include <index/addressindex.h>
+#include <index/balancesindex.h>
 #include <index/blockfilterindex.h>
+#include <index/spentindex.h>
+#include <index/timestampindex.h>
 #include <index/txindex.h>
 #include <interfaces/chain.h>
 #include <key_io.h>
@@ -13,11 +17,13 @@
 #include <systemnode/systemnode-sync.h>
 #include <node/context.h>
 #include <outputtype.h>
+#include <primitives/asset.h>
 #include <rpc/blockchain.h>
 #include <rpc/server.h>
 #include <rpc/util.h>
 #include <scheduler.h>
 #include <script/descriptor.h>
+#include <sync.h>
 #include <util/check.h>
 #include <util/message.h> // For MessageSign(), MessageVerify()
 #include <util/ref.h>
@@ -492,6 +498,8 @@ static RPCHelpMan getmemoryinfo()
                                 {RPCResult::Type::NUM, "chunks_used", "Number allocated chunks"},
                                 {RPCResult::Type::NUM, "chunks_free", "Number unused chunks"},
                             }},
+                            {RPCResult::Type::NUM, "interned_assets", "Number of distinct assets shared by the outputs held in memory"},
+                            {RPCResult::Type::NUM, "interned_assets_usage", "Number of bytes used by the shared assets and their table"},
                         }
                     },
                     RPCResult{"mode \"mallocinfo\"",
@@ -508,6 +516,8 @@ static RPCHelpMan getmemoryinfo()
     if (mode == "stats") {
         UniValue obj(UniValue::VOBJ);
         obj.pushKV("locked", RPCLockedMemoryInfo());
+        obj.pushKV("interned_assets", uint64_t(CAssetHandle::InternedCount()));
+        obj.pushKV("interned_assets_usage", uint64_t(CAssetHandle::DynamicMemoryUsage()));
         return obj;
     } else if (mode == "mallocinfo") {
 #ifdef HAVE_MALLOC_INFO
@@ -522,6 +532,137 @@ static RPCHelpMan getmemoryinfo()
     };
 }
 
+static UniValue LockStatsHistogram(const std::array<uint64_t, LockSiteStats::BUCKETS>& vHistogram)
+{
+    // Drop the empty buckets of the long times
+    int nBuckets = LockSiteStats::BUCKETS;
+    while (nBuckets > 0 && !vHistogram[nBuckets - 1])
+        nBuckets--;
+
+    UniValue histogram(UniValue::VARR);
+    for (int i = 0; i < nBuckets; i++)
+        histogram.push_back(vHistogram[i]);
+    return histogram;
+}
+
+static RPCHelpMan getlockstats()
+{
+    return RPCHelpMan{"getlockstats",
+                "Returns the wait and hold times of the locks acquired since startup, when running with -lockstats.\n"
+                "Locks are listed longest total wait first, each with the source locations that acquire it.\n"
+                "A source location locking a member of many objects is listed under each object it locked.\n"
+                "Histogram entry i counts the times up to 2^i microseconds, the last entry also all longer ones.\n"
+                "Locks taken to wait on a condition variable record no hold time.\n",
+                {},
+                RPCResult{
+                    RPCResult::Type::OBJ, "", "",
+                    {
+                        {RPCResult::Type::BOOL, "enabled", "Whether lock statistics are being recorded"},
+                        {RPCResult::Type::NUM, "untracked", "Acquisitions not recorded, the table of source locations and locks being full"},
+                        {RPCResult::Type::ARR, "locks", "",
+                        {
+                            {RPCResult::Type::OBJ, "", "",
+                            {
+                                {RPCResult::Type::STR, "name", "The lock, as named by the code locking it"},
+                                {RPCResult::Type::NUM, "acquired", "Number of acquisitions"},
+                                {RPCResult::Type::NUM, "contended", "Number of acquisitions that had to wait"},
+                                {RPCResult::Type::NUM, "wait_us", "Total time waited for the lock"},
+                                {RPCResult::Type::NUM, "hold_us", "Total time the lock was held"},
+                                {RPCResult::Type::NUM, "max_wait_us", "Longest wait for the lock"},
+                                {RPCResult::Type::NUM, "max_hold_us", "Longest hold of the lock"},
+                                {RPCResult::Type::ARR, "wait_histogram", "Contended acquisitions by wait time", {{RPCResult::Type::NUM, "", ""}}},
+                                {RPCResult::Type::ARR, "hold_histogram", "Acquisitions by hold time", {{RPCResult::Type::NUM, "", ""}}},
+                                {RPCResult::Type::ARR, "sites", "",
+                                {
+                                    {RPCResult::Type::OBJ, "", "",
+                                    {
+                                        {RPCResult::Type::STR, "site", "The source location, file:line"},
+                                        {RPCResult::Type::NUM, "acquired", "Number of acquisitions"},
+                                        {RPCResult::Type::NUM, "contended", "Number of acquisitions that had to wait"},
+                                        {RPCResult::Type::NUM, "wait_us", "Total time waited for the lock"},
+                                        {RPCResult::Type::NUM, "hold_us", "Total time the lock was held"},
+                                        {RPCResult::Type::NUM, "max_wait_us", "Longest wait for the lock"},
+                                        {RPCResult::Type::NUM, "max_hold_us", "Longest hold of the lock"},
+                                    }},
+                                }},
+                            }},
+                        }},
+                    }
+                },
+                RPCExamples{
+                    HelpExampleCli("getlockstats", "")
+            + HelpExampleRpc("getlockstats", "")
+                },
+        [&](const RPCHelpMan& self, const JSONRPCRequest& request) -> UniValue
+{
+    std::vector<LockStats> vSites = GetLockStats();
+    std::sort(vSites.begin(), vSites.end(), [](const LockStats& a, const LockStats& b) {
+        return a.nWaitTime > b.nWaitTime;
+    });
+
+    // Sites are grouped by mutex, different locks may share a name. The same lock is named ::cs_main and cs_main.
+    std::map<const void*, LockStats> mapLocks;
+    std::map<const void*, UniValue> mapSites;
+    for (const LockStats& site : vSites) {
+        LockStats& lock = mapLocks[site.pMutex];
+        if (lock.strName.empty())
+            lock.strName = site.strName.compare(0, 2, "::") ? site.strName : site.strName.substr(2);
+        lock.pMutex = site.pMutex;
+        lock.nCount += site.nCount;
+        lock.nContended += site.nContended;
+        lock.nWaitTime += site.nWaitTime;
+        lock.nHoldTime += site.nHoldTime;
+        lock.nMaxWaitTime = std::max(lock.nMaxWaitTime, site.nMaxWaitTime);
+        lock.nMaxHoldTime = std::max(lock.nMaxHoldTime, site.nMaxHoldTime);
+        for (int i = 0; i < LockSiteStats::BUCKETS; i++) {
+            lock.vWaitHistogram[i] += site.vWaitHistogram[i];
+            lock.vHoldHistogram[i] += site.vHoldHistogram[i];
+        }
+
+        UniValue obj(UniValue::VOBJ);
+        obj.pushKV("site", strprintf("%s:%d", site.strFile, site.nLine));
+        obj.pushKV("acquired", site.nCount);
+        obj.pushKV("contended", site.nContended);
+        obj.pushKV("wait_us", site.nWaitTime / 1000);
+        obj.pushKV("hold_us", site.nHoldTime / 1000);
+        obj.pushKV("max_wait_us", site.nMaxWaitTime / 1000);
+        obj.pushKV("max_hold_us", site.nMaxHoldTime / 1000);
+        auto it = mapSites.emplace(site.pMutex, UniValue::VARR).first;
+        it->second.push_back(obj);
+    }
+
+    std::vector<LockStats> vLocks;
+    for (auto& lock : mapLocks)
+        vLocks.push_back(std::move(lock.second));
+    std::sort(vLocks.begin(), vLocks.end(), [](const LockStats& a, const LockStats& b) {
+        return a.nWaitTime > b.nWaitTime;
+    });
+
+    UniValue locks(UniValue::VARR);
+    for (const LockStats& lock : vLocks) {
+        UniValue obj(UniValue::VOBJ);
+        obj.pushKV("name", lock.strName);
+        obj.pushKV("acquired", lock.nCount);
+        obj.pushKV("contended", lock.nContended);
+        obj.pushKV("wait_us", lock.nWaitTime / 1000);
+        obj.pushKV("hold_us", lock.nHoldTime / 1000);
+        obj.pushKV("max_wait_us", lock.nMaxWaitTime / 1000);
+        obj.pushKV("max_hold_us", lock.nMaxHoldTime / 1000);
+        obj.pushKV("wait_histogram", LockStatsHistogram(lock.vWaitHistogram));
+        obj.pushKV("hold_histogram", LockStatsHistogram(lock.vHoldHistogram));
+        obj.pushKV("sites", mapSites[lock.pMutex]);
+        locks.push_back(obj);
+    }
+
+    UniValue result(UniValue::VOBJ);
+    result.pushKV("enabled", g_lock_stats.load());
+    result.pushKV("untracked", g_lock_stats_untracked.load());
+    result.pushKV("locks", locks);
+    return result;
+},
+    };
+}
+
 static void EnableOrDisableLogCategories(UniValue cats, bool enable) {
     cats = cats.get_array();
     for (unsigned int i = 0; i < cats.size(); ++i) {
@@ -723,6 +864,22 @@ static RPCHelpMan getindexinfo()
         result.pushKVs(SummaryToJSON(g_txindex->GetSummary(), index_name));
     }
 
+    if (g_addressindex) {
+        result.pushKVs(SummaryToJSON(g_addressindex->GetSummary(), index_name));
+    }
+
+    if (g_spentindex) {
+        result.pushKVs(SummaryToJSON(g_spentindex->GetSummary(), index_name));
+    }
+
+    if (g_timestampindex) {
+        result.pushKVs(SummaryToJSON(g_timestampindex->GetSummary(), index_name));
+    }
+
+    if (g_balancesindex) {
+        result.pushKVs(SummaryToJSON(g_balancesindex->GetSummary(), index_name));
+    }
+
     ForEachBlockFilterIndex([&result, &index_name](const BlockFilterIndex& index) {
         result.pushKVs(SummaryToJSON(index.GetSummary(), index_name));
     });
@@ -874,6 +1031,7 @@ static const CRPCCommand commands[] =
 { //  category              name                      actor (function)         argNames
   //  --------------------- ------------------------  -----------------------  ----------
     { "control",            "getmemoryinfo",          &getmemoryinfo,          {"mode"} },
+    { "control",            "getlockstats",           &getlockstats,           {} },
     { "control",            "logging",                &logging,                {"include", "exclude"}},
     { "util",               "validateaddress",        &validateaddress,        {"address"} },
     { "util",               "createmultisig",         &createmultisig,         {"nrequired","keys","address_type"} },
@@ -449,6 +449,131 @@ static RPCHelpMan getaddednodeinfo()
     };
 }
 
+static UniValue MessageProcessingStatsToJSON(const mapMsgCmdProcessingStats& mapStats)
+{
+    UniValue ret(UniValue::VOBJ);
+    for (const auto& i : mapStats) {
+        const CMessageProcessingStats& stats = i.second;
+        // Drop the empty buckets of the long times
+        int nBuckets = CMessageProcessingStats::BUCKETS;
+        while (nBuckets > 0 && !stats.vCPUTimeHistogram[nBuckets - 1])
+            nBuckets--;
+        UniValue histogram(UniValue::VARR);
+        for (int k = 0; k < nBuckets; k++)
+            histogram.push_back(stats.vCPUTimeHistogram[k]);
+
+        UniValue obj(UniValue::VOBJ);
+        obj.pushKV("count", stats.nCount);
+        obj.pushKV("cputime_us", stats.nCPUTime);
+        obj.pushKV("walltime_us", stats.nWallTime);
+        obj.pushKV("cputime_histogram", histogram);
+        ret.pushKV(i.first, obj);
+    }
+    return ret;
+}
+
+static void MessageProcessingStatsToPrometheus(std::string& out, const mapMsgCmdProcessingStats& mapStats, const std::string& strLabels)
+{
+    for (const auto& i : mapStats) {
+        const CMessageProcessingStats& stats = i.second;
+        const std::string labels = strprintf("%stype=\"%s\"", strLabels, i.first);
+        uint64_t nCumulative = 0;
+        for (int k = 0; k < CMessageProcessingStats::BUCKETS - 1; k++) {
+            nCumulative += stats.vCPUTimeHistogram[k];
+            out += strprintf("crown_message_cpu_seconds_bucket{%s,le=\"%g\"} %u\n", labels, (1 << k) * 1e-6, nCumulative);
+        }
+        out += strprintf("crown_message_cpu_seconds_bucket{%s,le=\"+Inf\"} %u\n", labels, stats.nCount);
+        out += strprintf("crown_message_cpu_seconds_sum{%s} %g\n", labels, stats.nCPUTime * 1e-6);
+        out += strprintf("crown_message_cpu_seconds_count{%s} %u\n", labels, stats.nCount);
+        out += strprintf("crown_message_wall_seconds_total{%s} %g\n", labels, stats.nWallTime * 1e-6);
+    }
+}
+
+static RPCHelpMan getmessagestats()
+{
+    return RPCHelpMan{"getmessagestats",
+                "\nReturns the cost of processing the received messages by command, in total since startup and for each connected peer.\n"
+                "Messages of unknown commands are listed under '" + NET_MESSAGE_COMMAND_OTHER + "'.\n",
+                {
+                    {"format", RPCArg::Type::STR, /* default */ "\"json\"", "\"json\", or \"prometheus\" for the Prometheus text exposition format."},
+                },
+                {
+                    RPCResult{"format \"json\"",
+                        RPCResult::Type::OBJ, "", "",
+                        {
+                            {RPCResult::Type::OBJ_DYN, "messages", "All messages",
+                            {
+                                {RPCResult::Type::OBJ, "command", "",
+                                {
+                                    {RPCResult::Type::NUM, "count", "Number of messages processed"},
+                                    {RPCResult::Type::NUM, "cputime_us", "CPU time of the message handler thread spent processing them"},
+                                    {RPCResult::Type::NUM, "walltime_us", "Time spent processing them, including waits for locks"},
+                                    {RPCResult::Type::ARR, "cputime_histogram", "Entry i counts the messages that took up to 2^i microseconds of CPU time", {{RPCResult::Type::NUM, "", ""}}},
+                                }},
+                            }},
+                            {RPCResult::Type::ARR, "peers", "",
+                            {
+                                {RPCResult::Type::OBJ, "", "",
+                                {
+                                    {RPCResult::Type::NUM, "id", "Peer index"},
+                                    {RPCResult::Type::STR, "addr", "(host:port) The IP address and port of the peer"},
+                                    {RPCResult::Type::OBJ_DYN, "messages", "The messages of the peer, as above", {{RPCResult::Type::ELISION, "", ""}}},
+                                }},
+                            }},
+                        }},
+                    RPCResult{"format \"prometheus\"",
+                        RPCResult::Type::STR, "", "The metrics, peer metrics carry a peer label"},
+                },
+                RPCExamples{
+                    HelpExampleCli("getmessagestats", "")
+            + HelpExampleCli("getmessagestats", "\"prometheus\"")
+            + HelpExampleRpc("getmessagestats", "")
+                },
+        [&](const RPCHelpMan& self, const JSONRPCRequest& request) -> UniValue
+{
+    NodeContext& node = EnsureNodeContext(request.context);
+    if(!node.connman)
+        throw JSONRPCError(RPC_CLIENT_P2P_DISABLED, "Error: Peer-to-peer functionality missing or disabled");
+
+    const std::string format = request.params[0].isNull() ? "json" : request.params[0].get_str();
+    if (format != "json" && format != "prometheus")
+        throw JSONRPCError(RPC_INVALID_PARAMETER, "unknown format " + format);
+
+    std::vector<CNodeStats> vstats;
+    node.connman->GetNodeStats(vstats);
+    std::vector<std::pair<const CNodeStats*, CNodeStateStats>> vPeers;
+    for (const CNodeStats& stats : vstats) {
+        CNodeStateStats statestats;
+        if (GetNodeStateStats(stats.nodeid, statestats))
+            vPeers.emplace_back(&stats, std::move(statestats));
+    }
+
+    if (format == "prometheus") {
+        std::string out = "# TYPE crown_message_cpu_seconds histogram\n"
+                          "# TYPE crown_message_wall_seconds_total counter\n";
+        MessageProcessingStatsToPrometheus(out, GetMessageProcessingStats(), "");
+        for (const auto& peer : vPeers)
+            MessageProcessingStatsToPrometheus(out, peer.second.m_msg_processing_stats, strprintf("peer=\"%d\",", peer.first->nodeid));
+        return out;
+    }
+
+    UniValue peers(UniValue::VARR);
+    for (const auto& peer : vPeers) {
+        UniValue obj(UniValue::VOBJ);
+        obj.pushKV("id", peer.first->nodeid);
+        obj.pushKV("addr", peer.first->addrName);
+        obj.pushKV("messages", MessageProcessingStatsToJSON(peer.second.m_msg_processing_stats));
+        peers.push_back(obj);
+    }
+
+    UniValue ret(UniValue::VOBJ);
+    ret.pushKV("messages", MessageProcessingStatsToJSON(GetMessageProcessingStats()));
+    ret.pushKV("peers", peers);
+    return ret;
+},
+    };
+}
+
 static RPCHelpMan getnettotals()
 {
     return RPCHelpMan{"getnettotals",
@@ -902,6 +1027,7 @@ static const CRPCCommand commands[] =
     { "network",            "getconnectioncount",     &getconnectioncount,     {} },
     { "network",            "ping",                   &ping,                   {} },
     { "network",            "getpeerinfo",            &getpeerinfo,            {} },
+    { "network",            "getmessagestats",        &getmessagestats,        {"format"} },
     { "network",            "addnode",                &addnode,                {"node","command"} },
     { "network",            "disconnectnode",         &disconnectnode,         {"address", "nodeid"} },
     { "network",            "getaddednodeinfo",       &getaddednodeinfo,       {"node"} },
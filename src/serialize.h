@@ -1200,7 +1200,7 @@ inline int PutVarInt(uint8_t *p, uint64_t i)
     return nBytes;
 };
 
-inline int GetVarInt(const std::vector<uint8_t> &v, size_t ofs, uint64_t &i, size_t &nB)
+inline int GetVarInt(Span<const uint8_t> v, size_t ofs, uint64_t &i, size_t &nB)
 {
     size_t ml = v.size() - ofs;
     if (ml <= 0) {
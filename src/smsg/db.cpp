@@ -11,6 +11,7 @@
 #include <compat/endian.h>
 
 #include <leveldb/db.h>
+#include <memory>
 #include <string.h>
 
 namespace smsg {
@@ -23,6 +24,11 @@ const std::string DBK_QUEUED            = "QM";
 const std::string DBK_PURGED_TOKEN      = "pm";
 const std::string DBK_FUNDING_TX_DATA   = "fd";
 const std::string DBK_FUNDING_TX_LINK   = "fl";
+const std::string DBK_INBOX_UNREAD      = "IU";
+const std::string DBK_INBOX_ADDR        = "IA";
+const std::string DBK_OUTBOX_ADDR       = "SA";
+const std::string DBK_MESSAGE_META      = "mh";
+const std::string DBK_INDEX_VERSION     = "iv";
 
 RecursiveMutex cs_smsgDB;
 leveldb::DB *smsgDB = nullptr;
@@ -112,6 +118,73 @@ bool SecMsgDB::ScanBatch(const CDataStream &key, std::string *value, bool *delet
     return scanner.foundEntry;
 }
 
+bool SecMsgDB::WriteOrCommit(leveldb::WriteBatch &batch)
+{
+    if (activeBatch) {
+        // batch was unused, everything went to activeBatch
+        return true;
+    }
+
+    leveldb::WriteOptions writeOptions;
+    writeOptions.sync = true;
+    leveldb::Status s = pdb->Write(writeOptions, &batch);
+    if (!s.ok()) {
+        return error("SecMsgDB write failed: %s\n", s.ToString());
+    }
+
+    return true;
+};
+
+// Inbox and outbox messages are indexed by address and unread state. An index key ends with the 28 byte
+// message id (timestamp + hash) of the message it points to, so indexes iterate in message order.
+static bool IsIndexed(const uint8_t *chKey)
+{
+    return memcmp(chKey, DBK_INBOX.data(), 2) == 0
+        || memcmp(chKey, DBK_OUTBOX.data(), 2) == 0;
+};
+
+static bool IsInbox(const uint8_t *chKey)
+{
+    return memcmp(chKey, DBK_INBOX.data(), 2) == 0;
+};
+
+static std::string AddressIndexKey(const uint8_t *chKey, const CKeyID &address)
+{
+    std::string key = IsInbox(chKey) ? DBK_INBOX_ADDR : DBK_OUTBOX_ADDR;
+    key.append((const char*)address.begin(), 20);
+    key.append((const char*)chKey + 2, 28);
+    return key;
+};
+
+static std::string UnreadIndexKey(const uint8_t *chKey)
+{
+    std::string key = DBK_INBOX_UNREAD;
+    key.append((const char*)chKey + 2, 28);
+    return key;
+};
+
+static std::string MetaKey(const uint8_t *chKey)
+{
+    std::string key = DBK_MESSAGE_META;
+    key.append((const char*)chKey, 30);
+    return key;
+};
+
+static void WriteIndexes(leveldb::WriteBatch *batch, const uint8_t *chKey, const SecMsgStored &smsgStored)
+{
+    if (!IsIndexed(chKey)) {
+        return;
+    }
+    batch->Put(AddressIndexKey(chKey, smsgStored.addrTo), "");
+    if (IsInbox(chKey)) {
+        if (smsgStored.status & SMSG_MASK_UNREAD) {
+            batch->Put(UnreadIndexKey(chKey), "");
+        } else {
+            batch->Delete(UnreadIndexKey(chKey));
+        }
+    }
+};
+
 bool SecMsgDB::TxnBegin()
 {
     if (activeBatch) {
@@ -426,19 +499,12 @@ bool SecMsgDB::WriteSmesg(const uint8_t *chKey, const SecMsgStored &smsgStored)
     CDataStream ssValue(SER_DISK, CLIENT_VERSION);
     ssValue << smsgStored;
 
-    if (activeBatch) {
-        activeBatch->Put(ssKey.str(), ssValue.str());
-        return true;
-    }
+    leveldb::WriteBatch batch;
+    leveldb::WriteBatch *pbatch = activeBatch ? activeBatch : &batch;
+    pbatch->Put(ssKey.str(), ssValue.str());
+    WriteIndexes(pbatch, chKey, smsgStored);
 
-    leveldb::WriteOptions writeOptions;
-    writeOptions.sync = true;
-    leveldb::Status s = pdb->Put(writeOptions, ssKey.str(), ssValue.str());
-    if (!s.ok()) {
-        return error("SecMsgDB write failed: %s\n", s.ToString());
-    }
-
-    return true;
+    return WriteOrCommit(batch);
 };
 
 bool SecMsgDB::ExistsSmesg(const uint8_t *chKey)
@@ -467,19 +533,208 @@ bool SecMsgDB::EraseSmesg(const uint8_t *chKey)
     CDataStream ssKey(SER_DISK, CLIENT_VERSION);
     ssKey.write((const char*)chKey, 30);
 
+    leveldb::WriteBatch batch;
+    leveldb::WriteBatch *pbatch = activeBatch ? activeBatch : &batch;
+
+    if (IsIndexed(chKey)) {
+        SecMsgStored smsgStored;
+        if (ReadSmesg(chKey, smsgStored)) {
+            pbatch->Delete(AddressIndexKey(chKey, smsgStored.addrTo));
+        }
+        SecMsgMeta meta;
+        if (ReadSmesgMeta(chKey, meta)) {
+            if (!meta.addrFrom.IsNull()) {
+                pbatch->Delete(AddressIndexKey(chKey, meta.addrFrom));
+            }
+            pbatch->Delete(MetaKey(chKey));
+        }
+        if (IsInbox(chKey)) {
+            pbatch->Delete(UnreadIndexKey(chKey));
+        }
+    }
+    pbatch->Delete(ssKey.str());
+
+    return WriteOrCommit(batch);
+};
+
+/** Erase all messages under prefix, and for the inbox and outbox their index keys */
+bool SecMsgDB::EraseAllSmesg(const std::string &prefix, uint32_t &nErased)
+{
+    if (!pdb) {
+        return false;
+    }
+
+    leveldb::WriteBatch batch;
+    leveldb::WriteBatch *pbatch = activeBatch ? activeBatch : &batch;
+
+    std::vector<std::pair<std::string, size_t>> vRanges;
+    vRanges.emplace_back(prefix, 30);
+    if (IsIndexed((const uint8_t*)prefix.data())) {
+        bool fInbox = IsInbox((const uint8_t*)prefix.data());
+        vRanges.emplace_back(fInbox ? DBK_INBOX_ADDR : DBK_OUTBOX_ADDR, 2 + 20 + 28);
+        vRanges.emplace_back(DBK_MESSAGE_META + prefix, 2 + 30);
+        if (fInbox) {
+            vRanges.emplace_back(DBK_INBOX_UNREAD, 30);
+        }
+    }
+
+    nErased = 0;
+    std::unique_ptr<leveldb::Iterator> it(pdb->NewIterator(leveldb::ReadOptions()));
+    for (const auto &range : vRanges) {
+        for (it->Seek(range.first); it->Valid(); it->Next()) {
+            if (!it->key().starts_with(range.first)) {
+                break;
+            }
+            if (it->key().size() != range.second) {
+                continue;
+            }
+            pbatch->Delete(it->key());
+            if (&range == &vRanges[0]) {
+                nErased++;
+            }
+        }
+    }
+
+    return WriteOrCommit(batch);
+};
+
+bool SecMsgDB::ReadSmesgMeta(const uint8_t *chKey, SecMsgMeta &meta)
+{
+    if (!pdb) {
+        return false;
+    }
+
+    CDataStream ssKey(SER_DISK, CLIENT_VERSION);
+    ssKey.write(MetaKey(chKey).data(), 32);
+    std::string strValue;
+
+    bool readFromDb = true;
     if (activeBatch) {
-        activeBatch->Delete(ssKey.str());
-        return true;
+        // Check activeBatch first
+        bool deleted = false;
+        readFromDb = ScanBatch(ssKey, &strValue, &deleted) == false;
+        if (deleted) {
+            return false;
+        }
+    }
+
+    if (readFromDb) {
+        leveldb::Status s = pdb->Get(leveldb::ReadOptions(), ssKey.str(), &strValue);
+        if (!s.ok()) {
+            if (s.IsNotFound()) {
+                return false;
+            }
+            return error("LevelDB read failure: %s\n", s.ToString());
+        }
+    }
+
+    try {
+        CDataStream ssValue(MakeUCharSpan(strValue), SER_DISK, CLIENT_VERSION);
+        ssValue >> meta;
+    } catch (std::exception &e) {
+        LogPrintf("%s unserialize threw: %s.\n", __func__, e.what());
+        return false;
+    }
+
+    return true;
+};
+
+bool SecMsgDB::WriteSmesgMeta(const uint8_t *chKey, const SecMsgMeta &meta)
+{
+    if (!pdb || !IsIndexed(chKey)) {
+        return false;
+    }
+
+    CDataStream ssValue(SER_DISK, CLIENT_VERSION);
+    ssValue << meta;
+
+    leveldb::WriteBatch batch;
+    leveldb::WriteBatch *pbatch = activeBatch ? activeBatch : &batch;
+    pbatch->Put(MetaKey(chKey), ssValue.str());
+    if (!meta.addrFrom.IsNull()) {
+        pbatch->Put(AddressIndexKey(chKey, meta.addrFrom), "");
+    }
+
+    return WriteOrCommit(batch);
+};
+
+bool SecMsgDB::NextIndexKey(leveldb::Iterator *it, const std::string &prefix, const std::string &seek, const std::string &msgPrefix, uint8_t *chKey)
+{
+    if (!pdb) {
+        return false;
+    }
+
+    if (!it->Valid()) { // First run
+        it->Seek(seek);
+    } else {
+        it->Next();
+    }
+
+    if (!(it->Valid()
+        && it->key().size() == prefix.size() + 28
+        && memcmp(it->key().data(), prefix.data(), prefix.size()) == 0)) {
+        return false;
+    }
+
+    memcpy(chKey, msgPrefix.data(), 2);
+    memcpy(chKey + 2, it->key().data() + prefix.size(), 28);
+
+    return true;
+};
+
+/** Write the index keys of the inbox and outbox messages stored before the indexes existed */
+bool SecMsgDB::BuildIndexes()
+{
+    if (!pdb) {
+        return false;
+    }
+
+    std::string strValue;
+    leveldb::Status s = pdb->Get(leveldb::ReadOptions(), DBK_INDEX_VERSION, &strValue);
+    if (s.ok()) {
+        try {
+            int nVersion = 0;
+            CDataStream ssValue(MakeUCharSpan(strValue), SER_DISK, CLIENT_VERSION);
+            ssValue >> nVersion;
+            if (nVersion == SMSG_INDEX_VERSION) {
+                return true;
+            }
+        } catch (std::exception &e) {
+            LogPrintf("%s unserialize threw: %s.\n", __func__, e.what());
+        }
+    }
+
+    LogPrintf("Building secure message inbox and outbox indexes.\n");
+
+    leveldb::WriteBatch batch;
+    uint8_t chKey[30];
+    size_t nMessages = 0;
+    for (const auto &prefix : {DBK_INBOX, DBK_OUTBOX}) {
+        SecMsgStored smsgStored;
+        std::unique_ptr<leveldb::Iterator> it(pdb->NewIterator(leveldb::ReadOptions()));
+        while (NextSmesg(it.get(), prefix, chKey, smsgStored)) {
+            WriteIndexes(&batch, chKey, smsgStored);
+            SecMsgMeta meta;
+            if (ReadSmesgMeta(chKey, meta) && !meta.addrFrom.IsNull()) {
+                batch.Put(AddressIndexKey(chKey, meta.addrFrom), "");
+            }
+            nMessages++;
+        }
     }
 
+    CDataStream ssValue(SER_DISK, CLIENT_VERSION);
+    ssValue << SMSG_INDEX_VERSION;
+    batch.Put(DBK_INDEX_VERSION, ssValue.str());
+
     leveldb::WriteOptions writeOptions;
     writeOptions.sync = true;
-    leveldb::Status s = pdb->Delete(writeOptions, ssKey.str());
-
-    if (s.ok() || s.IsNotFound()) {
-        return true;
+    s = pdb->Write(writeOptions, &batch);
+    if (!s.ok()) {
+        return error("SecMsgDB write failed: %s\n", s.ToString());
     }
-    return error("SecMsgDB erase failed: %s\n", s.ToString());
+
+    LogPrintf("Indexed %u secure messages.\n", nMessages);
+    return true;
 };
 
 bool SecMsgDB::ReadPurged(const uint8_t *chKey, SecMsgPurged &smsgPurged)
@@ -20,6 +20,7 @@ namespace smsg {
 class SecMsgKey;
 class SecMsgStored;
 class SecMsgPurged;
+class SecMsgMeta;
 
 extern RecursiveMutex cs_smsgDB;
 extern leveldb::DB *smsgDB;
@@ -32,6 +33,14 @@ extern const std::string DBK_QUEUED;
 extern const std::string DBK_PURGED_TOKEN;
 extern const std::string DBK_FUNDING_TX_DATA;
 extern const std::string DBK_FUNDING_TX_LINK;
+extern const std::string DBK_INBOX_UNREAD;
+extern const std::string DBK_INBOX_ADDR;
+extern const std::string DBK_OUTBOX_ADDR;
+extern const std::string DBK_MESSAGE_META;
+extern const std::string DBK_INDEX_VERSION;
+
+/** Version of the inbox/outbox index keys, the indexes are rebuilt when the stored version differs */
+static const int SMSG_INDEX_VERSION = 1;
 
 class SecMsgDB
 {
@@ -70,6 +79,18 @@ public:
     bool WriteSmesg(const uint8_t *chKey, const SecMsgStored &smsgStored);
     bool ExistsSmesg(const uint8_t *chKey);
     bool EraseSmesg(const uint8_t *chKey);
+    bool EraseAllSmesg(const std::string &prefix, uint32_t &nErased);
+
+    bool ReadSmesgMeta(const uint8_t *chKey, SecMsgMeta &meta);
+    bool WriteSmesgMeta(const uint8_t *chKey, const SecMsgMeta &meta);
+
+    /**
+     * Step through the index keys under prefix, from seek on the first call, and set chKey to the key of the message
+     * (under msgPrefix) the index key points to. Index keys are prefix followed by the 28 byte message id, so a message
+     * prefix is its own index.
+     */
+    bool NextIndexKey(leveldb::Iterator *it, const std::string &prefix, const std::string &seek, const std::string &msgPrefix, uint8_t *chKey);
+    bool BuildIndexes();
 
     bool NextPrivKey(leveldb::Iterator *it, const std::string &prefix, CKeyID &idk, SecMsgKey &key);
 
@@ -85,6 +106,9 @@ public:
 
     leveldb::DB *pdb; // points to the global instance
     leveldb::WriteBatch *activeBatch;
+
+private:
+    bool WriteOrCommit(leveldb::WriteBatch &batch);
 };
 
 } // namespace smsg
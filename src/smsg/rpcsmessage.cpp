@@ -56,6 +56,62 @@ static void EnsureSMSGIsEnabled()
         throw JSONRPCError(RPC_INTERNAL_ERROR, "Secure messaging is disabled.");
 };
 
+/** Read the address, count and cursor options smsginbox and smsgoutbox page their listings with */
+static void ParsePagingOptions(const UniValue &options, CKeyID &address, uint32_t &nMaxMessages, std::vector<uint8_t> &vCursor)
+{
+    if (options["address"].isStr()) {
+        CTxDestination dest = DecodeDestination(options["address"].get_str());
+        if (!IsValidDestination(dest) || !std::holds_alternative<PKHash>(dest)) {
+            throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "Invalid address.");
+        }
+        address = ToKeyID(std::get<PKHash>(dest));
+    }
+    if (options["count"].isNum()) {
+        int nCount = options["count"].get_int();
+        if (nCount < 0) {
+            throw JSONRPCError(RPC_INVALID_PARAMETER, "count must not be negative.");
+        }
+        nMaxMessages = nCount;
+    }
+    if (options["cursor"].isStr()) {
+        std::string sCursor = options["cursor"].get_str();
+        if (!IsHex(sCursor) || sCursor.size() != 56) {
+            throw JSONRPCError(RPC_INVALID_PARAMETER, "cursor must be 28 bytes in hex string.");
+        }
+        vCursor = ParseHex(sCursor);
+    }
+};
+
+/** Call fn for the messages under msg_prefix in id order, starting after vCursor if it's set, until fn returns false.
+ *  The messages are found through the index under index_prefix, which is msg_prefix itself to visit all of them.
+ */
+static void ForEachStoredMessage(smsg::SecMsgDB &db, const std::string &msg_prefix, const std::string &index_prefix, const std::vector<uint8_t> &vCursor,
+                                 const std::function<bool(const uint8_t *chKey, smsg::SecMsgStored &smsgStored)> &fn)
+{
+    std::string seek = index_prefix;
+    seek.append(vCursor.begin(), vCursor.end());
+
+    uint8_t chKey[30];
+    smsg::SecMsgStored smsgStored;
+    std::unique_ptr<leveldb::Iterator> it(db.pdb->NewIterator(leveldb::ReadOptions()));
+    while (db.NextIndexKey(it.get(), index_prefix, seek, msg_prefix, chKey)) {
+        if (!vCursor.empty() && memcmp(&chKey[2], vCursor.data(), 28) == 0) {
+            continue;
+        }
+        if (!db.ReadSmesg(chKey, smsgStored)) {
+            continue;
+        }
+        if (!fn(chKey, smsgStored)) {
+            break;
+        }
+    }
+};
+
+static std::string AddressIndexPrefix(const std::string &prefix, const CKeyID &address)
+{
+    return prefix + std::string((const char*)address.begin(), 20);
+};
+
 static RPCHelpMan smsgenable()
 {
     return RPCHelpMan{"smsgenable",
@@ -527,11 +583,13 @@ static RPCHelpMan smsgscanbuckets()
 {
     return RPCHelpMan{"smsgscanbuckets",
                 "\nForce rescan of all messages in the bucket store.\n"
-                "Wallet must be unlocked if any receiving keys are stored in the wallet.\n",
+                "Wallet must be unlocked if any receiving keys are stored in the wallet.\n"
+                "An interrupted scan can be continued with the resume option.\n",
                 {
                     {"options", RPCArg::Type::OBJ, /* default */ "", "",
                         {
                             {"scanexpired", RPCArg::Type::BOOL, /* default */ "false", "Scan all messages."},
+                            {"resume", RPCArg::Type::BOOL, /* default */ "false", "Continue after the last bucket file completed by an interrupted scan."},
                         },
                         "options"},
                 },
@@ -545,24 +603,36 @@ static RPCHelpMan smsgscanbuckets()
     EnsureSMSGIsEnabled();
 
     bool scan_all = false;
+    bool resume = false;
     if (request.params[0].isObject()) {
         UniValue options = request.params[0].get_obj();
         RPCTypeCheckObj(options,
         {
             {"scanexpired",          UniValueType(UniValue::VBOOL)},
+            {"resume",               UniValueType(UniValue::VBOOL)},
         }, true, true);
         if (options["scanexpired"].isBool()) {
             scan_all = options["scanexpired"].get_bool();
         }
+        if (options["resume"].isBool()) {
+            resume = options["resume"].get_bool();
+        }
     }
 
     UniValue result(UniValue::VOBJ);
-    if (!smsgModule.ScanBuckets(scan_all)) {
+    if (!smsgModule.ScanBuckets(scan_all, resume)) {
         result.pushKV("result", "Scan Buckets Failed.");
     } else {
         result.pushKV("result", "Scan Buckets Completed.");
     }
 
+    smsg::SecMsgScanProgress progress = smsgModule.GetScanProgress();
+    result.pushKV("files", (int)progress.nFiles);
+    result.pushKV("files_total", (int)progress.nFilesTotal);
+    result.pushKV("messages", (int)progress.nMessages);
+    result.pushKV("received", (int)progress.nFoundMessages);
+    result.pushKV("complete", progress.fComplete);
+
     return result;
 },
     };
@@ -994,12 +1064,15 @@ static RPCHelpMan smsginbox()
                 "\nDecrypt and display received messages.\n"
                 "Warning: clear will delete all messages.\n",
                 {
-                    {"mode", RPCArg::Type::STR, /* default */ "unread", "\"all|unread|clear\" List all messages, unread messages or clear all messages."},
+                    {"mode", RPCArg::Type::STR, /* default */ "unread", "\"all|unread|count|clear\" List all messages, unread messages, count messages or clear all messages."},
                     {"filter", RPCArg::Type::STR, /* default */ "", "Filter messages when in list mode. Applied to from, to and text fields."},
                     {"options", RPCArg::Type::OBJ, /* default */ "", "",
                         {
                             {"updatestatus", RPCArg::Type::BOOL, /* default */ "true", "Update read status if true."},
                             {"encoding", RPCArg::Type::STR, /* default */ "text", "Display message data in encoding, values: \"text\", \"hex\", \"none\"."},
+                            {"address", RPCArg::Type::STR, /* default */ "", "List only messages sent from or to address."},
+                            {"count", RPCArg::Type::NUM, /* default */ "0", "Maximum number of messages to list, 0 for no limit."},
+                            {"cursor", RPCArg::Type::STR_HEX, /* default */ "", "List messages after the one with this msgid, the cursor returned by the previous call."},
                         },
                         "options"},
                 },
@@ -1014,6 +1087,7 @@ static RPCHelpMan smsginbox()
                         {RPCResult::Type::STR, "from", "Address the message was sent from"},
                         {RPCResult::Type::STR, "to", "Address the message was sent to"},
                         {RPCResult::Type::STR, "text", "Message text"},
+                        {RPCResult::Type::STR_HEX, "cursor", /* optional */ true, "Pass in options to list the next messages, set when count messages were listed"},
                 }},
                 RPCExamples{
                     "Display unread received messages:"
@@ -1033,6 +1107,9 @@ static RPCHelpMan smsginbox()
 
     std::string sEnc = "text";
     bool update_status = true;
+    CKeyID address;
+    uint32_t nMaxMessages = 0;
+    std::vector<uint8_t> vCursor;
     if (request.params[2].isObject()) {
         UniValue options = request.params[2].get_obj();
         if (options["updatestatus"].isBool()) {
@@ -1041,6 +1118,7 @@ static RPCHelpMan smsginbox()
         if (options["encoding"].isStr()) {
             sEnc = options["encoding"].get_str();
         }
+        ParsePagingOptions(options, address, nMaxMessages, vCursor);
     }
 
     UniValue result(UniValue::VOBJ);
@@ -1053,37 +1131,54 @@ static RPCHelpMan smsginbox()
         }
 
         uint32_t nMessages = 0;
-        uint8_t chKey[30];
 
         if (mode == "clear") {
             LOCK(smsg::cs_smsgDB);
             dbInbox.TxnBegin();
+            dbInbox.EraseAllSmesg(smsg::DBK_INBOX, nMessages);
+            dbInbox.TxnCommit();
 
-            leveldb::Iterator *it = dbInbox.pdb->NewIterator(leveldb::ReadOptions());
-            while (dbInbox.NextSmesgKey(it, smsg::DBK_INBOX, chKey)) {
-                dbInbox.EraseSmesg(chKey);
+            result.pushKV("result", strprintf("Deleted %u messages.", nMessages));
+        } else
+        if (mode == "count") {
+            uint32_t nUnread = 0;
+            uint8_t chKey[30];
+            std::unique_ptr<leveldb::Iterator> it(dbInbox.pdb->NewIterator(leveldb::ReadOptions()));
+            while (dbInbox.NextSmesgKey(it.get(), smsg::DBK_INBOX, chKey)) {
                 nMessages++;
             }
-            delete it;
-            dbInbox.TxnCommit();
+            it.reset(dbInbox.pdb->NewIterator(leveldb::ReadOptions()));
+            while (dbInbox.NextSmesgKey(it.get(), smsg::DBK_INBOX_UNREAD, chKey)) {
+                nUnread++;
+            }
 
-            result.pushKV("result", strprintf("Deleted %u messages.", nMessages));
+            result.pushKV("messages", (int)nMessages);
+            result.pushKV("unread", (int)nUnread);
         } else
         if (mode == "all" || mode == "unread") {
             int fCheckReadStatus = mode == "unread" ? 1 : 0;
 
-            smsg::SecMsgStored smsgStored;
             smsg::MessageData msg;
+            smsg::SecMsgMeta meta;
+            std::vector<std::pair<std::vector<uint8_t>, smsg::SecMsgStored>> vRead;
+            std::vector<std::pair<std::vector<uint8_t>, smsg::SecMsgMeta>> vMeta;
+            std::string sCursor;
+
+            // Only the listed messages are decrypted, the address and unread indexes find them
+            std::string index_prefix = smsg::DBK_INBOX;
+            if (!address.IsNull()) {
+                index_prefix = AddressIndexPrefix(smsg::DBK_INBOX_ADDR, address);
+            } else
+            if (fCheckReadStatus) {
+                index_prefix = smsg::DBK_INBOX_UNREAD;
+            }
 
-            dbInbox.TxnBegin();
-
-            leveldb::Iterator *it = dbInbox.pdb->NewIterator(leveldb::ReadOptions());
             UniValue messageList(UniValue::VARR);
 
-            while (dbInbox.NextSmesg(it, smsg::DBK_INBOX, chKey, smsgStored)) {
+            ForEachStoredMessage(dbInbox, smsg::DBK_INBOX, index_prefix, vCursor, [&](const uint8_t *chKey, smsg::SecMsgStored &smsgStored) {
                 if (fCheckReadStatus
                     && !(smsgStored.status & SMSG_MASK_UNREAD)) {
-                    continue;
+                    return true;
                 }
                 const unsigned char *pHeader = smsgStored.vchMessage.data();
                 smsg::SecureMessage smsg(pHeader);
@@ -1102,7 +1197,11 @@ static RPCHelpMan smsginbox()
                         && !(part::stringsMatchI(msg.sFromAddress, filter, 3) ||
                             part::stringsMatchI(sAddrTo, filter, 3) ||
                             part::stringsMatchI(sText, filter, 3))) {
-                        continue;
+                        return true;
+                    }
+
+                    if (!dbInbox.ReadSmesgMeta(chKey, meta)) {
+                        vMeta.emplace_back(std::vector<uint8_t>(chKey, chKey + 30), smsg::SecMsgMeta(msg.addrFrom));
                     }
 
                     PushTime(objM, "received", smsgStored.timeReceived);
@@ -1144,7 +1243,7 @@ static RPCHelpMan smsginbox()
                     }
                 } else {
                     if (filter.size() > 0) {
-                        continue;
+                        return true;
                     }
 
                     objM.pushKV("status", "Decrypt failed");
@@ -1156,18 +1255,36 @@ static RPCHelpMan smsginbox()
                 // Only set 'read' status if the message decrypted successfully and update_status is set
                 if (fCheckReadStatus && rv == 0 && update_status) {
                     smsgStored.status &= ~SMSG_MASK_UNREAD;
-                    dbInbox.WriteSmesg(chKey, smsgStored);
+                    vRead.emplace_back(std::vector<uint8_t>(chKey, chKey + 30), smsgStored);
                 }
                 nMessages++;
+                if (nMaxMessages > 0 && nMessages >= nMaxMessages) {
+                    sCursor = HexStr(Span<const unsigned char>(&chKey[2], 28));
+                    return false;
+                }
+                return true;
+            });
+
+            if (vRead.size() > 0 || vMeta.size() > 0) {
+                LOCK(smsg::cs_smsgDB);
+                dbInbox.TxnBegin();
+                for (const auto &item : vRead) {
+                    dbInbox.WriteSmesg(item.first.data(), item.second);
+                }
+                for (const auto &item : vMeta) {
+                    dbInbox.WriteSmesgMeta(item.first.data(), item.second);
+                }
+                dbInbox.TxnCommit();
             }
-            delete it;
-            dbInbox.TxnCommit();
 
             result.pushKV("messages", messageList);
             result.pushKV("result", strprintf("%u", nMessages));
+            if (!sCursor.empty()) {
+                result.pushKV("cursor", sCursor);
+            }
         } else {
             result.pushKV("result", "Unknown Mode.");
-            result.pushKV("expected", "all|unread|clear.");
+            result.pushKV("expected", "all|unread|count|clear.");
         }
     } // cs_smsgDB
 
@@ -1188,6 +1305,9 @@ static RPCHelpMan smsgoutbox()
                         {
                             {"encoding", RPCArg::Type::STR, /* default */ "text", "Display message data in encoding, values: \"text\", \"hex\", \"none\"."},
                             {"sending", RPCArg::Type::BOOL, /* default */ "false", "Display messages in sending queue."},
+                            {"address", RPCArg::Type::STR, /* default */ "", "List only messages sent from or to address."},
+                            {"count", RPCArg::Type::NUM, /* default */ "0", "Maximum number of messages to list, 0 for no limit."},
+                            {"cursor", RPCArg::Type::STR_HEX, /* default */ "", "List messages after the one with this msgid, the cursor returned by the previous call."},
                         },
                         "options"},
                 },
@@ -1199,6 +1319,7 @@ static RPCHelpMan smsgoutbox()
                         {RPCResult::Type::STR, "from", "Address the message was sent from"},
                         {RPCResult::Type::STR, "to", "Address the message was sent to"},
                         {RPCResult::Type::STR, "text", "Message text"},
+                        {RPCResult::Type::STR_HEX, "cursor", /* optional */ true, "Pass in options to list the next messages, set when count messages were listed"},
                 }},
                 RPCExamples{
                     HelpExampleCli("smsgoutbox", "")
@@ -1215,6 +1336,9 @@ static RPCHelpMan smsgoutbox()
 
     bool show_sending = false;
     std::string sEnc = "text";
+    CKeyID address;
+    uint32_t nMaxMessages = 0;
+    std::vector<uint8_t> vCursor;
     if (request.params[2].isObject()) {
         UniValue options = request.params[2].get_obj();
         if (options["encoding"].isStr()) {
@@ -1223,13 +1347,11 @@ static RPCHelpMan smsgoutbox()
         if (options["sending"].isBool()) {
             show_sending = options["sending"].get_bool();
         }
+        ParsePagingOptions(options, address, nMaxMessages, vCursor);
     }
 
     UniValue result(UniValue::VOBJ);
 
-    uint8_t chKey[30];
-    memset(&chKey[0], 0, sizeof(chKey));
-
     {
         LOCK(smsg::cs_smsgDB);
 
@@ -1243,25 +1365,28 @@ static RPCHelpMan smsgoutbox()
         std::string db_prefix = show_sending ? smsg::DBK_QUEUED : smsg::DBK_OUTBOX;
         if (mode == "clear") {
             dbOutbox.TxnBegin();
-
-            leveldb::Iterator *it = dbOutbox.pdb->NewIterator(leveldb::ReadOptions());
-            while (dbOutbox.NextSmesgKey(it, db_prefix, chKey)) {
-                dbOutbox.EraseSmesg(chKey);
-                nMessages++;
-            }
-            delete it;
+            dbOutbox.EraseAllSmesg(db_prefix, nMessages);
             dbOutbox.TxnCommit();
 
             result.pushKV("result", strprintf("Deleted %u messages.", nMessages));
         } else
         if (mode == "all") {
-            smsg::SecMsgStored smsgStored;
             smsg::MessageData msg;
-            leveldb::Iterator *it = dbOutbox.pdb->NewIterator(leveldb::ReadOptions());
+            std::string sCursor;
+
+            // The send queue is not indexed, it only holds messages until their proof of work is done
+            std::string index_prefix = db_prefix;
+            if (!address.IsNull() && !show_sending) {
+                index_prefix = AddressIndexPrefix(smsg::DBK_OUTBOX_ADDR, address);
+            }
 
             UniValue messageList(UniValue::VARR);
 
-            while (dbOutbox.NextSmesg(it, db_prefix, chKey, smsgStored)) {
+            ForEachStoredMessage(dbOutbox, db_prefix, index_prefix, vCursor, [&](const uint8_t *chKey, smsg::SecMsgStored &smsgStored) {
+                if (!address.IsNull() && show_sending
+                    && smsgStored.addrTo != address) {
+                    return true;
+                }
                 const unsigned char *pHeader = smsgStored.vchMessage.data();
                 smsg::SecureMessage smsg(pHeader);
                 const smsg::SecureMessage *psmsg = &smsg;
@@ -1279,7 +1404,7 @@ static RPCHelpMan smsgoutbox()
                         && !(part::stringsMatchI(msg.sFromAddress, filter, 3) ||
                             part::stringsMatchI(sAddrTo, filter, 3) ||
                             part::stringsMatchI(sText, filter, 3))) {
-                        continue;
+                        return true;
                     }
 
                     PushTime(objM, "sent", msg.timestamp);
@@ -1315,7 +1440,7 @@ static RPCHelpMan smsgoutbox()
                     }
                 } else {
                     if (filter.size() > 0) {
-                        continue;
+                        return true;
                     }
 
                     objM.pushKV("status", "Decrypt failed");
@@ -1323,11 +1448,18 @@ static RPCHelpMan smsgoutbox()
                 }
                 messageList.push_back(objM);
                 nMessages++;
-            }
-            delete it;
+                if (nMaxMessages > 0 && nMessages >= nMaxMessages) {
+                    sCursor = HexStr(Span<const unsigned char>(&chKey[2], 28));
+                    return false;
+                }
+                return true;
+            });
 
             result.pushKV("messages" ,messageList);
             result.pushKV("result", strprintf("%u", nMessages));
+            if (!sCursor.empty()) {
+                result.pushKV("cursor", sCursor);
+            }
         } else {
             result.pushKV("result", "Unknown Mode.");
             result.pushKV("expected", "all|clear.");
@@ -1370,16 +1502,14 @@ static RPCHelpMan smsgbuckets()
         uint32_t nMessages = 0;
         uint64_t nBytes = 0;
         {
-            LOCK(smsgModule.cs_smsg);
-            std::map<int64_t, smsg::SecMsgBucket>::const_iterator it;
-            for (it = smsgModule.buckets.begin(); it != smsgModule.buckets.end(); ++it) {
-                const std::set<smsg::SecMsgToken> &tokenSet = it->second.setTokens;
+            smsgModule.buckets.ForEach([&](int64_t bucket_time, const smsg::SecMsgBucket &bucket) {
+                const std::set<smsg::SecMsgToken> &tokenSet = bucket.setTokens;
 
-                std::string sBucket = ToString(it->first);
+                std::string sBucket = ToString(bucket_time);
                 std::string sFile = sBucket + "_01.dat";
-                std::string sHash = ToString((int64_t)it->second.hash);
+                std::string sHash = ToString((int64_t)bucket.hash);
 
-                size_t nActiveMessages = it->second.CountActive();
+                size_t nActiveMessages = bucket.CountActive();
 
                 nBuckets++;
                 nMessages += nActiveMessages;
@@ -1387,11 +1517,11 @@ static RPCHelpMan smsgbuckets()
                 UniValue objM(UniValue::VOBJ);
                 if (show_buckets) {
                     objM.pushKV("bucket", sBucket);
-                    PushTime(objM, "time", it->first);
+                    PushTime(objM, "time", bucket_time);
                     objM.pushKV("no. messages", strprintf("%u", tokenSet.size()));
                     objM.pushKV("active messages", strprintf("%u", nActiveMessages));
                     objM.pushKV("hash", sHash);
-                    objM.pushKV("last changed", part::GetTimeString(it->second.timeChanged, cbuf, sizeof(cbuf)));
+                    objM.pushKV("last changed", part::GetTimeString(bucket.timeChanged, cbuf, sizeof(cbuf)));
                 }
 
                 fs::path fullPath = gArgs.GetDataDirNet() / fs::PathFromString(smsg::STORE_DIR) / fs::PathFromString(sFile);
@@ -1416,8 +1546,8 @@ static RPCHelpMan smsgbuckets()
                 if (objM.size() > 0) {
                     arrBuckets.push_back(objM);
                 }
-            }
-        } // cs_smsg
+            });
+        }
 
         UniValue objM(UniValue::VOBJ);
         objM.pushKV("numbuckets", (int)nBuckets);
@@ -1432,9 +1562,8 @@ static RPCHelpMan smsgbuckets()
     if (mode == "dump") {
         {
             LOCK(smsgModule.cs_smsg);
-            std::map<int64_t, smsg::SecMsgBucket>::iterator it;
-            for (it = smsgModule.buckets.begin(); it != smsgModule.buckets.end(); ++it) {
-                std::string sFile = ToString(it->first) + "_01.dat";
+            smsgModule.buckets.ForEach([&](int64_t bucket_time, const smsg::SecMsgBucket &bucket) {
+                std::string sFile = ToString(bucket_time) + "_01.dat";
 
                 try {
                     fs::path fullPath = gArgs.GetDataDirNet() / fs::PathFromString(smsg::STORE_DIR) / fs::PathFromString(sFile);
@@ -1443,7 +1572,7 @@ static RPCHelpMan smsgbuckets()
                     //objM.push_back(Pair("file size, error", ex.what()));
                     LogPrintf("Error removing bucket file %s.\n", ex.what());
                 }
-            }
+            });
             smsgModule.buckets.clear();
             smsgModule.start_time = GetAdjustedTime();
         } // cs_smsg
@@ -2339,11 +2468,9 @@ static RPCHelpMan smsgdebug()
         }
 
         int num_messages = 0;
-        LOCK(smsgModule.cs_smsg);
-        std::map<int64_t, smsg::SecMsgBucket>::const_iterator it;
         std::vector<uint8_t> vch_msg;
-        for (it = smsgModule.buckets.begin(); it != smsgModule.buckets.end(); ++it) {
-            const std::set<smsg::SecMsgToken> &token_set = it->second.setTokens;
+        smsgModule.buckets.ForEach([&](int64_t bucket_time, const smsg::SecMsgBucket &bucket) {
+            const std::set<smsg::SecMsgToken> &token_set = bucket.setTokens;
             for (auto token : token_set) {
                 if (smsgModule.Retrieve(token, vch_msg) != smsg::SMSG_NO_ERROR) {
                     LogPrintf("SecureMsgRetrieve failed %d.\n", token.timestamp);
@@ -2354,10 +2481,10 @@ static RPCHelpMan smsgdebug()
                 if (psmsg->version[0] == 0 && psmsg->version[1] == 0) {
                     continue; // Skip purged
                 }
-                file << strprintf("%d,%s\n", it->first, HexStr(smsgModule.GetMsgID(psmsg, vch_msg.data() + smsg::SMSG_HDR_LEN)));
+                file << strprintf("%d,%s\n", bucket_time, HexStr(smsgModule.GetMsgID(psmsg, vch_msg.data() + smsg::SMSG_HDR_LEN)));
                 num_messages++;
             }
-        }
+        });
 
         file.close();
         result.pushKV("messages", num_messages);
@@ -32,6 +32,7 @@ Notes:
 #include <crypto/sha512.h>
 #include <wallet/ismine.h>
 #include <support/allocators/secure.h>
+#include <support/cleanse.h>
 #include <util/strencodings.h>
 #include <consensus/validation.h>
 #include <validation.h>
@@ -39,15 +40,18 @@ Notes:
 #include <smsg/crypter.h>
 #include <smsg/db.h>
 #include <random.h>
+#include <shutdown.h>
 #include <chain.h>
 #include <netmessagemaker.h>
 #include <net.h>
 #include <net_processing.h>
+#include <node/ui_interface.h>
 #include <streams.h>
 #include <univalue.h>
 #include <node/context.h>
 #include <util/string.h>
 #include <util/system.h>
+#include <util/translation.h>
 
 #ifdef ENABLE_WALLET
 #include <wallet/coincontrol.h>
@@ -57,6 +61,7 @@ Notes:
 #endif
 
 
+#include <algorithm>
 #include <stdint.h>
 #include <time.h>
 #include <map>
@@ -132,12 +137,14 @@ void SecMsgBucket::hashBucket(int64_t bucket_time)
 
     nActive = 0;
     nLeastTTL = 0;
+    rangeHashes.fill(0);
     for (auto it = setTokens.begin(); it != setTokens.end(); ++it) {
         if (it->timestamp + it->ttl < now) {
             continue;
         }
 
         XXH64_update(state, it->sample, 8);
+        rangeHashes[RangeIndex(*it)] ^= (uint32_t)XXH64(it->sample, 8, it->timestamp);
         if (it->ttl > 0 && (nLeastTTL == 0 || it->ttl < nLeastTTL)) {
             nLeastTTL = it->ttl;
         }
@@ -156,6 +163,34 @@ void SecMsgBucket::hashBucket(int64_t bucket_time)
     return;
 };
 
+std::array<bool, SMSG_SYNC_RANGES> SecMsgBucket::MismatchedRanges(const std::array<uint32_t, SMSG_SYNC_RANGES> &peerRangeHashes) const
+{
+    std::array<bool, SMSG_SYNC_RANGES> fRanges;
+    for (uint32_t r = 0; r < SMSG_SYNC_RANGES; ++r) {
+        fRanges[r] = peerRangeHashes[r] != rangeHashes[r];
+    }
+    return fRanges;
+};
+
+std::vector<const SecMsgToken*> SecMsgBucket::TokensToShow(int64_t bucket_time, int64_t now, int64_t last_shown,
+                                                           const std::array<bool, SMSG_SYNC_RANGES> &fRanges) const
+{
+    std::vector<const SecMsgToken*> vTokens;
+    for (auto it = setTokens.begin(); it != setTokens.end(); ++it) {
+        if (it->timestamp + it->ttl < now) {
+            continue;
+        }
+        if (bucket_time + it->m_changed < last_shown) {
+            continue;
+        }
+        if (!fRanges[RangeIndex(*it)]) {
+            continue;
+        }
+        vTokens.push_back(&(*it));
+    }
+    return vTokens;
+};
+
 size_t SecMsgBucket::CountActive() const
 {
     size_t nMessages = 0;
@@ -171,6 +206,62 @@ size_t SecMsgBucket::CountActive() const
     return nMessages;
 };
 
+std::vector<int64_t> SecMsgBucketSet::GetTimes() const
+{
+    std::vector<int64_t> vTimes;
+    for (const auto &shard : m_shards) {
+        LOCK(shard.cs);
+        for (const auto &it : shard.buckets) {
+            vTimes.push_back(it.first);
+        }
+    }
+    std::sort(vTimes.begin(), vTimes.end());
+    return vTimes;
+};
+
+std::shared_ptr<const std::vector<SecMsgBucketInfo>> SecMsgBucketSet::Snapshot() const
+{
+    LOCK(cs_snapshot);
+    uint64_t nChanges = m_changes;
+    if (m_snapshot && m_snapshot_changes == nChanges) {
+        return m_snapshot;
+    }
+
+    auto vInfo = std::make_shared<std::vector<SecMsgBucketInfo>>();
+    for (const auto &shard : m_shards) {
+        LOCK(shard.cs);
+        for (const auto &it : shard.buckets) {
+            vInfo->push_back(SecMsgBucketInfo{it.first, it.second.timeChanged, it.second.hash, it.second.nActive});
+        }
+    }
+    std::sort(vInfo->begin(), vInfo->end(), [](const SecMsgBucketInfo &a, const SecMsgBucketInfo &b) {
+        return a.time < b.time;
+    });
+
+    m_snapshot = std::move(vInfo);
+    m_snapshot_changes = nChanges;
+    return m_snapshot;
+};
+
+size_t SecMsgBucketSet::size() const
+{
+    size_t nBuckets = 0;
+    for (const auto &shard : m_shards) {
+        LOCK(shard.cs);
+        nBuckets += shard.buckets.size();
+    }
+    return nBuckets;
+};
+
+void SecMsgBucketSet::clear()
+{
+    for (auto &shard : m_shards) {
+        LOCK(shard.cs);
+        shard.buckets.clear();
+    }
+    m_changes++;
+};
+
 /** Bucket management thread
   */
 void ThreadSecureMsg(smsg::CSMSG *smsg_module)
@@ -184,59 +275,58 @@ void ThreadSecureMsg(smsg::CSMSG *smsg_module)
 
         vTimedOutLocks.resize(0);
         int64_t cutoffTime = now - SMSG_RETENTION;
-        {
-            LOCK(smsg_module->cs_smsg);
-            for (std::map<int64_t, SecMsgBucket>::iterator it(smsg_module->buckets.begin()); it != smsg_module->buckets.end(); ) {
-                bool fErase = it->first < cutoffTime;
+        smsg_module->buckets.ModifyEach([&](int64_t bucket_time, SecMsgBucket &bucket) {
+            bool fErase = bucket_time < cutoffTime;
 
-                if (!fErase
-                    && it->first + it->second.nLeastTTL < now) {
-                    it->second.hashBucket(it->first);
+            if (!fErase
+                && bucket_time + bucket.nLeastTTL < now) {
+                bucket.hashBucket(bucket_time);
 
-                    // TODO: periodically prune files
-                    if (it->second.nActive < 1) {
-                        fErase = true;
-                    }
+                // TODO: periodically prune files
+                if (bucket.nActive < 1) {
+                    fErase = true;
                 }
+            }
 
-                if (fErase) {
-                    LogPrint(BCLog::SMSG, "Removing bucket %d.\n", it->first);
+            if (fErase) {
+                LogPrint(BCLog::SMSG, "Removing bucket %d.\n", bucket_time);
 
-                    std::string fileName = ToString(it->first);
+                std::string fileName = ToString(bucket_time);
 
-                    fs::path fullPath = gArgs.GetDataDirNet() / fs::PathFromString(STORE_DIR) / fs::PathFromString(fileName + "_01.dat");
-                    if (fs::exists(fullPath)) {
-                        try { fs::remove(fullPath);
-                        } catch (const fs::filesystem_error &ex) {
-                            LogPrintf("Error removing bucket file %s.\n", ex.what());
-                        }
-                    } else {
-                        LogPrintf("Path %s does not exist.\n", fs::PathToString(fullPath));
+                fs::path fullPath = gArgs.GetDataDirNet() / fs::PathFromString(STORE_DIR) / fs::PathFromString(fileName + "_01.dat");
+                if (fs::exists(fullPath)) {
+                    try { fs::remove(fullPath);
+                    } catch (const fs::filesystem_error &ex) {
+                        LogPrintf("Error removing bucket file %s.\n", ex.what());
                     }
+                } else {
+                    LogPrintf("Path %s does not exist.\n", fs::PathToString(fullPath));
+                }
 
-                    // Look for a wl file, it stores incoming messages when wallet is locked
-                    fullPath = gArgs.GetDataDirNet() / fs::PathFromString(STORE_DIR) / fs::PathFromString(fileName + "_01_wl.dat");
-                    if (fs::exists(fullPath)) {
-                        try { fs::remove(fullPath);
-                        } catch (const fs::filesystem_error &ex) {
-                            LogPrintf("Error removing wallet locked file %s.\n", ex.what());
-                        }
+                // Look for a wl file, it stores incoming messages when wallet is locked
+                fullPath = gArgs.GetDataDirNet() / fs::PathFromString(STORE_DIR) / fs::PathFromString(fileName + "_01_wl.dat");
+                if (fs::exists(fullPath)) {
+                    try { fs::remove(fullPath);
+                    } catch (const fs::filesystem_error &ex) {
+                        LogPrintf("Error removing wallet locked file %s.\n", ex.what());
                     }
+                }
+                return false;
+            }
 
-                    smsg_module->buckets.erase(it++);
-                } else {
-                    if (it->second.nLockCount > 0) { // Tick down nLockCount, to eventually expire if peer never sends data
-                        it->second.nLockCount--;
+            if (bucket.nLockCount > 0) { // Tick down nLockCount, to eventually expire if peer never sends data
+                bucket.nLockCount--;
 
-                        if (it->second.nLockCount == 0) { // lock timed out
-                            vTimedOutLocks.push_back(std::make_pair(it->first, it->second.nLockPeerId)); // g_connman->cs_vNodes
-                            it->second.nLockPeerId = -1;
-                        }
-                    }
-                    ++it;
+                if (bucket.nLockCount == 0) { // lock timed out
+                    vTimedOutLocks.push_back(std::make_pair(bucket_time, bucket.nLockPeerId)); // g_connman->cs_vNodes
+                    bucket.nLockPeerId = -1;
                 }
             }
+            return true;
+        });
 
+        {
+            LOCK(smsg_module->cs_smsg);
             if (smsg_module->nLastProcessedPurged + SMSG_SECONDS_IN_DAY < now) {
                 smsg_module->BuildPurgedSets();
             }
@@ -389,12 +479,9 @@ void ThreadSecureMsgPow(smsg::CSMSG *smsg_module)
             }
 
             // Add to message store
-            {
-                LOCK(smsg_module->cs_smsg);
-                if (smsg_module->Store(pHeader, pPayload, smsg.nPayload, true) != 0) {
-                    LogPrintf("SecMsgPow: Could not place message in buckets, message removed.\n");
-                    continue;
-                }
+            if (smsg_module->Store(pHeader, pPayload, smsg.nPayload, true) != 0) {
+                LogPrintf("SecMsgPow: Could not place message in buckets, message removed.\n");
+                continue;
             }
 
             // Test if message was sent to self
@@ -545,18 +632,15 @@ int CSMSG::BuildBucketSet()
 
         size_t nTokenSetSize = 0;
         SecureMessage smsg;
-        {
-            LOCK(cs_smsg);
+        FILE *fp;
+        if (!(fp = fsbridge::fopen(itd->path(), "rb"))) {
+            LogPrintf("Error opening file: %s\n", strerror(errno));
+            continue;
+        }
 
-            SecMsgBucket &bucket = buckets[fileTime];
+        buckets.Modify(fileTime, [&](SecMsgBucket &bucket) {
             std::set<SecMsgToken> &tokenSet = bucket.setTokens;
 
-            FILE *fp;
-            if (!(fp = fopen(itd->path().string().c_str(), "rb"))) {
-                LogPrintf("Error opening file: %s\n", strerror(errno));
-                continue;
-            }
-
             for (;;) {
                 long int ofs = ftell(fp);
                 SecMsgToken token;
@@ -592,10 +676,10 @@ int CSMSG::BuildBucketSet()
                 tokenSet.insert(token);
             }
 
-            fclose(fp);
             bucket.hashBucket(fileTime);
             nTokenSetSize = tokenSet.size();
-        } // cs_smsg
+        }, true);
+        fclose(fp);
 
         nMessages += nTokenSetSize;
         LogPrint(BCLog::SMSG, "Bucket %d contains %u messages.\n", fileTime, nTokenSetSize);
@@ -641,6 +725,23 @@ int CSMSG::BuildPurgedSets()
     return SMSG_NO_ERROR;
 };
 
+int CSMSG::BuildMessageIndexes()
+{
+    LogPrint(BCLog::SMSG, "%s\n", __func__);
+    LOCK(cs_smsgDB);
+
+    SecMsgDB db;
+    if (!db.Open("cr+")) {
+        return SMSG_GENERAL_ERROR;
+    }
+
+    if (!db.BuildIndexes()) {
+        return SMSG_GENERAL_ERROR;
+    }
+
+    return SMSG_NO_ERROR;
+};
+
 int CSMSG::AddWalletAddresses()
 {
     LogPrint(BCLog::SMSG, "%s\n", __func__);
@@ -943,6 +1044,10 @@ bool CSMSG::Start(std::shared_ptr<CWallet> pwalletIn, std::vector<std::shared_pt
         return error("%s: Could not load purged sets, secure messaging disabled.", __func__);
     }
 
+    if (BuildMessageIndexes() != 0) {
+        LogPrintf("%s: Could not build the inbox and outbox indexes.\n", __func__);
+    }
+
     start_time = GetAdjustedTime();
 
     m_thread_interrupt.reset();
@@ -1051,10 +1156,6 @@ bool CSMSG::Disable()
         }
 
         // Clear buckets
-        std::map<int64_t, SecMsgBucket>::iterator it;
-        for (it = buckets.begin(); it != buckets.end(); ++it) {
-            it->second.setTokens.clear();
-        }
         buckets.clear();
         addresses.clear();
     }
@@ -1273,6 +1374,9 @@ int CSMSG::ReceiveData(PeerManager *peerLogic, CNode *pfrom, const std::string &
         + smsgShow =
             (1) received a list of requested bucket hashes which the other party does not have.
             (2) respond with smsgHave - contains all the message hashes within the requested buckets.
+        + smsgShowRng =
+            (1) smsgShow with the range hashes of the requesting node's buckets, sent to peers from SMSG_RANGES_VERSION.
+            (2) respond with smsgHave - contains the message hashes in the ranges where the hashes differ.
         + smsgHave =
             (1) A list of all the message hashes which a node has in response to smsgShow.
         + smsgWant =
@@ -1345,7 +1449,6 @@ int CSMSG::ReceiveData(PeerManager *peerLogic, CNode *pfrom, const std::string &
         uint32_t nInvBuckets;           // no. of bucket headers sent by peer in smsgInv
         nInvBuckets = memget_uint32_le(&vchData[0]);
         if (LogAcceptCategory(BCLog::SMSG)) {
-            LOCK(cs_smsg);
             LogPrintf("Peer %d sent %d bucket headers, this has %d.\n", pfrom->GetId(), nInvBuckets, buckets.size());
         }
 
@@ -1395,40 +1498,49 @@ int CSMSG::ReceiveData(PeerManager *peerLogic, CNode *pfrom, const std::string &
                 continue;
             }
 
-            {
-                LOCK(cs_smsg);
-                const auto it_lb = buckets.find(time);
+            bool fHaveBucket = false;
+            uint32_t nLockCount = 0, nActive = 0, nLocalHash = 0;
+            NodeId nLockPeerId = -1;
+            buckets.Read(time, [&](const SecMsgBucket &bucket) {
+                fHaveBucket = true;
+                nLockCount = bucket.nLockCount;
+                nLockPeerId = bucket.nLockPeerId;
+                nActive = bucket.nActive;
+                nLocalHash = bucket.hash;
                 if (LogAcceptCategory(BCLog::SMSG)) {
-                    LogPrintf("Peer bucket %d %u %u.\n", time, ncontent, hash);
-                    if (it_lb != buckets.end()) {
-                        LogPrintf("This bucket %d %u %u.\n", time, it_lb->second.setTokens.size(), it_lb->second.hash);
-                    }
+                    LogPrintf("This bucket %d %u %u.\n", time, bucket.setTokens.size(), bucket.hash);
                 }
+            });
+            LogPrint(BCLog::SMSG, "Peer bucket %d %u %u.\n", time, ncontent, hash);
 
-                if (it_lb != buckets.end() && it_lb->second.nLockCount > 0) {
-                    LogPrint(BCLog::SMSG, "Bucket is locked %u, waiting for peer %u to send data.\n", it_lb->second.nLockCount, it_lb->second.nLockPeerId);
-                    nLocked++;
-                    continue;
-                }
+            if (fHaveBucket && nLockCount > 0) {
+                LogPrint(BCLog::SMSG, "Bucket is locked %u, waiting for peer %u to send data.\n", nLockCount, nLockPeerId);
+                nLocked++;
+                continue;
+            }
 
-                // If this node has more than the peer node, peer node will pull from this
-                //  if then peer node has more this node will pull fom peer
-
-                if (it_lb == buckets.end()
-                    || it_lb->second.nActive < ncontent
-                    || (it_lb->second.nActive == ncontent
-                        && it_lb->second.hash != hash)) { // if same amount in buckets check hash
-                        LOCK(pfrom->smsgData.cs_smsg_net);
-                        auto nv = PeerBucket(ncontent, hash);
-                        auto ret = pfrom->smsgData.m_buckets.insert(std::pair<int64_t, PeerBucket>(time, nv));
-                        if (!ret.second) {
-                            ret.first->second = nv;
-                        }
-                }
-            } // cs_smsg
+            // If this node has more than the peer node, peer node will pull from this
+            //  if then peer node has more this node will pull fom peer
+
+            if (!fHaveBucket
+                || nActive < ncontent
+                || (nActive == ncontent
+                    && nLocalHash != hash)) { // if same amount in buckets check hash
+                    LOCK(pfrom->smsgData.cs_smsg_net);
+                    auto nv = PeerBucket(ncontent, hash);
+                    auto ret = pfrom->smsgData.m_buckets.insert(std::pair<int64_t, PeerBucket>(time, nv));
+                    if (!ret.second) {
+                        ret.first->second = nv;
+                    }
+            }
         }
     } else
-    if (strCommand == NetMsgType::SMSGSHOW) {
+    if (strCommand == NetMsgType::SMSGSHOW
+        || strCommand == NetMsgType::SMSGSHOWRANGES) {
+        // smsgShow lists the bucket times, smsgShowRng follows every bucket time with the number of range
+        // hashes (0 or SMSG_SYNC_RANGES) and the range hashes of the requesting node. Only the tokens in
+        // ranges that hash differently are sent back.
+        const bool fRanges = strCommand == NetMsgType::SMSGSHOWRANGES;
         std::vector<uint8_t> vchData;
         vRecv >> vchData;
 
@@ -1438,20 +1550,39 @@ int CSMSG::ReceiveData(PeerManager *peerLogic, CNode *pfrom, const std::string &
 
         uint32_t nBuckets = memget_uint32_le(&vchData[0]);
 
-        if (vchData.size() < 4 + nBuckets * 8) {
+        if (vchData.size() < 4 + (uint64_t)nBuckets * (fRanges ? 12 : 8)) {
             return SMSG_GENERAL_ERROR;
         }
 
         LogPrint(BCLog::SMSG, "Peer %d requests contents of %u buckets.\n", pfrom->GetId(), nBuckets);
 
-        std::map<int64_t, SecMsgBucket>::iterator itb;
-        std::set<SecMsgToken>::iterator it;
-
         std::vector<uint8_t> vchDataOut;
         int64_t time;
         uint8_t *pIn = &vchData[4];
-        for (uint32_t i = 0; i < nBuckets; ++i, pIn += 8) {
+        const uint8_t *pEnd = vchData.data() + vchData.size();
+        for (uint32_t i = 0; i < nBuckets; ++i) {
+            if (pEnd - pIn < (fRanges ? 12 : 8)) {
+                SmsgMisbehaving(pfrom, 10);
+                return SMSG_GENERAL_ERROR;
+            }
             time = memget_int64_le(pIn);
+            pIn += 8;
+
+            uint8_t *pRangeHashes = nullptr;
+            if (fRanges) {
+                uint32_t nRanges = memget_uint32_le(pIn);
+                pIn += 4;
+                if ((nRanges != 0 && nRanges != SMSG_SYNC_RANGES)
+                    || (size_t)(pEnd - pIn) < nRanges * 4) {
+                    LogPrint(BCLog::SMSG, "Peer %d sent invalid ranges for bucket %d.\n", pfrom->GetId(), time);
+                    SmsgMisbehaving(pfrom, 10);
+                    return SMSG_GENERAL_ERROR;
+                }
+                if (nRanges > 0) {
+                    pRangeHashes = pIn;
+                    pIn += nRanges * 4;
+                }
+            }
 
             int64_t last_shown = 0;
             {
@@ -1462,46 +1593,44 @@ int CSMSG::ReceiveData(PeerManager *peerLogic, CNode *pfrom, const std::string &
                 }
             }
 
-            {
-                LOCK(cs_smsg);
-                itb = buckets.find(time);
-                if (itb == buckets.end()) {
-                    LogPrint(BCLog::SMSG, "Don't have bucket %d.\n", time);
-                    continue;
+            bool fListed = false;
+            bool fHaveBucket = buckets.Read(time, [&](const SecMsgBucket &bucket) {
+                // Ranges both nodes hold the same tokens in are skipped
+                std::array<bool, SMSG_SYNC_RANGES> fRanges;
+                fRanges.fill(true);
+                if (pRangeHashes) {
+                    std::array<uint32_t, SMSG_SYNC_RANGES> peerRangeHashes;
+                    for (uint32_t r = 0; r < SMSG_SYNC_RANGES; ++r) {
+                        peerRangeHashes[r] = memget_uint32_le(pRangeHashes + r * 4);
+                    }
+                    fRanges = bucket.MismatchedRanges(peerRangeHashes);
                 }
 
-                std::set<SecMsgToken> &tokenSet = itb->second.setTokens;
-
-                try { vchDataOut.resize(8 + 16 * tokenSet.size());
+                std::vector<const SecMsgToken*> vTokens = bucket.TokensToShow(time, GetAdjustedTime(), last_shown, fRanges);
+                try { vchDataOut.resize(8 + 16 * vTokens.size());
                 } catch (std::exception &e) {
-                    LogPrintf("vchDataOut.resize %u threw: %s.\n", 8 + 16 * tokenSet.size(), e.what());
-                    continue;
+                    LogPrintf("vchDataOut.resize %u threw: %s.\n", 8 + 16 * vTokens.size(), e.what());
+                    return;
                 }
                 memput_int64_le(&vchDataOut[0], time);
 
-                int64_t now = GetAdjustedTime();
-                size_t nMessages = 0;
                 uint8_t *p = &vchDataOut[8];
-                for (it = tokenSet.begin(); it != tokenSet.end(); ++it) {
-                    if (it->timestamp + it->ttl < now) {
-                        continue;
-                    }
-                    if (time + it->m_changed < last_shown) {
-                        continue;
-                    }
-                    memput_int64_le(p, it->timestamp);
-                    memcpy(p+8, &it->sample, 8);
-
+                for (const SecMsgToken *token : vTokens) {
+                    memput_int64_le(p, token->timestamp);
+                    memcpy(p+8, &token->sample, 8);
                     p += 16;
-                    nMessages++;
                 }
-                if (nMessages != tokenSet.size()) {
-                    try { vchDataOut.resize(8 + 16 * nMessages);
-                    } catch (std::exception &e) {
-                        LogPrintf("vchDataOut.resize %u threw: %s.\n", 8 + 16 * nMessages, e.what());
-                        continue;
-                    }
+                if (pRangeHashes) {
+                    LogPrint(BCLog::SMSG, "Showing %u of %u tokens of bucket %d to peer %d.\n", vTokens.size(), bucket.setTokens.size(), time, pfrom->GetId());
                 }
+                fListed = true;
+            });
+            if (!fHaveBucket) {
+                LogPrint(BCLog::SMSG, "Don't have bucket %d.\n", time);
+                continue;
+            }
+            if (!fListed) {
+                continue;
             }
             {
                 LOCK(pfrom->smsgData.cs_smsg_net);
@@ -1548,57 +1677,64 @@ int CSMSG::ReceiveData(PeerManager *peerLogic, CNode *pfrom, const std::string &
                 return SMSG_NO_ERROR;
             }
 
-            SecMsgBucket &bucket = buckets[time];
-            if (bucket.nLockCount > 0) {
-                LogPrint(BCLog::SMSG, "Bucket %d lock count %u, waiting for message data from peer %u.\n", time, bucket.nLockCount, bucket.nLockPeerId);
-                return SMSG_GENERAL_ERROR;
-            }
+            bool fLocked = false;
+            buckets.Modify(time, [&](SecMsgBucket &bucket) {
+                if (bucket.nLockCount > 0) {
+                    LogPrint(BCLog::SMSG, "Bucket %d lock count %u, waiting for message data from peer %u.\n", time, bucket.nLockCount, bucket.nLockPeerId);
+                    fLocked = true;
+                    return;
+                }
 
-            LogPrint(BCLog::SMSG, "Sifting through bucket %d.\n", time);
+                LogPrint(BCLog::SMSG, "Sifting through bucket %d.\n", time);
 
-            vchDataOut.resize(8);
-            memcpy(&vchDataOut[0], &vchData[0], 8);
+                vchDataOut.resize(8);
+                memcpy(&vchDataOut[0], &vchData[0], 8);
 
-            std::set<SecMsgToken> &tokenSet = bucket.setTokens;
-            SecMsgToken token;
-            SecMsgPurged purgedToken;
-            uint8_t *p = &vchData[8];
+                const std::set<SecMsgToken> &tokenSet = bucket.setTokens;
+                SecMsgToken token;
+                SecMsgPurged purgedToken;
+                uint8_t *p = &vchData[8];
+
+                for (int i = 0; i < n; ++i, p += 16) {
+                    token.timestamp = memget_int64_le(p);
+                    memcpy(&token.sample, p+8, 8);
+
+                    if (setPurgedTimestamps.find(token.timestamp) != setPurgedTimestamps.end()) {
+                        purgedToken.timestamp = memget_int64_le(p);
+                        memcpy(&purgedToken.sample, p+8, 8);
+                        if (setPurged.find(purgedToken) != setPurged.end()) {
+                            continue;
+                        }
+                    }
 
-            for (int i = 0; i < n; ++i, p += 16) {
-                token.timestamp = memget_int64_le(p);
-                memcpy(&token.sample, p+8, 8);
+                    std::set<SecMsgToken>::const_iterator it = tokenSet.find(token);
+                    if (it == tokenSet.end()) {
+                        int nd = vchDataOut.size();
+                        try {
+                            vchDataOut.resize(nd + 16);
+                        } catch (std::exception &e) {
+                            LogPrintf("vchDataOut.resize %d threw: %s.\n", nd + 16, e.what());
+                            continue;
+                        }
 
-                if (setPurgedTimestamps.find(token.timestamp) != setPurgedTimestamps.end()) {
-                    purgedToken.timestamp = memget_int64_le(p);
-                    memcpy(&purgedToken.sample, p+8, 8);
-                    if (setPurged.find(purgedToken) != setPurged.end()) {
-                        continue;
+                        memcpy(&vchDataOut[nd], p, 16);
                     }
                 }
 
-                std::set<SecMsgToken>::const_iterator it = tokenSet.find(token);
-                if (it == tokenSet.end()) {
-                    int nd = vchDataOut.size();
-                    try {
-                        vchDataOut.resize(nd + 16);
-                    } catch (std::exception &e) {
-                        LogPrintf("vchDataOut.resize %d threw: %s.\n", nd + 16, e.what());
-                        continue;
-                    }
-
-                    memcpy(&vchDataOut[nd], p, 16);
+                if (vchDataOut.size() > 8) {
+                    LogPrint(BCLog::SMSG, "Locking bucket %u for peer %d.\n", time, pfrom->GetId());
+                    bucket.nLockCount   = 3; // lock this bucket for at most 3 * SMSG_THREAD_DELAY seconds, unset when peer sends smsgMsg
+                    bucket.nLockPeerId  = pfrom->GetId();
                 }
+            }, true);
+            if (fLocked) {
+                return SMSG_GENERAL_ERROR;
             }
 
             if (vchDataOut.size() > 8) {
                 size_t n_messages = (vchDataOut.size() - 8) / 16;
                 pfrom->smsgData.m_num_want_sent += n_messages;
-                if (LogAcceptCategory(BCLog::SMSG)) {
-                    LogPrintf("Asking peer for %u messages.\n", n_messages);
-                    LogPrintf("Locking bucket %u for peer %d.\n", time, pfrom->GetId());
-                }
-                bucket.nLockCount   = 3; // lock this bucket for at most 3 * SMSG_THREAD_DELAY seconds, unset when peer sends smsgMsg
-                bucket.nLockPeerId  = pfrom->GetId();
+                LogPrint(BCLog::SMSG, "Asking peer for %u messages.\n", n_messages);
                 m_node->connman->PushMessage(pfrom,
                     CNetMsgMaker(INIT_PROTO_VERSION).Make(NetMsgType::SMSGWANT, vchDataOut));
             }
@@ -1621,16 +1757,9 @@ int CSMSG::ReceiveData(PeerManager *peerLogic, CNode *pfrom, const std::string &
         int64_t time = memget_int64_le(&vchData[0]);
         uint32_t nBunch = 0;
 
-        {
-            LOCK(cs_smsg);
-            auto itb = buckets.find(time);
-            if (itb == buckets.end()) {
-                LogPrint(BCLog::SMSG, "Don't have bucket %d.\n", time);
-                return SMSG_GENERAL_ERROR;
-            }
-
-            std::set<SecMsgToken> &tokenSet = itb->second.setTokens;
-            std::set<SecMsgToken>::iterator it;
+        bool fHaveBucket = buckets.Read(time, [&](const SecMsgBucket &bucket) {
+            const std::set<SecMsgToken> &tokenSet = bucket.setTokens;
+            std::set<SecMsgToken>::const_iterator it;
             SecMsgToken token;
             uint8_t *p = &vchData[8];
             for (int i = 0; i < n; ++i) {
@@ -1659,7 +1788,11 @@ int CSMSG::ReceiveData(PeerManager *peerLogic, CNode *pfrom, const std::string &
                 }
                 p += 16;
             }
-        } // cs_smsg
+        });
+        if (!fHaveBucket) {
+            LogPrint(BCLog::SMSG, "Don't have bucket %d.\n", time);
+            return SMSG_GENERAL_ERROR;
+        }
 
         if (nBunch > 0) {
             LogPrint(BCLog::SMSG, "Sending block of %u messages for bucket %d.\n", nBunch, time);
@@ -1783,10 +1916,10 @@ bool CSMSG::SendData(CNode *pto, bool fSendTrickle)
     size_t buckets_to_process = 0;
     std::vector<uint8_t> vchData;
     {
-        LOCK2(cs_smsg, pto->smsgData.cs_smsg_net);
+        LOCK(pto->smsgData.cs_smsg_net);
         if (pto->smsgData.lastMatched <= m_last_changed) {
-
-            std::map<int64_t, SecMsgBucket>::iterator it;
+            // Inventories are built from the shared snapshot, without locking the buckets
+            const auto vBuckets = buckets.Snapshot();
 
             /*
             Get time before loop and after looping through messages set nLastMatched to time before loop.
@@ -1807,9 +1940,7 @@ bool CSMSG::SendData(CNode *pto, bool fSendTrickle)
                     Loop of buckets skips message
              */
 
-            for (it = buckets.begin(); it != buckets.end(); ++it) {
-                SecMsgBucket &bkt = it->second;
-
+            for (const auto &bkt : *vBuckets) {
                 uint32_t nMessages = bkt.nActive;
 
                 if (bkt.timeChanged < pto->smsgData.lastMatched     // peer was last sent all buckets at time of lastMatched. It should have this bucket
@@ -1833,7 +1964,7 @@ bool CSMSG::SendData(CNode *pto, bool fSendTrickle)
                 }
 
                 uint8_t *p = &vchData[sz];
-                memput_int64_le(p, it->first);
+                memput_int64_le(p, bkt.time);
                 memput_uint32_le(p+8, nMessages);
                 memput_uint32_le(p+12, hash);
 
@@ -1856,8 +1987,10 @@ bool CSMSG::SendData(CNode *pto, bool fSendTrickle)
     }
 
     size_t nBucketsContestReq = 0;
+    bool fShowRanges = false;
     if (buckets_to_process > 0) {
         LOCK2(cs_smsg, pto->smsgData.cs_smsg_net);
+        fShowRanges = pto->smsgData.m_version >= SMSG_RANGES_VERSION;
         for (auto it = pto->smsgData.m_buckets.begin(); it != pto->smsgData.m_buckets.end();) {
             if (nBucketsContestReq >= SMSG_MAX_SHOW) {
                  break;
@@ -1870,24 +2003,46 @@ bool CSMSG::SendData(CNode *pto, bool fSendTrickle)
             }
 
             PeerBucket &bkt = it->second;
-            const auto it_lb = buckets.find(it->first);
-
-            if (it_lb == buckets.end()
-                || (it_lb->second.nLockPeerId < 0 || it_lb->second.nLockPeerId == pto->GetId())) {
-                if (it_lb != buckets.end() &&
-                    (it_lb->second.nActive > bkt.m_active || (it_lb->second.nActive == bkt.m_active && it_lb->second.hash == bkt.m_hash))) {
+            bool fHaveBucket = false;
+            NodeId nLockPeerId = -1;
+            uint32_t nActive = 0, nLocalHash = 0;
+            std::array<uint32_t, SMSG_SYNC_RANGES> rangeHashes;
+            buckets.Read(it->first, [&](const SecMsgBucket &bucket) {
+                fHaveBucket = true;
+                nLockPeerId = bucket.nLockPeerId;
+                nActive = bucket.nActive;
+                nLocalHash = bucket.hash;
+                rangeHashes = bucket.rangeHashes;
+            });
+
+            if (!fHaveBucket
+                || (nLockPeerId < 0 || nLockPeerId == pto->GetId())) {
+                if (fHaveBucket &&
+                    (nActive > bkt.m_active || (nActive == bkt.m_active && nLocalHash == bkt.m_hash))) {
                     LogPrint(BCLog::SMSG, "Not requesting list of bucket %d.\n", it->first);
                 } else {
                     LogPrint(BCLog::SMSG, "Requesting list of bucket %d from peer %d.\n", it->first, pto->GetId());
+                    // Send the range hashes along if the bucket is large enough for them to save tokens
+                    uint32_t nRanges = 0;
+                    if (fShowRanges && fHaveBucket && nActive >= SMSG_SYNC_MIN_ACTIVE) {
+                        nRanges = SMSG_SYNC_RANGES;
+                    }
+                    size_t nEntry = fShowRanges ? 12 + nRanges * 4 : 8;
                     size_t sz = vchData.size();
-                    try { vchData.resize(sz + 8 + (sz == 0 ? 4 : 0)); } catch (std::exception& e) {
-                        LogPrintf("vchData.resize %u threw: %s.\n", vchData.size() + 8 + (sz == 0 ? 4 : 0), e.what());
+                    try { vchData.resize(sz + nEntry + (sz == 0 ? 4 : 0)); } catch (std::exception& e) {
+                        LogPrintf("vchData.resize %u threw: %s.\n", vchData.size() + nEntry + (sz == 0 ? 4 : 0), e.what());
                         continue;
                     }
                     if (sz == 0) {
                         sz = 4;
                     }
                     memput_int64_le(&vchData[sz], it->first);
+                    if (fShowRanges) {
+                        memput_uint32_le(&vchData[sz + 8], nRanges);
+                        for (uint32_t r = 0; r < nRanges; ++r) {
+                            memput_uint32_le(&vchData[sz + 12 + r * 4], rangeHashes[r]);
+                        }
+                    }
                     nBucketsContestReq++;
                     m_show_requests[it->first] = now + 10;
                 }
@@ -1900,7 +2055,7 @@ bool CSMSG::SendData(CNode *pto, bool fSendTrickle)
     if (nBucketsContestReq > 0) {
         memput_uint32_le(&vchData[0], (uint32_t)nBucketsContestReq);
         m_node->connman->PushMessage(pto,
-            CNetMsgMaker(INIT_PROTO_VERSION).Make(NetMsgType::SMSGSHOW, vchData));
+            CNetMsgMaker(INIT_PROTO_VERSION).Make(fShowRanges ? NetMsgType::SMSGSHOWRANGES : NetMsgType::SMSGSHOW, vchData));
     }
 
     {
@@ -2106,7 +2261,66 @@ bool CSMSG::ScanBlockChain()
     return true;
 };
 
-bool CSMSG::ScanBuckets(bool scan_all)
+/** Read the messages of a bucket file, fn is called with batches holding up to SMSG_SCAN_BATCH_BYTES of messages.
+  * Each message is the header followed by the payload.
+  */
+static bool ReadBucketFile(const fs::path &path, const std::function<void(const std::vector<std::vector<uint8_t>>&)> &fn)
+{
+    FILE *fp;
+    errno = 0;
+    if (!(fp = fsbridge::fopen(path, "rb"))) {
+        LogPrintf("Error opening file: %s\n", strerror(errno));
+        return false;
+    }
+
+    std::vector<std::vector<uint8_t>> vMessages;
+    size_t nBatchBytes = 0;
+    unsigned char header_buffer[SMSG_HDR_LEN];
+    SecureMessage smsg;
+    for (;;) {
+        errno = 0;
+        if (fread(header_buffer, sizeof(uint8_t), SMSG_HDR_LEN, fp) != (size_t)SMSG_HDR_LEN) {
+            if (errno != 0) {
+                LogPrintf("fread header failed: %s\n", strerror(errno));
+            }
+            break;
+        }
+        smsg.set(header_buffer);
+
+        std::vector<uint8_t> vchMsg;
+        try { vchMsg.resize(SMSG_HDR_LEN + smsg.nPayload); } catch (std::exception &e) {
+            LogPrintf("%s: Could not resize vchData, %u, %s\n", __func__, smsg.nPayload, e.what());
+            fclose(fp);
+            return false;
+        }
+        memcpy(vchMsg.data(), header_buffer, SMSG_HDR_LEN);
+
+        if (fread(vchMsg.data() + SMSG_HDR_LEN, sizeof(uint8_t), smsg.nPayload, fp) != smsg.nPayload) {
+            LogPrintf("fread data failed: %s\n", strerror(errno));
+            break;
+        }
+
+        nBatchBytes += vchMsg.size();
+        vMessages.push_back(std::move(vchMsg));
+        if (nBatchBytes >= SMSG_SCAN_BATCH_BYTES) {
+            fn(vMessages);
+            vMessages.clear();
+            nBatchBytes = 0;
+        }
+    }
+    fclose(fp);
+
+    if (!vMessages.empty()) {
+        fn(vMessages);
+    }
+    return true;
+};
+
+/** Rescan the bucket store for messages to this node.
+  * Files are scanned oldest first and the progress is kept in m_scan_progress, if resume is set a previously
+  * interrupted scan continues after the last file it completed.
+  */
+bool CSMSG::ScanBuckets(bool scan_all, bool resume)
 {
     LogPrint(BCLog::SMSG, "%s\n", __func__);
 
@@ -2116,10 +2330,6 @@ bool CSMSG::ScanBuckets(bool scan_all)
 
     int64_t  mStart         = GetTimeMillis();
     int64_t  now            = GetTime();
-    uint32_t nFiles         = 0;
-    uint32_t nMessages      = 0;
-    uint32_t nFoundMessages = 0;
-    unsigned char header_buffer[SMSG_HDR_LEN];
 
     fs::path pathSmsgDir = gArgs.GetDataDirNet() / fs::PathFromString(STORE_DIR);
     fs::directory_iterator itend;
@@ -2130,9 +2340,7 @@ bool CSMSG::ScanBuckets(bool scan_all)
         return true; // not an error
     }
 
-    SecureMessage smsg;
-    std::vector<uint8_t> vchData;
-
+    std::vector<std::pair<int64_t, fs::path>> vFiles;
     for (fs::directory_iterator itd(pathSmsgDir); itd != itend; ++itd) {
         if (!fs::is_regular_file(itd->status())) {
             continue;
@@ -2146,9 +2354,6 @@ bool CSMSG::ScanBuckets(bool scan_all)
 
         std::string fileName = itd->path().filename().string();
 
-        LogPrint(BCLog::SMSG, "Processing file: %s.\n", fileName);
-        nFiles++;
-
         // TODO files must be split if > 2GB
         // time_noFile.dat
         size_t sep = fileName.find_first_of("_");
@@ -2183,65 +2388,89 @@ bool CSMSG::ScanBuckets(bool scan_all)
             continue;
         }
 
-        {
-            LOCK(cs_smsg);
-            FILE *fp;
-            errno = 0;
-            if (!(fp = fopen(itd->path().string().c_str(), "rb"))) {
-                LogPrintf("Error opening file: %s\n", strerror(errno));
-                continue;
-            }
+        vFiles.emplace_back(fileTime, itd->path());
+    }
+    std::sort(vFiles.begin(), vFiles.end());
 
-            for (;;) {
-                errno = 0;
-                if (fread(header_buffer, sizeof(uint8_t), SMSG_HDR_LEN, fp) != (size_t)SMSG_HDR_LEN) {
-                    if (errno != 0) {
-                        LogPrintf("fread header failed: %s\n", strerror(errno));
-                    } else {
-                        //LogPrintf("End of file.\n");
-                    }
-                    break;
-                }
-                smsg.set(header_buffer);
+    SecMsgScanProgress progress;
+    {
+        LOCK(cs_scan_progress);
+        if (resume && !m_scan_progress.fComplete) {
+            progress = m_scan_progress;
+        }
+        progress.nFilesTotal = vFiles.size();
+        progress.fComplete = false;
+        m_scan_progress = progress;
+    }
 
-                try { vchData.resize(smsg.nPayload); } catch (std::exception &e) {
-                    LogPrintf("SecureMsgWalletUnlocked(): Could not resize vchData, %u, %s\n", smsg.nPayload, e.what());
-                    fclose(fp);
-                    return false;
-                }
+    const std::string strProgress = _("Scanning secure messages...").translated;
+    for (const auto &file : vFiles) {
+        std::string fileName = fs::PathToString(file.second.filename());
+        if (std::make_pair(file.first, fileName) <= std::make_pair(progress.nResumeFileTime, progress.sResumeFile)) {
+            continue; // Completed by the scan being resumed
+        }
 
-                if (fread(vchData.data(), sizeof(uint8_t), smsg.nPayload, fp) != smsg.nPayload) {
-                    LogPrintf("fread data failed: %s\n", strerror(errno));
-                    break;
-                }
+        if (m_thread_interrupt || ShutdownRequested()) {
+            uiInterface.ShowProgress(strProgress, 100, false);
+            LogPrintf("%s: Interrupted after %u of %u files.\n", __func__, progress.nFiles, progress.nFilesTotal);
+            return false;
+        }
+        uiInterface.ShowProgress(strProgress, progress.nFilesTotal ? progress.nFiles * 100 / progress.nFilesTotal : 0, false);
+
+        LogPrint(BCLog::SMSG, "Processing file: %s.\n", fileName);
 
+        bool fRead = ReadBucketFile(file.second, [&](const std::vector<std::vector<uint8_t>> &vMessages) {
+            std::vector<SecMsgScanItem> items;
+            for (const auto &vchMsg : vMessages) {
+                SecureMessage smsg(vchMsg.data());
                 if (smsg.version[0] == 0 && smsg.version[1] == 0) {
                     // Purged message header
                 } else
                 if (!scan_all && smsg.timestamp + smsg.m_ttl < now) {
                     // Expired message
                 } else {
-                    bool fOwnMessage;
-                    int rv = ScanMessage(header_buffer, vchData.data(), smsg.nPayload, true, fOwnMessage);
-                    if (rv == SMSG_NO_ERROR) {
-                        nFoundMessages++;
-                    } else {
-                        // SecureMsgScanMessage failed
-                    }
+                    items.emplace_back(vchMsg.data(), vchMsg.data() + SMSG_HDR_LEN, smsg.nPayload);
                 }
-                nMessages++;
+                progress.nMessages++;
             }
 
-            fclose(fp);
-        } // cs_smsg
+            LOCK(cs_smsg);
+            ScanMessages(items, true);
+            for (const auto &item : items) {
+                if (item.rv == SMSG_NO_ERROR && item.fOwnMessage) {
+                    progress.nFoundMessages++;
+                }
+            }
+        });
+        if (!fRead) {
+            continue;
+        }
+
+        progress.nFiles++;
+        progress.nResumeFileTime = file.first;
+        progress.sResumeFile = fileName;
+        LOCK(cs_scan_progress);
+        m_scan_progress = progress;
     }
+    uiInterface.ShowProgress(strProgress, 100, false);
 
-    LogPrintf("Processed %u files, scanned %u messages, received %u messages.\n", nFiles, nMessages, nFoundMessages);
+    {
+        LOCK(cs_scan_progress);
+        m_scan_progress.fComplete = true;
+    }
+
+    LogPrintf("Processed %u files, scanned %u messages, received %u messages.\n", progress.nFiles, progress.nMessages, progress.nFoundMessages);
     LogPrintf("Took %d ms\n", GetTimeMillis() - mStart);
 
     return true;
 }
 
+SecMsgScanProgress CSMSG::GetScanProgress()
+{
+    LOCK(cs_scan_progress);
+    return m_scan_progress;
+};
+
 int CSMSG::ManageLocalKey(CKeyID &keyId, ChangeType mode)
 {
     // TODO: default recv and recvAnon
@@ -2299,7 +2528,6 @@ int CSMSG::WalletUnlocked(CWallet *pwallet)
     uint32_t nFiles         = 0;
     uint32_t nMessages      = 0;
     uint32_t nFoundMessages = 0;
-    unsigned char header_buffer[SMSG_HDR_LEN];
 
     fs::path pathSmsgDir = gArgs.GetDataDirNet() / fs::PathFromString(STORE_DIR);
     fs::directory_iterator itend;
@@ -2310,9 +2538,6 @@ int CSMSG::WalletUnlocked(CWallet *pwallet)
         return SMSG_NO_ERROR; // not an error
     }
 
-    SecureMessage smsg;
-    std::vector<uint8_t> vchData;
-
     for (fs::directory_iterator itd(pathSmsgDir); itd != itend; ++itd) {
         if (!fs::is_regular_file(itd->status())) {
             continue;
@@ -2353,69 +2578,43 @@ int CSMSG::WalletUnlocked(CWallet *pwallet)
         }
 
         bool remove_file = true;
-        {
-            LOCK(cs_smsg);
-            FILE *fp;
-            errno = 0;
-            if (!(fp = fopen(itd->path().string().c_str(), "rb"))) {
-                LogPrintf("Error opening file: %s\n", strerror(errno));
-                continue;
-            }
-
-            for (;;) {
-                errno = 0;
-                if (fread(header_buffer, sizeof(uint8_t), SMSG_HDR_LEN, fp) != (size_t)SMSG_HDR_LEN) {
-                    if (errno != 0) {
-                        LogPrintf("fread header failed: %s\n", strerror(errno));
-                    } else {
-                        //LogPrintf("End of file.\n");
-                    }
-                    break;
-                }
-                smsg.set(header_buffer);
-
-                try { vchData.resize(smsg.nPayload); } catch (std::exception &e) {
-                    LogPrintf("%s: Could not resize vchData, %u, %s\n", __func__, smsg.nPayload, e.what());
-                    fclose(fp);
-                    return SMSG_GENERAL_ERROR;
-                }
-
-                if (fread(&vchData[0], sizeof(uint8_t), smsg.nPayload, fp) != smsg.nPayload) {
-                    LogPrintf("fread data failed: %s\n", strerror(errno));
-                    break;
-                }
-
+        bool fRead = ReadBucketFile(itd->path(), [&](const std::vector<std::vector<uint8_t>> &vMessages) {
+            std::vector<SecMsgScanItem> items;
+            for (const auto &vchMsg : vMessages) {
+                SecureMessage smsg(vchMsg.data());
                 if (now > smsg.timestamp + smsg.m_ttl) {
                     LogPrint(BCLog::SMSG, "Time expired %d, ttl %d.\n", smsg.timestamp, smsg.m_ttl);
                     continue;
                 }
+                items.emplace_back(vchMsg.data(), vchMsg.data() + SMSG_HDR_LEN, smsg.nPayload);
+            }
 
-                // Don't report to gui,
-                bool fOwnMessage;
-                int rv = ScanMessage(header_buffer, &vchData[0], smsg.nPayload, true, fOwnMessage, true);
-                if (rv == 0) {
+            // Don't report to gui,
+            LOCK(cs_smsg);
+            ScanMessages(items, true, true);
+            for (const auto &item : items) {
+                if (item.rv == SMSG_NO_ERROR && item.fOwnMessage) {
                     nFoundMessages++;
                 } else
-                if (rv == SMSG_WALLET_LOCKED) {
+                if (item.rv == SMSG_WALLET_LOCKED) {
                     remove_file = false;
-                } else {
-                    // SecureMsgScanMessage failed
                 }
-
                 nMessages++;
             }
+        });
+        if (!fRead) {
+            continue;
+        }
 
-            fclose(fp);
-
-            // Remove wl file when scanned
-            if (remove_file) {
-                try {
-                    fs::remove(itd->path());
-                } catch (const fs::filesystem_error &ex) {
-                    return errorN(SMSG_GENERAL_ERROR, "%s: Could not remove file %s - %s.", __func__, fileName, ex.what());
-                }
+        // Remove wl file when scanned
+        if (remove_file) {
+            LOCK(cs_smsg);
+            try {
+                fs::remove(itd->path());
+            } catch (const fs::filesystem_error &ex) {
+                return errorN(SMSG_GENERAL_ERROR, "%s: Could not remove file %s - %s.", __func__, fileName, ex.what());
             }
-        } // cs_smsg
+        }
     }
 
     LogPrintf("Processed %u files, scanned %u messages, received %u messages.\n", nFiles, nMessages, nFoundMessages);
@@ -2448,174 +2647,331 @@ int CSMSG::WalletKeyChanged(CKeyID &keyId, const std::string &sLabel, ChangeType
     return ManageLocalKey(keyId, mode);
 };
 
-/** Check if message belongs to this node.
-  * If so add to inbox db.
-  *
-  * if !reportToGui don't fire NotifySecMsgInboxChanged
-  *  - loads messages received when wallet locked in bulk.
+/** Derive the encryption and MAC keys shared between the sender and keyDest from the ephemeral public key R.
+  * key_e and key_m are the first and last 32 bytes of SHA512(ECDH(R, keyDest)).
   */
-int CSMSG::ScanMessage(const uint8_t *pHeader, const uint8_t *pPayload, uint32_t nPayload, bool reportToGui, bool &fOwnMessage, bool unlocking)
+static bool DeriveSharedKeys(const secp256k1_pubkey &R, const CKey &keyDest, uint8_t *key_em)
 {
-    LogPrint(BCLog::SMSG, "%s\n", __func__);
+    uint256 P;
+    if (!secp256k1_ecdh(secp256k1_context_smsg, P.begin(), &R, keyDest.begin(), nullptr, nullptr)) {
+        return false;
+    }
+    CSHA512().Write(P.begin(), 32).Finalize(key_em);
+    return true;
+};
 
-    fOwnMessage = false;
-    MessageData msg; // placeholder
-    CKeyID addressTo;
-    for (auto &p : smsgModule.keyStore.mapKeys) {
-        auto &address = p.first;
-        auto &key = p.second;
+/** Message authentication code, (hash of timestamp + iv + payload) */
+static bool CheckMac(const SecureMessage &smsg, const uint8_t *key_m, const uint8_t *pPayload, uint32_t nPayload)
+{
+    uint8_t MAC[32];
+
+    CHMAC_SHA256 ctx(key_m, 32);
+    int64_t tmp64 = htole64(smsg.timestamp);
+    ctx.Write((uint8_t*) &tmp64, sizeof(tmp64));
+    ctx.Write((uint8_t*) smsg.iv, sizeof(smsg.iv));
+    ctx.Write((uint8_t*) pPayload, nPayload);
+    ctx.Finalize(MAC);
+
+    return part::memcmp_nta(MAC, smsg.mac, 32) == 0;
+};
 
+/** Check the MAC of a message with the ECDH secret of keyDest, without decrypting the payload */
+static bool TrialMac(const SecureMessage &smsg, const secp256k1_pubkey &R, const CKey &keyDest, const uint8_t *pPayload, uint32_t nPayload)
+{
+    uint8_t key_em[64];
+    bool fMatch = DeriveSharedKeys(R, keyDest, key_em) && CheckMac(smsg, &key_em[32], pPayload, nPayload);
+    memory_cleanse(key_em, sizeof(key_em));
+    return fMatch;
+};
+
+/** Collect the keys messages can be received with.
+  * Fetching a key from an encrypted wallet decrypts and verifies it, which is done here once per batch of
+  * messages rather than once per trial.
+  * was_locked is set if a receiving key is in a locked wallet.
+  */
+int CSMSG::GetTrialKeys(std::vector<SecMsgTrialKey> &keys, bool &was_locked)
+{
+    keys.clear();
+    was_locked = false;
+
+    LOCK(cs_smsg);
+    for (const auto &p : keyStore.mapKeys) {
+        const auto &key = p.second;
         if (!(key.nFlags & SMK_RECEIVE_ON)) {
             continue;
         }
+        keys.emplace_back(p.first, key.key, key.nFlags & SMK_RECEIVE_ANON);
+    }
 
-        if (!(key.nFlags & SMK_RECEIVE_ANON)) {
-            // Have to do full decrypt to see address from
-            if (Decrypt(false, key.key, address, pHeader, pPayload, nPayload, msg) == 0) {
-                if (LogAcceptCategory(BCLog::SMSG)) {
-                    LogPrintf("Decrypted message with %s.\n", EncodeDestination(PKHash(addressTo)));
-                }
-                if (msg.sFromAddress.compare("anon") != 0) {
-                    fOwnMessage = true;
+#ifdef ENABLE_WALLET
+    for (const auto &addr : addresses) {
+        if (!addr.fReceiveEnabled) {
+            continue;
+        }
+
+        CKey keyDest;
+        for (const auto &pw : m_vpwallets) {
+            LegacyScriptPubKeyMan* spk_man = pw->GetLegacyScriptPubKeyMan();
+
+            if (pw->IsLocked()) {
+                if (spk_man->HaveKey(addr.address)) {
+                    was_locked = true;
                 }
-                addressTo = address;
-                break;
+                continue;
             }
-        } else {
-            if (Decrypt(true, key.key, address, pHeader, pPayload, nPayload, msg) == 0) {
-                if (LogAcceptCategory(BCLog::SMSG)) {
-                    LogPrintf("Decrypted message with %s.\n", EncodeDestination(PKHash(addressTo)));
-                }
-                fOwnMessage = true;
-                addressTo = address;
+            if (spk_man->GetKey(addr.address, keyDest)) {
                 break;
             }
         }
+        if (!keyDest.IsValid()) {
+            continue;
+        }
+        keys.emplace_back(addr.address, keyDest, addr.fReceiveAnon);
     }
+#endif
 
-    bool was_locked = false;
-    if (!fOwnMessage) {
-#ifdef ENABLE_WALLET
+    return SMSG_NO_ERROR;
+};
 
-        for (std::vector<SecMsgAddress>::iterator it = addresses.begin(); it != addresses.end(); ++it) {
-            if (!it->fReceiveEnabled) {
+/** Check which messages of a batch belong to this node.
+  * If so add them to the inbox db.
+  *
+  * The MAC of every message is trialled against every receiving key, spread over worker threads when the
+  * batch is large enough. The ephemeral public key of a message is parsed once and the keys are fetched
+  * once for the whole batch. Only the first key a message matches is used to fully decrypt it, in the
+  * same order as keys were tried before.
+  *
+  * if !reportToGui don't fire NotifySecMsgInboxChanged
+  *  - loads messages received when wallet locked in bulk.
+  */
+int CSMSG::ScanMessages(std::vector<SecMsgScanItem> &items, bool reportToGui, bool unlocking)
+{
+    LogPrint(BCLog::SMSG, "%s: %u messages\n", __func__, items.size());
+
+    if (items.empty()) {
+        return SMSG_NO_ERROR;
+    }
+
+    bool was_locked = false;
+    std::vector<SecMsgTrialKey> keys;
+    GetTrialKeys(keys, was_locked);
+
+    // Parse the headers, messages that can't be decrypted by any key are rejected here
+    std::vector<SecureMessage> vSmsg(items.size());
+    std::vector<secp256k1_pubkey> vR(items.size());
+    std::vector<uint32_t> vMacBytes(items.size(), 0);
+    std::vector<bool> vTrial(items.size(), false);
+    for (size_t i = 0; i < items.size(); ++i) {
+        SecMsgScanItem &item = items[i];
+        item.rv = SMSG_NO_ERROR;
+        item.fOwnMessage = false;
+        if (!item.pHeader || !item.pPayload) {
+            item.rv = SMSG_GENERAL_ERROR;
+            continue;
+        }
+        SecureMessage &smsg = vSmsg[i];
+        smsg.set(item.pHeader);
+        if (smsg.IsPaidVersion()) {
+            if (item.nPayload < 32) {
+                item.rv = SMSG_GENERAL_ERROR;
                 continue;
             }
+            vMacBytes[i] = item.nPayload - 32; // Exclude funding txid
+        } else
+        if (smsg.version[0] != 2) {
+            LogPrint(BCLog::SMSG, "%s: Unknown version number.\n", __func__);
+            continue;
+        } else {
+            vMacBytes[i] = item.nPayload;
+        }
+        if (!secp256k1_ec_pubkey_parse(secp256k1_context_smsg, &vR[i], smsg.cpkR, 33)) {
+            LogPrint(BCLog::SMSG, "%s: secp256k1_ec_pubkey_parse failed: %s.\n", __func__, HexStr(Span<const unsigned char>(smsg.cpkR, 33)));
+            continue;
+        }
+        vTrial[i] = true;
+    }
 
-            addressTo = it->address;
-
-            CKey keyDest;
-            for (const auto &pw : m_vpwallets) {
-                LegacyScriptPubKeyMan* spk_man = pw->GetLegacyScriptPubKeyMan();
+    // Lowest index of a key that matches the MAC of each message, keys.size() if none does
+    const size_t nKeys = keys.size();
+    const size_t nChunks = (nKeys + SMSG_SCAN_KEY_CHUNK - 1) / SMSG_SCAN_KEY_CHUNK;
+    const size_t nUnits = items.size() * nChunks;
+    std::vector<std::atomic<size_t>> vMatch(items.size());
+    for (auto &m : vMatch) {
+        m = nKeys;
+    }
+    std::atomic<size_t> nNextUnit{0};
 
-                if (pw->IsLocked()) {
-                    if (spk_man->HaveKey(addressTo)) {
-                        was_locked = true;
-                    }
+    auto worker = [&]() {
+        size_t u;
+        while ((u = nNextUnit++) < nUnits) {
+            size_t i = u / nChunks;
+            if (!vTrial[i]) {
+                continue;
+            }
+            size_t kBegin = (u % nChunks) * SMSG_SCAN_KEY_CHUNK;
+            size_t kEnd = std::min(nKeys, kBegin + SMSG_SCAN_KEY_CHUNK);
+            for (size_t k = kBegin; k < kEnd && k < vMatch[i]; ++k) {
+                if (!TrialMac(vSmsg[i], vR[i], keys[k].key, items[i].pPayload, vMacBytes[i])) {
                     continue;
                 }
-                if (spk_man->GetKey(addressTo, keyDest)) {
-                    break;
-                }
+                size_t prev = vMatch[i];
+                while (k < prev && !vMatch[i].compare_exchange_weak(prev, k));
+                break;
             }
-            if (!keyDest.IsValid()) {
+        }
+    };
+
+    size_t nThreads = 1;
+    if (nUnits > 1 && items.size() * nKeys >= SMSG_MIN_PARALLEL_TRIALS) {
+        nThreads = std::min({(size_t)std::max(1, GetNumCores()), SMSG_MAX_SCAN_THREADS, nUnits});
+    }
+    std::vector<std::thread> threads;
+    for (size_t n = 1; n < nThreads; n++) {
+        threads.emplace_back(worker);
+    }
+    worker();
+    for (std::thread &thread : threads) {
+        thread.join();
+    }
+
+    MessageData msg; // placeholder
+    for (size_t i = 0; i < items.size(); ++i) {
+        SecMsgScanItem &item = items[i];
+        if (!vTrial[i]) {
+            continue;
+        }
+
+        CKeyID addressTo;
+        bool fDecrypted = false;
+        for (size_t k = vMatch[i]; k < nKeys; ++k) {
+            const SecMsgTrialKey &key = keys[k];
+            if (k > vMatch[i] && !TrialMac(vSmsg[i], vR[i], key.key, item.pPayload, vMacBytes[i])) {
                 continue;
             }
 
-            if (!it->fReceiveAnon) {
+            if (!key.fReceiveAnon) {
                 // Have to do full decrypt to see address from
-                if (Decrypt(false, keyDest, addressTo, pHeader, pPayload, nPayload, msg) == 0) {
-                    if (LogAcceptCategory(BCLog::SMSG)) {
-                        LogPrintf("Decrypted message with %s.\n", EncodeDestination(PKHash(addressTo)));
-                    }
-                    if (msg.sFromAddress.compare("anon") != 0) {
-                        fOwnMessage = true;
-                    }
-                    break;
+                if (Decrypt(false, key.key, key.address, item.pHeader, item.pPayload, item.nPayload, msg) != 0) {
+                    continue;
                 }
-            } else {
-                if (Decrypt(true, keyDest, addressTo, pHeader, pPayload, nPayload, msg) == 0) {
-                    if (LogAcceptCategory(BCLog::SMSG)) {
-                        LogPrintf("Decrypted message with %s.\n", EncodeDestination(PKHash(addressTo)));
-                    }
-                    fOwnMessage = true;
-                    break;
+                fDecrypted = true;
+                if (msg.sFromAddress.compare("anon") != 0) {
+                    item.fOwnMessage = true;
                 }
+            } else {
+                item.fOwnMessage = true;
+            }
+            if (LogAcceptCategory(BCLog::SMSG)) {
+                LogPrintf("Decrypted message with %s.\n", EncodeDestination(PKHash(key.address)));
             }
+            addressTo = key.address;
+            break;
         }
-#endif
-    }
 
-    if (!fOwnMessage && was_locked && !unlocking) {
-        LogPrint(BCLog::SMSG, "%s: Wallet is locked, storing message to scan later.\n", __func__);
-        // Only save unscanned if there are addresses
-        // was_locked will onlye be set if addresses.size() > 0
-        int rv;
-        if ((rv = StoreUnscanned(pHeader, pPayload, nPayload)) != 0) {
-            return SMSG_GENERAL_ERROR;
+        if (!item.fOwnMessage && was_locked && !unlocking) {
+            LogPrint(BCLog::SMSG, "%s: Wallet is locked, storing message to scan later.\n", __func__);
+            // Only save unscanned if there are addresses
+            // was_locked will onlye be set if addresses.size() > 0
+            if (StoreUnscanned(item.pHeader, item.pPayload, item.nPayload) != 0) {
+                item.rv = SMSG_GENERAL_ERROR;
+            } else {
+                item.rv = SMSG_WALLET_LOCKED;
+            }
+            continue;
+        }
+
+        if (item.fOwnMessage) {
+            SecMsgMeta meta(msg.addrFrom);
+            item.rv = StoreReceived(item.pHeader, item.pPayload, item.nPayload, addressTo, fDecrypted ? &meta : nullptr, reportToGui);
         }
-        return SMSG_WALLET_LOCKED;
     }
 
-    if (fOwnMessage) {
-        // Save to inbox
-        SecureMessage smsg(pHeader);
+    return SMSG_NO_ERROR;
+};
 
-        uint160 hash;
-        HashMsg(smsg, pPayload, nPayload-(smsg.IsPaidVersion() ? 32 : 0), hash);
+/** Check if message belongs to this node.
+  * If so add to inbox db.
+  *
+  * if !reportToGui don't fire NotifySecMsgInboxChanged
+  *  - loads messages received when wallet locked in bulk.
+  */
+int CSMSG::ScanMessage(const uint8_t *pHeader, const uint8_t *pPayload, uint32_t nPayload, bool reportToGui, bool &fOwnMessage, bool unlocking)
+{
+    LogPrint(BCLog::SMSG, "%s\n", __func__);
 
-        uint8_t chKey[30];
-        int64_t timestamp_be = (int64_t)htobe64(smsg.timestamp);
-        memcpy(&chKey[0], DBK_INBOX.data(), 2);
-        memcpy(&chKey[2], &timestamp_be, 8);
-        memcpy(&chKey[10], hash.begin(), 20);
+    std::vector<SecMsgScanItem> items;
+    items.emplace_back(pHeader, pPayload, nPayload);
+    ScanMessages(items, reportToGui, unlocking);
 
-        SecMsgStored smsgInbox;
-        smsgInbox.timeReceived  = GetTime();
-        smsgInbox.status        = (SMSG_MASK_UNREAD) & 0xFF;
-        smsgInbox.addrTo        = addressTo;
+    fOwnMessage = items[0].fOwnMessage;
+    return items[0].rv;
+};
 
-        try { smsgInbox.vchMessage.resize(SMSG_HDR_LEN + nPayload); } catch (std::exception &e) {
-            return errorN(SMSG_ALLOCATE_FAILED, "%s: Could not resize vchData, %u, %s.", __func__, SMSG_HDR_LEN + nPayload, e.what());
-        }
-        memcpy(&smsgInbox.vchMessage[0], pHeader, SMSG_HDR_LEN);
-        memcpy(&smsgInbox.vchMessage[SMSG_HDR_LEN], pPayload, nPayload);
+/** Save a message received with addressTo to the inbox db, pMeta is set if the message was decrypted */
+int CSMSG::StoreReceived(const uint8_t *pHeader, const uint8_t *pPayload, uint32_t nPayload, const CKeyID &addressTo, const SecMsgMeta *pMeta, bool reportToGui)
+{
+    // Save to inbox
+    SecureMessage smsg(pHeader);
 
-        bool fExisted = false;
-        {
-            LOCK(cs_smsgDB);
-            SecMsgDB dbInbox;
+    uint160 hash;
+    HashMsg(smsg, pPayload, nPayload-(smsg.IsPaidVersion() ? 32 : 0), hash);
 
-            if (dbInbox.Open("cw")) {
-                if (dbInbox.ExistsSmesg(chKey)) {
-                    fExisted = true;
-                    LogPrint(BCLog::SMSG, "Message already exists in inbox db.\n");
-                } else {
-                    dbInbox.WriteSmesg(chKey, smsgInbox);
-                    if (reportToGui) {
-                        NotifySecMsgInboxChanged(smsgInbox);
-                    }
-                    LogPrintf("SecureMsg saved to inbox, received with %s.\n", EncodeDestination(PKHash(addressTo)));
+    uint8_t chKey[30];
+    int64_t timestamp_be = (int64_t)htobe64(smsg.timestamp);
+    memcpy(&chKey[0], DBK_INBOX.data(), 2);
+    memcpy(&chKey[2], &timestamp_be, 8);
+    memcpy(&chKey[10], hash.begin(), 20);
+
+    SecMsgStored smsgInbox;
+    smsgInbox.timeReceived  = GetTime();
+    smsgInbox.status        = (SMSG_MASK_UNREAD) & 0xFF;
+    smsgInbox.addrTo        = addressTo;
+
+    try { smsgInbox.vchMessage.resize(SMSG_HDR_LEN + nPayload); } catch (std::exception &e) {
+        return errorN(SMSG_ALLOCATE_FAILED, "%s: Could not resize vchData, %u, %s.", __func__, SMSG_HDR_LEN + nPayload, e.what());
+    }
+    memcpy(&smsgInbox.vchMessage[0], pHeader, SMSG_HDR_LEN);
+    memcpy(&smsgInbox.vchMessage[SMSG_HDR_LEN], pPayload, nPayload);
+
+    bool fExisted = false;
+    {
+        LOCK(cs_smsgDB);
+        SecMsgDB dbInbox;
+
+        if (dbInbox.Open("cw")) {
+            if (dbInbox.ExistsSmesg(chKey)) {
+                fExisted = true;
+                LogPrint(BCLog::SMSG, "Message already exists in inbox db.\n");
+            } else {
+                dbInbox.TxnBegin();
+                dbInbox.WriteSmesg(chKey, smsgInbox);
+                if (pMeta) {
+                    dbInbox.WriteSmesgMeta(chKey, *pMeta);
                 }
+                dbInbox.TxnCommit();
+                if (reportToGui) {
+                    NotifySecMsgInboxChanged(smsgInbox);
+                }
+                LogPrintf("SecureMsg saved to inbox, received with %s.\n", EncodeDestination(PKHash(addressTo)));
             }
-        } // cs_smsgDB
+        }
+    } // cs_smsgDB
 
 #if HAVE_SYSTEM
-        if (!fExisted) {
-            // notify an external script when a message comes in
-            std::string strCmd = gArgs.GetArg("-smsgnotify", "");
-
-            //TODO: Format message
-            if (!strCmd.empty()) {
-                boost::replace_all(strCmd, "%s", HexStr(Span<const unsigned char>(&chKey[2], 28)));
-                std::thread t(runCommand, strCmd);
-                t.detach(); // thread runs free
-            }
+    if (!fExisted) {
+        // notify an external script when a message comes in
+        std::string strCmd = gArgs.GetArg("-smsgnotify", "");
 
-            GetMainSignals().NewSecureMessage(&smsg, hash);
+        //TODO: Format message
+        if (!strCmd.empty()) {
+            boost::replace_all(strCmd, "%s", HexStr(Span<const unsigned char>(&chKey[2], 28)));
+            std::thread t(runCommand, strCmd);
+            t.detach(); // thread runs free
         }
-#endif
+
+        GetMainSignals().NewSecureMessage(&smsg, hash);
     }
+#endif
 
     return SMSG_NO_ERROR;
 };
@@ -2924,8 +3280,8 @@ int CSMSG::ReadSmsgKey(const CKeyID &idk, CKey &key)
 
 int CSMSG::Retrieve(const SecMsgToken &token, std::vector<uint8_t> &vchData)
 {
+    AssertLockHeld(buckets.GetMutex(token.timestamp));
     LogPrint(BCLog::SMSG, "%s: %d.\n", __func__, token.timestamp);
-    AssertLockHeld(cs_smsg);
 
     fs::path pathSmsgDir = gArgs.GetDataDirNet() / fs::PathFromString(STORE_DIR);
 
@@ -2974,8 +3330,8 @@ int CSMSG::Retrieve(const SecMsgToken &token, std::vector<uint8_t> &vchData)
 
 int CSMSG::Remove(const SecMsgToken &token)
 {
+    AssertLockHeld(buckets.GetMutex(token.timestamp));
     LogPrint(BCLog::SMSG, "%s: %d.\n", __func__, token.timestamp);
-    AssertLockHeld(cs_smsg);
 
     unsigned char header_buffer[SMSG_HDR_LEN];
 
@@ -3083,19 +3439,16 @@ int CSMSG::Receive(PeerManager *peerLogic, CNode *pfrom, std::vector<uint8_t> &v
         LogPrintf("Error: Invalid message bunch received for bucket %d: %d, %d.\n", bktTime, nBunch, vchData.size());
         SmsgMisbehaving(pfrom, 20);
 
-        {
-            LOCK(cs_smsg);
-            // Release lock on bucket if it exists
-            auto itb = buckets.find(bktTime);
-            if (itb != buckets.end()) {
-                itb->second.nLockCount = 0;
-                itb->second.nLockPeerId = -1;
-            }
-        } // cs_smsg
+        // Release lock on bucket if it exists
+        buckets.Modify(bktTime, [](SecMsgBucket &bucket) {
+            bucket.nLockCount = 0;
+            bucket.nLockPeerId = -1;
+        });
         return SMSG_GENERAL_ERROR;
     }
 
     uint32_t n = 12;
+    std::vector<SecMsgScanItem> items;
 
     for (uint32_t i = 0; i < nBunch; ++i) {
         if (vchData.size() - n < SMSG_HDR_LEN) {
@@ -3139,42 +3492,39 @@ int CSMSG::Receive(PeerManager *peerLogic, CNode *pfrom, std::vector<uint8_t> &v
             continue;
         }
 
-        {
-            LOCK(cs_smsg);
-            // Store message, but don't hash bucket
-            if (Store(&vchData[n], &vchData[n + SMSG_HDR_LEN], smsg.nPayload, false) != 0) {
-                // Message dropped
-                break;
-            }
-
-            bool fOwnMessage;
-            if (ScanMessage(&vchData[n], &vchData[n + SMSG_HDR_LEN], smsg.nPayload, true, fOwnMessage) != 0) {
-                // message recipient is not this node (or failed)
-            }
-        } // cs_smsg
+        // Store message, but don't hash bucket
+        if (Store(&vchData[n], &vchData[n + SMSG_HDR_LEN], smsg.nPayload, false) != 0) {
+            // Message dropped
+            break;
+        }
+        items.emplace_back(&vchData[n], &vchData[n + SMSG_HDR_LEN], smsg.nPayload);
 
         n += SMSG_HDR_LEN + smsg.nPayload;
     }
 
     {
         LOCK(cs_smsg);
-        // If messages have been added, bucket must exist now
-        auto itb = buckets.find(bktTime);
-        if (itb == buckets.end()) {
-            LogPrint(BCLog::SMSG, "Don't have bucket %d.\n", bktTime);
-            return SMSG_GENERAL_ERROR;
-        }
-
-        itb->second.nLockCount  = 0; // This node has received data from peer, release lock
-        itb->second.nLockPeerId = -1;
-        itb->second.hashBucket(itb->first);
+        // Trial decrypt the stored messages of the bunch together
+        ScanMessages(items, true);
     } // cs_smsg
 
+    // If messages have been added, bucket must exist now
+    bool fHaveBucket = buckets.Modify(bktTime, [&](SecMsgBucket &bucket) {
+        bucket.nLockCount  = 0; // This node has received data from peer, release lock
+        bucket.nLockPeerId = -1;
+        bucket.hashBucket(bktTime);
+    });
+    if (!fHaveBucket) {
+        LogPrint(BCLog::SMSG, "Don't have bucket %d.\n", bktTime);
+        return SMSG_GENERAL_ERROR;
+    }
+
     return SMSG_NO_ERROR;
 };
 
 int CSMSG::CheckPurged(const SecureMessage *psmsg, const uint8_t *pPayload)
 {
+    LOCK(cs_smsg);
     int64_t ts = psmsg->timestamp; // ubsan
     if (setPurgedTimestamps.find(ts) != setPurgedTimestamps.end()) {
         return SMSG_NO_ERROR;
@@ -3187,7 +3537,7 @@ int CSMSG::CheckPurged(const SecureMessage *psmsg, const uint8_t *pPayload)
     chKey[1] = DBK_PURGED_TOKEN[1];
     memcpy(chKey+2, vMsgId.data(), 28);
 
-    LOCK2(cs_smsg, cs_smsgDB);
+    LOCK(cs_smsgDB);
 
     SecMsgDB db;
     if (!db.Open("cr+")) {
@@ -3267,7 +3617,6 @@ int CSMSG::StoreUnscanned(const uint8_t *pHeader, const uint8_t *pPayload, uint3
 int CSMSG::Store(const uint8_t *pHeader, const uint8_t *pPayload, uint32_t nPayload, bool fHashBucket)
 {
     LogPrint(BCLog::SMSG, "%s\n", __func__);
-    AssertLockHeld(cs_smsg);
 
     if (!pHeader || !pPayload) {
         return errorN(SMSG_GENERAL_ERROR, "Null pointer to header or payload.");
@@ -3301,51 +3650,61 @@ int CSMSG::Store(const uint8_t *pHeader, const uint8_t *pPayload, uint32_t nPayl
     SecMsgToken token(smsg.timestamp, pPayload, nPayload, 0, nTTL);
     token.m_changed = now - bucketTime;
 
-    SecMsgBucket &bucket = buckets[bucketTime];
-    std::set<SecMsgToken> &tokenSet = bucket.setTokens;
-    if (tokenSet.find(token) != tokenSet.end()) {
-        LogPrint(BCLog::SMSG, "Already have message.\n");
-        if (LogAcceptCategory(BCLog::SMSG)) {
-            LogPrintf("bucketTime: %d\n", bucketTime);
-            LogPrintf("Message token: %s, nPayload %u\n", token.ToString(), nPayload);
+    // The bucket lock is held while appending, so the bucket file and its tokens stay consistent
+    int rv = SMSG_NO_ERROR;
+    buckets.Modify(bucketTime, [&](SecMsgBucket &bucket) {
+        std::set<SecMsgToken> &tokenSet = bucket.setTokens;
+        if (tokenSet.find(token) != tokenSet.end()) {
+            LogPrint(BCLog::SMSG, "Already have message.\n");
+            if (LogAcceptCategory(BCLog::SMSG)) {
+                LogPrintf("bucketTime: %d\n", bucketTime);
+                LogPrintf("Message token: %s, nPayload %u\n", token.ToString(), nPayload);
+            }
+            rv = SMSG_GENERAL_ERROR;
+            return;
         }
-        return SMSG_GENERAL_ERROR;
-    }
 
-    std::string fileName = ToString(bucketTime) + "_01.dat";
-    fs::path fullpath = pathSmsgDir / fs::PathFromString(fileName);
+        std::string fileName = ToString(bucketTime) + "_01.dat";
+        fs::path fullpath = pathSmsgDir / fs::PathFromString(fileName);
 
-    FILE *fp;
-    errno = 0;
-    if (!(fp = fopen(fs::PathToString(fullpath).c_str(), "ab"))) {
-        return errorN(SMSG_GENERAL_ERROR, "fopen failed: %s.", strerror(errno));
-    }
+        FILE *fp;
+        errno = 0;
+        if (!(fp = fopen(fs::PathToString(fullpath).c_str(), "ab"))) {
+            rv = errorN(SMSG_GENERAL_ERROR, "fopen failed: %s.", strerror(errno));
+            return;
+        }
 
-    // On windows ftell will always return 0 after fopen(ab), call fseek to set.
-    errno = 0;
-    if (fseek(fp, 0, SEEK_END) != 0) {
-        fclose(fp);
-        return errorN(SMSG_GENERAL_ERROR, "fseek failed: %s.", strerror(errno));
-    }
+        // On windows ftell will always return 0 after fopen(ab), call fseek to set.
+        errno = 0;
+        if (fseek(fp, 0, SEEK_END) != 0) {
+            fclose(fp);
+            rv = errorN(SMSG_GENERAL_ERROR, "fseek failed: %s.", strerror(errno));
+            return;
+        }
 
-    ofs = ftell(fp);
-    if (fwrite(pHeader,  sizeof(uint8_t), SMSG_HDR_LEN, fp) != (size_t)SMSG_HDR_LEN
-        || fwrite(pPayload, sizeof(uint8_t), nPayload, fp) != nPayload) {
-        fclose(fp);
-        return errorN(SMSG_GENERAL_ERROR, "fwrite failed: %s.", strerror(errno));
-    }
+        ofs = ftell(fp);
+        if (fwrite(pHeader,  sizeof(uint8_t), SMSG_HDR_LEN, fp) != (size_t)SMSG_HDR_LEN
+            || fwrite(pPayload, sizeof(uint8_t), nPayload, fp) != nPayload) {
+            fclose(fp);
+            rv = errorN(SMSG_GENERAL_ERROR, "fwrite failed: %s.", strerror(errno));
+            return;
+        }
 
-    fclose(fp);
+        fclose(fp);
 
-    token.offset = ofs;
-    tokenSet.insert(token);
+        token.offset = ofs;
+        tokenSet.insert(token);
 
-    if (nTTL > 0 && (bucket.nLeastTTL == 0 || nTTL < bucket.nLeastTTL)) {
-        bucket.nLeastTTL = nTTL;
-    }
+        if (nTTL > 0 && (bucket.nLeastTTL == 0 || nTTL < bucket.nLeastTTL)) {
+            bucket.nLeastTTL = nTTL;
+        }
 
-    if (fHashBucket) {
-        bucket.hashBucket(bucketTime);
+        if (fHashBucket) {
+            bucket.hashBucket(bucketTime);
+        }
+    }, true);
+    if (rv != SMSG_NO_ERROR) {
+        return rv;
     }
 
     LogPrint(BCLog::SMSG, "SecureMsg added to bucket %d.\n", bucketTime);
@@ -3387,36 +3746,37 @@ int CSMSG::Purge(std::vector<uint8_t> &vMsgId, std::string &sError)
     // Find in buckets
     int64_t bucketTime = msgtime - (msgtime % SMSG_BUCKET_LEN);
 
-    SecMsgBucket &bucket = buckets[bucketTime];
-    std::set<SecMsgToken> &tokenSet = bucket.setTokens;
+    buckets.Modify(bucketTime, [&](SecMsgBucket &bucket) {
+        std::set<SecMsgToken> &tokenSet = bucket.setTokens;
 
-    std::vector<uint8_t> vchOne;
-    for (auto it = tokenSet.begin(); it != tokenSet.end(); ++it) {
-        if (it->timestamp != msgtime) {
-            continue;
-        }
+        std::vector<uint8_t> vchOne;
+        for (auto it = tokenSet.begin(); it != tokenSet.end(); ++it) {
+            if (it->timestamp != msgtime) {
+                continue;
+            }
 
-        if (Retrieve(*it, vchOne) != SMSG_NO_ERROR) {
-            LogPrintf("%s: Retrieve failed, msgid: %s\n", __func__, HexStr(vMsgId));
-            continue;
-        }
+            if (Retrieve(*it, vchOne) != SMSG_NO_ERROR) {
+                LogPrintf("%s: Retrieve failed, msgid: %s\n", __func__, HexStr(vMsgId));
+                continue;
+            }
 
-        SecureMessage smsg(vchOne.data());
-        if (GetMsgID(&smsg, vchOne.data() + SMSG_HDR_LEN) != vMsgId) {
-            continue;
-        }
+            SecureMessage smsg(vchOne.data());
+            if (GetMsgID(&smsg, vchOne.data() + SMSG_HDR_LEN) != vMsgId) {
+                continue;
+            }
+
+            if (Remove(*it) != SMSG_NO_ERROR) {
+                LogPrintf("%s: Remove failed, msgid: %s\n", __func__, HexStr(vMsgId));
+                break;
+            }
+            //memcpy(purged.sample, vchOne.data() + SMSG_HDR_LEN, 8);
+            it->ttl = 0;
+            LogPrint(BCLog::SMSG, "Purged message %s in bucket %d\n", it->ToString(), bucketTime);
+            memcpy(purged.sample, it->sample, 8);
 
-        if (Remove(*it) != SMSG_NO_ERROR) {
-            LogPrintf("%s: Remove failed, msgid: %s\n", __func__, HexStr(vMsgId));
             break;
         }
-        //memcpy(purged.sample, vchOne.data() + SMSG_HDR_LEN, 8);
-        it->ttl = 0;
-        LogPrint(BCLog::SMSG, "Purged message %s in bucket %d\n", it->ToString(), bucketTime);
-        memcpy(purged.sample, it->sample, 8);
-
-        break;
-    }
+    });
 
     chKey[0] = 'p';
     db.WritePurged(chKey, purged);
@@ -3442,15 +3802,14 @@ int CSMSG::AdjustDifficulty(int64_t time)
 
     int rv = 0;
     for (auto bucket_time : bucket_times) {
-        auto it = buckets.find(bucket_time);
-        if (it != buckets.end()) {
-            if (it->second.nActive > excessive_messages) {
-                rv += -1 * 10000 * float(it->second.nActive / excessive_messages);
+        buckets.Read(bucket_time, [&](const SecMsgBucket &bucket) {
+            if (bucket.nActive > excessive_messages) {
+                rv += -1 * 10000 * float(bucket.nActive / excessive_messages);
             } else
-            if (it->second.nActive < few_messages) {
+            if (bucket.nActive < few_messages) {
                 rv += 1 * 10000;
             }
-        }
+        });
     }
 
     return rv;
@@ -3484,7 +3843,7 @@ int CSMSG::StoreFundingTx(const CTransaction &tx, const CBlockIndex *pindex)
         if (!data->IsVersion(DataTypes::OUTPUT_DATA)) {
             continue;
         }
-        const std::vector<uint8_t> &output_data = *data->GetPData();
+        const CTxDataBytes &output_data = *data->GetPData();
         if (output_data.size() < 25 || output_data[0] != DO_FUND_MSG) {
             continue;
         }
@@ -4191,7 +4550,10 @@ int CSMSG::Send(CKeyID &addressFrom, CKeyID &addressTo, std::string &message,
                 SecMsgDB dbSent;
 
                 if (dbSent.Open("cw")) {
+                    dbSent.TxnBegin();
                     dbSent.WriteSmesg(chKey, smsgOutbox);
+                    dbSent.WriteSmesgMeta(chKey, SecMsgMeta(addressFrom));
+                    dbSent.TxnCommit();
                     NotifySecMsgOutboxChanged(smsgOutbox);
                 }
             } // cs_smsgDB
@@ -4369,31 +4731,15 @@ int CSMSG::Decrypt(bool fTestOnly, const CKey &keyDest, const CKeyID &address, c
         return errorN(SMSG_GENERAL_ERROR, "%s: secp256k1_ec_pubkey_parse failed: %s.", __func__, HexStr(Span<const unsigned char>(smsg.cpkR, 33)));
     }
 
-    uint256 P;
-    if (!secp256k1_ecdh(secp256k1_context_smsg, P.begin(), &R, keyDest.begin(), nullptr, nullptr)) {
-        return errorN(SMSG_GENERAL_ERROR, "%s: secp256k1_ecdh failed.", __func__);
-    }
-
     // Use public key P to calculate the SHA512 hash H.
     //  The first 32 bytes of H are called key_e and the last 32 bytes are called key_m.
-    std::vector<uint8_t> vchHashedDec;
-    vchHashedDec.resize(64);    // 512 bits
-    memset(vchHashedDec.data(), 0, 64);
-    CSHA512().Write(P.begin(), 32).Finalize(&vchHashedDec[0]);
+    std::vector<uint8_t> vchHashedDec(64); // 512 bits
+    if (!DeriveSharedKeys(R, keyDest, vchHashedDec.data())) {
+        return errorN(SMSG_GENERAL_ERROR, "%s: secp256k1_ecdh failed.", __func__);
+    }
     std::vector<uint8_t> key_e(&vchHashedDec[0], &vchHashedDec[0]+32);
-    std::vector<uint8_t> key_m(&vchHashedDec[32], &vchHashedDec[32]+32);
-
-    // Message authentication code, (hash of timestamp + iv + destination + payload)
-    uint8_t MAC[32];
-
-    CHMAC_SHA256 ctx(key_m.data(), 32);
-    int64_t tmp64 = htole64(smsg.timestamp);
-    ctx.Write((uint8_t*) &tmp64, sizeof(tmp64));
-    ctx.Write((uint8_t*) smsg.iv, sizeof(smsg.iv));
-    ctx.Write((uint8_t*) pPayload, nPayload);
-    ctx.Finalize(MAC);
 
-    if (part::memcmp_nta(MAC, smsg.mac, 32) != 0) {
+    if (!CheckMac(smsg, &vchHashedDec[32], pPayload, nPayload)) {
         LogPrint(BCLog::SMSG, "MAC does not match.\n"); // expected if message is not to address on node
         return SMSG_MAC_MISMATCH;
     }
@@ -4447,6 +4793,7 @@ int CSMSG::Decrypt(bool fTestOnly, const CKey &keyDest, const CKeyID &address, c
     if (fFromAnonymous) {
         // Anonymous sender
         msg.sFromAddress = "anon";
+        msg.addrFrom.SetNull();
     } else {
         std::vector<uint8_t> vchUint160;
         vchUint160.resize(20);
@@ -4494,6 +4841,7 @@ int CSMSG::Decrypt(bool fTestOnly, const CKey &keyDest, const CKeyID &address, c
         }
 
         msg.sFromAddress = EncodeDestination(PKHash(ckidFrom));
+        msg.addrFrom = ckidFrom;
     }
 
     if (LogAcceptCategory(BCLog::SMSG)) {
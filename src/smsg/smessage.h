@@ -17,6 +17,7 @@
 #include <interfaces/node.h>
 #include <util/ui_change_type.h>
 
+#include <array>
 #include <atomic>
 #include <boost/signals2/signal.hpp>
 
@@ -28,12 +29,14 @@ class CNode;
 class PeerManager;
 class CBlockIndex;
 typedef int64_t NodeId;
+typedef struct secp256k1_context_struct secp256k1_context;
 
 extern RecursiveMutex cs_main;
 
 namespace smsg {
 
-const int SMSG_VERSION = 1;
+const int SMSG_VERSION = 2;
+const int SMSG_RANGES_VERSION = 2;                      // peers reconcile buckets by token range (smsgShowRng) from this version
 
 enum SecureMessageCodes {
     SMSG_NO_ERROR = 0,
@@ -99,6 +102,15 @@ const uint32_t SMSG_MAX_MSG_BYTES_PAID = 512 * 1024;    // the user input part (
 const uint32_t SMSG_MAX_MSG_WORST = LZ4_COMPRESSBOUND(SMSG_MAX_MSG_BYTES+SMSG_PL_HDR_LEN);
 const uint32_t SMSG_MAX_MSG_WORST_PAID = LZ4_COMPRESSBOUND(SMSG_MAX_MSG_BYTES_PAID+SMSG_PL_HDR_LEN);
 
+const size_t SMSG_MAX_SCAN_THREADS = 8;                 // worker threads trial decrypting a batch of messages
+const size_t SMSG_MIN_PARALLEL_TRIALS = 256;            // key x message trials below which a batch is scanned on the calling thread
+const size_t SMSG_SCAN_KEY_CHUNK = 32;                  // keys a worker trials against one message per unit of work
+const size_t SMSG_SCAN_BATCH_BYTES = 16 * 1024 * 1024;  // bucket file data read into memory per scanned batch
+
+const uint32_t SMSG_BUCKET_SHARDS = 16;                 // independently locked partitions of the bucket set
+const uint32_t SMSG_SYNC_RANGES = 64;                   // token ranges of a bucket compared by smsgShowRng
+const uint32_t SMSG_SYNC_MIN_ACTIVE = 32;               // below this many active messages a bucket is listed in full
+
 const int32_t ACCEPT_FUNDING_TX_DEPTH = 1;
 const int64_t KEEP_FUNDING_TX_DATA = 86400 * 31;
 const int64_t PRUNE_FUNDING_TX_DATA = 3600;
@@ -228,6 +240,7 @@ public:
     int64_t               timestamp;
     std::string           sToAddress;
     std::string           sFromAddress;
+    CKeyID                addrFrom;   // null when sent anonymously
     std::vector<uint8_t>  vchMessage; // null terminated plaintext
 };
 
@@ -320,16 +333,140 @@ public:
     void hashBucket(int64_t bucket_time);
     size_t CountActive() const;
 
+    /** Token range a message falls in when reconciling buckets, the sample is uniformly distributed ciphertext */
+    static uint32_t RangeIndex(const SecMsgToken &token) { return token.sample[0] % SMSG_SYNC_RANGES; };
+    /** Ranges in which a peer with the given range hashes holds different tokens than this bucket */
+    std::array<bool, SMSG_SYNC_RANGES> MismatchedRanges(const std::array<uint32_t, SMSG_SYNC_RANGES> &peerRangeHashes) const;
+    /** Active tokens in the selected ranges that changed since last_shown, in token order */
+    std::vector<const SecMsgToken*> TokensToShow(int64_t bucket_time, int64_t now, int64_t last_shown,
+                                                 const std::array<bool, SMSG_SYNC_RANGES> &fRanges) const;
+
     int64_t               timeChanged;
     uint32_t              hash;           // token set should get ordered the same on each node
     uint32_t              nLeastTTL;      // lowest ttl in seconds of messages in bucket
     uint32_t              nActive;        // Number of untimedout messages in bucket
     uint32_t              nLockCount;     // set when smsgWant first sent, unset at end of smsgMsg, ticks down in ThreadSecureMsg()
     NodeId                nLockPeerId;    // id of peer that bucket is locked for
+    std::array<uint32_t, SMSG_SYNC_RANGES> rangeHashes{}; // order independent hash of the active tokens in each range
 
     std::set<SecMsgToken> setTokens;
 };
 
+/** The fields of a bucket inventories are built from */
+class SecMsgBucketInfo
+{
+public:
+    int64_t  time;
+    int64_t  timeChanged;
+    uint32_t hash;
+    uint32_t nActive;
+};
+
+/** The message buckets, sharded by bucket time.
+ *
+ * Every shard has its own lock, which covers the tokens of its buckets and their bucket files, so peer sync,
+ * local sends and scans working on different buckets don't serialize on cs_smsg. A shard lock is always taken
+ * last and only one is held at a time, fn must not access the bucket set again.
+ * Inventories are built from Snapshot(), a copy of the bucket summaries that is only rebuilt after a change.
+ */
+class SecMsgBucketSet
+{
+private:
+    class Shard
+    {
+    public:
+        mutable Mutex cs;
+        std::map<int64_t, SecMsgBucket> buckets GUARDED_BY(cs);
+    };
+    std::array<Shard, SMSG_BUCKET_SHARDS> m_shards;
+
+    std::atomic<uint64_t> m_changes{0};
+    mutable Mutex cs_snapshot;
+    mutable std::shared_ptr<const std::vector<SecMsgBucketInfo>> m_snapshot GUARDED_BY(cs_snapshot);
+    mutable uint64_t m_snapshot_changes GUARDED_BY(cs_snapshot) = 0;
+
+    Shard &GetShard(int64_t time) { return m_shards[(uint64_t)(time / SMSG_BUCKET_LEN) % SMSG_BUCKET_SHARDS]; };
+    const Shard &GetShard(int64_t time) const { return m_shards[(uint64_t)(time / SMSG_BUCKET_LEN) % SMSG_BUCKET_SHARDS]; };
+
+public:
+    /** Call fn with the bucket at time under its lock, returns false if there is no such bucket */
+    template <typename Fn>
+    bool Read(int64_t time, Fn fn) const
+    {
+        const Shard &shard = GetShard(time);
+        LOCK(shard.cs);
+        const auto it = shard.buckets.find(time);
+        if (it == shard.buckets.end()) {
+            return false;
+        }
+        fn(it->second);
+        return true;
+    };
+
+    /** As Read, for changing the bucket, which is created first if fCreate is set */
+    template <typename Fn>
+    bool Modify(int64_t time, Fn fn, bool fCreate = false)
+    {
+        Shard &shard = GetShard(time);
+        LOCK(shard.cs);
+        auto it = shard.buckets.find(time);
+        if (it == shard.buckets.end()) {
+            if (!fCreate) {
+                return false;
+            }
+            it = shard.buckets.emplace(time, SecMsgBucket()).first;
+        }
+        fn(it->second);
+        m_changes++;
+        return true;
+    };
+
+    /** Call fn(time, bucket) for all buckets in time order, locking one bucket at a time */
+    template <typename Fn>
+    void ForEach(Fn fn) const
+    {
+        for (int64_t time : GetTimes()) {
+            const Shard &shard = GetShard(time);
+            LOCK(shard.cs);
+            const auto it = shard.buckets.find(time);
+            if (it != shard.buckets.end()) {
+                fn(it->first, it->second);
+            }
+        }
+    };
+
+    /** As ForEach, for changing the buckets. Buckets fn returns false for are erased. */
+    template <typename Fn>
+    void ModifyEach(Fn fn)
+    {
+        for (int64_t time : GetTimes()) {
+            Shard &shard = GetShard(time);
+            LOCK(shard.cs);
+            auto it = shard.buckets.find(time);
+            if (it == shard.buckets.end()) {
+                continue;
+            }
+            SecMsgBucket &bucket = it->second;
+            const SecMsgBucketInfo before{time, bucket.timeChanged, bucket.hash, bucket.nActive};
+            if (!fn(it->first, bucket)) {
+                shard.buckets.erase(it);
+                m_changes++;
+            } else if (bucket.timeChanged != before.timeChanged || bucket.hash != before.hash || bucket.nActive != before.nActive) {
+                // Only what Snapshot reports counts as a change
+                m_changes++;
+            }
+        }
+    };
+
+    /** The lock of the bucket at time, Retrieve and Remove need it held */
+    Mutex &GetMutex(int64_t time) const { return GetShard(time).cs; };
+
+    std::vector<int64_t> GetTimes() const;
+    std::shared_ptr<const std::vector<SecMsgBucketInfo>> Snapshot() const;
+    size_t size() const;
+    void clear();
+};
+
 class SecMsgAddress
 {
 public:
@@ -418,15 +555,80 @@ public:
     };
 };
 
+/** Decrypted header data of an inbox or outbox message, kept so it can be indexed without decrypting the message */
+class SecMsgMeta
+{
+public:
+    SecMsgMeta() {};
+    explicit SecMsgMeta(const CKeyID &addrFromIn) : addrFrom(addrFromIn) {};
+
+    CKeyID addrFrom; // null when sent anonymously
+
+    template<typename Stream>
+    void Serialize(Stream &s) const
+    {
+        s << addrFrom;
+    };
+    template <typename Stream>
+    void Unserialize(Stream &s)
+    {
+        s >> addrFrom;
+    };
+};
+
+/** A receiving key, fetched once for a batch of messages instead of for every trial */
+class SecMsgTrialKey
+{
+public:
+    SecMsgTrialKey(const CKeyID &addressIn, const CKey &keyIn, bool fReceiveAnonIn)
+        : address(addressIn), key(keyIn), fReceiveAnon(fReceiveAnonIn) {};
+
+    CKeyID address;
+    CKey key;
+    bool fReceiveAnon;
+};
+
+/** A message to be scanned by ScanMessages, and the result of the scan */
+class SecMsgScanItem
+{
+public:
+    SecMsgScanItem(const uint8_t *pHeaderIn, const uint8_t *pPayloadIn, uint32_t nPayloadIn)
+        : pHeader(pHeaderIn), pPayload(pPayloadIn), nPayload(nPayloadIn) {};
+
+    const uint8_t *pHeader;
+    const uint8_t *pPayload;
+    uint32_t nPayload;
+
+    int rv = SMSG_GENERAL_ERROR;
+    bool fOwnMessage = false;
+};
+
+/** Progress of the latest ScanBuckets run, an interrupted run can be resumed after the last completed file */
+class SecMsgScanProgress
+{
+public:
+    int64_t nResumeFileTime = 0;
+    std::string sResumeFile;
+    uint32_t nFiles = 0;
+    uint32_t nFilesTotal = 0;
+    uint32_t nMessages = 0;
+    uint32_t nFoundMessages = 0;
+    bool fComplete = true;
+};
+
 void AddOptions(ArgsManager& argsman);
 const char *GetString(size_t errorCode);
 
 extern std::atomic<bool> fSecMsgEnabled;
+//! Context for the ECDH of messages, created by CSMSG::Start
+extern secp256k1_context *secp256k1_context_smsg;
+
 class CSMSG
 {
 public:
     int BuildBucketSet();
     int BuildPurgedSets();
+    int BuildMessageIndexes();
     int AddWalletAddresses();
     int LoadKeyStore();
 
@@ -456,13 +658,17 @@ public:
     bool ScanBlock(const CBlock &block);
     bool ScanChainForPublicKeys(CBlockIndex *pindexStart);
     bool ScanBlockChain();
-    bool ScanBuckets(bool scan_all);
+    bool ScanBuckets(bool scan_all, bool resume=false);
+    SecMsgScanProgress GetScanProgress();
 
     int ManageLocalKey(CKeyID &keyId, ChangeType mode);
     int WalletUnlocked(CWallet *pwallet);
     int WalletKeyChanged(CKeyID &keyId, const std::string &sLabel, ChangeType mode);
 
+    int GetTrialKeys(std::vector<SecMsgTrialKey> &keys, bool &was_locked);
+    int ScanMessages(std::vector<SecMsgScanItem> &items, bool reportToGui, bool unlocking=false);
     int ScanMessage(const uint8_t *pHeader, const uint8_t *pPayload, uint32_t nPayload, bool reportToGui, bool &received_msg, bool unlocking=false);
+    int StoreReceived(const uint8_t *pHeader, const uint8_t *pPayload, uint32_t nPayload, const CKeyID &addressTo, const SecMsgMeta *pMeta, bool reportToGui);
 
     int GetStoredKey(const CKeyID &ckid, CPubKey &cpkOut);
     int GetLocalKey(const CKeyID &ckid, CPubKey &cpkOut);
@@ -479,8 +685,9 @@ public:
 
     int ReadSmsgKey(const CKeyID &idk, CKey &key);
 
-    int Retrieve(const SecMsgToken &token, std::vector<uint8_t> &vchData) EXCLUSIVE_LOCKS_REQUIRED(cs_smsg);
-    int Remove(const SecMsgToken &token) EXCLUSIVE_LOCKS_REQUIRED(cs_smsg);
+    // Must be called under the lock of the token's bucket, see SecMsgBucketSet::GetMutex
+    int Retrieve(const SecMsgToken &token, std::vector<uint8_t> &vchData);
+    int Remove(const SecMsgToken &token);
 
     int SmsgMisbehaving(CNode *pfrom, uint8_t n);
     int Receive(PeerManager *peerLogic, CNode *pfrom, std::vector<uint8_t> &vchData);
@@ -488,8 +695,8 @@ public:
     int CheckPurged(const SecureMessage *psmsg, const uint8_t *pPayload);
 
     int StoreUnscanned(const uint8_t *pHeader, const uint8_t *pPayload, uint32_t nPayload);
-    int Store(const uint8_t *pHeader, const uint8_t *pPayload, uint32_t nPayload, bool fHashBucket) EXCLUSIVE_LOCKS_REQUIRED(cs_smsg);
-    int Store(const SecureMessage &smsg, bool fHashBucket) EXCLUSIVE_LOCKS_REQUIRED(cs_smsg);
+    int Store(const uint8_t *pHeader, const uint8_t *pPayload, uint32_t nPayload, bool fHashBucket);
+    int Store(const SecureMessage &smsg, bool fHashBucket);
 
     int Purge(std::vector<uint8_t> &vMsgId, std::string &sError);
 
@@ -523,10 +730,10 @@ public:
     int Decrypt(bool fTestOnly, const CKeyID &address, const uint8_t *pHeader, const uint8_t *pPayload, uint32_t nPayload, MessageData &msg);
     int Decrypt(bool fTestOnly, const CKeyID &address, const SecureMessage &smsg, MessageData &msg);
 
-    RecursiveMutex cs_smsg; // All except inbox and outbox
+    RecursiveMutex cs_smsg; // All except inbox, outbox and buckets
 
     SecMsgKeyStore keyStore;
-    std::map<int64_t, SecMsgBucket> buckets;
+    SecMsgBucketSet buckets;
     std::vector<SecMsgAddress> addresses;
     std::set<SecMsgPurged> setPurged;
     std::set<int64_t> setPurgedTimestamps;
@@ -537,13 +744,16 @@ public:
     std::unique_ptr<interfaces::Handler> m_wallet_load_handler;
 
     int64_t start_time = 0;
-    int64_t m_last_changed = 0;  // Updated whenever a message is stored
+    std::atomic<int64_t> m_last_changed{0};  // Updated whenever a message is stored
     int64_t nLastProcessedPurged = 0;
     CAmount m_absurd_smsg_fee = 500 * COIN;
     uint16_t m_smsg_max_receive_count = SMSG_DEFAULT_MAXRCV;
 
     std::map<int64_t, int64_t> m_show_requests;
 
+    Mutex cs_scan_progress;
+    SecMsgScanProgress m_scan_progress GUARDED_BY(cs_scan_progress);
+
     CThreadInterrupt m_thread_interrupt;
     std::thread thread_smsg;
     std::thread thread_smsg_pow;
@@ -13,6 +13,7 @@
 #include <util/strencodings.h>
 #include <util/threadnames.h>
 
+#include <algorithm>
 #include <map>
 #include <set>
 #include <system_error>
@@ -32,6 +33,122 @@ void PrintLockContention(const char* pszName, const char* pszFile, int nLine)
 }
 #endif /* DEBUG_LOCKCONTENTION */
 
+std::atomic<bool> g_lock_stats{false};
+std::atomic<uint64_t> g_lock_stats_untracked{0};
+
+//! Room for every LOCK in the tree, a site per translation unit for those in headers, and
+//! one per object for the sites locking a member of the peers or other objects
+static constexpr size_t LOCK_SITES = 4096;
+static constexpr size_t LOCK_SITES_MAX_PROBES = 64;
+static LockSiteStats g_lock_sites[LOCK_SITES];
+
+static int LockStatsBucket(uint64_t nTime)
+{
+    uint64_t nMicros = nTime >> 10;
+    int nBucket = 0;
+    while (nMicros && nBucket < LockSiteStats::BUCKETS - 1) {
+        nMicros >>= 1;
+        nBucket++;
+    }
+    return nBucket;
+}
+
+static void UpdateMax(std::atomic<uint64_t>& nMax, uint64_t nValue)
+{
+    uint64_t nPrev = nMax.load(std::memory_order_relaxed);
+    while (nPrev < nValue && !nMax.compare_exchange_weak(nPrev, nValue, std::memory_order_relaxed)) {
+    }
+}
+
+void LockSiteStats::AddAcquire(int64_t nWait, bool fContended)
+{
+    nCount.fetch_add(1, std::memory_order_relaxed);
+    if (!fContended)
+        return;
+    nContended.fetch_add(1, std::memory_order_relaxed);
+    nWaitTime.fetch_add(nWait, std::memory_order_relaxed);
+    UpdateMax(nMaxWaitTime, nWait);
+    vWaitHistogram[LockStatsBucket(nWait)].fetch_add(1, std::memory_order_relaxed);
+}
+
+void LockSiteStats::AddHold(int64_t nHold)
+{
+    nHoldTime.fetch_add(nHold, std::memory_order_relaxed);
+    UpdateMax(nMaxHoldTime, nHold);
+    vHoldHistogram[LockStatsBucket(nHold)].fetch_add(1, std::memory_order_relaxed);
+}
+
+LockSiteStats* GetLockSiteStats(const char* pszName, const char* pszFile, int nLine, const void* pMutex)
+{
+    // __FILE__ literals are unique per translation unit, so their address identifies the file
+    uint64_t nKey = ((reinterpret_cast<uintptr_t>(pszFile) >> 3) * 31 + nLine) * 31 + (reinterpret_cast<uintptr_t>(pMutex) >> 3);
+    size_t i = nKey * 0x9E3779B97F4A7C15ULL >> 32;
+    for (size_t n = 0; n < LOCK_SITES_MAX_PROBES; n++, i++) {
+        LockSiteStats& site = g_lock_sites[i % LOCK_SITES];
+        const char* pszSiteFile = site.pszFile.load(std::memory_order_acquire);
+        if (!pszSiteFile) {
+            if (!site.fClaimed.exchange(true)) {
+                site.pszName = pszName;
+                site.pMutex = pMutex;
+                site.nLine = nLine;
+                site.pszFile.store(pszFile, std::memory_order_release);
+                return &site;
+            }
+            // Another thread is claiming the slot, find out for which site
+            while (!(pszSiteFile = site.pszFile.load(std::memory_order_acquire))) {
+                std::this_thread::yield();
+            }
+        }
+        if (pszSiteFile == pszFile && site.nLine == nLine && site.pMutex == pMutex)
+            return &site;
+    }
+    g_lock_stats_untracked.fetch_add(1, std::memory_order_relaxed);
+    return nullptr;
+}
+
+std::vector<LockStats> GetLockStats()
+{
+    std::vector<LockStats> vStats;
+    for (const LockSiteStats& site : g_lock_sites) {
+        const char* pszFile = site.pszFile.load(std::memory_order_acquire);
+        if (!pszFile)
+            continue;
+        LockStats stats;
+        stats.strName = site.pszName;
+        stats.strFile = pszFile;
+        stats.pMutex = site.pMutex;
+        stats.nLine = site.nLine;
+        stats.nCount = site.nCount.load(std::memory_order_relaxed);
+        stats.nContended = site.nContended.load(std::memory_order_relaxed);
+        stats.nWaitTime = site.nWaitTime.load(std::memory_order_relaxed);
+        stats.nHoldTime = site.nHoldTime.load(std::memory_order_relaxed);
+        stats.nMaxWaitTime = site.nMaxWaitTime.load(std::memory_order_relaxed);
+        stats.nMaxHoldTime = site.nMaxHoldTime.load(std::memory_order_relaxed);
+        for (int i = 0; i < LockSiteStats::BUCKETS; i++) {
+            stats.vWaitHistogram[i] = site.vWaitHistogram[i].load(std::memory_order_relaxed);
+            stats.vHoldHistogram[i] = site.vHoldHistogram[i].load(std::memory_order_relaxed);
+        }
+        vStats.push_back(std::move(stats));
+    }
+    return vStats;
+}
+
+void LogLockStats(size_t nSites)
+{
+    std::vector<LockStats> vStats = GetLockStats();
+    std::sort(vStats.begin(), vStats.end(), [](const LockStats& a, const LockStats& b) {
+        return a.nWaitTime > b.nWaitTime;
+    });
+    if (vStats.size() > nSites)
+        vStats.resize(nSites);
+
+    for (const LockStats& stats : vStats) {
+        LogPrintf("Lock stats: %s at %s:%d: %u acquired, %u contended, waited %.3fms (max %.3fms), held %.3fms (max %.3fms)\n",
+            stats.strName, stats.strFile, stats.nLine, stats.nCount, stats.nContended,
+            stats.nWaitTime * 1e-6, stats.nMaxWaitTime * 1e-6, stats.nHoldTime * 1e-6, stats.nMaxHoldTime * 1e-6);
+    }
+}
+
 #ifdef DEBUG_LOCKORDER
 //
 // Early deadlock detection.
@@ -9,10 +9,14 @@
 #include <threadsafety.h>
 #include <util/macros.h>
 
+#include <array>
+#include <atomic>
+#include <chrono>
 #include <condition_variable>
 #include <mutex>
 #include <string>
 #include <thread>
+#include <vector>
 
 ////////////////////////////////////////////////
 //                                            //
@@ -128,14 +132,96 @@ typedef AnnotatedMixin<std::mutex> Mutex;
 void PrintLockContention(const char* pszName, const char* pszFile, int nLine);
 #endif
 
+/**
+ * Wait and hold times of the acquisitions of a lock at one source location, collected
+ * while g_lock_stats is set (-lockstats). A location locking a member of many objects,
+ * such as a peer's mutex, has statistics for each object it locks. Only updated with
+ * relaxed atomics, so that the instrumentation never takes a lock itself. Times are in
+ * nanoseconds.
+ *
+ * Locks taken with WAIT_LOCK record no hold time: a condition variable waiting on them
+ * releases the mutex without the lock knowing.
+ */
+struct LockSiteStats
+{
+    //! Histogram bucket i counts the times up to 2^i microseconds, the last one all longer times
+    static constexpr int BUCKETS = 24;
+
+    std::atomic<const char*> pszFile{nullptr};
+    const char* pszName{nullptr};
+    //! The mutex acquired, telling apart locks of the same name
+    const void* pMutex{nullptr};
+    int nLine{0};
+    std::atomic<bool> fClaimed{false};
+
+    std::atomic<uint64_t> nCount{0};
+    std::atomic<uint64_t> nContended{0};
+    std::atomic<uint64_t> nWaitTime{0};
+    std::atomic<uint64_t> nHoldTime{0};
+    std::atomic<uint64_t> nMaxWaitTime{0};
+    std::atomic<uint64_t> nMaxHoldTime{0};
+    std::atomic<uint64_t> vWaitHistogram[BUCKETS]{};
+    std::atomic<uint64_t> vHoldHistogram[BUCKETS]{};
+
+    void AddAcquire(int64_t nWait, bool fContended);
+    void AddHold(int64_t nHold);
+};
+
+/** A copy of the LockSiteStats of one source location and mutex */
+struct LockStats
+{
+    std::string strName;
+    std::string strFile;
+    const void* pMutex{nullptr};
+    int nLine{0};
+    uint64_t nCount{0};
+    uint64_t nContended{0};
+    uint64_t nWaitTime{0};
+    uint64_t nHoldTime{0};
+    uint64_t nMaxWaitTime{0};
+    uint64_t nMaxHoldTime{0};
+    std::array<uint64_t, LockSiteStats::BUCKETS> vWaitHistogram{};
+    std::array<uint64_t, LockSiteStats::BUCKETS> vHoldHistogram{};
+};
+
+static const bool DEFAULT_LOCK_STATS = false;
+static const int64_t DEFAULT_LOCK_STATS_INTERVAL = 600;
+//! Lock sites in each periodic log summary
+static const size_t LOCK_STATS_LOG_SITES = 10;
+
+//! Whether lock acquisitions record their wait and hold times (-lockstats)
+extern std::atomic<bool> g_lock_stats;
+//! Acquisitions not recorded because there was no room for their site
+extern std::atomic<uint64_t> g_lock_stats_untracked;
+
+/** The statistics of a lock site and mutex, nullptr when there is no room for more sites */
+LockSiteStats* GetLockSiteStats(const char* pszName, const char* pszFile, int nLine, const void* pMutex);
+/** The statistics of every lock site acquired since g_lock_stats was set */
+std::vector<LockStats> GetLockStats();
+/** Log the lock sites with the longest total wait time */
+void LogLockStats(size_t nSites);
+
+static inline int64_t LockStatsTime()
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
 /** Wrapper around std::unique_lock style lock for Mutex. */
 template <typename Mutex, typename Base = typename Mutex::UniqueLock>
 class SCOPED_LOCKABLE UniqueLock : public Base
 {
 private:
+    LockSiteStats* m_lock_stats{nullptr};
+    int64_t m_lock_acquired{0};
+    bool m_lock_hold_stats{true};
+
     void Enter(const char* pszName, const char* pszFile, int nLine)
     {
         EnterCritical(pszName, pszFile, nLine, (void*)(Base::mutex()));
+        if (g_lock_stats.load(std::memory_order_relaxed) && (m_lock_stats = GetLockSiteStats(pszName, pszFile, nLine, Base::mutex()))) {
+            EnterWithStats(pszName, pszFile, nLine);
+            return;
+        }
 #ifdef DEBUG_LOCKCONTENTION
         if (!Base::try_lock()) {
             PrintLockContention(pszName, pszFile, nLine);
@@ -146,17 +232,43 @@ private:
 #endif
     }
 
+    void EnterWithStats(const char* pszName, const char* pszFile, int nLine)
+    {
+        if (Base::try_lock()) {
+            m_lock_acquired = LockStatsTime();
+            m_lock_stats->AddAcquire(0, false);
+            return;
+        }
+#ifdef DEBUG_LOCKCONTENTION
+        PrintLockContention(pszName, pszFile, nLine);
+#endif
+        const int64_t nWaitStart = LockStatsTime();
+        Base::lock();
+        m_lock_acquired = LockStatsTime();
+        m_lock_stats->AddAcquire(m_lock_acquired - nWaitStart, true);
+    }
+
     bool TryEnter(const char* pszName, const char* pszFile, int nLine)
     {
         EnterCritical(pszName, pszFile, nLine, (void*)(Base::mutex()), true);
         Base::try_lock();
-        if (!Base::owns_lock())
+        if (!Base::owns_lock()) {
             LeaveCritical();
+        } else if (g_lock_stats.load(std::memory_order_relaxed) && (m_lock_stats = GetLockSiteStats(pszName, pszFile, nLine, Base::mutex()))) {
+            m_lock_acquired = LockStatsTime();
+            m_lock_stats->AddAcquire(0, false);
+        }
         return Base::owns_lock();
     }
 
+    void LeaveWithStats()
+    {
+        if (m_lock_stats && m_lock_hold_stats)
+            m_lock_stats->AddHold(LockStatsTime() - m_lock_acquired);
+    }
+
 public:
-    UniqueLock(Mutex& mutexIn, const char* pszName, const char* pszFile, int nLine, bool fTry = false) EXCLUSIVE_LOCK_FUNCTION(mutexIn) : Base(mutexIn, std::defer_lock)
+    UniqueLock(Mutex& mutexIn, const char* pszName, const char* pszFile, int nLine, bool fTry = false, bool fHoldStats = true) EXCLUSIVE_LOCK_FUNCTION(mutexIn) : Base(mutexIn, std::defer_lock), m_lock_hold_stats(fHoldStats)
     {
         if (fTry)
             TryEnter(pszName, pszFile, nLine);
@@ -164,7 +276,7 @@ public:
             Enter(pszName, pszFile, nLine);
     }
 
-    UniqueLock(Mutex* pmutexIn, const char* pszName, const char* pszFile, int nLine, bool fTry = false) EXCLUSIVE_LOCK_FUNCTION(pmutexIn)
+    UniqueLock(Mutex* pmutexIn, const char* pszName, const char* pszFile, int nLine, bool fTry = false, bool fHoldStats = true) EXCLUSIVE_LOCK_FUNCTION(pmutexIn) : m_lock_hold_stats(fHoldStats)
     {
         if (!pmutexIn) return;
 
@@ -177,8 +289,10 @@ public:
 
     ~UniqueLock() UNLOCK_FUNCTION()
     {
-        if (Base::owns_lock())
+        if (Base::owns_lock()) {
+            LeaveWithStats();
             LeaveCritical();
+        }
     }
 
     operator bool()
@@ -198,6 +312,7 @@ public:
     public:
         explicit reverse_lock(UniqueLock& _lock, const char* _guardname, const char* _file, int _line) : lock(_lock), file(_file), line(_line) {
             CheckLastCritical((void*)lock.mutex(), lockname, _guardname, _file, _line);
+            lock.LeaveWithStats();
             lock.unlock();
             LeaveCritical();
             lock.swap(templock);
@@ -207,6 +322,7 @@ public:
             templock.swap(lock);
             EnterCritical(lockname.c_str(), file.c_str(), line, (void*)lock.mutex());
             lock.lock();
+            lock.m_lock_acquired = LockStatsTime();
         }
 
      private:
@@ -232,7 +348,7 @@ using DebugLock = UniqueLock<typename std::remove_reference<typename std::remove
     DebugLock<decltype(cs1)> criticalblock1(cs1, #cs1, __FILE__, __LINE__); \
     DebugLock<decltype(cs2)> criticalblock2(cs2, #cs2, __FILE__, __LINE__);
 #define TRY_LOCK(cs, name) DebugLock<decltype(cs)> name(cs, #cs, __FILE__, __LINE__, true)
-#define WAIT_LOCK(cs, name) DebugLock<decltype(cs)> name(cs, #cs, __FILE__, __LINE__)
+#define WAIT_LOCK(cs, name) DebugLock<decltype(cs)> name(cs, #cs, __FILE__, __LINE__, false, false)
 
 #define ENTER_CRITICAL_SECTION(cs)                            \
     {                                                         \
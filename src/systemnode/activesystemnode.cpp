@@ -216,13 +216,13 @@ bool CActiveSystemnode::SendSystemnodePing(std::string& errorMessage, CConnman&
         }
 
         pmn->lastPing = mnp;
-        snodeman.mapSeenSystemnodePing.insert(std::make_pair(mnp.GetHash(), mnp));
+        snodeman.mapSeenSystemnodePing.Add(mnp.GetHash(), mnp);
 
         //snodeman.mapSeenSystemnodeBroadcast.lastPing is probably outdated, so we'll update it
         CSystemnodeBroadcast mnb(*pmn);
         uint256 hash = mnb.GetHash();
-        if (snodeman.mapSeenSystemnodeBroadcast.count(hash))
-            snodeman.mapSeenSystemnodeBroadcast[hash].lastPing = mnp;
+        if (CSystemnodeBroadcast* psnb = snodeman.mapSeenSystemnodeBroadcast.Get(hash))
+            psnb->lastPing = mnp;
 
         mnp.Relay(connman);
 
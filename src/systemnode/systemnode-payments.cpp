@@ -9,6 +9,7 @@
 #include <crown/spork.h>
 #include <key_io.h>
 #include <masternode/masternode-budget.h>
+#include <memusage.h>
 #include <net_processing.h>
 #include <netfulfilledman.h>
 #include <netmessagemaker.h>
@@ -323,7 +324,7 @@ bool CSystemnodeBlockPayees::IsTransactionValid(const CTransaction& txNew, const
         bool found = false;
         int pos = -1;
         for (unsigned int k = 0; k <  (txNew.nVersion >= TX_ELE_VERSION ? txNew.vpout.size() : txNew.vout.size()) ; k++){
-            CTxOutAsset txout = (txNew.nVersion >= TX_ELE_VERSION ? txNew.vpout[k] : txNew.vout[k]);
+            const CTxOutRef txout = txNew.GetOutputs()[k];
             if(payee.scriptPubKey == txout.scriptPubKey && systemnodePayment == txout.nValue){
                 pos = k;
                 found = true;
@@ -624,6 +625,12 @@ std::string CSystemnodePayments::ToString() const
     return info.str();
 }
 
+size_t CSystemnodePayments::DynamicMemoryUsage() const
+{
+    LOCK2(cs_mapSystemnodeBlocks, cs_mapSystemnodePayeeVotes);
+    return memusage::DynamicUsage(mapSystemnodePayeeVotes) + memusage::DynamicUsage(mapSystemnodeBlocks) + memusage::DynamicUsage(mapSystemnodesLastVote);
+}
+
 bool CSystemnodePaymentWinner::Sign(CKey& keySystemnode, CPubKey& pubKeySystemnode)
 {
     std::string errorMessage;
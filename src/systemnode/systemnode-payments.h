@@ -225,6 +225,8 @@ public:
     std::string GetRequiredPaymentsString(int nBlockHeight);
     void FillBlockPayee(CMutableTransaction& txNew, int64_t nFees, bool &hasMNPayment);
     std::string ToString() const;
+    /// Memory held by the votes, block payees and last votes
+    size_t DynamicMemoryUsage() const;
 
     SERIALIZE_METHODS(CSystemnodePayments, obj)
     {
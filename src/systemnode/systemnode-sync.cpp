@@ -68,7 +68,7 @@ void CSystemnodeSync::Reset()
 
 void CSystemnodeSync::AddedSystemnodeList(uint256 hash)
 {
-    if (snodeman.mapSeenSystemnodeBroadcast.count(hash)) {
+    if (snodeman.mapSeenSystemnodeBroadcast.Has(hash)) {
         if (mapSeenSyncSNB[hash] < SYSTEMNODE_SYNC_THRESHOLD) {
             lastSystemnodeList = GetTime();
             mapSeenSyncSNB[hash]++;
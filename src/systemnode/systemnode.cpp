@@ -149,7 +149,7 @@ bool CSystemnode::UpdateFromNewBroadcast(CSystemnodeBroadcast& snb, CConnman& co
         int nDoS = 0;
         if (snb.lastPing == CSystemnodePing() || (snb.lastPing != CSystemnodePing() && snb.lastPing.CheckAndUpdate(nDoS, connman, false))) {
             lastPing = snb.lastPing;
-            snodeman.mapSeenSystemnodePing.insert(std::make_pair(lastPing.GetHash(), lastPing));
+            snodeman.mapSeenSystemnodePing.Add(lastPing.GetHash(), lastPing);
         }
         return true;
     }
@@ -294,7 +294,7 @@ bool CSystemnode::GetRecentPaymentBlocks(std::vector<const CBlockIndex*>& vPayme
         int m = (block.vtx[0]->nVersion >= TX_ELE_VERSION ? block.vtx[0]->vpout.size() : block.vtx[0]->vout.size());
 
         if (m > 2) {
-            CTxOutAsset out = (block.vtx[0]->nVersion >= TX_ELE_VERSION ? block.vtx[0]->vpout[2] : block.vtx[0]->vout[2]);
+            const CTxOutRef out = block.vtx[0]->GetOutputs()[2];
             if (out.scriptPubKey == snpayee){
                 vPaymentBlocks.emplace_back(pindex);
                 fBlockFound = true;
@@ -450,7 +450,7 @@ bool CSystemnodeBroadcast::CheckInputsAndAdd(int& nDoS, CConnman& connman)
     if(GetUTXOConfirmations(vin.prevout) < SYSTEMNODE_MIN_CONFIRMATIONS){
         LogPrint(BCLog::NET, "snb - Input must have at least %d confirmations\n", SYSTEMNODE_MIN_CONFIRMATIONS);
         // maybe we miss few blocks, let this snb to be checked again later
-        snodeman.mapSeenSystemnodeBroadcast.erase(GetHash());
+        snodeman.mapSeenSystemnodeBroadcast.Erase(GetHash());
         systemnodeSync.mapSeenSyncSNB.erase(GetHash());
         return false;
     }
@@ -796,8 +796,8 @@ bool CSystemnodePing::CheckAndUpdate(int& nDos, CConnman& connman, bool fRequire
             //snodeman.mapSeenSystemnodeBroadcast.lastPing is probably outdated, so we'll update it
             CSystemnodeBroadcast snb(*psn);
             uint256 hash = snb.GetHash();
-            if (snodeman.mapSeenSystemnodeBroadcast.count(hash)) {
-                snodeman.mapSeenSystemnodeBroadcast[hash].lastPing = *this;
+            if (CSystemnodeBroadcast* psnb = snodeman.mapSeenSystemnodeBroadcast.Get(hash)) {
+                psnb->lastPing = *this;
             }
 
             psn->Check(true);
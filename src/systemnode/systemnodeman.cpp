@@ -5,6 +5,7 @@
 #include <addrman.h>
 #include <crown/legacysigner.h>
 #include <crown/spork.h>
+#include <memusage.h>
 #include <net_processing.h>
 #include <netmessagemaker.h>
 #include <sync.h>
@@ -160,13 +161,16 @@ void CSystemnodeMan::ProcessMessage(CNode* pfrom, const std::string& strCommand,
 
         LogPrint(BCLog::SYSTEMNODE, "snp - Systemnode ping, vin: %s\n", snp.vin.ToString());
 
-        if (mapSeenSystemnodePing.count(snp.GetHash()))
+        uint256 snpHash = snp.GetHash();
+        if (mapSeenSystemnodePing.Has(snpHash))
             return; //seen
-        mapSeenSystemnodePing.insert(std::make_pair(snp.GetHash(), snp));
+        mapSeenSystemnodePing.MarkSeen(snpHash, snp.vin.prevout);
 
         int nDoS = 0;
-        if (snp.CheckAndUpdate(nDoS, *connman))
+        if (snp.CheckAndUpdate(nDoS, *connman)) {
+            mapSeenSystemnodePing.Add(snpHash, snp);
             return;
+        }
 
         if (nDoS > 0) {
             // if anything significant failed, mark that node
@@ -207,29 +211,27 @@ void CSystemnodeMan::ProcessMessage(CNode* pfrom, const std::string& strCommand,
             }
         } //else, asking for a specific node which is ok
 
-        int nInvCount = 0;
-        for (const auto& sn : vSystemnodes) {
-            if (sn.IsEnabled()) {
-                LogPrint(BCLog::SYSTEMNODE, "sndseg - Sending Systemnode entry - %s \n", sn.addr.ToString());
-                if (vin == CTxIn() || vin == sn.vin) {
-                    CSystemnodeBroadcast snb = CSystemnodeBroadcast(sn);
-                    uint256 hash = snb.GetHash();
-                    pfrom->PushInventory(CInv(MSG_SYSTEMNODE_ANNOUNCE, hash));
-                    nInvCount++;
-                    if (!mapSeenSystemnodeBroadcast.count(hash))
-                        mapSeenSystemnodeBroadcast.insert(std::make_pair(hash, snb));
-                    if (vin == sn.vin) {
-                        LogPrint(BCLog::SYSTEMNODE, "sndseg - Sent 1 Systemnode entries to %s\n", pfrom->addr.ToString());
-                        return;
-                    }
-                }
-            }
-        }
-
         if (vin == CTxIn()) {
+            // the list inventory is shared between peers and streamed by the send loop in bounded chunks
+            std::shared_ptr<const std::vector<CInv>> pinv = GetListInventory();
+            int nInvCount = pinv->size();
+            pfrom->PushListInventory(pinv);
+
             const CNetMsgMaker msgMaker(PROTOCOL_VERSION);
             connman->PushMessage(pfrom, msgMaker.Make("snssc", SYSTEMNODE_SYNC_LIST, nInvCount));
             LogPrint(BCLog::SYSTEMNODE, "sndseg - Sent %d Systemnode entries to %s\n", nInvCount, pfrom->addr.ToString());
+            return;
+        }
+
+        LOCK(cs);
+        CSystemnode* psn = Find(vin);
+        if (psn && psn->IsEnabled()) {
+            LogPrint(BCLog::SYSTEMNODE, "sndseg - Sending Systemnode entry - %s \n", psn->addr.ToString());
+            CSystemnodeBroadcast snb = CSystemnodeBroadcast(*psn);
+            uint256 hash = snb.GetHash();
+            pfrom->PushInventory(CInv(MSG_SYSTEMNODE_ANNOUNCE, hash));
+            mapSeenSystemnodeBroadcast.Add(hash, snb);
+            LogPrint(BCLog::SYSTEMNODE, "sndseg - Sent 1 Systemnode entries to %s\n", pfrom->addr.ToString());
         }
     }
 }
@@ -247,18 +249,10 @@ void CSystemnodeMan::CheckAndRemove(bool forceExpiredRemoval)
 
             LogPrint(BCLog::SYSTEMNODE, "CSystemnodeMan: Removing inactive Systemnode %s - %i now\n", (*it).addr.ToString(), size() - 1);
 
-            //erase all of the broadcasts we've seen from this vin
+            //erase the broadcasts we've seen from this vin
             // -- if we missed a few pings and the node was removed, this will allow is to get it back without them
             //    sending a brand new snb
-            std::map<uint256, CSystemnodeBroadcast>::iterator it3 = mapSeenSystemnodeBroadcast.begin();
-            while (it3 != mapSeenSystemnodeBroadcast.end()) {
-                if ((*it3).second.vin == (*it).vin) {
-                    systemnodeSync.mapSeenSyncSNB.erase((*it3).first);
-                    mapSeenSystemnodeBroadcast.erase(it3++);
-                } else {
-                    ++it3;
-                }
-            }
+            systemnodeSync.mapSeenSyncSNB.erase(mapSeenSystemnodeBroadcast.EraseNode((*it).vin.prevout));
 
             // allow us to ask for this systemnode again if we see another ping
             std::map<COutPoint, int64_t>::iterator it2 = mWeAskedForSystemnodeListEntry.begin();
@@ -271,6 +265,7 @@ void CSystemnodeMan::CheckAndRemove(bool forceExpiredRemoval)
             }
 
             it = vSystemnodes.erase(it);
+            pListInventory.reset();
         } else {
             ++it;
         }
@@ -307,26 +302,14 @@ void CSystemnodeMan::CheckAndRemove(bool forceExpiredRemoval)
     }
 
     // remove expired mapSeenSystemnodeBroadcast
-    auto it3 = mapSeenSystemnodeBroadcast.begin();
-    while (it3 != mapSeenSystemnodeBroadcast.end()) {
-        if ((*it3).second.lastPing.sigTime < GetTime() - SYSTEMNODE_REMOVAL_SECONDS * 2) {
-            LogPrint(BCLog::SYSTEMNODE, "CSystemnodeMan::CheckAndRemove - Removing expired Systemnode broadcast %s\n", (*it3).second.GetHash().ToString());
-            systemnodeSync.mapSeenSyncSNB.erase((*it3).second.GetHash());
-            mapSeenSystemnodeBroadcast.erase(it3++);
-        } else {
-            ++it3;
-        }
+    const int64_t nExpireTime = GetTime() - SYSTEMNODE_REMOVAL_SECONDS * 2;
+    for (const uint256& hash : mapSeenSystemnodeBroadcast.EraseIf([nExpireTime](const CSystemnodeBroadcast& snb) { return snb.lastPing.sigTime < nExpireTime; })) {
+        LogPrint(BCLog::SYSTEMNODE, "CSystemnodeMan::CheckAndRemove - Removing expired Systemnode broadcast %s\n", hash.ToString());
+        systemnodeSync.mapSeenSyncSNB.erase(hash);
     }
 
     // remove expired mapSeenSystemnodePing
-    std::map<uint256, CSystemnodePing>::iterator it4 = mapSeenSystemnodePing.begin();
-    while (it4 != mapSeenSystemnodePing.end()) {
-        if ((*it4).second.sigTime < GetTime() - (SYSTEMNODE_REMOVAL_SECONDS * 2)) {
-            mapSeenSystemnodePing.erase(it4++);
-        } else {
-            ++it4;
-        }
-    }
+    mapSeenSystemnodePing.EraseIf([nExpireTime](const CSystemnodePing& snp) { return snp.sigTime < nExpireTime; });
 }
 
 void CSystemnodeMan::Clear()
@@ -336,8 +319,9 @@ void CSystemnodeMan::Clear()
     mAskedUsForSystemnodeList.clear();
     mWeAskedForSystemnodeList.clear();
     mWeAskedForSystemnodeListEntry.clear();
-    mapSeenSystemnodeBroadcast.clear();
-    mapSeenSystemnodePing.clear();
+    mapSeenSystemnodeBroadcast.Clear();
+    mapSeenSystemnodePing.Clear();
+    pListInventory.reset();
 }
 
 int CSystemnodeMan::CountEnabled(int protocolVersion)
@@ -355,6 +339,30 @@ int CSystemnodeMan::CountEnabled(int protocolVersion)
     return i;
 }
 
+std::shared_ptr<const std::vector<CInv>> CSystemnodeMan::GetListInventory()
+{
+    LOCK(cs);
+
+    if (pListInventory && nListInventoryTime > GetTime() - SYSTEMNODES_LIST_INV_SECONDS)
+        return pListInventory;
+
+    auto pinv = std::make_shared<std::vector<CInv>>();
+    pinv->reserve(vSystemnodes.size());
+    for (const auto& sn : vSystemnodes) {
+        if (!sn.IsEnabled())
+            continue;
+        CSystemnodeBroadcast snb = CSystemnodeBroadcast(sn);
+        uint256 hash = snb.GetHash();
+        mapSeenSystemnodeBroadcast.Add(hash, snb);
+        pinv->emplace_back(MSG_SYSTEMNODE_ANNOUNCE, hash);
+    }
+
+    LogPrint(BCLog::SYSTEMNODE, "CSystemnodeMan::GetListInventory - Rebuilt list inventory with %d entries\n", pinv->size());
+    pListInventory = std::move(pinv);
+    nListInventoryTime = GetTime();
+    return pListInventory;
+}
+
 void CSystemnodeMan::DsegUpdate(CNode* pnode, CConnman& connman)
 {
     LOCK(cs);
@@ -488,6 +496,7 @@ bool CSystemnodeMan::Add(CSystemnode& sn)
     if (!psn) {
         LogPrint(BCLog::SYSTEMNODE, "CSystemnodeMan: Adding new Systemnode %s - %i now\n", sn.addr.ToString(), size() + 1);
         vSystemnodes.push_back(sn);
+        pListInventory.reset();
         return true;
     }
 
@@ -497,8 +506,8 @@ bool CSystemnodeMan::Add(CSystemnode& sn)
 void CSystemnodeMan::UpdateSystemnodeList(CSystemnodeBroadcast snb, CConnman& connman)
 {
     auto snbHash = snb.GetHash();
-    mapSeenSystemnodePing.insert(std::make_pair(snb.lastPing.GetHash(), snb.lastPing));
-    mapSeenSystemnodeBroadcast.insert(std::make_pair(snbHash, snb));
+    mapSeenSystemnodePing.Add(snb.lastPing.GetHash(), snb.lastPing);
+    mapSeenSystemnodeBroadcast.Add(snbHash, snb);
     systemnodeSync.AddedSystemnodeList(snbHash);
 
     LogPrint(BCLog::SYSTEMNODE, "CSystemnodeMan::UpdateSystemnodeList() - addr: %s\n    vin: %s\n", snb.addr.ToString(), snb.vin.ToString());
@@ -507,8 +516,9 @@ void CSystemnodeMan::UpdateSystemnodeList(CSystemnodeBroadcast snb, CConnman& co
     if (!psn) {
         CSystemnode sn(snb);
         Add(sn);
-    } else {
-        psn->UpdateFromNewBroadcast(snb, connman);
+    } else if (psn->UpdateFromNewBroadcast(snb, connman)) {
+        LOCK(cs);
+        pListInventory.reset();
     }
 }
 
@@ -521,6 +531,7 @@ void CSystemnodeMan::Remove(CTxIn vin)
         if ((*it).vin == vin) {
             LogPrint(BCLog::SYSTEMNODE, "CSystemnodeMan: Removing Systemnode %s - %i now\n", (*it).addr.ToString(), size() - 1);
             vSystemnodes.erase(it);
+            pListInventory.reset();
             break;
         }
         ++it;
@@ -536,6 +547,16 @@ std::string CSystemnodeMan::ToString() const
     return info.str();
 }
 
+size_t CSystemnodeMan::DynamicMemoryUsage() const
+{
+    LOCK(cs);
+
+    size_t nUsage = memusage::DynamicUsage(vSystemnodes);
+    nUsage += memusage::DynamicUsage(mAskedUsForSystemnodeList) + memusage::DynamicUsage(mWeAskedForSystemnodeList) + memusage::DynamicUsage(mWeAskedForSystemnodeListEntry);
+    nUsage += memusage::DynamicUsage(mMnbRecoveryRequests) + memusage::DynamicUsage(mMnbRecoveryGoodReplies);
+    return nUsage + mapSeenSystemnodeBroadcast.DynamicMemoryUsage() + mapSeenSystemnodePing.DynamicMemoryUsage();
+}
+
 CSystemnode* CSystemnodeMan::GetCurrentSystemNode(int mod, int64_t nBlockHeight, int minProtocol)
 {
     int64_t score = 0;
@@ -604,11 +625,11 @@ bool CSystemnodeMan::CheckSnbAndUpdateSystemnodeList(CSystemnodeBroadcast snb, i
     LogPrint(BCLog::SYSTEMNODE, "CSystemnodeMan::CheckSnbAndUpdateSystemnodeList - Systemnode broadcast, vin: %s\n", snb.vin.ToString());
 
     uint256 snbHash = snb.GetHash();
-    if (mapSeenSystemnodeBroadcast.count(snbHash)) {
+    if (mapSeenSystemnodeBroadcast.Has(snbHash)) {
         systemnodeSync.AddedSystemnodeList(snbHash);
         return true;
     }
-    mapSeenSystemnodeBroadcast.insert(std::make_pair(snbHash, snb));
+    mapSeenSystemnodeBroadcast.MarkSeen(snbHash, snb.vin.prevout);
 
     LogPrint(BCLog::SYSTEMNODE, "CSystemnodeMan::CheckSnbAndUpdateSystemnodeList - Systemnode broadcast, vin: %s new\n", snb.vin.ToString());
 
@@ -638,6 +659,7 @@ bool CSystemnodeMan::CheckSnbAndUpdateSystemnodeList(CSystemnodeBroadcast snb, i
     // make sure it's still unspent
     //  - this is checked later by .check() in many places and by ThreadCheckDarkSendPool()
     if (snb.CheckInputsAndAdd(nDos, connman)) {
+        mapSeenSystemnodeBroadcast.Add(snbHash, snb);
         systemnodeSync.AddedSystemnodeList(snbHash);
     } else {
         LogPrint(BCLog::SYSTEMNODE, "CSystemnodeMan::CheckSnbAndUpdateSystemnodeList - Rejected Systemnode entry %s\n", snb.addr.ToString());
@@ -11,10 +11,14 @@
 #include <util/system.h>
 #include <base58.h>
 #include <validation.h>
+#include <crown/seenobjects.h>
 #include <systemnode/systemnode.h>
 
 #define SYSTEMNODES_DUMP_SECONDS (15 * 60)
 #define SYSTEMNODES_DSEG_SECONDS (3 * 60 * 60)
+#define SYSTEMNODES_LIST_INV_SECONDS 60
+#define SYSTEMNODES_SEEN_BROADCAST_ELEMENTS (1 << 14)
+#define SYSTEMNODES_SEEN_PING_ELEMENTS (1 << 16)
 
 
 class CSystemnodeMan;
@@ -49,11 +53,15 @@ private:
     /// Set when Systemnodes are removed, cleared when CGovernanceManager is notified
     bool fSystemnodesRemoved;
 
+    // sndseg reply announcing the whole list, shared by all peers until the list changes or it expires
+    std::shared_ptr<const std::vector<CInv>> pListInventory;
+    int64_t nListInventoryTime{0};
+
 public:
-    // Keep track of all broadcasts I've seen
-    std::map<uint256, CSystemnodeBroadcast> mapSeenSystemnodeBroadcast;
-    // Keep track of all pings I've seen
-    std::map<uint256, CSystemnodePing> mapSeenSystemnodePing;
+    // Keep track of all broadcasts I've seen, full objects only for the latest one per systemnode
+    CSeenObjects<CSystemnodeBroadcast> mapSeenSystemnodeBroadcast{SYSTEMNODES_SEEN_BROADCAST_ELEMENTS};
+    // Keep track of all pings I've seen, full objects only for the latest one per systemnode
+    CSeenObjects<CSystemnodePing> mapSeenSystemnodePing{SYSTEMNODES_SEEN_PING_ELEMENTS};
 
     SERIALIZE_METHODS(CSystemnodeMan, obj)
     {
@@ -92,6 +100,9 @@ public:
 
     void DsegUpdate(CNode* pnode, CConnman& connman);
 
+    /// Inventory of all enabled Systemnodes, rebuilt at most once per list change or SYSTEMNODES_LIST_INV_SECONDS
+    std::shared_ptr<const std::vector<CInv>> GetListInventory();
+
     /// Find an entry
     CSystemnode* Find(const CTxIn& vin);
     CSystemnode* Find(const CPubKey& pubKeySystemnode);
@@ -120,6 +131,8 @@ public:
     int size() { return vSystemnodes.size(); }
 
     std::string ToString() const;
+    /// Memory held by the Systemnode list, the requests and the seen objects
+    size_t DynamicMemoryUsage() const;
 
     void Remove(CTxIn vin);
 
@@ -0,0 +1,91 @@
+// Copyright (c) 2014-2020 The Crown developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <chainparams.h>
+#include <primitives/asset.h>
+#include <primitives/transaction.h>
+#include <test/util/setup_common.h>
+
+#include <boost/test/unit_test.hpp>
+
+namespace {
+CAsset RandomAsset()
+{
+    CAsset asset(InsecureRand256());
+    asset.nType = AssetMetadata::TOKEN;
+    asset.contract_url = "https://example.com/a/contract/url/past/the/small/string/buffer";
+    return asset;
+}
+} // namespace
+
+BOOST_FIXTURE_TEST_SUITE(asset_tests, BasicTestingSetup)
+
+BOOST_AUTO_TEST_CASE(asset_intern_identity)
+{
+    const size_t nCount = CAssetHandle::InternedCount();
+    const size_t nUsage = CAssetHandle::DynamicMemoryUsage();
+    const CAsset asset = RandomAsset();
+    size_t nUsageHeld;
+    {
+        // identical assets share one copy, which the table accounts for
+        CAssetHandle handle1(asset);
+        CAssetHandle handle2(CAsset{asset});
+        BOOST_CHECK_EQUAL(&handle1.get(), &handle2.get());
+        BOOST_CHECK(handle1->IsIdentical(asset));
+        BOOST_CHECK_EQUAL(CAssetHandle::InternedCount(), nCount + 1);
+        BOOST_CHECK_GT(CAssetHandle::DynamicMemoryUsage(), nUsage);
+
+        // an asset differing past its ID is kept apart, yet compares equal
+        CAsset other = asset;
+        other.nExpiry = 1;
+        CAssetHandle handle3(other);
+        BOOST_CHECK_NE(&handle1.get(), &handle3.get());
+        BOOST_CHECK(handle1 == handle3);
+        BOOST_CHECK(handle3->IsIdentical(other));
+        BOOST_CHECK_EQUAL(CAssetHandle::InternedCount(), nCount + 2);
+
+        // outputs hold the shared copy too
+        CTxOutAsset out(asset, 1, CScript() << OP_TRUE);
+        BOOST_CHECK_EQUAL(&out.nAsset.get(), &handle1.get());
+        nUsageHeld = CAssetHandle::DynamicMemoryUsage();
+    }
+
+    // an asset is freed with its last handle
+    BOOST_CHECK_EQUAL(CAssetHandle::InternedCount(), nCount);
+    BOOST_CHECK_LT(CAssetHandle::DynamicMemoryUsage(), nUsageHeld);
+
+    // the null asset isn't interned
+    CAssetHandle handleNull{CAsset()};
+    BOOST_CHECK_EQUAL(&handleNull.get(), &CAssetHandle::NullAsset());
+    BOOST_CHECK_EQUAL(CAssetHandle::InternedCount(), nCount);
+}
+
+BOOST_AUTO_TEST_CASE(asset_intern_subsidy)
+{
+    // the subsidy asset is interned with the chain params, and stays without any handle
+    const CAsset& subsidy = Params().GetConsensus().subsidy_asset;
+    const CAsset* pSubsidy;
+    {
+        CAssetHandle handle(subsidy);
+        pSubsidy = &handle.get();
+    }
+    CAssetHandle handle1(subsidy);
+    CAssetHandle handle2(CAsset{subsidy});
+    BOOST_CHECK_EQUAL(&handle1.get(), pSubsidy);
+    BOOST_CHECK_EQUAL(&handle2.get(), pSubsidy);
+    BOOST_CHECK(handle1->IsIdentical(subsidy));
+
+    // only an identical asset takes the bypass
+    CAsset other = subsidy;
+    other.nFlags ^= AssetMetadata::ASSET_STAKEABLE;
+    CAssetHandle handle3(other);
+    BOOST_CHECK_NE(&handle3.get(), pSubsidy);
+    BOOST_CHECK(handle3->IsIdentical(other));
+
+    // interning it again keeps the same copy
+    CAssetHandle::PreIntern(subsidy);
+    BOOST_CHECK_EQUAL(&CAssetHandle(subsidy).get(), pSubsidy);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
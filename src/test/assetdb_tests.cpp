@@ -0,0 +1,129 @@
+// Copyright (c) 2014-2020 The Crown developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <assetdb.h>
+#include <test/util/setup_common.h>
+
+#include <string>
+
+#include <boost/test/unit_test.hpp>
+
+namespace {
+CAssetData AssetData(const std::string& name, const std::string& shortname)
+{
+    AssetMetadata metadata;
+    metadata.nVersion = 1;
+    metadata.nType = AssetMetadata::TOKEN;
+    metadata.setName(name);
+    metadata.setShortName(shortname);
+    CAssetData data;
+    data.asset = CAsset(metadata);
+    data.txhash = InsecureRand256();
+    return data;
+}
+
+//! An asset with the ID of none of the registered ones, named name
+CAsset Named(const std::string& name)
+{
+    CAsset asset(InsecureRand256());
+    asset.setName(name);
+    return asset;
+}
+} // namespace
+
+BOOST_FIXTURE_TEST_SUITE(assetdb_tests, BasicTestingSetup)
+
+BOOST_AUTO_TEST_CASE(assets_cache_put_erase)
+{
+    CAssetsCache cache(10);
+    const CAssetData gold = AssetData("GoldCoin", "GLD");
+    cache.Put("GoldCoin", gold);
+    BOOST_CHECK(cache.Exists("GoldCoin"));
+    BOOST_CHECK_EQUAL(cache.Size(), 1U);
+
+    // found by ID, and by name or short name ignoring case
+    const CAssetRules* rules = cache.FindRules(gold.asset);
+    BOOST_REQUIRE(rules);
+    BOOST_CHECK(rules->txhash == gold.txhash);
+    BOOST_CHECK(cache.FindRules(Named("goldcoin")) == rules);
+    BOOST_CHECK(cache.FindRules(Named("GLD")) == rules);
+    BOOST_CHECK(!cache.FindRules(Named("Gold")));
+    BOOST_CHECK(cache.NameExists("GOLDCOIN"));
+    BOOST_CHECK(cache.NameExists("gld"));
+    BOOST_CHECK(!cache.NameExists("GLDX"));
+
+    // putting the key again replaces its rules
+    const CAssetData gold2 = AssetData("GoldCoin", "GLD2");
+    cache.Put("GoldCoin", gold2);
+    BOOST_CHECK_EQUAL(cache.Size(), 1U);
+    BOOST_CHECK(!cache.FindRules(gold.asset) || cache.FindRules(gold.asset)->txhash == gold2.txhash);
+    BOOST_CHECK(cache.FindRules(gold2.asset)->txhash == gold2.txhash);
+    BOOST_CHECK(!cache.NameExists("GLD"));
+    BOOST_CHECK(cache.NameExists("GLD2"));
+
+    cache.Erase("GoldCoin");
+    BOOST_CHECK(!cache.Exists("GoldCoin"));
+    BOOST_CHECK(!cache.FindRules(gold2.asset));
+    BOOST_CHECK(!cache.NameExists("GoldCoin"));
+    BOOST_CHECK(!cache.NameExists("GLD2"));
+
+    cache.Put("GoldCoin", gold);
+    cache.Clear();
+    BOOST_CHECK_EQUAL(cache.Size(), 0U);
+    BOOST_CHECK(!cache.FindRules(gold.asset));
+    BOOST_CHECK(!cache.NameExists("GoldCoin"));
+}
+
+BOOST_AUTO_TEST_CASE(assets_cache_eviction)
+{
+    CAssetsCache cache(2);
+    const CAssetData a = AssetData("AssetA", "AAA");
+    const CAssetData b = AssetData("AssetB", "BBB");
+    const CAssetData c = AssetData("AssetC", "CCC");
+    cache.Put("AssetA", a);
+    cache.Put("AssetB", b);
+    // put again, AssetA is now the most recently used
+    cache.Put("AssetA", a);
+    cache.Put("AssetC", c);
+
+    // the least recently used is evicted with its rules
+    BOOST_CHECK_EQUAL(cache.Size(), 2U);
+    BOOST_CHECK(!cache.Exists("AssetB"));
+    BOOST_CHECK(!cache.FindRules(b.asset));
+    BOOST_CHECK(!cache.NameExists("BBB"));
+    BOOST_CHECK(cache.FindRules(a.asset));
+    BOOST_CHECK(cache.FindRules(c.asset));
+    BOOST_CHECK(cache.NameExists("AssetC"));
+}
+
+BOOST_AUTO_TEST_CASE(assets_cache_name_hash)
+{
+    // names differing in case only, or a name matching another's short name, share a hash
+    CAssetsCache cache(10);
+    const CAssetData upper = AssetData("SILVER", "SLV");
+    const CAssetData lower = AssetData("silver", "slv");
+    const CAssetData shorter = AssetData("Slv1", "SILV");
+    cache.Put("SILVER", upper);
+    cache.Put("silver", lower);
+    cache.Put("Slv1", shorter);
+    BOOST_CHECK(cache.FindRules(upper.asset)->txhash == upper.txhash);
+    BOOST_CHECK(cache.FindRules(lower.asset)->txhash == lower.txhash);
+
+    // a name is found as long as one of the assets sharing its hash has it
+    cache.Erase("SILVER");
+    BOOST_CHECK(cache.NameExists("Silver"));
+    BOOST_CHECK(cache.FindRules(Named("Silver"))->txhash == lower.txhash);
+    BOOST_CHECK(cache.FindRules(lower.asset));
+    cache.Erase("silver");
+    BOOST_CHECK(!cache.NameExists("Silver"));
+    BOOST_CHECK(!cache.NameExists("SLV"));
+    BOOST_CHECK(cache.NameExists("slv1"));
+    BOOST_CHECK(cache.NameExists("silv"));
+
+    // the name of an asset is matched without its zero padding
+    BOOST_CHECK(cache.FindRules(Named("SLV1"))->txhash == shorter.txhash);
+    BOOST_CHECK_EQUAL(Named("Slv1").getAssetNameSpan().size(), 4U);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,228 @@
+// Copyright (c) 2014-2020 The Crown developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <chainparams.h>
+#include <coins.h>
+#include <node/coinstats.h>
+#include <script/script.h>
+#include <test/util/setup_common.h>
+#include <txdb.h>
+#include <undo.h>
+#include <validation.h>
+
+#include <vector>
+
+#include <boost/test/unit_test.hpp>
+
+int ApplyTxInUndo(Coin&& undo, CCoinsViewCache& view, const COutPoint& out);
+void UpdateCoins(const CTransaction& tx, CCoinsViewCache& inputs, CTxUndo &txundo, int nHeight);
+
+namespace
+{
+//! Drop the assets that have nothing left, they are not stored either
+CAmountMap NonZero(const CAmountMap& supply)
+{
+    CAmountMap ret;
+    for (const auto& asset : supply) {
+        if (asset.second != 0) ret.insert(asset);
+    }
+    return ret;
+}
+
+//! Compare the supply tracked by the database with a full scan of its coins
+void CheckSupply(CCoinsViewDB& db)
+{
+    CAmountMap tracked;
+    BOOST_REQUIRE(db.GetAssetSupply(tracked));
+
+    CCoinsScriptStats stats;
+    BOOST_REQUIRE(GetUTXOScriptStats(db, stats, 2));
+    CAmountMap scanned;
+    for (const auto& asset : stats.mapAssets) {
+        scanned[asset.first] = asset.second.nPlainValue;
+    }
+    BOOST_CHECK(NonZero(tracked) == NonZero(scanned));
+}
+
+struct AssetSupplySetup : public TestingSetup {
+    CCoinsViewDB db{"assetsupply_tests", 1 << 20, true, false};
+    std::vector<CAsset> assets{CAsset(), CAsset(InsecureRand256()), CAsset(InsecureRand256())};
+    uint256 hashBest{Params().GenesisBlock().GetHash()};
+
+    Coin RandomCoin(int nHeight)
+    {
+        const CAsset& asset = assets[InsecureRandRange(assets.size())];
+        return Coin(CTxOutAsset(asset, 1 + InsecureRandRange(1000 * COIN), CScript() << OP_TRUE), nHeight, false, false);
+    }
+
+    void Flush(CCoinsViewCache& cache)
+    {
+        cache.SetBestBlock(hashBest);
+        BOOST_REQUIRE(cache.Flush());
+    }
+};
+} // namespace
+
+BOOST_FIXTURE_TEST_SUITE(assetsupply_tests, AssetSupplySetup)
+
+BOOST_AUTO_TEST_CASE(assetsupply_flush)
+{
+    BOOST_REQUIRE(db.WriteAssetSupply(CAmountMap()));
+
+    CCoinsViewCache base(&db);
+    std::vector<COutPoint> outpoints;
+    CAmountMap expected;
+    for (int round = 0; round < 4; round++) {
+        // a stacked cache, as used when connecting a block
+        CCoinsViewCache cache(&base);
+        for (int i = 0; i < 100; i++) {
+            COutPoint outpoint(InsecureRand256(), InsecureRandRange(4));
+            Coin coin = RandomCoin(round + 1);
+            expected[coin.out.nAsset] += coin.out.nValue;
+            cache.AddCoin(outpoint, std::move(coin), false);
+            outpoints.push_back(outpoint);
+        }
+        for (int i = 0; i < 30; i++) {
+            size_t n = InsecureRandRange(outpoints.size());
+            Coin coin;
+            BOOST_CHECK(cache.SpendCoin(outpoints[n], &coin));
+            expected[coin.out.nAsset] -= coin.out.nValue;
+            outpoints.erase(outpoints.begin() + n);
+        }
+
+        CAmountMap tracked;
+        BOOST_REQUIRE(cache.GetAssetSupply(tracked));
+        BOOST_CHECK(NonZero(tracked) == NonZero(expected));
+
+        Flush(cache);
+        BOOST_REQUIRE(base.GetAssetSupply(tracked));
+        BOOST_CHECK(NonZero(tracked) == NonZero(expected));
+        if (round % 2) {
+            Flush(base);
+            CheckSupply(db);
+        }
+    }
+}
+
+BOOST_AUTO_TEST_CASE(assetsupply_overwrite)
+{
+    BOOST_REQUIRE(db.WriteAssetSupply(CAmountMap()));
+
+    const COutPoint outpoint(InsecureRand256(), 0);
+    {
+        CCoinsViewCache cache(&db);
+        cache.AddCoin(outpoint, Coin(CTxOutAsset(assets[1], 50 * COIN, CScript() << OP_TRUE), 1, true, false), false);
+        Flush(cache);
+    }
+    CheckSupply(db);
+
+    // Overwrite a coin that only the parent view has, as a duplicate coinbase does
+    CCoinsViewCache cache(&db);
+    cache.AddCoin(outpoint, Coin(CTxOutAsset(assets[2], 20 * COIN, CScript() << OP_TRUE), 2, true, false), true);
+    CAmountMap tracked;
+    BOOST_REQUIRE(cache.GetAssetSupply(tracked));
+    BOOST_CHECK_EQUAL(tracked[assets[1]], 0);
+    BOOST_CHECK_EQUAL(tracked[assets[2]], 20 * COIN);
+    Flush(cache);
+    CheckSupply(db);
+}
+
+BOOST_AUTO_TEST_CASE(assetsupply_reorg)
+{
+    BOOST_REQUIRE(db.WriteAssetSupply(CAmountMap()));
+
+    // Coins the block spends
+    std::vector<COutPoint> prevouts;
+    {
+        CCoinsViewCache cache(&db);
+        for (int i = 0; i < 20; i++) {
+            prevouts.emplace_back(InsecureRand256(), 0);
+            cache.AddCoin(prevouts.back(), RandomCoin(1), false);
+        }
+        Flush(cache);
+    }
+    CheckSupply(db);
+    CAmountMap supplyBefore;
+    BOOST_REQUIRE(db.GetAssetSupply(supplyBefore));
+
+    // Connect a block of transactions with asset outputs
+    std::vector<CTransactionRef> vtx;
+    std::vector<CTxUndo> vtxundo;
+    {
+        CCoinsViewCache cache(&db);
+        for (size_t i = 0; i < prevouts.size(); i += 2) {
+            CMutableTransaction tx;
+            tx.nVersion = TX_ELE_VERSION;
+            tx.vin.emplace_back(prevouts[i]);
+            tx.vin.emplace_back(prevouts[i + 1]);
+            for (int o = 0; o < 3; o++) {
+                tx.vpout.emplace_back(RandomCoin(2).out);
+            }
+            vtx.push_back(MakeTransactionRef(tx));
+            vtxundo.emplace_back();
+            UpdateCoins(*vtx.back(), cache, vtxundo.back(), 2);
+        }
+        Flush(cache);
+    }
+    CheckSupply(db);
+
+    // Disconnect it again the way DisconnectBlock does
+    {
+        CCoinsViewCache cache(&db);
+        for (int i = vtx.size() - 1; i >= 0; i--) {
+            const CTransaction& tx = *vtx[i];
+            for (size_t o = 0; o < tx.vpout.size(); o++) {
+                BOOST_CHECK(cache.SpendCoin(COutPoint(tx.GetHash(), o)));
+            }
+            for (unsigned int j = tx.vin.size(); j-- > 0;) {
+                BOOST_CHECK_EQUAL(ApplyTxInUndo(std::move(vtxundo[i].vprevout[j]), cache, tx.vin[j].prevout), DISCONNECT_OK);
+            }
+        }
+        Flush(cache);
+    }
+    CheckSupply(db);
+    CAmountMap supplyAfter;
+    BOOST_REQUIRE(db.GetAssetSupply(supplyAfter));
+    BOOST_CHECK(NonZero(supplyBefore) == NonZero(supplyAfter));
+
+    // An unclean disconnect overwrites an output that is still unspent on disk
+    {
+        CCoinsViewCache cache(&db);
+        BOOST_CHECK_EQUAL(ApplyTxInUndo(RandomCoin(1), cache, prevouts[0]), DISCONNECT_UNCLEAN);
+        Flush(cache);
+    }
+    CheckSupply(db);
+}
+
+BOOST_AUTO_TEST_CASE(assetsupply_rebuild)
+{
+    // A chainstate without the 'S' record, as left by an interrupted flush or an older version
+    std::vector<COutPoint> outpoints;
+    {
+        CCoinsViewCache cache(&db);
+        for (int i = 0; i < 200; i++) {
+            outpoints.emplace_back(InsecureRand256(), 0);
+            cache.AddCoin(outpoints.back(), RandomCoin(1), false);
+        }
+        Flush(cache);
+    }
+    CAmountMap supply;
+    BOOST_CHECK(!db.GetAssetSupply(supply));
+
+    BOOST_REQUIRE(InitAssetSupply(db));
+    CheckSupply(db);
+
+    // The rebuilt record is kept current by the following flushes
+    {
+        CCoinsViewCache cache(&db);
+        for (int i = 0; i < 50; i++) {
+            BOOST_CHECK(cache.SpendCoin(outpoints[i]));
+            cache.AddCoin(COutPoint(InsecureRand256(), 1), RandomCoin(2), false);
+        }
+        Flush(cache);
+    }
+    CheckSupply(db);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
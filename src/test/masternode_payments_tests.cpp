@@ -0,0 +1,340 @@
+// Copyright (c) 2014-2020 The Crown developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <chainparams.h>
+#include <consensus/validation.h>
+#include <crown/spork.h>
+#include <key.h>
+#include <masternode/masternode-payments.h>
+#include <masternode/masternode.h>
+#include <masternode/masternodeman.h>
+#include <net.h>
+#include <script/standard.h>
+#include <test/util/setup_common.h>
+#include <timedata.h>
+#include <validation.h>
+#include <validationinterface.h>
+#include <version.h>
+
+#include <algorithm>
+#include <memory>
+#include <vector>
+
+#include <boost/test/unit_test.hpp>
+
+namespace {
+//! Masternodes known to mnodeman, ranked on the 100 block chain of the fixture
+struct WinnerSetup : public TestChain100Setup {
+    std::vector<CKey> vKeys;
+    std::vector<CTxIn> vVins;
+    std::unique_ptr<CConnman> connman{new CConnman(0x1337, 0x1337)};
+
+    WinnerSetup()
+    {
+        mnodeman.Clear();
+        masternodePayments.Clear();
+        masternodePayments.mapMasternodesLastVote.clear();
+        for (int i = 0; i < 3 * MNPAYMENTS_SIGNATURES_TOTAL; i++) {
+            vKeys.emplace_back();
+            vKeys.back().MakeNewKey(true);
+            vVins.emplace_back(COutPoint(InsecureRand256(), 0));
+
+            CMasternode mn;
+            mn.vin = vVins.back();
+            mn.pubkey2 = vKeys.back().GetPubKey();
+            mn.protocolVersion = PROTOCOL_VERSION;
+            mn.unitTest = true;
+            mn.lastPing = CMasternodePing(mn.vin);
+            mn.lastPing.sigTime = GetAdjustedTime();
+            BOOST_REQUIRE(mnodeman.Add(mn));
+        }
+    }
+
+    ~WinnerSetup()
+    {
+        mnodeman.Clear();
+        masternodePayments.Clear();
+        masternodePayments.mapMasternodesLastVote.clear();
+    }
+
+    //! Index in vVins of the masternode ranked nRank for winners of nBlockHeight
+    size_t Ranked(int nRank, int nBlockHeight)
+    {
+        for (size_t i = 0; i < vVins.size(); i++) {
+            if (mnodeman.GetMasternodeRank(vVins[i], nBlockHeight - 100, MIN_MNW_PEER_PROTO_VERSION) == nRank)
+                return i;
+        }
+        BOOST_FAIL("no masternode ranked " << nRank);
+        return 0;
+    }
+
+    CMasternodePaymentWinner Winner(size_t i, int nBlockHeight, const CScript& payee)
+    {
+        CMasternodePaymentWinner winner(vVins[i]);
+        winner.nBlockHeight = nBlockHeight;
+        winner.AddPayee(payee);
+        CPubKey pubkey = vKeys[i].GetPubKey();
+        BOOST_REQUIRE(winner.Sign(vKeys[i], pubkey));
+        return winner;
+    }
+
+    bool Accepted(CMasternodePaymentWinner& winner)
+    {
+        return masternodePayments.mapMasternodePayeeVotes.count(winner.GetHash());
+    }
+
+    int Votes(int nBlockHeight, const CScript& payee)
+    {
+        auto it = masternodePayments.mapMasternodeBlocks.find(nBlockHeight);
+        if (it == masternodePayments.mapMasternodeBlocks.end())
+            return 0;
+        for (const auto& p : it->second.vecPayments) {
+            if (p.scriptPubKey == payee)
+                return p.nVotes;
+        }
+        return 0;
+    }
+};
+
+CScript RandomPayee()
+{
+    CKey key;
+    key.MakeNewKey(true);
+    return GetScriptForDestination(PKHash(key.GetPubKey()));
+}
+} // namespace
+
+BOOST_FIXTURE_TEST_SUITE(masternode_payments_tests, WinnerSetup)
+
+BOOST_AUTO_TEST_CASE(mnw_batch_grouping)
+{
+    const CMasternodeWinnerStats statsBefore = masternodePayments.GetWinnerStats();
+
+    // the quorum of every height votes, enough winners to verify them on several threads
+    std::vector<CMasternodePaymentWinner> vWinners;
+    std::vector<CScript> vPayees;
+    for (int nBlockHeight = 150; nBlockHeight < 158; nBlockHeight++) {
+        vPayees.push_back(RandomPayee());
+        for (int nRank = 1; nRank <= MNPAYMENTS_SIGNATURES_TOTAL; nRank++) {
+            vWinners.push_back(Winner(Ranked(nRank, nBlockHeight), nBlockHeight, vPayees.back()));
+        }
+    }
+    for (size_t i = 0; i < vWinners.size(); i++) {
+        BOOST_CHECK(masternodePayments.QueueWinner(i, vWinners[i]));
+    }
+    // a winner is queued once
+    BOOST_CHECK(!masternodePayments.QueueWinner(0, vWinners[0]));
+    BOOST_CHECK_EQUAL(masternodePayments.GetWinnerStats().nQueued, vWinners.size());
+
+    masternodePayments.ProcessPendingWinners(*connman);
+
+    for (auto& winner : vWinners) {
+        BOOST_CHECK(Accepted(winner));
+    }
+    for (int nBlockHeight = 150; nBlockHeight < 158; nBlockHeight++) {
+        BOOST_CHECK_EQUAL(Votes(nBlockHeight, vPayees[nBlockHeight - 150]), MNPAYMENTS_SIGNATURES_TOTAL);
+    }
+
+    const CMasternodeWinnerStats stats = masternodePayments.GetWinnerStats();
+    BOOST_CHECK_EQUAL(stats.nQueued, 0U);
+    BOOST_CHECK_EQUAL(stats.nBatches - statsBefore.nBatches, 1U);
+    BOOST_CHECK_EQUAL(stats.nProcessed - statsBefore.nProcessed, vWinners.size());
+    BOOST_CHECK_EQUAL(stats.nAccepted - statsBefore.nAccepted, vWinners.size());
+}
+
+BOOST_AUTO_TEST_CASE(mnw_batch_rank)
+{
+    const int nBlockHeight = 150;
+    const CScript payee = RandomPayee();
+
+    // ranked just past the payment quorum: ignored, it is a common mistake
+    CMasternodePaymentWinner winnerNear = Winner(Ranked(MNPAYMENTS_SIGNATURES_TOTAL + 1, nBlockHeight), nBlockHeight, payee);
+    CMasternodePaymentWinner winnerEdge = Winner(Ranked(2 * MNPAYMENTS_SIGNATURES_TOTAL, nBlockHeight), nBlockHeight, payee);
+    // ranked past twice the quorum: ignored as well (and punished once synced)
+    CMasternodePaymentWinner winnerFar = Winner(Ranked(2 * MNPAYMENTS_SIGNATURES_TOTAL + 1, nBlockHeight), nBlockHeight, payee);
+    CMasternodePaymentWinner winnerTop = Winner(Ranked(MNPAYMENTS_SIGNATURES_TOTAL, nBlockHeight), nBlockHeight, payee);
+
+    // a masternode without a rank, here because its collateral is gone, is not rejected
+    size_t nDisabled = Ranked(3 * MNPAYMENTS_SIGNATURES_TOTAL, nBlockHeight);
+    CMasternodePaymentWinner winnerDisabled = Winner(nDisabled, nBlockHeight, payee);
+    {
+        CMasternode* pmn = mnodeman.Find(vVins[nDisabled]);
+        BOOST_REQUIRE(pmn);
+        pmn->unitTest = false;
+        pmn->Check(true);
+        BOOST_REQUIRE(!pmn->IsEnabled());
+    }
+
+    // an unknown masternode is ignored
+    CKey key;
+    key.MakeNewKey(true);
+    CMasternodePaymentWinner winnerUnknown(CTxIn(COutPoint(InsecureRand256(), 0)));
+    winnerUnknown.nBlockHeight = nBlockHeight;
+    winnerUnknown.AddPayee(payee);
+    CPubKey pubkey = key.GetPubKey();
+    BOOST_REQUIRE(winnerUnknown.Sign(key, pubkey));
+
+    for (CMasternodePaymentWinner* pwinner : {&winnerNear, &winnerEdge, &winnerFar, &winnerTop, &winnerDisabled, &winnerUnknown}) {
+        BOOST_CHECK(masternodePayments.QueueWinner(0, *pwinner));
+    }
+    masternodePayments.ProcessPendingWinners(*connman);
+
+    BOOST_CHECK(!Accepted(winnerNear));
+    BOOST_CHECK(!Accepted(winnerEdge));
+    BOOST_CHECK(!Accepted(winnerFar));
+    BOOST_CHECK(!Accepted(winnerUnknown));
+    BOOST_CHECK(Accepted(winnerTop));
+    BOOST_CHECK(Accepted(winnerDisabled));
+    BOOST_CHECK_EQUAL(Votes(nBlockHeight, payee), 2);
+}
+
+BOOST_AUTO_TEST_CASE(mnw_batch_can_vote)
+{
+    const int nBlockHeight = 150;
+    const size_t nMasternode = Ranked(1, nBlockHeight);
+    const CScript payee1 = RandomPayee();
+    const CScript payee2 = RandomPayee();
+
+    // one vote per masternode and height, the first one queued wins
+    CMasternodePaymentWinner winner1 = Winner(nMasternode, nBlockHeight, payee1);
+    CMasternodePaymentWinner winner2 = Winner(nMasternode, nBlockHeight, payee2);
+    int nNextHeight = nBlockHeight + 1;
+    while (mnodeman.GetMasternodeRank(vVins[nMasternode], nNextHeight - 100, MIN_MNW_PEER_PROTO_VERSION) > MNPAYMENTS_SIGNATURES_TOTAL) {
+        BOOST_REQUIRE(++nNextHeight < 200);
+    }
+    CMasternodePaymentWinner winnerNext = Winner(nMasternode, nNextHeight, payee2);
+    BOOST_CHECK(masternodePayments.QueueWinner(0, winner1));
+    BOOST_CHECK(masternodePayments.QueueWinner(0, winner2));
+    masternodePayments.ProcessPendingWinners(*connman);
+    BOOST_CHECK(Accepted(winner1));
+    BOOST_CHECK(!Accepted(winner2));
+    BOOST_CHECK_EQUAL(Votes(nBlockHeight, payee1), 1);
+    BOOST_CHECK_EQUAL(Votes(nBlockHeight, payee2), 0);
+
+    // a later batch doesn't let it vote again for that height, only for another one
+    BOOST_CHECK(masternodePayments.QueueWinner(0, winner2));
+    BOOST_CHECK(masternodePayments.QueueWinner(0, winnerNext));
+    masternodePayments.ProcessPendingWinners(*connman);
+    BOOST_CHECK(!Accepted(winner2));
+    BOOST_CHECK(Accepted(winnerNext));
+}
+
+BOOST_AUTO_TEST_CASE(mnw_batch_bad_signature)
+{
+    const int nBlockHeight = 150;
+    const CScript payee = RandomPayee();
+
+    // no signature, and a signature no key can be recovered from
+    CMasternodePaymentWinner winnerUnsigned(vVins[Ranked(1, nBlockHeight)]);
+    winnerUnsigned.nBlockHeight = nBlockHeight;
+    winnerUnsigned.AddPayee(payee);
+    CMasternodePaymentWinner winnerCorrupt = Winner(Ranked(2, nBlockHeight), nBlockHeight, payee);
+    BOOST_REQUIRE_EQUAL(winnerCorrupt.vchSig.size(), 65U);
+    std::fill(winnerCorrupt.vchSig.begin() + 1, winnerCorrupt.vchSig.begin() + 33, 0);
+    CMasternodePaymentWinner winnerTruncated = Winner(Ranked(3, nBlockHeight), nBlockHeight, payee);
+    winnerTruncated.vchSig.pop_back();
+
+    // the valid winners of the same batch still go through
+    std::vector<CMasternodePaymentWinner> vValid;
+    for (int nRank = 4; nRank <= MNPAYMENTS_SIGNATURES_TOTAL; nRank++) {
+        vValid.push_back(Winner(Ranked(nRank, nBlockHeight), nBlockHeight, payee));
+    }
+
+    BOOST_CHECK(masternodePayments.QueueWinner(0, winnerUnsigned));
+    BOOST_CHECK(masternodePayments.QueueWinner(1, winnerCorrupt));
+    BOOST_CHECK(masternodePayments.QueueWinner(1, winnerTruncated));
+    for (auto& winner : vValid) {
+        BOOST_CHECK(masternodePayments.QueueWinner(2, winner));
+    }
+    masternodePayments.ProcessPendingWinners(*connman);
+
+    BOOST_CHECK(!Accepted(winnerUnsigned));
+    BOOST_CHECK(!Accepted(winnerCorrupt));
+    BOOST_CHECK(!Accepted(winnerTruncated));
+    for (auto& winner : vValid) {
+        BOOST_CHECK(Accepted(winner));
+    }
+    BOOST_CHECK_EQUAL(Votes(nBlockHeight, payee), (int)vValid.size());
+}
+
+BOOST_AUTO_TEST_CASE(mnw_batch_held)
+{
+    // the winners of a height whose rank block isn't known yet stay queued
+    const int nBlockHeight = 210;
+    const CScript payee = RandomPayee();
+    std::vector<CMasternodePaymentWinner> vWinners;
+    for (size_t i = 0; i < vVins.size(); i++) {
+        vWinners.push_back(Winner(i, nBlockHeight, payee));
+        BOOST_CHECK(masternodePayments.QueueWinner(0, vWinners.back()));
+    }
+    const CMasternodeWinnerStats statsBefore = masternodePayments.GetWinnerStats();
+    masternodePayments.ProcessPendingWinners(*connman);
+    CMasternodeWinnerStats stats = masternodePayments.GetWinnerStats();
+    BOOST_CHECK_EQUAL(stats.nQueued, vWinners.size());
+    BOOST_CHECK_EQUAL(stats.nProcessed, statsBefore.nProcessed);
+    BOOST_CHECK_EQUAL(Votes(nBlockHeight, payee), 0);
+
+    // and are ranked once the block comes
+    const CScript script = RandomPayee();
+    while (WITH_LOCK(cs_main, return ::ChainActive().Height()) < nBlockHeight - 100) {
+        CreateAndProcessBlock({}, script);
+    }
+    masternodePayments.ProcessPendingWinners(*connman);
+    stats = masternodePayments.GetWinnerStats();
+    BOOST_CHECK_EQUAL(stats.nQueued, 0U);
+    BOOST_CHECK_EQUAL(stats.nProcessed - statsBefore.nProcessed, vWinners.size());
+    BOOST_CHECK_EQUAL(Votes(nBlockHeight, payee), MNPAYMENTS_SIGNATURES_TOTAL);
+}
+
+BOOST_AUTO_TEST_CASE(mn_quorum_by_block)
+{
+    // scores of a height are calculated from the block before it
+    const int nBlockHeight = 90;
+    std::shared_ptr<const CMasternodeQuorum> pquorum = mnodeman.GetQuorum(nBlockHeight, MNPAYMENTS_SIGNATURES_TOTAL, MIN_MNW_PEER_PROTO_VERSION);
+    BOOST_REQUIRE(pquorum);
+    BOOST_CHECK(pquorum->hashBlock == WITH_LOCK(cs_main, return ::ChainActive()[nBlockHeight - 1]->GetBlockHash()));
+    BOOST_CHECK_EQUAL(pquorum->mapRanks.size(), (size_t)MNPAYMENTS_SIGNATURES_TOTAL);
+    for (const CTxIn& vin : vVins) {
+        int nRank = mnodeman.GetMasternodeRank(vin, nBlockHeight, MIN_MNW_PEER_PROTO_VERSION);
+        BOOST_CHECK_EQUAL(pquorum->GetRank(vin.prevout), nRank <= MNPAYMENTS_SIGNATURES_TOTAL ? nRank : -1);
+    }
+
+    // the same block gets the same quorum
+    BOOST_CHECK(mnodeman.GetQuorum(nBlockHeight, MNPAYMENTS_SIGNATURES_TOTAL, MIN_MNW_PEER_PROTO_VERSION) == pquorum);
+
+    // another block at the height, after a reorg, is ranked anew
+    {
+        BlockValidationState state;
+        CBlockIndex* pindex = WITH_LOCK(cs_main, return ::ChainActive()[nBlockHeight - 1]);
+        BOOST_REQUIRE(::ChainstateActive().InvalidateBlock(state, Params(), pindex));
+    }
+    const CScript script = RandomPayee();
+    while (WITH_LOCK(cs_main, return ::ChainActive().Height()) < 100) {
+        CreateAndProcessBlock({}, script);
+    }
+    std::shared_ptr<const CMasternodeQuorum> pquorumReorg = mnodeman.GetQuorum(nBlockHeight, MNPAYMENTS_SIGNATURES_TOTAL, MIN_MNW_PEER_PROTO_VERSION);
+    BOOST_REQUIRE(pquorumReorg);
+    BOOST_CHECK(pquorumReorg != pquorum);
+    BOOST_CHECK(pquorumReorg->hashBlock != pquorum->hashBlock);
+    BOOST_CHECK(pquorumReorg->hashBlock == WITH_LOCK(cs_main, return ::ChainActive()[nBlockHeight - 1]->GetBlockHash()));
+}
+
+BOOST_AUTO_TEST_CASE(mn_quorum_spork_update)
+{
+    RegisterValidationInterface(&mnodeman);
+    const int nBlockHeight = 90;
+    std::shared_ptr<const CMasternodeQuorum> pquorum = mnodeman.GetQuorum(nBlockHeight, MNPAYMENTS_SIGNATURES_TOTAL, MIN_MNW_PEER_PROTO_VERSION);
+    BOOST_REQUIRE(pquorum);
+    BOOST_CHECK(mnodeman.GetQuorum(nBlockHeight, MNPAYMENTS_SIGNATURES_TOTAL, MIN_MNW_PEER_PROTO_VERSION) == pquorum);
+
+    // a spork change ranks the quorum anew
+    GetMainSignals().SporkUpdated(SPORK_8_MASTERNODE_PAYMENT_ENFORCEMENT, 0);
+    std::shared_ptr<const CMasternodeQuorum> pquorumSpork = mnodeman.GetQuorum(nBlockHeight, MNPAYMENTS_SIGNATURES_TOTAL, MIN_MNW_PEER_PROTO_VERSION);
+    BOOST_REQUIRE(pquorumSpork);
+    BOOST_CHECK(pquorumSpork != pquorum);
+    BOOST_CHECK(pquorumSpork->mapRanks == pquorum->mapRanks);
+    UnregisterValidationInterface(&mnodeman);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,90 @@
+// Copyright (c) 2014-2020 The Crown developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <chainparams.h>
+#include <clientversion.h>
+#include <masternode/masternode-payments.h>
+#include <mn_processing.h>
+#include <net.h>
+#include <protocol.h>
+#include <streams.h>
+#include <test/util/setup_common.h>
+#include <util/time.h>
+#include <version.h>
+
+#include <string>
+#include <vector>
+
+#include <boost/test/unit_test.hpp>
+
+namespace {
+CMasternodeMessageRecord Record(int64_t nTime, const std::string& msg_type, const std::vector<unsigned char>& vData)
+{
+    CMasternodeMessageRecord record;
+    record.nTimeMicros = nTime * 1000000;
+    record.nPeer = 7;
+    record.addrPeer = CService(CNetAddr(), 9340);
+    record.nPeerVersion = PROTOCOL_VERSION;
+    record.nRecvVersion = PROTOCOL_VERSION;
+    record.msg_type = msg_type;
+    record.vData = vData;
+    return record;
+}
+
+void WriteCapture(const fs::path& path, const std::vector<CMasternodeMessageRecord>& vRecords)
+{
+    CAutoFile file(fsbridge::fopen(path, "wb"), SER_DISK, CLIENT_VERSION);
+    BOOST_REQUIRE(!file.IsNull());
+    for (const CMasternodeMessageRecord& record : vRecords)
+        file << record;
+}
+} // namespace
+
+BOOST_FIXTURE_TEST_SUITE(mn_processing_tests, RegTestingSetup)
+
+BOOST_AUTO_TEST_CASE(replay_mn_messages)
+{
+    CConnman connman(0x1337, 0x1337);
+    const fs::path path = GetDataDir() / "mnmessages.dat";
+
+    // a spork cut short, a winner for a block far past the tip and a message nobody handles
+    CMasternodePaymentWinner winner;
+    winner.nBlockHeight = 1000000;
+    CDataStream ssWinner(SER_NETWORK, PROTOCOL_VERSION);
+    ssWinner << winner;
+    WriteCapture(path, {
+        Record(1600000000, NetMsgType::SPORK, {1, 2, 3}),
+        Record(1600000010, NetMsgType::MNWINNER, std::vector<unsigned char>(ssWinner.begin(), ssWinner.end())),
+        Record(1600000020, "unknown", {}),
+    });
+
+    SetMockTime(42);
+    CMasternodeReplayStats stats;
+    std::string strError;
+    BOOST_REQUIRE(ReplayMasternodeMessages(path, Params(), *m_node.mempool, connman, stats, strError));
+    BOOST_CHECK_EQUAL(stats.nMessages, 3U);
+    BOOST_CHECK_EQUAL(stats.nFailed, 1U);
+    BOOST_CHECK_EQUAL(stats.mapTypes[NetMsgType::SPORK].nCount, 1U);
+    BOOST_CHECK_EQUAL(stats.mapTypes[NetMsgType::SPORK].nBytes, 3U);
+    BOOST_CHECK_EQUAL(stats.mapTypes["unknown"].nCount, 1U);
+
+    // the queued winners are verified with the message, under its name
+    BOOST_CHECK(stats.mapTypes[NetMsgType::MNWINNER].mapLocks.count("cs_processWinners"));
+    BOOST_CHECK(!stats.mapTypes["unknown"].mapLocks.count("cs_processWinners"));
+    BOOST_CHECK_EQUAL(stats.vUsageBefore.size(), stats.vUsageAfter.size());
+    BOOST_CHECK_EQUAL(stats.vUsageBefore.front().first, "masternodes");
+
+    // the mock time and lock statistics are as they were
+    BOOST_CHECK_EQUAL(GetMockTime(), 42);
+    BOOST_CHECK(!g_lock_stats);
+    SetMockTime(0);
+
+    // the running node of any other chain is left alone
+    CMasternodeReplayStats statsMain;
+    BOOST_CHECK(!ReplayMasternodeMessages(path, *CreateChainParams(gArgs, CBaseChainParams::MAIN), *m_node.mempool, connman, statsMain, strError));
+    BOOST_CHECK_EQUAL(statsMain.nMessages, 0U);
+    BOOST_CHECK(!ReplayMasternodeMessages(GetDataDir() / "missing.dat", Params(), *m_node.mempool, connman, statsMain, strError));
+}
+
+BOOST_AUTO_TEST_SUITE_END()
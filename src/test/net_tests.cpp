@@ -21,7 +21,9 @@
 
 #include <boost/test/unit_test.hpp>
 
+#include <algorithm>
 #include <ios>
+#include <list>
 #include <memory>
 #include <string>
 
@@ -83,6 +85,47 @@ static CDataStream AddrmanToStream(CAddrManSerializationMock& _addrman)
     return CDataStream(vchData, SER_DISK, CLIENT_VERSION);
 }
 
+static CNetMessage TestMessage(MessageClass msg_class, uint32_t nSize, const std::string& strCommand = "")
+{
+    CNetMessage msg(CDataStream(SER_NETWORK, PROTOCOL_VERSION));
+    msg.m_class = msg_class;
+    msg.m_raw_message_size = nSize;
+    msg.m_command = strCommand;
+    return msg;
+}
+
+static void PushMessages(CProcessMsgQueue& queue, MessageClass msg_class, int nCount, uint32_t nSize)
+{
+    std::list<CNetMessage> msgs;
+    for (int i = 0; i < nCount; i++) {
+        msgs.push_back(TestMessage(msg_class, nSize));
+    }
+    queue.Push(msgs, msgs.end());
+}
+
+//! The classes of the next nCount messages taken from the queue
+static std::vector<MessageClass> PopClasses(CProcessMsgQueue& queue, int nCount)
+{
+    std::vector<MessageClass> vClasses;
+    std::list<CNetMessage> msgs;
+    for (int i = 0; i < nCount && queue.Pop(msgs); i++) {
+        vClasses.push_back(msgs.front().m_class);
+    }
+    return vClasses;
+}
+
+//! The lengths of the runs of messages of one class
+static std::vector<std::pair<MessageClass, int>> ClassRuns(const std::vector<MessageClass>& vClasses)
+{
+    std::vector<std::pair<MessageClass, int>> vRuns;
+    for (MessageClass msg_class : vClasses) {
+        if (vRuns.empty() || vRuns.back().first != msg_class)
+            vRuns.emplace_back(msg_class, 0);
+        vRuns.back().second++;
+    }
+    return vRuns;
+}
+
 BOOST_FIXTURE_TEST_SUITE(net_tests, BasicTestingSetup)
 
 BOOST_AUTO_TEST_CASE(cnode_listen_port)
@@ -769,4 +812,132 @@ BOOST_AUTO_TEST_CASE(PoissonNextSend)
     g_mock_deterministic_tests = false;
 }
 
+BOOST_AUTO_TEST_CASE(process_msg_queue_order)
+{
+    CProcessMsgQueue queue;
+    std::list<CNetMessage> msgs;
+    BOOST_CHECK(queue.empty());
+    BOOST_CHECK(!queue.Pop(msgs));
+
+    // Only the messages up to end are queued
+    msgs.push_back(TestMessage(MessageClass::TX, 100, "t0"));
+    msgs.push_back(TestMessage(MessageClass::CONTROL, 100, "c0"));
+    msgs.push_back(TestMessage(MessageClass::BLOCK, 100, "b0"));
+    msgs.push_back(TestMessage(MessageClass::CONTROL, 100, "c1"));
+    msgs.push_back(TestMessage(MessageClass::TX, 100, "t1"));
+    msgs.push_back(TestMessage(MessageClass::GOSSIP, 100, "g0"));
+    queue.Push(msgs, std::prev(msgs.end()));
+    BOOST_CHECK_EQUAL(msgs.size(), 1U);
+    msgs.clear();
+
+    // Control messages come first, each class keeps its own order
+    std::vector<std::string> vCommands;
+    while (queue.Pop(msgs)) {
+        vCommands.push_back(msgs.front().m_command);
+        // A control message arriving in between is taken next
+        if (vCommands.size() == 4) {
+            std::list<CNetMessage> control;
+            control.push_back(TestMessage(MessageClass::CONTROL, 100, "c2"));
+            queue.Push(control, control.end());
+        }
+    }
+    BOOST_CHECK((vCommands == std::vector<std::string>{"c0", "c1", "b0", "t0", "c2", "t1"}));
+    BOOST_CHECK_EQUAL(msgs.size(), vCommands.size());
+    BOOST_CHECK(queue.empty());
+}
+
+BOOST_AUTO_TEST_CASE(process_msg_queue_notfound)
+{
+    // A peer answers a getdata with two transactions and a notfound for the rest, among its gossip
+    CProcessMsgQueue queue;
+    std::list<CNetMessage> msgs;
+    for (const char* command : {NetMsgType::MNPING, NetMsgType::TX, NetMsgType::TX, NetMsgType::NOTFOUND, NetMsgType::PING, NetMsgType::CMPCTBLOCK, NetMsgType::MNPING}) {
+        msgs.push_back(TestMessage(GetMessageClass(command), 100, command));
+    }
+    queue.Push(msgs, msgs.end());
+
+    // The notfound, and the ping behind it, wait for the messages received before it, the block after it doesn't
+    std::vector<std::string> vCommands;
+    while (queue.Pop(msgs)) {
+        vCommands.push_back(msgs.front().m_command);
+    }
+    BOOST_REQUIRE_EQUAL(vCommands.size(), 7U);
+    vCommands.resize(5);
+    BOOST_CHECK((vCommands == std::vector<std::string>{NetMsgType::TX, NetMsgType::TX, NetMsgType::MNPING, NetMsgType::NOTFOUND, NetMsgType::PING}));
+    msgs.clear();
+
+    // Received later, a notfound is taken first once the data before it is done
+    msgs.push_back(TestMessage(GetMessageClass(NetMsgType::BLOCK), 100, NetMsgType::BLOCK));
+    msgs.push_back(TestMessage(GetMessageClass(NetMsgType::NOTFOUND), 100, NetMsgType::NOTFOUND));
+    queue.Push(msgs, msgs.end());
+    msgs.push_back(TestMessage(GetMessageClass(NetMsgType::TX), 100, NetMsgType::TX));
+    queue.Push(msgs, msgs.end());
+    vCommands.clear();
+    while (queue.Pop(msgs)) {
+        vCommands.push_back(msgs.front().m_command);
+    }
+    BOOST_CHECK((vCommands == std::vector<std::string>{NetMsgType::BLOCK, NetMsgType::NOTFOUND, NetMsgType::TX}));
+}
+
+BOOST_AUTO_TEST_CASE(process_msg_queue_budget)
+{
+    // Each round grants the block class twice the bytes of the transaction class
+    CProcessMsgQueue queue;
+    PushMessages(queue, MessageClass::BLOCK, 1000, 16000);
+    PushMessages(queue, MessageClass::TX, 1000, 16000);
+    std::vector<std::pair<MessageClass, int>> vRuns = ClassRuns(PopClasses(queue, 6 * 48));
+    BOOST_REQUIRE_EQUAL(vRuns.size(), 12U);
+    for (size_t i = 0; i < vRuns.size(); i++) {
+        BOOST_CHECK(vRuns[i].first == (i % 2 ? MessageClass::TX : MessageClass::BLOCK));
+        BOOST_CHECK_EQUAL(vRuns[i].second, i % 2 ? 16 : 32);
+    }
+
+    // A message larger than the budget left is still taken, and the overdraft carries over to the next rounds
+    CProcessMsgQueue large;
+    PushMessages(large, MessageClass::BLOCK, 100, 300000);
+    PushMessages(large, MessageClass::TX, 1000, 16000);
+    vRuns = ClassRuns(PopClasses(large, 2 + 16 + 2 + 16 + 2 + 16 + 1 + 16 + 2));
+    std::vector<std::pair<MessageClass, int>> vExpected;
+    for (int nBlocks : {2, 2, 2, 1}) {
+        vExpected.emplace_back(MessageClass::BLOCK, nBlocks);
+        vExpected.emplace_back(MessageClass::TX, 16);
+    }
+    vExpected.emplace_back(MessageClass::BLOCK, 2);
+    BOOST_CHECK(vRuns == vExpected);
+
+    // CPU time spent on a class is charged to it as well
+    CProcessMsgQueue slow;
+    PushMessages(slow, MessageClass::BLOCK, 1000, 100);
+    PushMessages(slow, MessageClass::TX, 1000, 16000);
+    BOOST_CHECK(PopClasses(slow, 1) == std::vector<MessageClass>{MessageClass::BLOCK});
+    slow.ChargeCPUTime(MessageClass::BLOCK, 2 * DEFAULT_MSG_CLASS_WEIGHTS[0] * MSG_CLASS_CPU_QUANTUM);
+    vRuns = ClassRuns(PopClasses(slow, 2 * 16 + 1));
+    BOOST_CHECK((vRuns == std::vector<std::pair<MessageClass, int>>{{MessageClass::TX, 2 * 16}, {MessageClass::BLOCK, 1}}));
+}
+
+BOOST_AUTO_TEST_CASE(process_msg_queue_idle_class)
+{
+    // A class with nothing queued doesn't hold back the others
+    CProcessMsgQueue queue;
+    PushMessages(queue, MessageClass::SMSG, 1000, 16000);
+    std::vector<MessageClass> vClasses = PopClasses(queue, 200);
+    BOOST_CHECK_EQUAL(vClasses.size(), 200U);
+    BOOST_CHECK(std::all_of(vClasses.begin(), vClasses.end(), [](MessageClass msg_class) { return msg_class == MessageClass::SMSG; }));
+
+    // Nor does it save up budget while idle: a flood of it afterwards gets the share of a single round
+    PushMessages(queue, MessageClass::BLOCK, 1000, 16000);
+    std::vector<std::pair<MessageClass, int>> vRuns = ClassRuns(PopClasses(queue, 10 * 36));
+    int nBlockRuns = 0;
+    for (const auto& run : vRuns) {
+        if (run.first == MessageClass::BLOCK) {
+            BOOST_CHECK(run.second <= 32);
+            nBlockRuns++;
+        } else {
+            BOOST_CHECK(run.first == MessageClass::SMSG);
+            BOOST_CHECK(run.second <= 4);
+        }
+    }
+    BOOST_CHECK(nBlockRuns >= 9);
+}
+
 BOOST_AUTO_TEST_SUITE_END()
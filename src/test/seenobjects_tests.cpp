@@ -0,0 +1,135 @@
+// Copyright (c) 2014-2020 The Crown developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <crown/seenobjects.h>
+#include <test/util/setup_common.h>
+
+#include <boost/test/unit_test.hpp>
+
+namespace {
+struct SeenObject {
+    CTxIn vin;
+    int64_t sigTime{0};
+
+    SeenObject() = default;
+    SeenObject(const COutPoint& outpoint, int64_t nTime) : vin(outpoint), sigTime(nTime) {}
+};
+} // namespace
+
+BOOST_FIXTURE_TEST_SUITE(seenobjects_tests, BasicTestingSetup)
+
+BOOST_AUTO_TEST_CASE(seenobjects_erase_readd)
+{
+    CSeenObjects<SeenObject> seen(1 << 10);
+    const COutPoint outpoint(InsecureRand256(), 0);
+    const uint256 hash = InsecureRand256();
+
+    seen.Add(hash, SeenObject(outpoint, 100));
+    BOOST_CHECK(seen.Has(hash));
+    BOOST_CHECK(seen.Get(hash) != nullptr);
+
+    seen.Erase(hash);
+    BOOST_CHECK(!seen.Has(hash));
+    BOOST_CHECK(seen.Get(hash) == nullptr);
+    BOOST_CHECK_EQUAL(seen.size(), 0U);
+
+    // the same object must be accepted again after it was erased
+    seen.Add(hash, SeenObject(outpoint, 100));
+    BOOST_CHECK(seen.Has(hash));
+    BOOST_CHECK(seen.Get(hash) != nullptr);
+    BOOST_CHECK_EQUAL(seen.size(), 1U);
+
+    // hashes only marked as seen are forgotten the same way
+    const uint256 hashInvalid = InsecureRand256();
+    seen.MarkSeen(hashInvalid, outpoint);
+    BOOST_CHECK(seen.Has(hashInvalid));
+    seen.Erase(hashInvalid);
+    BOOST_CHECK(!seen.Has(hashInvalid));
+    seen.MarkSeen(hashInvalid, outpoint);
+    BOOST_CHECK(seen.Has(hashInvalid));
+}
+
+BOOST_AUTO_TEST_CASE(seenobjects_erase_node_and_expired)
+{
+    CSeenObjects<SeenObject> seen(1 << 10);
+    const COutPoint outpoint1(InsecureRand256(), 0);
+    const COutPoint outpoint2(InsecureRand256(), 1);
+    const uint256 hashOld = InsecureRand256();
+    const uint256 hashNew = InsecureRand256();
+    const uint256 hash2 = InsecureRand256();
+
+    // only the newest object of a node is kept, older hashes stay seen
+    seen.Add(hashOld, SeenObject(outpoint1, 100));
+    seen.Add(hashNew, SeenObject(outpoint1, 200));
+    seen.Add(hash2, SeenObject(outpoint2, 100));
+    BOOST_CHECK_EQUAL(seen.size(), 2U);
+    BOOST_CHECK(seen.Get(hashOld) == nullptr);
+    BOOST_CHECK(seen.Has(hashOld));
+
+    // dropping a node forgets its older hashes too, so they can be announced again
+    BOOST_CHECK(seen.EraseNode(outpoint1) == hashNew);
+    BOOST_CHECK(!seen.Has(hashNew));
+    BOOST_CHECK(!seen.Has(hashOld));
+    BOOST_CHECK(seen.Has(hash2));
+    BOOST_CHECK(seen.EraseNode(outpoint1).IsNull());
+    seen.Add(hashOld, SeenObject(outpoint1, 100));
+    BOOST_CHECK(seen.Get(hashOld) != nullptr);
+    seen.Add(hashNew, SeenObject(outpoint1, 200));
+    BOOST_CHECK(seen.Get(hashNew) != nullptr);
+
+    // hashes only marked as seen belong to their node as well
+    const uint256 hashInvalid = InsecureRand256();
+    seen.MarkSeen(hashInvalid, outpoint2);
+
+    std::vector<uint256> vErased = seen.EraseIf([](const SeenObject& obj) { return obj.sigTime < 150; });
+    BOOST_CHECK_EQUAL(vErased.size(), 1U);
+    BOOST_CHECK(vErased[0] == hash2);
+    BOOST_CHECK(!seen.Has(hash2));
+    BOOST_CHECK(!seen.Has(hashInvalid));
+    BOOST_CHECK(seen.Has(hashNew));
+    BOOST_CHECK(seen.Has(hashOld));
+    seen.Add(hash2, SeenObject(outpoint2, 100));
+    BOOST_CHECK(seen.Has(hash2));
+    BOOST_CHECK_EQUAL(seen.size(), 2U);
+}
+
+BOOST_AUTO_TEST_CASE(seenobjects_erased_set_bounded)
+{
+    // 16 erased hashes at most are masked before the cache is rebuilt
+    CSeenObjects<SeenObject> seen(1 << 8);
+    const COutPoint outpoint(InsecureRand256(), 0);
+    const uint256 hashKept = InsecureRand256();
+    seen.Add(hashKept, SeenObject(outpoint, 100));
+
+    std::vector<uint256> vHashes;
+    for (int i = 0; i < 64; ++i) {
+        vHashes.push_back(InsecureRand256());
+        seen.MarkSeen(vHashes.back(), COutPoint(InsecureRand256(), 0));
+        seen.Erase(vHashes.back());
+    }
+    for (const uint256& hash : vHashes)
+        BOOST_CHECK(!seen.Has(hash));
+    // stored objects survive the rebuild
+    BOOST_CHECK(seen.Has(hashKept));
+    BOOST_CHECK(seen.Get(hashKept) != nullptr);
+}
+
+BOOST_AUTO_TEST_CASE(seenobjects_node_hashes_bounded)
+{
+    CSeenObjects<SeenObject> seen(1 << 10);
+    const COutPoint outpoint(InsecureRand256(), 0);
+    std::vector<uint256> vHashes;
+    for (size_t i = 0; i < CSeenObjects<SeenObject>::MAX_SEEN_PER_NODE + 8; ++i) {
+        vHashes.push_back(InsecureRand256());
+        seen.Add(vHashes.back(), SeenObject(outpoint, 100 + i));
+    }
+    BOOST_CHECK_EQUAL(seen.size(), 1U);
+
+    // only the most recent hashes of a node are forgotten with it
+    seen.EraseNode(outpoint);
+    for (size_t i = 0; i < vHashes.size(); ++i)
+        BOOST_CHECK_EQUAL(seen.Has(vHashes[i]), i < 8);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,209 @@
+// Copyright (c) 2014-2020 The Crown developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <smsg/db.h>
+#include <smsg/smessage.h>
+#include <streams.h>
+#include <clientversion.h>
+#include <test/util/setup_common.h>
+
+#include <leveldb/env.h>
+#include <memenv.h>
+
+#include <array>
+#include <memory>
+#include <set>
+
+#include <boost/test/unit_test.hpp>
+
+using namespace smsg;
+
+namespace {
+typedef std::array<uint8_t, 30> MsgKey;
+
+//! A secure message db kept in memory, installed as the global smsgDB
+struct SmsgDBSetup : public BasicTestingSetup {
+    std::unique_ptr<leveldb::Env> env;
+    SecMsgDB db;
+    std::vector<CKeyID> addresses;
+
+    SmsgDBSetup()
+    {
+        env.reset(leveldb::NewMemEnv(leveldb::Env::Default()));
+        leveldb::Options options;
+        options.create_if_missing = true;
+        options.env = env.get();
+        BOOST_REQUIRE(leveldb::DB::Open(options, "smsgdb", &smsgDB).ok());
+        BOOST_REQUIRE(db.Open("cw"));
+        for (int i = 0; i < 4; i++) {
+            uint256 rand = InsecureRand256();
+            CKeyID address;
+            memcpy(address.begin(), rand.begin(), 20);
+            addresses.push_back(address);
+        }
+    }
+
+    ~SmsgDBSetup()
+    {
+        delete smsgDB;
+        smsgDB = nullptr;
+    }
+
+    CKeyID RandomAddress() { return addresses[InsecureRandRange(addresses.size())]; }
+
+    MsgKey RandomKey(const std::string& prefix)
+    {
+        MsgKey chKey;
+        memcpy(chKey.data(), prefix.data(), 2);
+        uint256 rand = InsecureRand256();
+        memcpy(chKey.data() + 2, rand.begin(), 28);
+        return chKey;
+    }
+
+    SecMsgStored RandomStored()
+    {
+        SecMsgStored smsgStored;
+        smsgStored.timeReceived = InsecureRand32();
+        smsgStored.status = InsecureRandBool() ? SMSG_MASK_UNREAD : 0;
+        smsgStored.folderId = 0;
+        smsgStored.addrTo = RandomAddress();
+        smsgStored.addrOutbox = RandomAddress();
+        smsgStored.vchMessage.assign(SMSG_HDR_LEN, (uint8_t)InsecureRandRange(256));
+        return smsgStored;
+    }
+
+    //! All the index keys currently in the db
+    std::set<std::string> IndexKeys()
+    {
+        std::set<std::string> keys;
+        std::unique_ptr<leveldb::Iterator> it(smsgDB->NewIterator(leveldb::ReadOptions()));
+        for (const std::string& prefix : {DBK_INBOX_ADDR, DBK_OUTBOX_ADDR, DBK_INBOX_UNREAD}) {
+            for (it->Seek(prefix); it->Valid() && it->key().starts_with(prefix); it->Next()) {
+                keys.insert(it->key().ToString());
+            }
+        }
+        return keys;
+    }
+
+    //! The index keys the stored messages and their metadata call for
+    std::set<std::string> ExpectedIndexKeys()
+    {
+        std::set<std::string> keys;
+        uint8_t chKey[30];
+        for (const std::string& prefix : {DBK_INBOX, DBK_OUTBOX}) {
+            const std::string& addrPrefix = prefix == DBK_INBOX ? DBK_INBOX_ADDR : DBK_OUTBOX_ADDR;
+            SecMsgStored smsgStored;
+            std::unique_ptr<leveldb::Iterator> it(smsgDB->NewIterator(leveldb::ReadOptions()));
+            while (db.NextSmesg(it.get(), prefix, chKey, smsgStored)) {
+                const std::string id((const char*)chKey + 2, 28);
+                keys.insert(addrPrefix + std::string((const char*)smsgStored.addrTo.begin(), 20) + id);
+                SecMsgMeta meta;
+                if (db.ReadSmesgMeta(chKey, meta) && !meta.addrFrom.IsNull()) {
+                    keys.insert(addrPrefix + std::string((const char*)meta.addrFrom.begin(), 20) + id);
+                }
+                if (prefix == DBK_INBOX && (smsgStored.status & SMSG_MASK_UNREAD)) {
+                    keys.insert(DBK_INBOX_UNREAD + id);
+                }
+            }
+        }
+        return keys;
+    }
+
+    void EraseIndexKeys(bool fVersion)
+    {
+        leveldb::WriteBatch batch;
+        for (const std::string& key : IndexKeys()) {
+            batch.Delete(key);
+        }
+        if (fVersion) {
+            batch.Delete(DBK_INDEX_VERSION);
+        }
+        BOOST_REQUIRE(smsgDB->Write(leveldb::WriteOptions(), &batch).ok());
+    }
+};
+} // namespace
+
+BOOST_FIXTURE_TEST_SUITE(smsg_db_tests, SmsgDBSetup)
+
+BOOST_AUTO_TEST_CASE(smsg_db_indexes)
+{
+    // Write inbox and outbox messages, some with a known sender
+    std::vector<MsgKey> vKeys;
+    for (int i = 0; i < 100; i++) {
+        vKeys.push_back(RandomKey(InsecureRandBool() ? DBK_INBOX : DBK_OUTBOX));
+        BOOST_CHECK(db.WriteSmesg(vKeys.back().data(), RandomStored()));
+        if (InsecureRandBool()) {
+            BOOST_CHECK(db.WriteSmesgMeta(vKeys.back().data(), SecMsgMeta(RandomAddress())));
+        }
+    }
+    // Messages outside the inbox and outbox are not indexed
+    MsgKey queued = RandomKey(DBK_QUEUED);
+    BOOST_CHECK(db.WriteSmesg(queued.data(), RandomStored()));
+    BOOST_CHECK(!db.WriteSmesgMeta(queued.data(), SecMsgMeta(RandomAddress())));
+    BOOST_CHECK(IndexKeys() == ExpectedIndexKeys());
+    BOOST_CHECK(!IndexKeys().empty());
+
+    // Marking messages read and unread again moves them in and out of the unread index
+    for (int i = 0; i < 20; i++) {
+        const MsgKey& chKey = vKeys[InsecureRandRange(vKeys.size())];
+        SecMsgStored smsgStored;
+        BOOST_REQUIRE(db.ReadSmesg(chKey.data(), smsgStored));
+        smsgStored.status ^= SMSG_MASK_UNREAD;
+        BOOST_CHECK(db.WriteSmesg(chKey.data(), smsgStored));
+    }
+    BOOST_CHECK(IndexKeys() == ExpectedIndexKeys());
+
+    // Erasing a message drops every index key pointing at it
+    for (int i = 0; i < 30; i++) {
+        size_t n = InsecureRandRange(vKeys.size());
+        BOOST_CHECK(db.EraseSmesg(vKeys[n].data()));
+        vKeys.erase(vKeys.begin() + n);
+    }
+    BOOST_CHECK(db.EraseSmesg(queued.data()));
+    BOOST_CHECK(IndexKeys() == ExpectedIndexKeys());
+
+    // The same holds inside a transaction
+    BOOST_REQUIRE(db.TxnBegin());
+    BOOST_CHECK(db.EraseSmesg(vKeys.back().data()));
+    vKeys.pop_back();
+    MsgKey added = RandomKey(DBK_INBOX);
+    BOOST_CHECK(db.WriteSmesg(added.data(), RandomStored()));
+    BOOST_CHECK(db.WriteSmesgMeta(added.data(), SecMsgMeta(RandomAddress())));
+    BOOST_REQUIRE(db.TxnCommit());
+    BOOST_CHECK(IndexKeys() == ExpectedIndexKeys());
+
+    uint32_t nErased = 0;
+    BOOST_CHECK(db.EraseAllSmesg(DBK_OUTBOX, nErased));
+    BOOST_CHECK(nErased > 0);
+    BOOST_CHECK(IndexKeys() == ExpectedIndexKeys());
+}
+
+BOOST_AUTO_TEST_CASE(smsg_db_build_indexes)
+{
+    for (int i = 0; i < 100; i++) {
+        MsgKey chKey = RandomKey(InsecureRandBool() ? DBK_INBOX : DBK_OUTBOX);
+        BOOST_CHECK(db.WriteSmesg(chKey.data(), RandomStored()));
+        if (InsecureRandBool()) {
+            BOOST_CHECK(db.WriteSmesgMeta(chKey.data(), SecMsgMeta(RandomAddress())));
+        }
+        if (i % 10 == 0) {
+            BOOST_CHECK(db.EraseSmesg(chKey.data()));
+        }
+    }
+    const std::set<std::string> keys = IndexKeys();
+    BOOST_CHECK(keys == ExpectedIndexKeys());
+
+    // A db from before the indexes existed gets them all back
+    EraseIndexKeys(true);
+    BOOST_CHECK(IndexKeys().empty());
+    BOOST_CHECK(db.BuildIndexes());
+    BOOST_CHECK(IndexKeys() == keys);
+
+    // Once the version is stored the indexes are not built again
+    EraseIndexKeys(false);
+    BOOST_CHECK(db.BuildIndexes());
+    BOOST_CHECK(IndexKeys().empty());
+}
+
+BOOST_AUTO_TEST_SUITE_END()
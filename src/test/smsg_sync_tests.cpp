@@ -0,0 +1,194 @@
+// Copyright (c) 2014-2020 The Crown developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <smsg/smessage.h>
+#include <test/util/setup_common.h>
+#include <timedata.h>
+
+#include <boost/test/unit_test.hpp>
+
+using namespace smsg;
+
+namespace {
+//! An active token whose sample starts with nRange, so that it falls in range nRange % SMSG_SYNC_RANGES
+SecMsgToken RangeToken(int64_t timestamp, uint8_t nRange)
+{
+    uint8_t sample[8];
+    for (uint8_t& b : sample) {
+        b = (uint8_t)InsecureRandRange(256);
+    }
+    sample[0] = nRange;
+    return SecMsgToken(timestamp, sample, 8, 0, 3600);
+}
+
+std::array<bool, SMSG_SYNC_RANGES> AllRanges()
+{
+    std::array<bool, SMSG_SYNC_RANGES> fRanges;
+    fRanges.fill(true);
+    return fRanges;
+}
+} // namespace
+
+BOOST_FIXTURE_TEST_SUITE(smsg_sync_tests, BasicTestingSetup)
+
+BOOST_AUTO_TEST_CASE(smsg_range_hashes)
+{
+    const int64_t now = GetAdjustedTime();
+    const int64_t bucket_time = now - now % SMSG_BUCKET_LEN;
+
+    // An empty bucket hashes every range to zero
+    SecMsgBucket empty;
+    empty.hashBucket(bucket_time);
+    BOOST_CHECK_EQUAL(empty.nActive, 0U);
+    for (uint32_t r = 0; r < SMSG_SYNC_RANGES; ++r) {
+        BOOST_CHECK_EQUAL(empty.rangeHashes[r], 0U);
+    }
+
+    // The range hashes don't depend on the order the tokens arrived in
+    std::vector<SecMsgToken> vTokens;
+    for (int i = 0; i < 200; ++i) {
+        vTokens.push_back(RangeToken(bucket_time + i, (uint8_t)InsecureRandRange(256)));
+    }
+    SecMsgBucket a, b;
+    for (const SecMsgToken& token : vTokens) {
+        a.setTokens.insert(token);
+    }
+    for (auto it = vTokens.rbegin(); it != vTokens.rend(); ++it) {
+        b.setTokens.insert(*it);
+    }
+    a.hashBucket(bucket_time);
+    b.hashBucket(bucket_time);
+    BOOST_CHECK_EQUAL(a.nActive, vTokens.size());
+    BOOST_CHECK(a.rangeHashes == b.rangeHashes);
+    BOOST_CHECK_EQUAL(a.hash, b.hash);
+
+    // Expired tokens are left out of the hashes
+    SecMsgToken expired = RangeToken(bucket_time - 2 * 3600, 7);
+    b.setTokens.insert(expired);
+    b.hashBucket(bucket_time);
+    BOOST_CHECK(a.rangeHashes == b.rangeHashes);
+    BOOST_CHECK_EQUAL(b.nActive, vTokens.size());
+}
+
+BOOST_AUTO_TEST_CASE(smsg_range_boundaries)
+{
+    const int64_t now = GetAdjustedTime();
+    const int64_t bucket_time = now - now % SMSG_BUCKET_LEN;
+
+    // Samples on both sides of a range boundary fall in different ranges, and ranges wrap around
+    BOOST_CHECK_EQUAL(SecMsgBucket::RangeIndex(RangeToken(now, SMSG_SYNC_RANGES - 1)), SMSG_SYNC_RANGES - 1);
+    BOOST_CHECK_EQUAL(SecMsgBucket::RangeIndex(RangeToken(now, SMSG_SYNC_RANGES)), 0U);
+    BOOST_CHECK_EQUAL(SecMsgBucket::RangeIndex(RangeToken(now, 0)), 0U);
+    BOOST_CHECK_EQUAL(SecMsgBucket::RangeIndex(RangeToken(now, 255)), 255U % SMSG_SYNC_RANGES);
+
+    // Buckets that only differ in the last range of one split don't select the first range of the next
+    SecMsgBucket a, b;
+    for (uint8_t n : {(uint8_t)0, (uint8_t)(SMSG_SYNC_RANGES - 1), (uint8_t)SMSG_SYNC_RANGES, (uint8_t)(2 * SMSG_SYNC_RANGES - 1)}) {
+        SecMsgToken token = RangeToken(bucket_time + n, n);
+        a.setTokens.insert(token);
+        b.setTokens.insert(token);
+    }
+    SecMsgToken extra = RangeToken(bucket_time + 500, SMSG_SYNC_RANGES - 1);
+    b.setTokens.insert(extra);
+    a.hashBucket(bucket_time);
+    b.hashBucket(bucket_time);
+
+    std::array<bool, SMSG_SYNC_RANGES> fRanges = b.MismatchedRanges(a.rangeHashes);
+    for (uint32_t r = 0; r < SMSG_SYNC_RANGES; ++r) {
+        BOOST_CHECK_EQUAL(fRanges[r], r == SMSG_SYNC_RANGES - 1);
+    }
+
+    // Every token of the differing range is listed, nothing from the neighbouring ones
+    std::vector<const SecMsgToken*> vShow = b.TokensToShow(bucket_time, now, 0, fRanges);
+    BOOST_CHECK_EQUAL(vShow.size(), 3U);
+    for (const SecMsgToken* token : vShow) {
+        BOOST_CHECK_EQUAL(SecMsgBucket::RangeIndex(*token), SMSG_SYNC_RANGES - 1);
+    }
+}
+
+BOOST_AUTO_TEST_CASE(smsg_mismatched_ranges)
+{
+    const int64_t now = GetAdjustedTime();
+    const int64_t bucket_time = now - now % SMSG_BUCKET_LEN;
+
+    SecMsgBucket local, peer, empty;
+    for (int i = 0; i < 100; ++i) {
+        SecMsgToken token = RangeToken(bucket_time + i, (uint8_t)InsecureRandRange(256));
+        local.setTokens.insert(token);
+        peer.setTokens.insert(token);
+    }
+    SecMsgToken missing = RangeToken(bucket_time + 200, 5);
+    local.setTokens.insert(missing);
+    local.hashBucket(bucket_time);
+    peer.hashBucket(bucket_time);
+    empty.hashBucket(bucket_time);
+
+    // Same tokens, nothing to show
+    BOOST_CHECK((local.MismatchedRanges(local.rangeHashes) == std::array<bool, SMSG_SYNC_RANGES>{}));
+    BOOST_CHECK(local.TokensToShow(bucket_time, now, 0, local.MismatchedRanges(local.rangeHashes)).empty());
+
+    // The peer is only sent the range it misses a token in
+    std::array<bool, SMSG_SYNC_RANGES> fRanges = local.MismatchedRanges(peer.rangeHashes);
+    for (uint32_t r = 0; r < SMSG_SYNC_RANGES; ++r) {
+        BOOST_CHECK_EQUAL(fRanges[r], r == 5);
+    }
+    std::vector<const SecMsgToken*> vShow = local.TokensToShow(bucket_time, now, 0, fRanges);
+    BOOST_CHECK(std::find_if(vShow.begin(), vShow.end(), [&](const SecMsgToken* token) {
+        return !(*token < missing) && !(missing < *token);
+    }) != vShow.end());
+    BOOST_CHECK(vShow.size() < local.setTokens.size());
+
+    // A peer with an empty bucket is sent every range that holds tokens
+    fRanges = local.MismatchedRanges(empty.rangeHashes);
+    BOOST_CHECK_EQUAL(local.TokensToShow(bucket_time, now, 0, fRanges).size(), local.setTokens.size());
+
+    // An empty bucket has nothing to show, whatever the peer holds
+    fRanges = empty.MismatchedRanges(local.rangeHashes);
+    BOOST_CHECK(empty.TokensToShow(bucket_time, now, 0, fRanges).empty());
+
+    // Without range hashes every active token is listed, minus those shown before
+    BOOST_CHECK_EQUAL(local.TokensToShow(bucket_time, now, 0, AllRanges()).size(), local.setTokens.size());
+    BOOST_CHECK(local.TokensToShow(bucket_time, now, bucket_time + 1, AllRanges()).empty());
+}
+
+BOOST_AUTO_TEST_CASE(smsg_bucket_set_snapshot)
+{
+    const int64_t now = GetAdjustedTime();
+    const int64_t bucket_time = now - now % SMSG_BUCKET_LEN;
+    SecMsgBucketSet buckets;
+    for (int i = 0; i < 3; ++i) {
+        buckets.Modify(bucket_time + i * SMSG_BUCKET_LEN, [&](SecMsgBucket& bucket) {
+            bucket.setTokens.insert(RangeToken(bucket_time + i * SMSG_BUCKET_LEN, 0));
+        }, true);
+    }
+    auto snapshot = buckets.Snapshot();
+    BOOST_CHECK_EQUAL(snapshot->size(), 3U);
+
+    // Visiting the buckets, or changing nothing Snapshot reports, keeps the snapshot
+    size_t nVisited = 0;
+    buckets.ForEach([&](int64_t time, const SecMsgBucket& bucket) { nVisited++; });
+    BOOST_CHECK_EQUAL(nVisited, 3U);
+    buckets.ModifyEach([&](int64_t time, SecMsgBucket& bucket) {
+        bucket.nLockCount = 2;
+        return true;
+    });
+    BOOST_CHECK(buckets.Snapshot() == snapshot);
+
+    // Hashing and erasing buckets are changes
+    buckets.ModifyEach([&](int64_t time, SecMsgBucket& bucket) {
+        bucket.hashBucket(time);
+        return true;
+    });
+    auto hashed = buckets.Snapshot();
+    BOOST_CHECK(hashed != snapshot);
+    BOOST_CHECK_EQUAL(hashed->front().nActive, 1U);
+    buckets.ModifyEach([&](int64_t time, SecMsgBucket& bucket) { return time != bucket_time; });
+    BOOST_CHECK_EQUAL(buckets.Snapshot()->size(), 2U);
+
+    // Retrieve and Remove take a token time, which maps to the lock of its bucket
+    BOOST_CHECK(&buckets.GetMutex(bucket_time + 1) == &buckets.GetMutex(bucket_time));
+    BOOST_CHECK(&buckets.GetMutex(bucket_time + SMSG_BUCKET_LEN) != &buckets.GetMutex(bucket_time));
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,218 @@
+// Copyright (c) 2014-2020 The Crown developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <chain.h>
+#include <crown/spork.h>
+#include <test/util/setup_common.h>
+#include <validation.h>
+#include <validationinterface.h>
+
+#include <memory>
+#include <vector>
+
+#include <boost/test/unit_test.hpp>
+
+namespace {
+//! Block indexes on top of each other, not connected to the active chain
+struct RejectedBlocksSetup : public TestingSetup {
+    std::vector<uint256> vHashes;
+    std::vector<std::unique_ptr<CBlockIndex>> vIndexes;
+
+    RejectedBlocksSetup()
+    {
+        for (int nHeight = 0; nHeight < 3 * MAX_REJECTED_BLOCK_DEPTH; nHeight++) {
+            vHashes.push_back(InsecureRand256());
+        }
+        for (int nHeight = 0; nHeight < (int)vHashes.size(); nHeight++) {
+            vIndexes.emplace_back(new CBlockIndex());
+            vIndexes.back()->nHeight = nHeight;
+            vIndexes.back()->phashBlock = &vHashes[nHeight];
+        }
+        WITH_LOCK(cs_main, mapRejectedBlocks.clear());
+    }
+
+    ~RejectedBlocksSetup()
+    {
+        WITH_LOCK(cs_main, mapRejectedBlocks.clear());
+    }
+};
+
+//! Records the spork updates it is notified of
+struct SporkListener : public CValidationInterface {
+    std::vector<std::pair<int, int64_t>> vUpdates;
+
+    void SporkUpdated(int nSporkID, int64_t nValue) override { vUpdates.emplace_back(nSporkID, nValue); }
+};
+
+CRejectedBlock Rejected(const std::string& strReason)
+{
+    return CRejectedBlock{0, 0, strReason};
+}
+} // namespace
+
+BOOST_FIXTURE_TEST_SUITE(spork_tests, RejectedBlocksSetup)
+
+BOOST_AUTO_TEST_CASE(record_rejected_block)
+{
+    LOCK(cs_main);
+
+    RecordRejectedBlock(vIndexes[10].get(), "bad-mn-payee");
+    RecordRejectedBlock(vIndexes[20].get(), "bad-cb-amount");
+    BOOST_CHECK_EQUAL(mapRejectedBlocks.size(), 2U);
+    const CRejectedBlock& rejected = mapRejectedBlocks.at(vHashes[10]);
+    BOOST_CHECK_EQUAL(rejected.nHeight, 10);
+    BOOST_CHECK_EQUAL(rejected.strReason, "bad-mn-payee");
+
+    // A block rejected again keeps only its latest reason
+    RecordRejectedBlock(vIndexes[10].get(), "bad-sn-payee");
+    BOOST_CHECK_EQUAL(mapRejectedBlocks.size(), 2U);
+    BOOST_CHECK_EQUAL(mapRejectedBlocks.at(vHashes[10]).strReason, "bad-sn-payee");
+
+    // Records up to MAX_REJECTED_BLOCK_DEPTH below the new block are kept
+    RecordRejectedBlock(vIndexes[10 + MAX_REJECTED_BLOCK_DEPTH].get(), "bad-mn-payee");
+    BOOST_CHECK_EQUAL(mapRejectedBlocks.size(), 3U);
+    BOOST_CHECK(mapRejectedBlocks.count(vHashes[10]));
+
+    // Deeper ones are forgotten
+    RecordRejectedBlock(vIndexes[11 + MAX_REJECTED_BLOCK_DEPTH].get(), "bad-mn-payee");
+    BOOST_CHECK_EQUAL(mapRejectedBlocks.size(), 3U);
+    BOOST_CHECK(!mapRejectedBlocks.count(vHashes[10]));
+    BOOST_CHECK(mapRejectedBlocks.count(vHashes[20]));
+
+    RecordRejectedBlock(vIndexes[3 * MAX_REJECTED_BLOCK_DEPTH - 1].get(), "bad-cb-amount");
+    BOOST_CHECK_EQUAL(mapRejectedBlocks.size(), 1U);
+    BOOST_CHECK(mapRejectedBlocks.count(vHashes.back()));
+
+    // A block below the others doesn't prune them
+    RecordRejectedBlock(vIndexes[0].get(), "bad-cb-amount");
+    BOOST_CHECK_EQUAL(mapRejectedBlocks.size(), 2U);
+}
+
+BOOST_AUTO_TEST_CASE(rejected_by_spork)
+{
+    const CRejectedBlock mnPayee = Rejected("bad-mn-payee");
+    const CRejectedBlock snPayee = Rejected("bad-sn-payee");
+    const CRejectedBlock cbAmount = Rejected("bad-cb-amount");
+    const CRejectedBlock other = Rejected("bad-txns-inputs-missingorspent");
+
+    BOOST_CHECK(IsRejectedBySpork(mnPayee, SPORK_8_MASTERNODE_PAYMENT_ENFORCEMENT));
+    BOOST_CHECK(!IsRejectedBySpork(snPayee, SPORK_8_MASTERNODE_PAYMENT_ENFORCEMENT));
+    BOOST_CHECK(!IsRejectedBySpork(cbAmount, SPORK_8_MASTERNODE_PAYMENT_ENFORCEMENT));
+
+    BOOST_CHECK(!IsRejectedBySpork(mnPayee, SPORK_14_SYSTEMNODE_PAYMENT_ENFORCEMENT));
+    BOOST_CHECK(IsRejectedBySpork(snPayee, SPORK_14_SYSTEMNODE_PAYMENT_ENFORCEMENT));
+    BOOST_CHECK(!IsRejectedBySpork(cbAmount, SPORK_14_SYSTEMNODE_PAYMENT_ENFORCEMENT));
+
+    BOOST_CHECK(IsRejectedBySpork(mnPayee, SPORK_9_MASTERNODE_BUDGET_ENFORCEMENT));
+    BOOST_CHECK(IsRejectedBySpork(snPayee, SPORK_9_MASTERNODE_BUDGET_ENFORCEMENT));
+    BOOST_CHECK(!IsRejectedBySpork(cbAmount, SPORK_9_MASTERNODE_BUDGET_ENFORCEMENT));
+
+    BOOST_CHECK(IsRejectedBySpork(mnPayee, SPORK_13_ENABLE_SUPERBLOCKS));
+    BOOST_CHECK(IsRejectedBySpork(snPayee, SPORK_13_ENABLE_SUPERBLOCKS));
+    BOOST_CHECK(IsRejectedBySpork(cbAmount, SPORK_13_ENABLE_SUPERBLOCKS));
+
+    // Other checks are not governed by a spork, nor are the other sporks governing a check
+    for (int nSporkID = SPORK_START; nSporkID <= SPORK_END; nSporkID++) {
+        BOOST_CHECK(!IsRejectedBySpork(other, nSporkID));
+        if (nSporkID == SPORK_8_MASTERNODE_PAYMENT_ENFORCEMENT || nSporkID == SPORK_9_MASTERNODE_BUDGET_ENFORCEMENT ||
+            nSporkID == SPORK_13_ENABLE_SUPERBLOCKS || nSporkID == SPORK_14_SYSTEMNODE_PAYMENT_ENFORCEMENT) {
+            continue;
+        }
+        BOOST_CHECK(!IsRejectedBySpork(mnPayee, nSporkID));
+        BOOST_CHECK(!IsRejectedBySpork(snPayee, nSporkID));
+        BOOST_CHECK(!IsRejectedBySpork(cbAmount, nSporkID));
+    }
+}
+
+BOOST_AUTO_TEST_CASE(spork_snapshot)
+{
+    CSporkManager manager;
+    CSporkMessage spork;
+    spork.nSporkID = SPORK_8_MASTERNODE_PAYMENT_ENFORCEMENT;
+    spork.nValue = 42;
+    spork.nTimeSigned = 1000;
+
+    std::shared_ptr<const CSporkSnapshot> pOld = manager.GetSnapshot();
+    BOOST_CHECK_EQUAL(pOld->Get(spork.nSporkID), SPORK_8_MASTERNODE_PAYMENT_ENFORCEMENT_DEFAULT);
+    BOOST_CHECK_EQUAL(pOld->Get(SPORK_END + 1), -1);
+
+    // A reader keeps the snapshot it holds, the manager lets go of it
+    BOOST_CHECK(manager.AddSpork(spork));
+    BOOST_CHECK_EQUAL(pOld->Get(spork.nSporkID), SPORK_8_MASTERNODE_PAYMENT_ENFORCEMENT_DEFAULT);
+    BOOST_CHECK_EQUAL(pOld.use_count(), 1);
+    BOOST_CHECK_EQUAL(manager.GetSnapshot()->Get(spork.nSporkID), 42);
+
+    // The same or an older signing time doesn't replace the value, as in ProcessSpork
+    spork.nValue = 43;
+    BOOST_CHECK(!manager.AddSpork(spork));
+    spork.nTimeSigned = 999;
+    BOOST_CHECK(!manager.AddSpork(spork));
+    BOOST_CHECK_EQUAL(manager.GetSnapshot()->Get(spork.nSporkID), 42);
+    spork.nTimeSigned = 1001;
+    BOOST_CHECK(manager.AddSpork(spork));
+    BOOST_CHECK_EQUAL(manager.GetSnapshot()->Get(spork.nSporkID), 43);
+
+    LOCK(cs_mapSporks);
+    mapSporks.clear();
+    mapSporksActive.clear();
+}
+
+BOOST_AUTO_TEST_CASE(spork_updated_signal)
+{
+    CSporkManager manager;
+    SporkListener listener;
+    RegisterValidationInterface(&listener);
+
+    CSporkMessage spork;
+    spork.nSporkID = SPORK_13_ENABLE_SUPERBLOCKS;
+    spork.nValue = 7;
+    spork.nTimeSigned = 1000;
+    BOOST_CHECK(manager.AddSpork(spork));
+    // Listeners are notified once the new value is readable
+    BOOST_REQUIRE_EQUAL(listener.vUpdates.size(), 1U);
+    BOOST_CHECK_EQUAL(listener.vUpdates[0].first, SPORK_13_ENABLE_SUPERBLOCKS);
+    BOOST_CHECK_EQUAL(listener.vUpdates[0].second, 7);
+    BOOST_CHECK_EQUAL(manager.GetSnapshot()->Get(SPORK_13_ENABLE_SUPERBLOCKS), 7);
+
+    // A stale spork changes nothing and isn't announced
+    BOOST_CHECK(!manager.AddSpork(spork));
+    BOOST_CHECK_EQUAL(listener.vUpdates.size(), 1U);
+
+    UnregisterValidationInterface(&listener);
+    LOCK(cs_mapSporks);
+    mapSporks.clear();
+    mapSporksActive.clear();
+}
+
+BOOST_AUTO_TEST_CASE(reprocess_locked_blocks)
+{
+    const uint256 hashLock = InsecureRand256();
+    const uint256 hashOtherLock = InsecureRand256();
+    {
+        LOCK(cs_main);
+        RecordRejectedBlock(vIndexes[10].get(), "conflicting-tx-ix", hashLock);
+        RecordRejectedBlock(vIndexes[11].get(), "conflicting-tx-ix", hashOtherLock);
+        RecordRejectedBlock(vIndexes[12].get(), "bad-mn-payee");
+        BOOST_CHECK(mapRejectedBlocks.at(vHashes[10]).hashConflictTx == hashLock);
+        BOOST_CHECK(mapRejectedBlocks.at(vHashes[12]).hashConflictTx.IsNull());
+    }
+
+    // Only the blocks rejected for the lock are reconsidered
+    ReprocessLockedBlocks(hashLock);
+    {
+        LOCK(cs_main);
+        BOOST_CHECK_EQUAL(mapRejectedBlocks.size(), 2U);
+        BOOST_CHECK(!mapRejectedBlocks.count(vHashes[10]));
+        BOOST_CHECK(mapRejectedBlocks.count(vHashes[11]));
+        BOOST_CHECK(mapRejectedBlocks.count(vHashes[12]));
+    }
+
+    // A block rejected for no lock is not matched by a null hash
+    ReprocessLockedBlocks(uint256());
+    BOOST_CHECK_EQUAL(WITH_LOCK(cs_main, return mapRejectedBlocks.size()), 2U);
+    ReprocessLockedBlocks(hashOtherLock);
+    BOOST_CHECK_EQUAL(WITH_LOCK(cs_main, return mapRejectedBlocks.size()), 1U);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -5,6 +5,10 @@
 #include <sync.h>
 #include <test/util/setup_common.h>
 
+#include <chrono>
+#include <condition_variable>
+#include <thread>
+
 #include <boost/test/unit_test.hpp>
 
 namespace {
@@ -29,6 +33,28 @@ void TestPotentialDeadLockDetected(MutexType& mutex1, MutexType& mutex2)
     BOOST_CHECK(!error_thrown);
     #endif
 }
+
+void LockAndHold(Mutex& cs)
+{
+    LOCK(cs);
+    std::this_thread::sleep_for(std::chrono::milliseconds{2});
+}
+
+void LockAlso(Mutex& cs)
+{
+    LOCK(cs);
+}
+
+//! The statistics of the sites in this file locking a mutex
+std::vector<LockStats> SitesOf(const Mutex& cs)
+{
+    std::vector<LockStats> vSites;
+    for (const LockStats& site : GetLockStats()) {
+        if (site.pMutex == &cs && site.strFile == __FILE__)
+            vSites.push_back(site);
+    }
+    return vSites;
+}
 } // namespace
 
 BOOST_FIXTURE_TEST_SUITE(sync_tests, BasicTestingSetup)
@@ -55,4 +81,51 @@ BOOST_AUTO_TEST_CASE(potential_deadlock_detected)
     #endif
 }
 
+BOOST_AUTO_TEST_CASE(lock_stats)
+{
+    const bool prev = g_lock_stats.exchange(true);
+    Mutex cs1, cs2, cs_wait;
+
+    // Locks of the same name are told apart by their mutex
+    LockAndHold(cs1);
+    LockAndHold(cs1);
+    LockAlso(cs2);
+    std::vector<LockStats> vSites1 = SitesOf(cs1);
+    std::vector<LockStats> vSites2 = SitesOf(cs2);
+    BOOST_REQUIRE_EQUAL(vSites1.size(), 1U);
+    BOOST_REQUIRE_EQUAL(vSites2.size(), 1U);
+    BOOST_CHECK_EQUAL(vSites1[0].strName, "cs");
+    BOOST_CHECK_EQUAL(vSites2[0].strName, "cs");
+    BOOST_CHECK_EQUAL(vSites1[0].nCount, 2U);
+    BOOST_CHECK_EQUAL(vSites2[0].nCount, 1U);
+    BOOST_CHECK(vSites1[0].nHoldTime >= 4000000U);
+
+    // A site locking several mutexes counts for each of them
+    Mutex cs3, cs4;
+    LockAlso(cs3);
+    LockAlso(cs4);
+    LockAlso(cs4);
+    std::vector<LockStats> vSites3 = SitesOf(cs3);
+    std::vector<LockStats> vSites4 = SitesOf(cs4);
+    BOOST_REQUIRE_EQUAL(vSites3.size(), 1U);
+    BOOST_REQUIRE_EQUAL(vSites4.size(), 1U);
+    BOOST_CHECK_EQUAL(vSites3[0].nLine, vSites4[0].nLine);
+    BOOST_CHECK_EQUAL(vSites3[0].nCount, 1U);
+    BOOST_CHECK_EQUAL(vSites4[0].nCount, 2U);
+    BOOST_CHECK_EQUAL(SitesOf(cs2)[0].nCount, 1U);
+
+    // Waiting on a condition variable doesn't count as holding the lock
+    {
+        std::condition_variable cond;
+        WAIT_LOCK(cs_wait, lock);
+        cond.wait_for(lock, std::chrono::milliseconds{2});
+    }
+    std::vector<LockStats> vSitesWait = SitesOf(cs_wait);
+    BOOST_REQUIRE_EQUAL(vSitesWait.size(), 1U);
+    BOOST_CHECK_EQUAL(vSitesWait[0].nCount, 1U);
+    BOOST_CHECK_EQUAL(vSitesWait[0].nHoldTime, 0U);
+
+    g_lock_stats = prev;
+}
+
 BOOST_AUTO_TEST_SUITE_END()
@@ -859,4 +859,66 @@ BOOST_AUTO_TEST_CASE(test_IsStandard)
     fIsBareMultisigStd = DEFAULT_PERMIT_BAREMULTISIG;
 }
 
+BOOST_AUTO_TEST_CASE(tx_data_outputs_roundtrip)
+{
+    CMutableTransaction mtx;
+    mtx.nVersion = TX_ELE_VERSION;
+    mtx.nTime = 1600000000;
+    mtx.vin.emplace_back(COutPoint(InsecureRand256(), 0));
+    mtx.vpout.emplace_back(CAsset(), 0, CScript());
+
+    // coinstake data: height, smsg fee rate and difficulty, kept inline
+    std::vector<uint8_t> vStake{0x10, 0x27, 0x00, 0x00, DO_SMSG_FEE};
+    BOOST_REQUIRE_EQUAL(part::PutVarInt(vStake, 50000), 0);
+    vStake.push_back(DO_SMSG_DIFFICULTY);
+    vStake.insert(vStake.end(), {0xff, 0xff, 0x0f, 0x1f});
+    CTxData dataStake(vStake);
+    dataStake.nType = DO_NULL;
+    mtx.vdata.emplace_back(dataStake);
+    // a payload past the inline size
+    CTxData dataLarge(std::vector<uint8_t>(100, 0xab));
+    dataLarge.nType = DO_FUND_MSG;
+    mtx.vdata.emplace_back(dataLarge);
+    CTxData dataEmpty;
+    dataEmpty.nType = DO_SMSG_FEE;
+    mtx.vdata.emplace_back(dataEmpty);
+
+    CDataStream ss(SER_NETWORK, PROTOCOL_VERSION);
+    ss << mtx;
+    const std::vector<unsigned char> vch(ss.begin(), ss.end());
+    CMutableTransaction mtx2;
+    ss >> mtx2;
+    BOOST_CHECK(ss.empty());
+
+    BOOST_REQUIRE_EQUAL(mtx2.vdata.size(), 3U);
+    for (size_t i = 0; i < mtx.vdata.size(); i++) {
+        const CTxData* data = mtx.vdata[i].GetIf<CTxData>();
+        const CTxData* data2 = mtx2.vdata[i].GetIf<CTxData>();
+        BOOST_REQUIRE(data2);
+        BOOST_CHECK_EQUAL(data2->nVersion, OUTPUT_DATA);
+        BOOST_CHECK_EQUAL(data2->nType, data->nType);
+        BOOST_CHECK(data2->vData == data->vData);
+    }
+    CAmount fee_rate;
+    uint32_t compact;
+    BOOST_CHECK(mtx2.vdata[0]->GetSmsgFeeRate(fee_rate));
+    BOOST_CHECK_EQUAL(fee_rate, 50000);
+    BOOST_CHECK(mtx2.vdata[0]->GetSmsgDifficulty(compact));
+    BOOST_CHECK_EQUAL(compact, 0x1f0fffffU);
+
+    // the same bytes again, and the same hash
+    CDataStream ss2(SER_NETWORK, PROTOCOL_VERSION);
+    ss2 << mtx2;
+    BOOST_CHECK(std::vector<unsigned char>(ss2.begin(), ss2.end()) == vch);
+    BOOST_CHECK(CTransaction(mtx2).GetHash() == CTransaction(mtx).GetHash());
+
+    // a data output count past the end of the stream fails without reserving for it
+    mtx.vdata.clear();
+    CDataStream ss3(SER_NETWORK, PROTOCOL_VERSION);
+    ss3 << mtx;
+    ss3.resize(ss3.size() - 1);
+    WriteCompactSize(ss3, MAX_SIZE);
+    BOOST_CHECK_THROW(ss3 >> mtx2, std::ios_base::failure);
+}
+
 BOOST_AUTO_TEST_SUITE_END()
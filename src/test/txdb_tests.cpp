@@ -0,0 +1,224 @@
+// Copyright (c) 2014-2020 The Crown developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <chainparams.h>
+#include <coins.h>
+#include <dbwrapper.h>
+#include <node/coinstats.h>
+#include <script/script.h>
+#include <shutdown.h>
+#include <test/util/setup_common.h>
+#include <txdb.h>
+
+#include <memory>
+#include <vector>
+
+#include <boost/test/unit_test.hpp>
+
+namespace {
+//! Key of a coin record, as written with the given prefix
+struct CoinKey {
+    char key;
+    COutPoint outpoint;
+    CoinKey(char keyIn, const COutPoint& outpointIn) : key(keyIn), outpoint(outpointIn) {}
+
+    SERIALIZE_METHODS(CoinKey, obj) { READWRITE(obj.key, obj.outpoint.hash, VARINT(obj.outpoint.n)); }
+};
+
+//! A coin database on disk, reopened between the steps of a test
+struct CoinsDBSetup : public BasicTestingSetup {
+    const fs::path path{GetDataDir() / "txdb_tests"};
+    std::unique_ptr<CCoinsViewDB> db;
+    std::vector<CAsset> assets;
+    std::vector<std::pair<COutPoint, Coin>> coins;
+
+    CoinsDBSetup()
+    {
+        // The null asset, the subsidy asset and two assets which only differ past their ID
+        assets.emplace_back();
+        assets.push_back(Params().GetConsensus().subsidy_asset);
+        assets.emplace_back(InsecureRand256());
+        assets.push_back(assets.back());
+        assets.back().nType = AssetMetadata::TOKEN;
+        db = std::make_unique<CCoinsViewDB>(path, 1 << 20, false, true);
+    }
+
+    void Reopen()
+    {
+        db.reset();
+        db = std::make_unique<CCoinsViewDB>(path, 1 << 20, false, false);
+    }
+
+    //! Run f on the raw database, with the coin database closed
+    template <typename F>
+    void WithRawDB(F f)
+    {
+        db.reset();
+        {
+            CDBWrapper raw(path, 1 << 20, false, false, true);
+            f(raw);
+        }
+        db = std::make_unique<CCoinsViewDB>(path, 1 << 20, false, false);
+    }
+
+    void AddCoins(int nCount)
+    {
+        for (int i = 0; i < nCount; i++) {
+            COutPoint outpoint(InsecureRand256(), InsecureRandRange(200));
+            CTxOutAsset out(assets[i % assets.size()], 1 + InsecureRandRange(1000 * COIN), CScript() << InsecureRand32() << OP_DROP << OP_TRUE);
+            coins.emplace_back(outpoint, Coin(std::move(out), 1 + InsecureRandRange(1000000), InsecureRandBool(), InsecureRandBool()));
+        }
+    }
+
+    void Flush(size_t nBegin, size_t nEnd)
+    {
+        CCoinsViewCache cache(db.get());
+        for (size_t i = nBegin; i < nEnd; i++) {
+            cache.AddCoin(coins[i].first, Coin(coins[i].second), false);
+        }
+        cache.SetBestBlock(InsecureRand256());
+        BOOST_REQUIRE(cache.Flush());
+    }
+
+    void CheckCoins()
+    {
+        for (const auto& entry : coins) {
+            const Coin& expected = entry.second;
+            Coin coin;
+            BOOST_REQUIRE(db->GetCoin(entry.first, coin));
+            BOOST_CHECK_EQUAL(coin.nHeight, expected.nHeight);
+            BOOST_CHECK_EQUAL(coin.fCoinBase, expected.fCoinBase);
+            BOOST_CHECK_EQUAL(coin.fCoinStake, expected.fCoinStake);
+            BOOST_CHECK_EQUAL(coin.out.nValue, expected.out.nValue);
+            BOOST_CHECK(coin.out.scriptPubKey == expected.out.scriptPubKey);
+            BOOST_CHECK(coin.out.nAsset->IsIdentical(expected.out.nAsset.get()));
+        }
+    }
+
+    //! Number of records under a prefix
+    static size_t CountRecords(CDBWrapper& raw, char prefix)
+    {
+        size_t nCount = 0;
+        std::unique_ptr<CDBIterator> pcursor(raw.NewIterator());
+        char key;
+        for (pcursor->Seek(prefix); pcursor->Valid() && pcursor->GetKey(key) && key == prefix; pcursor->Next()) {
+            nCount++;
+        }
+        return nCount;
+    }
+};
+} // namespace
+
+BOOST_FIXTURE_TEST_SUITE(txdb_tests, CoinsDBSetup)
+
+BOOST_AUTO_TEST_CASE(coinsdb_asset_ordinals)
+{
+    AddCoins(100);
+    Flush(0, coins.size());
+    CheckCoins();
+
+    // Only the assets past the null and subsidy ones get an ordinal, once each
+    WithRawDB([&](CDBWrapper& raw) {
+        BOOST_CHECK_EQUAL(CountRecords(raw, 'O'), 2U);
+        BOOST_CHECK_EQUAL(CountRecords(raw, 'A'), coins.size());
+        CAsset asset;
+        BOOST_CHECK(raw.Read(std::make_pair('O', CCoinsAssetOrdinals::FIRST_ORDINAL), asset));
+        BOOST_CHECK(asset.IsIdentical(assets[2]) || asset.IsIdentical(assets[3]));
+        BOOST_CHECK(!raw.Exists(std::make_pair('O', CCoinsAssetOrdinals::NULL_ASSET)));
+        BOOST_CHECK(!raw.Exists(std::make_pair('O', CCoinsAssetOrdinals::SUBSIDY_ASSET)));
+    });
+
+    // The ordinals are read back on opening, and reused by the coins written afterwards
+    CheckCoins();
+    size_t nOld = coins.size();
+    AddCoins(50);
+    assets.emplace_back(InsecureRand256());
+    AddCoins(10);
+    Flush(nOld, coins.size());
+    Reopen();
+    CheckCoins();
+    WithRawDB([&](CDBWrapper& raw) { BOOST_CHECK_EQUAL(CountRecords(raw, 'O'), 3U); });
+
+    // A coin referring to an ordinal which was never recorded is an error
+    WithRawDB([&](CDBWrapper& raw) { BOOST_CHECK(raw.Erase(std::make_pair('O', CCoinsAssetOrdinals::FIRST_ORDINAL + 2))); });
+    Coin coin;
+    BOOST_CHECK_THROW(db->GetCoin(coins.back().first, coin), dbwrapper_error);
+}
+
+BOOST_AUTO_TEST_CASE(coinsdb_upgrade_asset_ordinals)
+{
+    // Half the coins made it to the new format before the upgrade was interrupted
+    AddCoins(200);
+    Flush(0, coins.size() / 2);
+    WithRawDB([&](CDBWrapper& raw) {
+        for (size_t i = coins.size() / 2; i < coins.size(); i++) {
+            BOOST_REQUIRE(raw.Write(CoinKey('C', coins[i].first), coins[i].second));
+        }
+    });
+
+    // Shutting down stops the upgrade before it moves any coin
+    StartShutdown();
+    BOOST_CHECK(!db->Upgrade());
+    AbortShutdown();
+    WithRawDB([&](CDBWrapper& raw) { BOOST_CHECK_EQUAL(CountRecords(raw, 'C'), coins.size() / 2); });
+
+    BOOST_CHECK(db->Upgrade());
+    CheckCoins();
+    WithRawDB([&](CDBWrapper& raw) {
+        BOOST_CHECK_EQUAL(CountRecords(raw, 'C'), 0U);
+        BOOST_CHECK_EQUAL(CountRecords(raw, 'A'), coins.size());
+        BOOST_CHECK_EQUAL(CountRecords(raw, 'O'), 2U);
+    });
+
+    // Upgrading again has nothing left to do
+    BOOST_CHECK(db->Upgrade());
+    CheckCoins();
+}
+
+BOOST_AUTO_TEST_CASE(coinsdb_version)
+{
+    // The format is recorded under the first legacy coins key, which a database without legacy coins still skips
+    BOOST_CHECK(db->Upgrade());
+    WithRawDB([&](CDBWrapper& raw) {
+        int nVersion = 0;
+        BOOST_CHECK(raw.Read(std::make_pair('c', uint256()), nVersion));
+        BOOST_CHECK_EQUAL(nVersion, 1);
+        BOOST_CHECK_EQUAL(CountRecords(raw, 'c'), 1U);
+    });
+    BOOST_CHECK(db->Upgrade());
+
+    // A format newer than this version knows of is refused
+    WithRawDB([&](CDBWrapper& raw) { BOOST_CHECK(raw.Write(std::make_pair('c', uint256()), 2)); });
+    BOOST_CHECK(!db->Upgrade());
+}
+
+BOOST_AUTO_TEST_CASE(coinsdb_range_cursors)
+{
+    AddCoins(100);
+    Flush(0, coins.size());
+    const uint256 hashBest = db->GetBestBlock();
+
+    // The ranges cover every coin once and agree on the best block
+    size_t nCount = 0;
+    for (const auto& pcursor : db->RangeCursors(16)) {
+        BOOST_CHECK(pcursor->GetBestBlock() == hashBest);
+        for (; pcursor->Valid(); pcursor->Next()) {
+            nCount++;
+        }
+    }
+    BOOST_CHECK_EQUAL(nCount, coins.size());
+
+    // A snapshot of a flush half written has no best block
+    WithRawDB([&](CDBWrapper& raw) {
+        BOOST_CHECK(raw.Write('H', std::vector<uint256>{InsecureRand256(), hashBest}));
+        BOOST_CHECK(raw.Erase('B'));
+    });
+    for (const auto& pcursor : db->RangeCursors(4)) {
+        BOOST_CHECK(pcursor->GetBestBlock().IsNull());
+    }
+    CCoinsScriptStats stats;
+    BOOST_CHECK(!GetUTXOScriptStats(*db, stats, 2));
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -15,43 +15,153 @@
 #include <util/translation.h>
 #include <util/vector.h>
 #include <validation.h>
+#include <chainparams.h>
 
 #include <insight/insight.h>
 #include <stdint.h>
 
-static const char DB_COIN = 'C';
+static const char DB_COIN = 'A';
+static const char DB_COIN_FULL_ASSET = 'C';
 static const char DB_COINS = 'c';
+static const char DB_ASSET_ORDINAL = 'O';
 static const char DB_BLOCK_FILES = 'f';
-static const char DB_ADDRESSINDEX = 'a';
-static const char DB_ADDRESSUNSPENTINDEX = 'u';
-static const char DB_TIMESTAMPINDEX = 's';
-static const char DB_BLOCKHASHINDEX = 'z';
-static const char DB_SPENTINDEX = 'p';
-static const char DB_BALANCESINDEX = 'i';
 static const char DB_BLOCK_INDEX = 'b';
 
 static const char DB_BEST_BLOCK = 'B';
+static const char DB_ASSET_SUPPLY = 'S';
 static const char DB_HEAD_BLOCKS = 'H';
 static const char DB_FLAG = 'F';
 static const char DB_REINDEX_FLAG = 'R';
 static const char DB_LAST_BLOCK = 'l';
 
+/**
+ * Format of the coin database, stored under the first legacy per-tx coins key. Versions from
+ * before the asset ordinals fail to parse it as a legacy record and refuse to start, rather than
+ * reading an empty UTXO set.
+ */
+static const std::pair<char, uint256> DB_COINS_VERSION{DB_COINS, uint256()};
+static const int COINS_DB_VERSION_ASSET_ORDINALS = 1;
+
 namespace {
 
 struct CoinEntry {
     COutPoint* outpoint;
     char key;
-    explicit CoinEntry(const COutPoint* ptr) : outpoint(const_cast<COutPoint*>(ptr)), key(DB_COIN)  {}
+    explicit CoinEntry(const COutPoint* ptr, char keyIn = DB_COIN) : outpoint(const_cast<COutPoint*>(ptr)), key(keyIn)  {}
 
     SERIALIZE_METHODS(CoinEntry, obj) { READWRITE(obj.key, obj.outpoint->hash, VARINT(obj.outpoint->n)); }
 };
 
+/**
+ * A coin as stored in the coin database, with its asset replaced by a CCoinsAssetOrdinals code.
+ *
+ * Serialized format:
+ * - VARINT((coinbase ? 1 : 0) | (height << 1))
+ * - the amount and script, compressed as by TxOutAssetCompression
+ * - VARINT(asset code)
+ * - VARINT(coinstake ? 1 : 0)
+ */
+struct CoinRecord {
+    Coin* coin;
+    uint64_t nAssetCode;
+    explicit CoinRecord(const Coin* ptr, uint64_t nAssetCodeIn = 0) : coin(const_cast<Coin*>(ptr)), nAssetCode(nAssetCodeIn) {}
+
+    template<typename Stream>
+    void Serialize(Stream &s) const {
+        assert(!coin->IsSpent());
+        uint32_t code = coin->nHeight * uint32_t{2} + coin->fCoinBase;
+        unsigned int nFlag = coin->fCoinStake ? 1 : 0;
+        s << VARINT(code) << Using<AmountCompression>(coin->out.nValue) << Using<ScriptCompression>(coin->out.scriptPubKey);
+        s << VARINT(nAssetCode) << VARINT(nFlag);
+    }
+
+    template<typename Stream>
+    void Unserialize(Stream &s) {
+        uint32_t code = 0;
+        unsigned int nFlag = 0;
+        coin->Clear();
+        s >> VARINT(code) >> Using<AmountCompression>(coin->out.nValue) >> Using<ScriptCompression>(coin->out.scriptPubKey);
+        s >> VARINT(nAssetCode) >> VARINT(nFlag);
+        coin->nHeight = code >> 1;
+        coin->fCoinBase = code & 1;
+        coin->fCoinStake = nFlag & 1;
+    }
+};
+
+}
+
+bool CCoinsAssetOrdinals::Load(CDBWrapper& db)
+{
+    LOCK(cs);
+    m_subsidy_asset = Params().GetConsensus().subsidy_asset;
+    m_assets.clear();
+    m_ordinals.clear();
+
+    std::unique_ptr<CDBIterator> pcursor(db.NewIterator());
+    pcursor->Seek(std::make_pair(DB_ASSET_ORDINAL, uint64_t{0}));
+    while (pcursor->Valid()) {
+        std::pair<char, uint64_t> key;
+        if (!pcursor->GetKey(key) || key.first != DB_ASSET_ORDINAL)
+            break;
+        CAsset asset;
+        if (key.second < FIRST_ORDINAL || !pcursor->GetValue(asset))
+            return error("%s: invalid asset ordinal record", __func__);
+        size_t nIndex = key.second - FIRST_ORDINAL;
+        if (nIndex >= m_assets.size())
+            m_assets.resize(nIndex + 1);
+        m_assets[nIndex] = asset;
+        m_ordinals[asset.assetID].push_back(key.second);
+        pcursor->Next();
+    }
+    return true;
+}
+
+uint64_t CCoinsAssetOrdinals::GetCode(const CAsset& asset, CDBBatch& batch)
+{
+    LOCK(cs);
+    if (asset.IsIdentical(m_subsidy_asset))
+        return SUBSIDY_ASSET;
+    if (asset.assetID.IsNull() && asset.IsIdentical(CAsset()))
+        return NULL_ASSET;
+
+    std::vector<uint64_t>& ordinals = m_ordinals[asset.assetID];
+    for (uint64_t nOrdinal : ordinals) {
+        if (asset.IsIdentical(m_assets[nOrdinal - FIRST_ORDINAL]))
+            return nOrdinal;
+    }
+
+    uint64_t nOrdinal = FIRST_ORDINAL + m_assets.size();
+    m_assets.emplace_back(asset);
+    ordinals.push_back(nOrdinal);
+    batch.Write(std::make_pair(DB_ASSET_ORDINAL, nOrdinal), asset);
+    return nOrdinal;
+}
+
+bool CCoinsAssetOrdinals::GetAsset(uint64_t nCode, CAssetHandle& asset) const
+{
+    if (nCode == NULL_ASSET) {
+        asset.SetNull();
+        return true;
+    }
+    LOCK(cs);
+    if (nCode == SUBSIDY_ASSET) {
+        asset = m_subsidy_asset;
+        return true;
+    }
+    if (nCode - FIRST_ORDINAL >= m_assets.size())
+        return false;
+    asset = m_assets[nCode - FIRST_ORDINAL];
+    return true;
 }
 
 CCoinsViewDB::CCoinsViewDB(fs::path ldb_path, size_t nCacheSize, bool fMemory, bool fWipe) :
     m_db(std::make_unique<CDBWrapper>(ldb_path, nCacheSize, fMemory, fWipe, true)),
     m_ldb_path(ldb_path),
-    m_is_memory(fMemory) { }
+    m_is_memory(fMemory)
+{
+    if (!m_asset_ordinals.Load(*m_db))
+        throw std::runtime_error("Corrupted asset ordinals in the coin database");
+}
 
 void CCoinsViewDB::ResizeCache(size_t new_cache_size)
 {
@@ -63,7 +173,18 @@ void CCoinsViewDB::ResizeCache(size_t new_cache_size)
 }
 
 bool CCoinsViewDB::GetCoin(const COutPoint &outpoint, Coin &coin) const {
-    return m_db->Read(CoinEntry(&outpoint), coin);
+    CoinRecord record(&coin);
+    if (!m_db->Read(CoinEntry(&outpoint), record))
+        return false;
+    if (!m_asset_ordinals.GetAsset(record.nAssetCode, coin.out.nAsset))
+        throw dbwrapper_error(strprintf("Unknown asset ordinal %u in coin database", record.nAssetCode));
+    return true;
+}
+
+void CCoinsViewDB::WriteCoin(CDBBatch& batch, const COutPoint& outpoint, const Coin& coin)
+{
+    uint64_t nAssetCode = m_asset_ordinals.GetCode(coin.out.nAsset, batch);
+    batch.Write(CoinEntry(&outpoint), CoinRecord(&coin, nAssetCode));
 }
 
 bool CCoinsViewDB::HaveCoin(const COutPoint &outpoint) const {
@@ -85,6 +206,18 @@ std::vector<uint256> CCoinsViewDB::GetHeadBlocks() const {
     return vhashHeadBlocks;
 }
 
+//! Drop assets that have no unspent outputs left
+static void EraseEmptySupply(CAmountMap &supply)
+{
+    for (auto it = supply.begin(); it != supply.end();) {
+        if (it->second == 0) {
+            it = supply.erase(it);
+        } else {
+            ++it;
+        }
+    }
+}
+
 bool CCoinsViewDB::BatchWrite(CCoinsMap &mapCoins, const uint256 &hashBlock) {
     CDBBatch batch(*m_db);
     size_t count = 0;
@@ -103,6 +236,17 @@ bool CCoinsViewDB::BatchWrite(CCoinsMap &mapCoins, const uint256 &hashBlock) {
         }
     }
 
+    // The asset supply is dropped in the first batch and only written back with
+    // the last one, so that it is rebuilt from scratch after an interrupted write.
+    CAmountMap supply;
+    bool fHaveSupply = m_db->Read(DB_ASSET_SUPPLY, supply);
+    if (fHaveSupply) {
+        supply += m_asset_supply_pending;
+        EraseEmptySupply(supply);
+        batch.Erase(DB_ASSET_SUPPLY);
+    }
+    m_asset_supply_pending.clear();
+
     // In the first batch, mark the database as being in the middle of a
     // transition from old_tip to hashBlock.
     // A vector is used for future extensibility, as we may want to support
@@ -112,11 +256,10 @@ bool CCoinsViewDB::BatchWrite(CCoinsMap &mapCoins, const uint256 &hashBlock) {
 
     for (CCoinsMap::iterator it = mapCoins.begin(); it != mapCoins.end();) {
         if (it->second.flags & CCoinsCacheEntry::DIRTY) {
-            CoinEntry entry(&it->first);
             if (it->second.coin.IsSpent())
-                batch.Erase(entry);
+                batch.Erase(CoinEntry(&it->first));
             else
-                batch.Write(entry, it->second.coin);
+                WriteCoin(batch, it->first, it->second.coin);
             changed++;
         }
         count++;
@@ -139,6 +282,9 @@ bool CCoinsViewDB::BatchWrite(CCoinsMap &mapCoins, const uint256 &hashBlock) {
     // In the last batch, mark the database as consistent with hashBlock again.
     batch.Erase(DB_HEAD_BLOCKS);
     batch.Write(DB_BEST_BLOCK, hashBlock);
+    if (fHaveSupply) {
+        batch.Write(DB_ASSET_SUPPLY, supply);
+    }
 
     LogPrint(BCLog::COINDB, "Writing final batch of %.2f MiB\n", batch.SizeEstimate() * (1.0 / 1048576.0));
     bool ret = m_db->WriteBatch(batch);
@@ -146,6 +292,27 @@ bool CCoinsViewDB::BatchWrite(CCoinsMap &mapCoins, const uint256 &hashBlock) {
     return ret;
 }
 
+bool CCoinsViewDB::GetAssetSupply(CAmountMap &supply) const
+{
+    if (!m_db->Read(DB_ASSET_SUPPLY, supply))
+        return false;
+    supply += m_asset_supply_pending;
+    return true;
+}
+
+void CCoinsViewDB::AddAssetSupply(const CAmountMap &delta)
+{
+    m_asset_supply_pending += delta;
+}
+
+bool CCoinsViewDB::WriteAssetSupply(const CAmountMap &supply)
+{
+    CAmountMap stored = supply;
+    EraseEmptySupply(stored);
+    m_asset_supply_pending.clear();
+    return m_db->Write(DB_ASSET_SUPPLY, stored);
+}
+
 size_t CCoinsViewDB::EstimateSize() const
 {
     return m_db->EstimateSize(DB_COIN, (char)(DB_COIN+1));
@@ -175,20 +342,56 @@ bool CBlockTreeDB::ReadLastBlockFile(int &nFile) {
 
 CCoinsViewCursor *CCoinsViewDB::Cursor() const
 {
-    CCoinsViewDBCursor *i = new CCoinsViewDBCursor(const_cast<CDBWrapper&>(*m_db).NewIterator(), GetBestBlock());
+    CCoinsViewDBCursor *i = new CCoinsViewDBCursor(const_cast<CDBWrapper&>(*m_db).NewIterator(), m_asset_ordinals, GetBestBlock());
     /* It seems that there are no "const iterators" for LevelDB.  Since we
        only need read operations on it, use a const-cast to get around
        that restriction.  */
     i->pcursor->Seek(DB_COIN);
     // Cache key of first record
-    if (i->pcursor->Valid()) {
-        CoinEntry entry(&i->keyTmp.second);
-        i->pcursor->GetKey(entry);
-        i->keyTmp.first = entry.key;
+    i->ReadKey();
+    return i;
+}
+
+std::vector<std::unique_ptr<CCoinsViewCursor>> CCoinsViewDB::RangeCursors(int nRanges) const
+{
+    assert(nRanges > 0 && nRanges <= 256);
+    std::shared_ptr<const leveldb::Snapshot> snapshot = m_db->GetSnapshot();
+    uint256 hashBestChain;
+    {
+        std::unique_ptr<CDBIterator> pcursor(m_db->NewIterator(snapshot));
+        pcursor->Seek(DB_BEST_BLOCK);
+        char chKey;
+        if (!pcursor->Valid() || !pcursor->GetKey(chKey) || chKey != DB_BEST_BLOCK || !pcursor->GetValue(hashBestChain)) {
+            hashBestChain.SetNull();
+        }
+        // A flush in progress, the coins belong to no single block
+        pcursor->Seek(DB_HEAD_BLOCKS);
+        if (pcursor->Valid() && pcursor->GetKey(chKey) && chKey == DB_HEAD_BLOCKS) {
+            hashBestChain.SetNull();
+        }
+    }
+
+    std::vector<std::unique_ptr<CCoinsViewCursor>> cursors;
+    for (int i = 0; i < nRanges; i++) {
+        int nBeginByte = 256 * i / nRanges;
+        CCoinsViewDBCursor *c = new CCoinsViewDBCursor(m_db->NewIterator(snapshot), m_asset_ordinals, hashBestChain, 256 * (i + 1) / nRanges);
+        uint256 hashBegin;
+        *hashBegin.begin() = nBeginByte;
+        c->pcursor->Seek(std::make_pair(DB_COIN, hashBegin));
+        c->ReadKey();
+        cursors.emplace_back(c);
+    }
+    return cursors;
+}
+
+void CCoinsViewDBCursor::ReadKey()
+{
+    CoinEntry entry(&keyTmp.second);
+    if (!pcursor->Valid() || !pcursor->GetKey(entry) || *keyTmp.second.hash.begin() >= nEndByte) {
+        keyTmp.first = 0; // Invalidate cached key after last record so that Valid() and GetKey() return false
     } else {
-        i->keyTmp.first = 0; // Make sure Valid() and GetKey() return false
+        keyTmp.first = entry.key;
     }
-    return i;
 }
 
 bool CCoinsViewDBCursor::GetKey(COutPoint &key) const
@@ -203,7 +406,8 @@ bool CCoinsViewDBCursor::GetKey(COutPoint &key) const
 
 bool CCoinsViewDBCursor::GetValue(Coin &coin) const
 {
-    return pcursor->GetValue(coin);
+    CoinRecord record(&coin);
+    return pcursor->GetValue(record) && m_asset_ordinals.GetAsset(record.nAssetCode, coin.out.nAsset);
 }
 
 unsigned int CCoinsViewDBCursor::GetValueSize() const
@@ -219,12 +423,7 @@ bool CCoinsViewDBCursor::Valid() const
 void CCoinsViewDBCursor::Next()
 {
     pcursor->Next();
-    CoinEntry entry(&keyTmp.second);
-    if (!pcursor->Valid() || !pcursor->GetKey(entry)) {
-        keyTmp.first = 0; // Invalidate cached key after last record so that Valid() and GetKey() return false
-    } else {
-        keyTmp.first = entry.key;
-    }
+    ReadKey();
 }
 
 bool CBlockTreeDB::WriteBatchSync(const std::vector<std::pair<int, const CBlockFileInfo*> >& fileInfo, int nLastFile, const std::vector<const CBlockIndex*>& blockinfo) {
@@ -240,185 +439,89 @@ bool CBlockTreeDB::WriteBatchSync(const std::vector<std::pair<int, const CBlockF
 }
 
 
-bool CBlockTreeDB::ReadSpentIndex(CSpentIndexKey &key, CSpentIndexValue &value) {
-    return Read(std::make_pair(DB_SPENTINDEX, key), value);
-}
-
-bool CBlockTreeDB::UpdateSpentIndex(const std::vector<std::pair<CSpentIndexKey, CSpentIndexValue> >&vect) {
-    CDBBatch batch(*this);
-    for (std::vector<std::pair<CSpentIndexKey,CSpentIndexValue> >::const_iterator it=vect.begin(); it!=vect.end(); it++) {
-        if (it->second.IsNull()) {
-            batch.Erase(std::make_pair(DB_SPENTINDEX, it->first));
-        } else {
-            batch.Write(std::make_pair(DB_SPENTINDEX, it->first), it->second);
-        }
-    }
-    return WriteBatch(batch);
-}
-
-bool CBlockTreeDB::UpdateAddressUnspentIndex(const std::vector<std::pair<CAddressUnspentKey, CAddressUnspentValue > >&vect) {
-    CDBBatch batch(*this);
-    for (std::vector<std::pair<CAddressUnspentKey, CAddressUnspentValue> >::const_iterator it=vect.begin(); it!=vect.end(); it++) {
-        if (it->second.IsNull()) {
-            batch.Erase(std::make_pair(DB_ADDRESSUNSPENTINDEX, it->first));
-        } else {
-            batch.Write(std::make_pair(DB_ADDRESSUNSPENTINDEX, it->first), it->second);
-        }
-    }
-    return WriteBatch(batch);
+bool CBlockTreeDB::WriteFlag(const std::string &name, bool fValue) {
+    return Write(std::make_pair(DB_FLAG, name), fValue ? '1' : '0');
 }
 
-bool CBlockTreeDB::ReadAddressUnspentIndex(uint160 addressHash, int type, CAsset asset,
-                                           std::vector<std::pair<CAddressUnspentKey, CAddressUnspentValue> > &unspentOutputs) {
-
-    std::unique_ptr<CDBIterator> pcursor(NewIterator());
-
-    pcursor->Seek(std::make_pair(DB_ADDRESSUNSPENTINDEX, CAddressIndexIteratorKey(type, addressHash)));
-
-    while (pcursor->Valid()) {
-        std::pair<char,CAddressUnspentKey> key;
-        if (pcursor->GetKey(key) && key.first == DB_ADDRESSUNSPENTINDEX && key.second.hashBytes == addressHash) {
-            CAddressUnspentValue nValue;
-            if (pcursor->GetValue(nValue)) {
-                unspentOutputs.push_back(std::make_pair(key.second, nValue));
-                pcursor->Next();
-            } else {
-                return error("failed to get address unspent value");
-            }
-        } else {
-            break;
-        }
-    }
-
+bool CBlockTreeDB::ReadFlag(const std::string &name, bool &fValue) {
+    char ch;
+    if (!Read(std::make_pair(DB_FLAG, name), ch))
+        return false;
+    fValue = ch == '1';
     return true;
 }
 
-bool CBlockTreeDB::WriteAddressIndex(const std::vector<std::pair<CAddressIndexKey, CAmountMap > >&vect) {
-    CDBBatch batch(*this);
-    for (std::vector<std::pair<CAddressIndexKey, CAmountMap> >::const_iterator it=vect.begin(); it!=vect.end(); it++)
-        batch.Write(std::make_pair(DB_ADDRESSINDEX, it->first), it->second);
-    return WriteBatch(batch);
-}
-
-bool CBlockTreeDB::EraseAddressIndex(const std::vector<std::pair<CAddressIndexKey, CAmountMap > >&vect) {
-    CDBBatch batch(*this);
-    for (std::vector<std::pair<CAddressIndexKey, CAmountMap> >::const_iterator it=vect.begin(); it!=vect.end(); it++)
-        batch.Erase(std::make_pair(DB_ADDRESSINDEX, it->first));
-    return WriteBatch(batch);
-}
+//! Prefixes of the insight index records kept here before the indexes moved to indexes/
+static const char DB_LEGACY_INSIGHT_PREFIXES[] = {'a', 'u', 's', 'z', 'p', 'i'};
 
-bool CBlockTreeDB::ReadAddressIndex(uint160 addressHash, int type, CAsset asset,
-                                    std::vector<std::pair<CAddressIndexKey, CAmountMap> > &addressIndex,
-                                    int start, int end) {
-
-    std::unique_ptr<CDBIterator> pcursor(NewIterator());
+namespace {
+//! The bytes that follow the prefix of a key, whatever its type
+struct CRawKeySuffix
+{
+    std::vector<unsigned char> data;
 
-    if (start > 0 && end > 0) {
-        pcursor->Seek(std::make_pair(DB_ADDRESSINDEX, CAddressIndexIteratorHeightKey(type, addressHash, asset, start)));
-    } else {
-        pcursor->Seek(std::make_pair(DB_ADDRESSINDEX, CAddressIndexIteratorKey(type, addressHash)));
+    template <typename Stream>
+    void Serialize(Stream& s) const
+    {
+        s.write((const char*)data.data(), data.size());
     }
 
-    while (pcursor->Valid()) {
-        std::pair<char,CAddressIndexKey> key;
-        if (pcursor->GetKey(key) && key.first == DB_ADDRESSINDEX && key.second.hashBytes == addressHash) {
-            if (end > 0 && key.second.blockHeight > end) {
-                break;
-            }
-            CAmountMap nValue;
-            if (pcursor->GetValue(nValue)) {
-                addressIndex.push_back(std::make_pair(key.second, nValue));
-                pcursor->Next();
-            } else {
-                return error("failed to get address index value");
-            }
-        } else {
-            break;
-        }
+    template <typename Stream>
+    void Unserialize(Stream& s)
+    {
+        data.resize(s.size());
+        s.read((char*)data.data(), data.size());
     }
+};
+} // namespace
 
-    return true;
-}
-
-bool CBlockTreeDB::WriteTimestampIndex(const CTimestampIndexKey &timestampIndex) {
-    CDBBatch batch(*this);
-    batch.Write(std::make_pair(DB_TIMESTAMPINDEX, timestampIndex), 0);
-    return WriteBatch(batch);
-}
-
-bool CBlockTreeDB::ReadTimestampIndex(const unsigned int &high, const unsigned int &low, const bool fActiveOnly, std::vector<std::pair<uint256, unsigned int> > &hashes)
+bool CBlockTreeDB::EraseLegacyInsightIndexes()
 {
-    const std::unique_ptr<CDBIterator> pcursor(NewIterator());
-
-    pcursor->Seek(std::make_pair(DB_TIMESTAMPINDEX, CTimestampIndexIteratorKey(low)));
-
-    if (fActiveOnly) {
-        while (pcursor->Valid()) {
-            if (ShutdownRequested()) return false;
-            std::pair<char, CTimestampIndexKey> key;
-            if (pcursor->GetKey(key) && key.first == DB_TIMESTAMPINDEX && key.second.timestamp < high) {
-                if (HashOnchainActive(key.second.blockHash)) {
-                    hashes.push_back(std::make_pair(key.second.blockHash, key.second.timestamp));
-                }
-                pcursor->Next();
-            } else {
-                break;
+    const size_t batch_size = 1 << 24; // 16 MiB
+    bool fLogged = false;
+
+    for (const char prefix : DB_LEGACY_INSIGHT_PREFIXES) {
+        std::pair<char, CRawKeySuffix> key;
+        std::pair<char, CRawKeySuffix> begin_key{prefix, CRawKeySuffix()};
+        std::pair<char, CRawKeySuffix> prev_key = begin_key;
+        CDBBatch batch(*this);
+        int64_t count = 0;
+
+        std::unique_ptr<CDBIterator> cursor(NewIterator());
+        for (cursor->Seek(begin_key); cursor->Valid(); cursor->Next()) {
+            if (ShutdownRequested()) {
+                // Whatever is left is picked up again on the next start
+                WriteBatch(batch);
+                return false;
             }
-        }
-    } else {
-        while (pcursor->Valid()) {
-            if (ShutdownRequested()) return false;
-            std::pair<char, CTimestampIndexKey> key;
-            if (pcursor->GetKey(key) && key.first == DB_TIMESTAMPINDEX && key.second.timestamp < high) {
-                hashes.push_back(std::make_pair(key.second.blockHash, key.second.timestamp));
-                pcursor->Next();
-            } else {
+            if (!cursor->GetKey(key) || key.first != prefix) {
                 break;
             }
+            if (!fLogged) {
+                LogPrintf("Erasing the insight index records left in the block index database...\n");
+                fLogged = true;
+            }
+            batch.Erase(key);
+            count++;
+            if (batch.SizeEstimate() > batch_size) {
+                // Erasing under the cursor is fine, leveldb iterators work on a snapshot
+                WriteBatch(batch);
+                CompactRange(prev_key, key);
+                batch.Clear();
+                prev_key = key;
+            }
         }
-    }
-
-    return true;
-}
-
-bool CBlockTreeDB::WriteTimestampBlockIndex(const CTimestampBlockIndexKey &blockhashIndex, const CTimestampBlockIndexValue &logicalts) {
-    CDBBatch batch(*this);
-    batch.Write(std::make_pair(DB_BLOCKHASHINDEX, blockhashIndex), logicalts);
-    return WriteBatch(batch);
-}
-
-bool CBlockTreeDB::ReadTimestampBlockIndex(const uint256 &hash, unsigned int &ltimestamp) {
-
-    CTimestampBlockIndexValue lts;
-    if (!Read(std::make_pair(DB_BLOCKHASHINDEX, hash), lts))
-	return false;
-
-    ltimestamp = lts.ltimestamp;
-    return true;
-}
+        if (count == 0) continue;
 
-bool CBlockTreeDB::WriteBlockBalancesIndex(const uint256 &key, const BlockBalances &value)
-{
-    CDBBatch batch(*this);
-    batch.Write(std::make_pair(DB_BALANCESINDEX, key), value);
-    return WriteBatch(batch);
-}
-
-bool CBlockTreeDB::ReadBlockBalancesIndex(const uint256 &key, BlockBalances &value)
-{
-    return Read(std::make_pair(DB_BALANCESINDEX, key), value);
-}
-
-
-bool CBlockTreeDB::WriteFlag(const std::string &name, bool fValue) {
-    return Write(std::make_pair(DB_FLAG, name), fValue ? '1' : '0');
-}
+        WriteBatch(batch);
+        CompactRange(begin_key, std::make_pair((char)(prefix + 1), CRawKeySuffix()));
+        LogPrintf("Erased %d records with prefix '%c'\n", count, prefix);
+    }
 
-bool CBlockTreeDB::ReadFlag(const std::string &name, bool &fValue) {
-    char ch;
-    if (!Read(std::make_pair(DB_FLAG, name), ch))
-        return false;
-    fValue = ch == '1';
+    // Flags of the indexes that were kept in sync with the block index
+    for (const char* name : {"addressindex", "timestampindex", "spentindex", "balancesindex"}) {
+        Erase(std::make_pair(DB_FLAG, std::string(name)));
+    }
     return true;
 }
 
@@ -529,13 +632,23 @@ public:
 
 /** Upgrade the database from older formats.
  *
- * Currently implemented: from the per-tx utxo model (0.8..0.14.x) to per-txout.
+ * Currently implemented: from the per-tx utxo model (0.8..0.14.x) to per-txout,
+ * and from per-txout coins with a full asset to asset ordinals.
  */
 bool CCoinsViewDB::Upgrade() {
+    int nVersion = 0;
+    if (m_db->Read(DB_COINS_VERSION, nVersion) && nVersion > COINS_DB_VERSION_ASSET_ORDINALS) {
+        return error("%s: coin database format %d is newer than this version supports", __func__, nVersion);
+    }
+
     std::unique_ptr<CDBIterator> pcursor(m_db->NewIterator());
-    pcursor->Seek(std::make_pair(DB_COINS, uint256()));
-    if (!pcursor->Valid()) {
-        return true;
+    pcursor->Seek(DB_COINS_VERSION);
+    std::pair<unsigned char, uint256> key;
+    if (pcursor->Valid() && pcursor->GetKey(key) && key.first == DB_COINS && key.second.IsNull()) {
+        pcursor->Next();
+    }
+    if (!pcursor->Valid() || !pcursor->GetKey(key) || key.first != DB_COINS) {
+        return UpgradeAssetOrdinals();
     }
 
     int64_t count = 0;
@@ -545,7 +658,6 @@ bool CCoinsViewDB::Upgrade() {
     size_t batch_size = 1 << 24;
     CDBBatch batch(*m_db);
     int reportDone = 0;
-    std::pair<unsigned char, uint256> key;
     std::pair<unsigned char, uint256> prev_key = {DB_COINS, uint256()};
     while (pcursor->Valid()) {
         if (ShutdownRequested()) {
@@ -571,8 +683,7 @@ bool CCoinsViewDB::Upgrade() {
                 if (!old_coins.vout[i].IsNull() && !old_coins.vout[i].scriptPubKey.IsUnspendable()) {
                     Coin newcoin(std::move(old_coins.vout[i]), old_coins.nHeight, old_coins.fCoinBase, old_coins.fCoinStake);
                     outpoint.n = i;
-                    CoinEntry entry(&outpoint);
-                    batch.Write(entry, newcoin);
+                    WriteCoin(batch, outpoint, newcoin);
                 }
             }
             batch.Erase(key);
@@ -591,5 +702,75 @@ bool CCoinsViewDB::Upgrade() {
     m_db->CompactRange({DB_COINS, uint256()}, key);
     uiInterface.ShowProgress("", 100, false);
     LogPrintf("[%s].\n", ShutdownRequested() ? "CANCELLED" : "DONE");
+    return !ShutdownRequested() && UpgradeAssetOrdinals();
+}
+
+/** Move the per-txout coins which embed their full asset to the asset ordinal format.
+ *
+ * The format version is recorded first, so older versions refuse the database from the
+ * moment it starts changing. Each batch writes the new records together with the ordinals
+ * they use and erases the old ones, so an interrupted upgrade resumes where it stopped.
+ */
+bool CCoinsViewDB::UpgradeAssetOrdinals() {
+    if (!m_db->Exists(DB_COINS_VERSION) && !m_db->Write(DB_COINS_VERSION, COINS_DB_VERSION_ASSET_ORDINALS, true)) {
+        return error("%s: cannot write the coin database version", __func__);
+    }
+
+    std::unique_ptr<CDBIterator> pcursor(m_db->NewIterator());
+    pcursor->Seek(DB_COIN_FULL_ASSET);
+    COutPoint outpoint;
+    CoinEntry entry(&outpoint, DB_COIN_FULL_ASSET);
+    if (!pcursor->Valid() || !pcursor->GetKey(entry) || entry.key != DB_COIN_FULL_ASSET) {
+        return true;
+    }
+
+    int64_t count = 0;
+    int64_t nTimeStart = GetTimeMillis();
+    LogPrintf("Upgrading utxo-set database to asset ordinals...\n");
+    LogPrintf("[0%%]..."); /* Continued */
+    uiInterface.ShowProgress(_("Upgrading UTXO database").translated, 0, true);
+    size_t batch_size = 1 << 24;
+    CDBBatch batch(*m_db);
+    int reportDone = 0;
+    std::pair<char, uint256> prev_key = {DB_COIN_FULL_ASSET, uint256()};
+    std::pair<char, uint256> key = prev_key;
+    while (pcursor->Valid()) {
+        if (ShutdownRequested()) {
+            break;
+        }
+        if (pcursor->GetKey(entry) && entry.key == DB_COIN_FULL_ASSET) {
+            key.second = outpoint.hash;
+            if (count++ % 256 == 0) {
+                uint32_t high = 0x100 * *outpoint.hash.begin() + *(outpoint.hash.begin() + 1);
+                int percentageDone = (int)(high * 100.0 / 65536.0 + 0.5);
+                uiInterface.ShowProgress(_("Upgrading UTXO database").translated, percentageDone, true);
+                if (reportDone < percentageDone/10) {
+                    // report max. every 10% step
+                    LogPrintf("[%d%%]...", percentageDone); /* Continued */
+                    reportDone = percentageDone/10;
+                }
+            }
+            Coin coin;
+            if (!pcursor->GetValue(coin)) {
+                return error("%s: cannot parse Coin record", __func__);
+            }
+            WriteCoin(batch, outpoint, coin);
+            batch.Erase(entry);
+            if (batch.SizeEstimate() > batch_size) {
+                m_db->WriteBatch(batch);
+                batch.Clear();
+                m_db->CompactRange(prev_key, key);
+                prev_key = key;
+            }
+            pcursor->Next();
+        } else {
+            break;
+        }
+    }
+    m_db->WriteBatch(batch);
+    m_db->CompactRange({DB_COIN_FULL_ASSET, uint256()}, key);
+    uiInterface.ShowProgress("", 100, false);
+    LogPrintf("[%s].\n", ShutdownRequested() ? "CANCELLED" : "DONE");
+    LogPrintf("Upgraded %d coins to asset ordinals in %dms\n", count, GetTimeMillis() - nTimeStart);
     return !ShutdownRequested();
 }
@@ -9,12 +9,11 @@
 #include <coins.h>
 #include <dbwrapper.h>
 #include <chain.h>
-#include <insight/addressindex.h>
-#include <insight/spentindex.h>
-#include <insight/timestampindex.h>
-#include <insight/balanceindex.h>
 #include <primitives/block.h>
+#include <sync.h>
 
+#include <functional>
+#include <map>
 #include <memory>
 #include <string>
 #include <utility>
@@ -46,6 +45,38 @@ static const int64_t nMaxCoinsDBCache = 8;
 // Actually declared in validation.cpp; can't include because of circular dependency.
 extern RecursiveMutex cs_main;
 
+/**
+ * The distinct assets held by the coin database.
+ *
+ * Coins are stored with a compact code in place of their asset: 0 for the null asset, 1 for the
+ * consensus subsidy asset, otherwise the ordinal under which the full asset is recorded once in
+ * the database. Ordinals are assigned on first use and never reused.
+ */
+class CCoinsAssetOrdinals
+{
+public:
+    static constexpr uint64_t NULL_ASSET = 0;
+    static constexpr uint64_t SUBSIDY_ASSET = 1;
+    static constexpr uint64_t FIRST_ORDINAL = 2;
+
+    //! Read the recorded ordinals, replacing the current ones
+    bool Load(CDBWrapper& db);
+
+    //! Code of an asset, recording a new ordinal for it in batch if needed
+    uint64_t GetCode(const CAsset& asset, CDBBatch& batch);
+
+    //! Asset of a code, false if no such ordinal was recorded
+    bool GetAsset(uint64_t nCode, CAssetHandle& asset) const;
+
+private:
+    mutable Mutex cs;
+    CAssetHandle m_subsidy_asset GUARDED_BY(cs);
+    //! Asset of each ordinal, from FIRST_ORDINAL
+    std::vector<CAssetHandle> m_assets GUARDED_BY(cs);
+    //! Ordinals recorded for an asset ID, of assets which differ in their other fields
+    std::map<CAssetID, std::vector<uint64_t>> m_ordinals GUARDED_BY(cs);
+};
+
 /** CCoinsView backed by the coin database (chainstate/) */
 class CCoinsViewDB final : public CCoinsView
 {
@@ -53,6 +84,14 @@ protected:
     std::unique_ptr<CDBWrapper> m_db;
     fs::path m_ldb_path;
     bool m_is_memory;
+    CCoinsAssetOrdinals m_asset_ordinals;
+
+    //! Add a coin record, in the asset ordinal format, to batch
+    void WriteCoin(CDBBatch& batch, const COutPoint& outpoint, const Coin& coin);
+    //! Upgrade coin records with a full asset to the asset ordinal format
+    bool UpgradeAssetOrdinals();
+    //! Supply change waiting to be written together with the next batch of coins
+    CAmountMap m_asset_supply_pending;
 public:
     /**
      * @param[in] ldb_path    Location in the filesystem where leveldb data will be stored.
@@ -66,6 +105,19 @@ public:
     bool BatchWrite(CCoinsMap &mapCoins, const uint256 &hashBlock) override;
     CCoinsViewCursor *Cursor() const override;
 
+    /**
+     * Cursors over nRanges disjoint slices of the coin database, split on the first txid byte.
+     * They all read from one snapshot, so together they see a single consistent UTXO set
+     * as of the returned best block, whatever gets flushed meanwhile. The best block is null
+     * when the snapshot caught a flush half written.
+     */
+    std::vector<std::unique_ptr<CCoinsViewCursor>> RangeCursors(int nRanges) const;
+
+    bool GetAssetSupply(CAmountMap &supply) const override;
+    void AddAssetSupply(const CAmountMap &delta) override;
+    //! Replace the stored per asset supply, e.g. with the result of a full scan at the current best block
+    bool WriteAssetSupply(const CAmountMap &supply);
+
     //! Attempt to update from an older database format. Returns whether an error occurred.
     bool Upgrade();
     size_t EstimateSize() const override;
@@ -88,10 +140,15 @@ public:
     void Next() override;
 
 private:
-    CCoinsViewDBCursor(CDBIterator* pcursorIn, const uint256 &hashBlockIn):
-        CCoinsViewCursor(hashBlockIn), pcursor(pcursorIn) {}
+    CCoinsViewDBCursor(CDBIterator* pcursorIn, const CCoinsAssetOrdinals& asset_ordinals, const uint256 &hashBlockIn, int nEndByteIn = 256):
+        CCoinsViewCursor(hashBlockIn), pcursor(pcursorIn), m_asset_ordinals(asset_ordinals), nEndByte(nEndByteIn) {}
+    void ReadKey();
+
     std::unique_ptr<CDBIterator> pcursor;
+    const CCoinsAssetOrdinals& m_asset_ordinals;
     std::pair<char, COutPoint> keyTmp;
+    //! First txid byte past the range covered by this cursor
+    int nEndByte;
 
     friend class CCoinsViewDB;
 };
@@ -107,25 +164,10 @@ public:
     bool ReadLastBlockFile(int &nFile);
     bool WriteReindexing(bool fReindexing);
     void ReadReindexing(bool &fReindexing);
-    bool ReadSpentIndex(CSpentIndexKey &key, CSpentIndexValue &value);
-    bool UpdateSpentIndex(const std::vector<std::pair<CSpentIndexKey, CSpentIndexValue> >&vect);
-    bool UpdateAddressUnspentIndex(const std::vector<std::pair<CAddressUnspentKey, CAddressUnspentValue > >&vect);
-    bool ReadAddressUnspentIndex(uint160 addressHash, int type, CAsset asset,
-                                 std::vector<std::pair<CAddressUnspentKey, CAddressUnspentValue> > &vect);
-    bool WriteAddressIndex(const std::vector<std::pair<CAddressIndexKey, CAmountMap> > &vect);
-    bool EraseAddressIndex(const std::vector<std::pair<CAddressIndexKey, CAmountMap> > &vect);
-    bool ReadAddressIndex(uint160 addressHash, int type, CAsset asset,
-                          std::vector<std::pair<CAddressIndexKey, CAmountMap> > &addressIndex,
-                          int start = 0, int end = 0);
-    bool WriteTimestampIndex(const CTimestampIndexKey &timestampIndex);
-    bool ReadTimestampIndex(const unsigned int &high, const unsigned int &low, const bool fActiveOnly, std::vector<std::pair<uint256, unsigned int> > &vect) EXCLUSIVE_LOCKS_REQUIRED(cs_main);
-    bool WriteTimestampBlockIndex(const CTimestampBlockIndexKey &blockhashIndex, const CTimestampBlockIndexValue &logicalts);
-    bool ReadTimestampBlockIndex(const uint256 &hash, unsigned int &logicalTS);
-
-    bool WriteBlockBalancesIndex(const uint256 &key, const BlockBalances &value);
-    bool ReadBlockBalancesIndex(const uint256 &key, BlockBalances &value);
     bool WriteFlag(const std::string &name, bool fValue);
     bool ReadFlag(const std::string &name, bool &fValue);
+    //! Drop the insight index records from before the indexes had their own databases, false if interrupted
+    bool EraseLegacyInsightIndexes();
     bool LoadBlockIndexGuts(const Consensus::Params& consensusParams, std::function<CBlockIndex*(const uint256&, bool&)> insertBlockIndex);
 
 
@@ -441,7 +441,7 @@ void CTxMemPool::addAddressIndex(const CTxMemPoolEntry &entry, const CCoinsViewC
     }
 
     for (unsigned int k = 0; k < (tx.nVersion >= TX_ELE_VERSION ? tx.vpout.size() : tx.vout.size()); k++) {
-        const CTxOutAsset &out = (tx.nVersion >= TX_ELE_VERSION ? tx.vpout[k] : tx.vout[k]);
+        const CTxOutRef out = tx.GetOutputs()[k];
         if (out.scriptPubKey.IsPayToScriptHash()) {
             std::vector<unsigned char> hashBytes(out.scriptPubKey.begin()+2, out.scriptPubKey.begin()+22);
             CMempoolAddressDeltaKey key(2, uint160(hashBytes), txhash, k, 0);
@@ -812,7 +812,7 @@ void CTxMemPool::check(const CCoinsViewCache *pcoins) const
             indexed_transaction_set::const_iterator it2 = mapTx.find(txin.prevout.hash);
             if (it2 != mapTx.end()) {
                 const CTransaction& tx2 = it2->GetTx();
-                CTxOutAsset outc = (tx2.nVersion >= TX_ELE_VERSION ? tx2.vpout[txin.prevout.n] : tx2.vout[txin.prevout.n]);
+                const CTxOutRef outc = tx2.GetOutputs()[txin.prevout.n];
                 assert((tx2.nVersion >= TX_ELE_VERSION ? tx2.vpout.size() : tx2.vout.size()) > txin.prevout.n && !outc.IsNull());
                 fDependsWait = true;
                 setParentCheck.insert(*it2);
@@ -9,6 +9,7 @@
 
 #include <util/time.h>
 
+#include <compat.h>
 #include <util/check.h>
 
 #include <atomic>
@@ -78,6 +79,26 @@ int64_t GetSystemTimeInSeconds()
     return GetTimeMicros()/1000000;
 }
 
+int64_t GetThreadCPUTimeMicros()
+{
+#ifdef WIN32
+    FILETIME creation, exit, kernel, user;
+    if (!GetThreadTimes(GetCurrentThread(), &creation, &exit, &kernel, &user))
+        return 0;
+    // In 100 nanosecond intervals
+    const uint64_t nKernel = (uint64_t{kernel.dwHighDateTime} << 32) | kernel.dwLowDateTime;
+    const uint64_t nUser = (uint64_t{user.dwHighDateTime} << 32) | user.dwLowDateTime;
+    return (nKernel + nUser) / 10;
+#elif defined(CLOCK_THREAD_CPUTIME_ID)
+    struct timespec ts;
+    if (clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts) != 0)
+        return 0;
+    return int64_t{ts.tv_sec} * 1000000 + ts.tv_nsec / 1000;
+#else
+    return 0;
+#endif
+}
+
 std::string FormatISO8601DateTime(int64_t nTime) {
     struct tm ts;
     time_t time_val = nTime;
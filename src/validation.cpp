@@ -153,7 +153,7 @@ CChain& ChainActive()
 RecursiveMutex cs_main;
 
 int nLastStakeAttempt{0};
-std::map<uint256, int64_t> mapRejectedBlocks;
+std::map<uint256, CRejectedBlock> mapRejectedBlocks;
 std::map<PointerHash, uint256> mapUsedStakePointers;
 ProofTracker* g_proofTracker = new ProofTracker();
 CBlockIndex *pindexBestHeader = nullptr;
@@ -631,7 +631,7 @@ bool MemPoolAccept::PreChecks(ATMPArgs& args, Workspace& ws)
     { //data checking is done here
         bool fHasFee = false;
         for (unsigned int k = 0; k < (tx.nVersion >= TX_ELE_VERSION ? tx.vpout.size() : tx.vout.size()) ; k++){
-            const CTxOutAsset &txout = (tx.nVersion >= TX_ELE_VERSION ? tx.vpout[k] : tx.vout[k]);
+            const CTxOutRef txout = tx.GetOutputs()[k];
 
             bool sub_address = false;
             sub_address = txout.scriptPubKey == Params().GetConsensus().mandatory_coinbase_destination;
@@ -1920,10 +1920,6 @@ DisconnectResult CChainState::DisconnectBlock(const CBlock& block, const CBlockI
         return DISCONNECT_FAILED;
     }
 
-    std::vector<std::pair<CAddressIndexKey, CAmountMap> > addressIndex;
-    std::vector<std::pair<CAddressUnspentKey, CAddressUnspentValue> > addressUnspentIndex;
-    std::vector<std::pair<CSpentIndexKey, CSpentIndexValue> > spentIndex;
-
     if (!UndoNftTxsInBlock(block, pindex)) {
         return DISCONNECT_FAILED;
     }
@@ -1936,29 +1932,6 @@ DisconnectResult CChainState::DisconnectBlock(const CBlock& block, const CBlockI
         bool is_coinstake = tx.IsCoinStake();
         //LogPrintf("0 %s \n", fClean ? "true": "false");
 
-        if (g_txindex) {
-
-            //CAmount assetAmount;
-            uint160 hashBytes;
-            for (unsigned int k = (tx.nVersion >= TX_ELE_VERSION ? tx.vpout.size() : tx.vout.size()); k-- > 0;) {
-                const CTxOutAsset &out = (tx.nVersion >= TX_ELE_VERSION ? tx.vpout[k] : tx.vout[k]);
-                const CScript *pScript;
-                std::vector<unsigned char> hashBytes;
-                int scriptType = 0;
-                CAmount nValue;
-                CAsset nAsset;
-                if (!ExtractIndexInfo(&out, scriptType, hashBytes, nValue, nAsset, pScript)
-                    || scriptType == 0) {
-                    continue;
-                }
-                CAmountMap p{{out.nAsset, out.nValue}};
-                // undo receiving activity
-                addressIndex.push_back(std::make_pair(CAddressIndexKey(scriptType, Hash160(hashBytes), out.nAsset, pindex->nHeight, i, hash, k, false), p));
-                // undo unspent index
-                addressUnspentIndex.push_back(std::make_pair(CAddressUnspentKey(scriptType, Hash160(hashBytes), out.nAsset, hash, k), CAddressUnspentValue()));
-            }
-        }
-
         if(tx.nVersion >= TX_ELE_VERSION){
             for (size_t o = 0; o < tx.vpout.size(); o++) {
                 if (!tx.vpout[o].scriptPubKey.IsUnspendable()) {
@@ -2005,31 +1978,6 @@ DisconnectResult CChainState::DisconnectBlock(const CBlock& block, const CBlockI
                 int res = ApplyTxInUndo(std::move(txundo.vprevout[j]), view, out);
                 if (res == DISCONNECT_FAILED) return DISCONNECT_FAILED;
                 fClean = fClean && res != DISCONNECT_UNCLEAN;
-
-                const CTxIn input = tx.vin[j];
-
-                if (g_txindex) {
-                    // undo and delete the spent index
-                    spentIndex.push_back(std::make_pair(CSpentIndexKey(input.prevout.hash, input.prevout.n), CSpentIndexValue()));
-                }
-
-                if (fAddressIndex) {
-                    const Coin &coin = view.AccessCoin(tx.vin[j].prevout);
-                    const CTxOutAsset &prevout = coin.out;
-                    const CScript *pScript = &prevout.scriptPubKey;
-
-                    std::vector<uint8_t> hashBytes;
-                    int scriptType = 0;
-                    if (!ExtractIndexInfo(pScript, scriptType, hashBytes)
-                        || scriptType == 0) {
-                        continue;
-                    }
-                    CAmountMap p{{prevout.nAsset, prevout.nValue}};
-
-                    addressIndex.push_back(std::make_pair(CAddressIndexKey(scriptType, uint160(hashBytes), prevout.nAsset, pindex->nHeight, i, hash, j, false), p));
-                    addressUnspentIndex.push_back(std::make_pair(CAddressUnspentKey(scriptType, uint160(hashBytes), prevout.nAsset, hash, j), CAddressUnspentValue()));
-                }
-
             }
             // At this point, all of txundo.vprevout should have been moved out.
         }
@@ -2037,21 +1985,6 @@ DisconnectResult CChainState::DisconnectBlock(const CBlock& block, const CBlockI
     //LogPrintf("2 %s \n", fClean ? "true": "false");
 
 
-    if (g_txindex) {
-        if (!pblocktree->UpdateSpentIndex(spentIndex)) {
-            AbortNode("Failed to delete spent index");
-            return DISCONNECT_FAILED;
-        }
-        if (!pblocktree->EraseAddressIndex(addressIndex)) {
-            AbortNode("Failed to delete address index");
-            return DISCONNECT_FAILED;
-        }
-        if (!pblocktree->UpdateAddressUnspentIndex(addressUnspentIndex)) {
-            AbortNode("Failed to write address unspent index");
-            return DISCONNECT_FAILED;
-        }
-    }
-
     // Undo stake pointer
     if (pindex->IsProofOfStake()) {
         COutPoint stakeSource(pindex->stakeSource.first, pindex->stakeSource.second);
@@ -2305,7 +2238,7 @@ bool CheckBlockProofPointer(const CBlockIndex* pindex, const CBlock& block, CPub
                 return error("%s: vout too small", __func__);
 
             CTxDestination dest;
-            const CTxOutAsset &rout = (tx->nVersion >= TX_ELE_VERSION ? tx->vpout[stakePointer.nPos] : tx->vout[stakePointer.nPos]);
+            const CTxOutRef rout = tx->GetOutputs()[stakePointer.nPos];
             if (!ExtractDestination(rout.scriptPubKey, dest))
                 return error("%s: failed to get destination from scriptPubKey", __func__);
 
@@ -2349,7 +2282,7 @@ bool CheckStake(const CBlockIndex* pindex, const CBlock& block, uint256& hashPro
 
     AssertLockHeld(cs_main);
     //Coinbase has to be 0 value
-    const CTxOutAsset &rout = (block.vtx[0]->nVersion >= TX_ELE_VERSION ? block.vtx[0]->vpout[0] : block.vtx[0]->vout[0]);
+    const CTxOutRef rout = block.vtx[0]->GetOutputs()[0];
 
     if (rout.nValue > 0){
         errormsg = "Coinbase output 0 must have 0 value";
@@ -2624,9 +2557,6 @@ bool CChainState::ConnectBlock(const CBlock& block, BlockValidationState& state,
     int nInputs = 0;
     int64_t nSigOpsCost = 0;
     blockundo.vtxundo.reserve(block.vtx.size() - 1);
-    std::vector<std::pair<CAddressIndexKey, CAmountMap> > addressIndex;
-    std::vector<std::pair<CAddressUnspentKey, CAddressUnspentValue> > addressUnspentIndex;
-    std::vector<std::pair<CSpentIndexKey, CSpentIndexValue> > spentIndex;
 
     std::vector<PrecomputedTransactionData> txdata;
     txdata.reserve(block.vtx.size()); // Required so that pointers to individual PrecomputedTransactionData don't get invalidated
@@ -2634,13 +2564,9 @@ bool CChainState::ConnectBlock(const CBlock& block, BlockValidationState& state,
     CAmountMap nValueOutMap;
     CAmountMap nValueInMap;
 
-    CAmount block_balances[3] = {0};
-    bool reset_balances = false;
-
     for (unsigned int i = 0; i < block.vtx.size(); i++)
     {
         const CTransaction &tx = *(block.vtx[i]);
-        const uint256 txhash = tx.GetHash();
 
         nInputs += tx.vin.size();
 
@@ -2672,40 +2598,8 @@ bool CChainState::ConnectBlock(const CBlock& block, BlockValidationState& state,
                 return state.Invalid(BlockValidationResult::BLOCK_CONSENSUS, "bad-txns-nonfinal");
             }
 
-            if (g_txindex)
-            {
-                for (size_t j = 0; j < tx.vin.size(); j++) {
-                    const CTxIn input = tx.vin[j];
-                    const Coin& coin = view.AccessCoin(tx.vin[j].prevout);
-                    const CTxOutAsset &prevout = coin.out; //(tx.nVersion >= TX_ELE_VERSION ? coin.out2 : coin.out);
-
-                    const CScript *pScript = &prevout.scriptPubKey;
-                    std::vector<uint8_t> hashBytes;
-                    int scriptType = 0;
-
-                    if (!ExtractIndexInfo(pScript, scriptType, hashBytes)
-                        || scriptType == 0) {
-                        continue;
-                    }
-
-                    if (g_txindex && scriptType > 0) {
-                        // record spending activity
-                        CAmountMap p{{prevout.nAsset, prevout.nValue}};
-
-                        addressIndex.push_back(std::make_pair(CAddressIndexKey(scriptType, uint160(hashBytes), prevout.nAsset, pindex->nHeight, i, txhash, j, true), p));
-                        // remove address from unspent index
-                        addressUnspentIndex.push_back(std::make_pair(CAddressUnspentKey(scriptType, uint160(hashBytes), prevout.nAsset, input.prevout.hash, input.prevout.n), CAddressUnspentValue()));
-                    }
-                    if (fSpentIndex) {
-                        // add the spent index to determine the txid and input that spent an output
-                        // and to find the amount and address from an input
-                        spentIndex.push_back(std::make_pair(CSpentIndexKey(input.prevout.hash, input.prevout.n), CSpentIndexValue(txhash, j, pindex->nHeight, prevout.nValue, prevout.nAsset, scriptType, uint160(hashBytes))));
-                    }
-                }
-
-                if (smsg::fSecMsgEnabled && tx_state.m_funds_smsg) {
-                    smsgModule.StoreFundingTx(tx, pindex);
-                }
+            if (g_txindex && smsg::fSecMsgEnabled && tx_state.m_funds_smsg) {
+                smsgModule.StoreFundingTx(tx, pindex);
             }
         }
 
@@ -2734,26 +2628,6 @@ bool CChainState::ConnectBlock(const CBlock& block, BlockValidationState& state,
             control.Add(vChecks);
         }
 
-        if (g_txindex) {
-            for (unsigned int k = 0; k <  (tx.nVersion >= TX_ELE_VERSION ? tx.vpout.size() : tx.vout.size()) ; k++) {
-                const CTxOutAsset &out = (tx.nVersion >= TX_ELE_VERSION ? tx.vpout[k] : tx.vout[k]);
-
-                const CScript *pScript;
-                std::vector<unsigned char> hashBytes;
-                int scriptType = 0;
-                CAmount nValue;
-                CAsset nAsset;
-                if (!ExtractIndexInfo(&out, scriptType, hashBytes, nValue, nAsset, pScript) || scriptType == 0) {
-                    continue;
-                }
-
-                // Record receiving activity
-                view.addressIndex.push_back(std::make_pair(CAddressIndexKey(scriptType, uint160(hashBytes), out.nAsset, pindex->nHeight, i, txhash, k, false), out.nValue));
-                // Record unspent output
-                view.addressUnspentIndex.push_back(std::make_pair(CAddressUnspentKey(scriptType, uint160(hashBytes), out.nAsset, txhash, k), CAddressUnspentValue(out.nValue, out.nAsset, out.scriptPubKey, pindex->nHeight)));
-            }
-        }
-
         nValueOutMap += tx.GetValueOutMap();
 
         if(!tx.IsCoinBase())
@@ -2780,14 +2654,20 @@ bool CChainState::ConnectBlock(const CBlock& block, BlockValidationState& state,
         blockCreated += block.vtx[1]->GetValueOut();
 
     if (!IsBlockValueValid(block, blockReward)) {
+        if (!fJustCheck)
+            RecordRejectedBlock(pindex, "bad-cb-amount");
         return state.Invalid(BlockValidationResult::BLOCK_CONSENSUS, "bad-cb-amount");
     }
 
     if(!IsBlockPayeeValid(blockCreated, *block.vtx[0], nHeight, block.nTime, pindex->pprev->nTime)) {
+        if (!fJustCheck)
+            RecordRejectedBlock(pindex, "bad-mn-payee");
         return state.Invalid(BlockValidationResult::BLOCK_CONSENSUS, "bad-mn-payee");
     }
 
     if(!SNIsBlockPayeeValid(blockCreated, *block.vtx[0], nHeight, block.nTime, pindex->pprev->nTime)) {
+        if (!fJustCheck)
+            RecordRejectedBlock(pindex, "bad-sn-payee");
         return state.Invalid(BlockValidationResult::BLOCK_CONSENSUS, "bad-sn-payee");
     }
 
@@ -2939,35 +2819,6 @@ bool CChainState::ConnectBlock(const CBlock& block, BlockValidationState& state,
         mapUsedStakePointers.emplace(stakeSource.GetHash(), block.GetHash());
     }
 
-    if (g_txindex) {
-
-        if (!pblocktree->WriteAddressIndex(addressIndex)) {
-            return AbortNode(state, "Failed to write address index");
-        }
-
-        if (!pblocktree->UpdateAddressUnspentIndex(addressUnspentIndex)) {
-            return AbortNode(state, "Failed to write address unspent index");
-        }
-
-        if (!pblocktree->UpdateSpentIndex(spentIndex))
-            return AbortNode(state, "Failed to write transaction index");
-
-        unsigned int logicalTS = pindex->nTime;
-        if (!pblocktree->WriteTimestampIndex(CTimestampIndexKey(logicalTS, pindex->GetBlockHash()))) {
-            return AbortNode(state, "Failed to write timestamp index");
-        }
-
-        if (!pblocktree->WriteTimestampBlockIndex(CTimestampBlockIndexKey(pindex->GetBlockHash()), CTimestampBlockIndexValue(logicalTS))) {
-            return AbortNode(state, "Failed to write blockhash index");
-        }
-
-        BlockBalances values(block_balances);
-
-        if (!pblocktree->WriteBlockBalancesIndex(block.GetHash(), values)) {
-            return AbortNode(state, "Failed to write balances index");
-        }
-    }
-
     assert(pindex->phashBlock);
     // add this block to the view's block chain
     view.SetBestBlock(pindex->GetBlockHash());
@@ -3000,7 +2851,8 @@ CoinsCacheSizeState CChainState::GetCoinsCacheSizeState(
     size_t max_mempool_size_bytes)
 {
     const int64_t nMempoolUsage = tx_pool ? tx_pool->DynamicMemoryUsage() : 0;
-    int64_t cacheSize = CoinsTip().DynamicMemoryUsage();
+    // the coins only point to their asset, most interned assets are held for them
+    int64_t cacheSize = CoinsTip().DynamicMemoryUsage() + CAssetHandle::DynamicMemoryUsage();
     int64_t nTotalSpace =
         max_coins_cache_size_bytes + std::max<int64_t>(max_mempool_size_bytes - nMempoolUsage, 0);
 
@@ -3919,6 +3771,22 @@ void ResetBlockFailureFlags(CBlockIndex *pindex) {
     return ::ChainstateActive().ResetBlockFailureFlags(pindex);
 }
 
+void RecordRejectedBlock(const CBlockIndex* pindex, const std::string& strReason, const uint256& hashConflictTx)
+{
+    AssertLockHeld(cs_main);
+
+    // Only recent rejections can become valid again, forget the ones far behind this block
+    auto it = mapRejectedBlocks.begin();
+    while (it != mapRejectedBlocks.end()) {
+        if (it->second.nHeight < pindex->nHeight - MAX_REJECTED_BLOCK_DEPTH)
+            it = mapRejectedBlocks.erase(it);
+        else
+            ++it;
+    }
+
+    mapRejectedBlocks[pindex->GetBlockHash()] = CRejectedBlock{GetTime(), pindex->nHeight, strReason, hashConflictTx};
+}
+
 CBlockIndex* BlockManager::AddToBlockIndex(const CBlockHeader& block, bool fProofOfStake)
 {
     AssertLockHeld(cs_main);
@@ -5024,20 +4892,6 @@ bool static LoadBlockIndexDB(ChainstateManager& chainman, const CChainParams& ch
     pblocktree->ReadReindexing(fReindexing);
     if(fReindexing) fReindex = true;
 
-    // Check whether we have an address index
-    pblocktree->ReadFlag("addressindex", fAddressIndex);
-    LogPrintf("%s: address index %s\n", __func__, fAddressIndex ? "enabled" : "disabled");
-
-    // Check whether we have a timestamp index
-    pblocktree->ReadFlag("timestampindex", fTimestampIndex);
-    LogPrintf("%s: timestamp index %s\n", __func__, fTimestampIndex ? "enabled" : "disabled");
-
-    // Check whether we have a spent index
-    pblocktree->ReadFlag("spentindex", fSpentIndex);
-    LogPrintf("%s: spent index %s\n", __func__, fSpentIndex ? "enabled" : "disabled");
-    pblocktree->ReadFlag("balancesindex", fBalancesIndex);
-    LogPrintf("%s: balances index %s\n", __func__, fBalancesIndex ? "enabled" : "disabled");
-
     return true;
 }
 
@@ -5463,24 +5317,6 @@ bool ChainstateManager::LoadBlockIndex(const CChainParams& chainparams)
         // needs_init.
 
         LogPrintf("Initializing databases...\n");
-
-        // Use the provided setting for -addressindex in the new database
-        fAddressIndex = gArgs.GetBoolArg("-addressindex", DEFAULT_ADDRESSINDEX);
-        pblocktree->WriteFlag("addressindex", fAddressIndex);
-        LogPrintf("%s: address index %s\n", __func__, fAddressIndex ? "enabled" : "disabled");
-
-        // Use the provided setting for -timestampindex in the new database
-        fTimestampIndex = gArgs.GetBoolArg("-timestampindex", DEFAULT_TIMESTAMPINDEX);
-        pblocktree->WriteFlag("timestampindex", fTimestampIndex);
-        LogPrintf("%s: timestamp index %s\n", __func__, fTimestampIndex ? "enabled" : "disabled");
-
-        // Use the provided setting for -spentindex in the new database
-        fSpentIndex = gArgs.GetBoolArg("-spentindex", DEFAULT_SPENTINDEX);
-        pblocktree->WriteFlag("spentindex", fSpentIndex);
-        LogPrintf("%s: spent index %s\n", __func__, fSpentIndex ? "enabled" : "disabled");
-        fBalancesIndex = gArgs.GetBoolArg("-balancesindex", DEFAULT_BALANCESINDEX);
-        pblocktree->WriteFlag("balancesindex", fBalancesIndex);
-        LogPrintf("%s: balances index %s\n", __func__, fBalancesIndex ? "enabled" : "disabled");
     }
     return true;
 }
@@ -5521,11 +5357,6 @@ void LoadExternalBlockFile(const CChainParams& chainparams, FILE* fileIn, FlatFi
     static std::multimap<uint256, FlatFilePos> mapBlocksUnknownParent;
     int64_t nStart = GetTimeMillis();
 
-    fAddressIndex = gArgs.GetBoolArg("-addressindex", DEFAULT_ADDRESSINDEX);
-    fTimestampIndex = gArgs.GetBoolArg("-timestampindex", DEFAULT_TIMESTAMPINDEX);
-    fSpentIndex = gArgs.GetBoolArg("-spentindex", DEFAULT_SPENTINDEX);
-    fBalancesIndex = gArgs.GetBoolArg("-balancesindex", DEFAULT_BALANCESINDEX);
-
     int nLoaded = 0;
     try {
         // This takes over fileIn and calls fclose() on it in the CBufferedFile destructor
@@ -89,6 +89,8 @@ static const int DEFAULT_STOPATHEIGHT = 0;
 static const unsigned int MIN_BLOCKS_TO_KEEP = 288;
 static const signed int DEFAULT_CHECKBLOCKS = 6;
 static const unsigned int DEFAULT_CHECKLEVEL = 3;
+/** Rejected blocks this far below the newest rejection are no longer kept for reconsideration */
+static const int MAX_REJECTED_BLOCK_DEPTH = 100;
 // Require that user allocate at least 550 MiB for block & undo files (blk???.dat and rev???.dat)
 // At 1MB per block, 288 blocks = 288MB.
 // Add 15% for Undo data = 331MB
@@ -121,7 +123,17 @@ enum class SynchronizationState {
 
 extern RecursiveMutex cs_main;
 extern CBlockPolicyEstimator feeEstimator;
-extern std::map<uint256, int64_t> mapRejectedBlocks;
+/** A block that failed a check depending on masternode data, sporks or tx locks, kept so it can be reconsidered */
+struct CRejectedBlock
+{
+    int64_t nTime;
+    int nHeight;
+    std::string strReason;
+    uint256 hashConflictTx; //! tx lock the block conflicted with, null if it was not rejected for a lock
+};
+extern std::map<uint256, CRejectedBlock> mapRejectedBlocks GUARDED_BY(cs_main);
+/** Remember why pindex was rejected, so that only the blocks affected by a later lock or spork change are reconsidered */
+void RecordRejectedBlock(const CBlockIndex* pindex, const std::string& strReason, const uint256& hashConflictTx = uint256()) EXCLUSIVE_LOCKS_REQUIRED(cs_main);
 typedef std::unordered_map<uint256, CBlockIndex*, BlockHasher> BlockMap;
 extern Mutex g_best_block_mutex;
 extern std::condition_variable g_best_block_cv;
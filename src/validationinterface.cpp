@@ -258,3 +258,8 @@ void CMainSignals::NewPoWValidBlock(const CBlockIndex *pindex, const std::shared
 void CMainSignals::NewSecureMessage(const smsg::SecureMessage *psmsg, const uint160 &hash) {
     m_internals->Iterate([&](CValidationInterface& callbacks) { callbacks.NewSecureMessage(psmsg, hash); });
 }
+
+void CMainSignals::SporkUpdated(int nSporkID, int64_t nValue) {
+    LOG_EVENT("%s: spork=%d value=%d", __func__, nSporkID, nValue);
+    m_internals->Iterate([&](CValidationInterface& callbacks) { callbacks.SporkUpdated(nSporkID, nValue); });
+}
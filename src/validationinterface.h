@@ -179,6 +179,11 @@ protected:
     virtual void NewPoWValidBlock(const CBlockIndex *pindex, const std::shared_ptr<const CBlock>& block) {};
 
     virtual void NewSecureMessage(const smsg::SecureMessage *psmsg, const uint160 &hash) {};
+    /**
+     * Notifies listeners that a spork got a new value, for subsystems caching state derived from it.
+     * Called synchronously on the thread that accepted the spork.
+     */
+    virtual void SporkUpdated(int nSporkID, int64_t nValue) {};
 
     friend class CMainSignals;
 };
@@ -214,6 +219,7 @@ public:
     void NewPoWValidBlock(const CBlockIndex *, const std::shared_ptr<const CBlock>&);
 
     void NewSecureMessage(const smsg::SecureMessage *psmsg, const uint160 &hash);
+    void SporkUpdated(int nSporkID, int64_t nValue);
 };
 
 CMainSignals& GetMainSignals();
@@ -1963,7 +1963,12 @@ bool CWalletTx::SubmitMemoryPoolAndRelay(std::string& err_string, bool relay, bo
             ExtractDestination((this->tx->nVersion >= TX_ELE_VERSION ? this->tx->vpout[0].scriptPubKey : this->tx->vout[0].scriptPubKey) , dest);
             LogPrintf("CWalletTx::RelayWalletTransaction() - Instantsend to address: %s\n", EncodeDestination(dest));
         }
-        instantSend.CreateNewLock(*(const CMutableTransaction*)this);
+        // The lock request is only kept for a transaction the mempool took
+        if (!pwallet->chain().broadcastTransaction(tx, pwallet->m_default_max_tx_fee, false, err_string))
+            return false;
+        fInMempool = true;
+        if (instantSend.CreateNewLock(this->tx) != 0)
+            instantSend.AddLockRequest(this->tx);
         RelayTransactionLockReq(this->tx);
         return true;
     }
@@ -3758,12 +3763,12 @@ bool CWallet::CreateTransactionInternal(
     uint8_t vers = datar.GetVersion();
     switch (vers) {
         case OUTPUT_DATA:{
-            OUTPUT_PTR<CTxData> out0 = MAKE_OUTPUT<CTxData>();
+            CTxData out0;
             CTxData *s = (CTxData*) &datar;
-            out0->nType = s->nType;
-            out0->vData = s->vData;
-            if (out0->vData.size() > 0)
-                txNew.vdata.push_back(out0);
+            out0.nType = s->nType;
+            out0.vData = s->vData;
+            if (out0.vData.size() > 0)
+                txNew.vdata.emplace_back(std::move(out0));
             break;
         }
     }